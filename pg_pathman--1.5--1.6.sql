@@ -0,0 +1,588 @@
+/*
+ * Columns to be summarized by zone maps.
+ */
+ALTER TABLE @extschema@.pathman_config_params
+ADD COLUMN zone_map_columns TEXT[] DEFAULT NULL;
+
+/*
+ * Number of unused RANGE partitions to be kept ahead of data.
+ */
+ALTER TABLE @extschema@.pathman_config_params
+ADD COLUMN premake INTEGER NOT NULL DEFAULT 0 CHECK (premake >= 0);
+
+/*
+ * Create only the partition needed for a new value (no intermediate ones).
+ */
+ALTER TABLE @extschema@.pathman_config_params
+ADD COLUMN spawn_sparse BOOLEAN NOT NULL DEFAULT FALSE;
+
+
+/*
+ * Zone maps: min/max summaries of non-key columns (one row per partition & column).
+ *		partrel			- parent table
+ *		partition		- summarized partition
+ *		attname			- summarized column
+ *		atttype			- type of column at the moment of refresh
+ *		valid			- FALSE if partition has been modified since last refresh
+ *		min_value		- min value of column as string (NULL if there are none)
+ *		max_value		- max value of column as string (NULL if there are none)
+ */
+CREATE TABLE @extschema@.pathman_zone_maps (
+	partrel			REGCLASS NOT NULL,
+	partition		REGCLASS NOT NULL,
+	attname			TEXT NOT NULL,
+	atttype			REGTYPE NOT NULL,
+	valid			BOOLEAN NOT NULL DEFAULT FALSE,
+	min_value		TEXT DEFAULT NULL,
+	max_value		TEXT DEFAULT NULL,
+
+	PRIMARY KEY (partition, attname)
+);
+
+GRANT SELECT, INSERT, UPDATE, DELETE
+ON @extschema@.pathman_zone_maps
+TO public;
+
+CREATE POLICY deny_modification ON @extschema@.pathman_zone_maps
+FOR ALL USING (check_security_policy(partrel));
+
+CREATE POLICY allow_select ON @extschema@.pathman_zone_maps FOR SELECT USING (true);
+
+/* Writers of a partition mark its summaries as invalid before commit */
+CREATE POLICY allow_invalidation ON @extschema@.pathman_zone_maps
+FOR UPDATE USING (pg_catalog.has_table_privilege(partition::OID, 'INSERT, UPDATE'))
+WITH CHECK (NOT valid);
+
+ALTER TABLE @extschema@.pathman_zone_maps ENABLE ROW LEVEL SECURITY;
+
+CREATE TRIGGER pathman_zone_maps_trigger
+AFTER INSERT OR UPDATE OR DELETE ON @extschema@.pathman_zone_maps
+FOR EACH ROW EXECUTE PROCEDURE @extschema@.pathman_config_params_trigger_func();
+
+SELECT pg_catalog.pg_extension_config_dump('@extschema@.pathman_zone_maps', '');
+
+
+/*
+ * Set columns to be summarized by zone maps (NULL disables zone maps)
+ */
+CREATE FUNCTION @extschema@.set_zone_map_columns(
+	relation	REGCLASS,
+	columns		TEXT[])
+RETURNS VOID AS $$
+DECLARE
+	col			TEXT;
+	col_type	REGTYPE;
+
+BEGIN
+	PERFORM @extschema@.validate_relname(relation);
+
+	FOREACH col IN ARRAY COALESCE(columns, '{}')
+	LOOP
+		SELECT atttypid FROM pg_catalog.pg_attribute
+		WHERE attrelid = relation AND attname = col AND
+			  attnum > 0 AND NOT attisdropped
+		INTO col_type;
+
+		IF col_type IS NULL THEN
+			RAISE EXCEPTION 'column "%" of relation "%" does not exist',
+							col, relation;
+		END IF;
+
+		IF NOT @extschema@.is_operator_supported(col_type, '<') THEN
+			RAISE EXCEPTION 'column "%" of type % cannot be summarized',
+							col, col_type;
+		END IF;
+	END LOOP;
+
+	/* Forget summaries of columns which are not needed anymore */
+	DELETE FROM @extschema@.pathman_zone_maps
+	WHERE partrel = relation AND attname != ALL(COALESCE(columns, '{}'));
+
+	PERFORM @extschema@.pathman_set_param(relation, 'zone_map_columns', columns);
+END
+$$ LANGUAGE plpgsql;
+
+
+/*
+ * Recompute zone maps of all partitions of 'parent_relid'
+ * (or of 'partition_relid' only). Returns number of processed partitions.
+ *
+ * NOTE: text representations of min & max values have to be read
+ * by any backend, hence ISO DateStyle & exact float digits.
+ */
+CREATE FUNCTION @extschema@.refresh_zone_maps(
+	parent_relid	REGCLASS,
+	partition_relid	REGCLASS DEFAULT NULL)
+RETURNS INTEGER AS $$
+DECLARE
+	columns			TEXT[];
+	col				TEXT;
+	col_type		REGTYPE;
+	part			REGCLASS;
+	v_min			TEXT;
+	v_max			TEXT;
+	v_count			INTEGER := 0;
+
+BEGIN
+	PERFORM @extschema@.validate_relname(parent_relid);
+
+	SELECT zone_map_columns FROM @extschema@.pathman_config_params
+	WHERE partrel = parent_relid
+	INTO columns;
+
+	/* Forget summaries of partitions which are not attached anymore */
+	DELETE FROM @extschema@.pathman_zone_maps zm
+	WHERE zm.partrel = parent_relid AND
+		  NOT EXISTS (SELECT 1 FROM pg_catalog.pg_inherits
+					  WHERE inhparent = parent_relid AND
+							inhrelid = zm.partition::OID);
+
+	IF columns IS NULL THEN
+		RETURN 0;
+	END IF;
+
+	FOR part IN (SELECT inhrelid::REGCLASS FROM pg_catalog.pg_inherits
+				 WHERE inhparent = parent_relid AND
+					   (partition_relid IS NULL OR inhrelid = partition_relid::OID)
+				 ORDER BY inhrelid)
+	LOOP
+		/* Block writers (and other refreshes) till we commit */
+		EXECUTE pg_catalog.format('LOCK TABLE %s IN SHARE ROW EXCLUSIVE MODE', part);
+
+		/* Any modification of partition will invalidate its zone map */
+		IF NOT EXISTS (SELECT 1 FROM pg_catalog.pg_trigger
+					   WHERE tgrelid = part::OID AND
+							 tgname = 'pathman_zone_map_trigger') THEN
+			EXECUTE pg_catalog.format('CREATE TRIGGER pathman_zone_map_trigger
+									   AFTER INSERT OR UPDATE ON %s
+									   FOR EACH ROW EXECUTE PROCEDURE
+									   @extschema@.pathman_zone_map_trigger_func()',
+									  part);
+		END IF;
+
+		FOREACH col IN ARRAY columns
+		LOOP
+			SELECT atttypid FROM pg_catalog.pg_attribute
+			WHERE attrelid = part AND attname = col AND
+				  attnum > 0 AND NOT attisdropped
+			INTO col_type;
+
+			/* Column might have been dropped */
+			CONTINUE WHEN col_type IS NULL;
+
+			EXECUTE pg_catalog.format('SELECT (SELECT %1$I::TEXT FROM %2$s
+											   WHERE %1$I IS NOT NULL
+											   ORDER BY %1$I LIMIT 1),
+											  (SELECT %1$I::TEXT FROM %2$s
+											   WHERE %1$I IS NOT NULL
+											   ORDER BY %1$I DESC LIMIT 1)',
+									  col, part)
+			INTO v_min, v_max;
+
+			INSERT INTO @extschema@.pathman_zone_maps
+				(partrel, partition, attname, atttype, valid, min_value, max_value)
+			VALUES (parent_relid, part, col, col_type, true, v_min, v_max)
+			ON CONFLICT (partition, attname) DO UPDATE
+			SET atttype = col_type, valid = true,
+				min_value = v_min, max_value = v_max;
+		END LOOP;
+
+		v_count := v_count + 1;
+	END LOOP;
+
+	RETURN v_count;
+END
+$$ LANGUAGE plpgsql
+SET DateStyle = 'ISO'
+SET IntervalStyle = 'postgres'
+SET extra_float_digits = 3;
+
+/*
+ * Refresh zone maps using RefreshZoneMapsWorker (one transaction per partition).
+ */
+CREATE FUNCTION @extschema@.refresh_zone_maps_concurrently(
+	relation		REGCLASS)
+RETURNS VOID AS 'pg_pathman', 'refresh_zone_maps_concurrently'
+LANGUAGE C STRICT;
+
+/*
+ * Load rows of a server-side file using ParallelCopyWorkers.
+ * NOTE: rows are committed by workers, not by caller's transaction.
+ */
+CREATE FUNCTION @extschema@.copy_from_parallel(
+	relation		REGCLASS,
+	filename		TEXT,
+	workers			INTEGER DEFAULT 2)
+RETURNS BIGINT AS 'pg_pathman', 'copy_from_parallel'
+LANGUAGE C STRICT;
+
+/*
+ * Set 'spawn sparse' option
+ */
+CREATE FUNCTION @extschema@.set_spawn_sparse(
+	relation	REGCLASS,
+	value		BOOLEAN)
+RETURNS VOID AS $$
+BEGIN
+	PERFORM @extschema@.pathman_set_param(relation, 'spawn_sparse', value);
+END
+$$ LANGUAGE plpgsql STRICT;
+
+/*
+ * Set number of unused RANGE partitions to be kept ahead of data
+ */
+CREATE FUNCTION @extschema@.set_premake(
+	relation	REGCLASS,
+	value		INTEGER)
+RETURNS VOID AS $$
+BEGIN
+	IF value < 0 THEN
+		RAISE EXCEPTION 'premake should not be less than 0';
+	END IF;
+
+	PERFORM @extschema@.pathman_set_param(relation, 'premake', value);
+END
+$$ LANGUAGE plpgsql STRICT;
+
+/*
+ * Append partitions, so that there are 'premake' (see pathman_config_params)
+ * unused partitions after the last used one. Returns number of new partitions.
+ */
+CREATE FUNCTION @extschema@.premake_range_partitions(
+	parent_relid	REGCLASS)
+RETURNS INTEGER AS 'pg_pathman', 'premake_range_partitions'
+LANGUAGE C STRICT;
+
+/*
+ * Start ProvisioningWorker which calls premake_range_partitions()
+ * for each table with 'premake' > 0 every 'naptime' seconds.
+ */
+CREATE FUNCTION @extschema@.start_provisioning_worker(
+	naptime			FLOAT8 DEFAULT 60.0)
+RETURNS VOID AS 'pg_pathman', 'start_provisioning_worker'
+LANGUAGE C STRICT;
+
+/*
+ * Stop ProvisioningWorker of current database.
+ */
+CREATE FUNCTION @extschema@.stop_provisioning_worker()
+RETURNS BOOL AS 'pg_pathman', 'stop_provisioning_worker'
+LANGUAGE C STRICT;
+
+/*
+ * Show how many partitions have been created on INSERT and ahead of time.
+ */
+CREATE FUNCTION @extschema@.show_spawn_stats(
+	OUT backend_spawns	INT8,
+	OUT bgw_spawns		INT8,
+	OUT premade			INT8)
+RETURNS RECORD AS 'pg_pathman', 'show_spawn_stats_internal'
+LANGUAGE C STRICT;
+
+/*
+ * View for show_spawn_stats().
+ */
+CREATE VIEW @extschema@.pathman_spawn_stats
+AS SELECT * FROM @extschema@.show_spawn_stats();
+
+GRANT SELECT ON @extschema@.pathman_spawn_stats TO PUBLIC;
+
+/*
+ * Show how many partitions the last COPY FROM has opened and closed.
+ */
+CREATE FUNCTION @extschema@.show_copy_stats(
+	OUT parent				REGCLASS,
+	OUT partitions_opened	INT8,
+	OUT partitions_evicted	INT8)
+RETURNS RECORD AS 'pg_pathman', 'show_copy_stats_internal'
+LANGUAGE C STRICT;
+
+/*
+ * View for show_copy_stats().
+ */
+CREATE VIEW @extschema@.pathman_copy_stats
+AS SELECT * FROM @extschema@.show_copy_stats();
+
+GRANT SELECT ON @extschema@.pathman_copy_stats TO PUBLIC;
+
+/*
+ * Show long-lived SpawnPartitionsWorkers.
+ */
+CREATE FUNCTION @extschema@.show_spawn_workers()
+RETURNS TABLE (
+	userid		REGROLE,
+	pid			INT,
+	dbid		OID,
+	relid		REGCLASS,
+	processed	INT8,
+	status		TEXT)
+AS 'pg_pathman', 'show_spawn_workers_internal'
+LANGUAGE C STRICT;
+
+/*
+ * View for show_spawn_workers().
+ */
+CREATE VIEW @extschema@.pathman_spawn_workers
+AS SELECT * FROM @extschema@.show_spawn_workers();
+
+GRANT SELECT ON @extschema@.pathman_spawn_workers TO PUBLIC;
+
+/*
+ * Invalidate zone map of a partition if new row doesn't fit it.
+ */
+CREATE FUNCTION @extschema@.pathman_zone_map_trigger_func()
+RETURNS TRIGGER AS 'pg_pathman', 'pathman_zone_map_trigger_func'
+LANGUAGE C;
+
+
+/*
+ * Monotonic (non-decreasing) functions of partitioning expression.
+ *		transform		- monotonic function
+ *		key_arg			- number of monotonic argument (starting with 1)
+ *		lower_bound		- returns min X such that transform(X) >= value
+ *		upper_bound		- returns min X such that transform(X) > value
+ *						  (NULL if lower_bound is an inverse of transform)
+ *		builtin			- TRUE for rows created by pg_pathman
+ *
+ * Bound functions take the same args as transform, only
+ * the monotonic one is replaced with a value of its result type.
+ */
+CREATE TABLE @extschema@.pathman_monotonic_transforms (
+	transform		REGPROCEDURE PRIMARY KEY,
+	key_arg			INT4 NOT NULL DEFAULT 1 CHECK (key_arg > 0),
+	lower_bound		REGPROCEDURE DEFAULT NULL,
+	upper_bound		REGPROCEDURE DEFAULT NULL,
+	builtin			BOOLEAN NOT NULL DEFAULT FALSE
+);
+
+GRANT SELECT ON @extschema@.pathman_monotonic_transforms TO public;
+
+/*
+ * Bounds for date_trunc(field, KEY).
+ */
+CREATE FUNCTION @extschema@.date_trunc_upper_bound(
+	field		TEXT,
+	value		TIMESTAMP)
+RETURNS TIMESTAMP AS $$
+	SELECT pg_catalog.date_trunc(field, value) +
+		   CASE WHEN pg_catalog.lower(field) IN ('quarter', 'quarters')
+				THEN '3 months'::INTERVAL
+				ELSE ('1 ' || field)::INTERVAL
+		   END;
+$$ LANGUAGE sql IMMUTABLE STRICT;
+
+CREATE FUNCTION @extschema@.date_trunc_lower_bound(
+	field		TEXT,
+	value		TIMESTAMP)
+RETURNS TIMESTAMP AS $$
+	SELECT CASE WHEN pg_catalog.date_trunc(field, value) = value
+				THEN value
+				ELSE @extschema@.date_trunc_upper_bound(field, value)
+		   END;
+$$ LANGUAGE sql IMMUTABLE STRICT;
+
+CREATE FUNCTION @extschema@.date_trunc_upper_bound(
+	field		TEXT,
+	value		TIMESTAMPTZ)
+RETURNS TIMESTAMPTZ AS $$
+	SELECT pg_catalog.date_trunc(field, value) +
+		   CASE WHEN pg_catalog.lower(field) IN ('quarter', 'quarters')
+				THEN '3 months'::INTERVAL
+				ELSE ('1 ' || field)::INTERVAL
+		   END;
+$$ LANGUAGE sql STABLE STRICT;
+
+CREATE FUNCTION @extschema@.date_trunc_lower_bound(
+	field		TEXT,
+	value		TIMESTAMPTZ)
+RETURNS TIMESTAMPTZ AS $$
+	SELECT CASE WHEN pg_catalog.date_trunc(field, value) = value
+				THEN value
+				ELSE @extschema@.date_trunc_upper_bound(field, value)
+		   END;
+$$ LANGUAGE sql STABLE STRICT;
+
+/*
+ * Bounds for KEY::DATE.
+ */
+CREATE FUNCTION @extschema@.timestamp_date_lower_bound(value DATE)
+RETURNS TIMESTAMP AS $$ SELECT value::TIMESTAMP; $$
+LANGUAGE sql IMMUTABLE STRICT;
+
+CREATE FUNCTION @extschema@.timestamp_date_upper_bound(value DATE)
+RETURNS TIMESTAMP AS $$ SELECT (value + 1)::TIMESTAMP; $$
+LANGUAGE sql IMMUTABLE STRICT;
+
+CREATE FUNCTION @extschema@.timestamptz_date_lower_bound(value DATE)
+RETURNS TIMESTAMPTZ AS $$ SELECT value::TIMESTAMPTZ; $$
+LANGUAGE sql STABLE STRICT;
+
+CREATE FUNCTION @extschema@.timestamptz_date_upper_bound(value DATE)
+RETURNS TIMESTAMPTZ AS $$ SELECT (value + 1)::TIMESTAMPTZ; $$
+LANGUAGE sql STABLE STRICT;
+
+/*
+ * Bounds for KEY::TIMESTAMP (KEY is DATE).
+ */
+CREATE FUNCTION @extschema@.date_timestamp_upper_bound(value TIMESTAMP)
+RETURNS DATE AS $$ SELECT value::DATE + 1; $$
+LANGUAGE sql IMMUTABLE STRICT;
+
+CREATE FUNCTION @extschema@.date_timestamp_lower_bound(value TIMESTAMP)
+RETURNS DATE AS $$
+	SELECT CASE WHEN value::DATE::TIMESTAMP = value
+				THEN value::DATE
+				ELSE value::DATE + 1
+		   END;
+$$ LANGUAGE sql IMMUTABLE STRICT;
+
+INSERT INTO @extschema@.pathman_monotonic_transforms
+VALUES ('pg_catalog.date_trunc(text, timestamp)', 2,
+		'@extschema@.date_trunc_lower_bound(text, timestamp)',
+		'@extschema@.date_trunc_upper_bound(text, timestamp)', true),
+	   ('pg_catalog.date_trunc(text, timestamptz)', 2,
+		'@extschema@.date_trunc_lower_bound(text, timestamptz)',
+		'@extschema@.date_trunc_upper_bound(text, timestamptz)', true),
+	   ('pg_catalog.date(timestamp)', 1,
+		'@extschema@.timestamp_date_lower_bound(date)',
+		'@extschema@.timestamp_date_upper_bound(date)', true),
+	   ('pg_catalog.date(timestamptz)', 1,
+		'@extschema@.timestamptz_date_lower_bound(date)',
+		'@extschema@.timestamptz_date_upper_bound(date)', true),
+	   ('pg_catalog."timestamp"(date)', 1,
+		'@extschema@.date_timestamp_lower_bound(timestamp)',
+		'@extschema@.date_timestamp_upper_bound(timestamp)', true);
+
+/*
+ * Invalidate cached transforms and plans that might depend on them.
+ */
+CREATE FUNCTION @extschema@.pathman_monotonic_transforms_trigger_func()
+RETURNS TRIGGER AS 'pg_pathman', 'pathman_monotonic_transforms_trigger_func'
+LANGUAGE C;
+
+CREATE TRIGGER pathman_monotonic_transforms_trigger
+AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE
+ON @extschema@.pathman_monotonic_transforms
+FOR EACH STATEMENT EXECUTE PROCEDURE
+@extschema@.pathman_monotonic_transforms_trigger_func();
+
+SELECT pg_catalog.pg_extension_config_dump('@extschema@.pathman_monotonic_transforms',
+										   'WHERE NOT builtin');
+
+/*
+ * Register a monotonic function of partitioning expression.
+ */
+CREATE FUNCTION @extschema@.add_monotonic_transform(
+	transform		REGPROCEDURE,
+	key_arg			INT4 DEFAULT 1,
+	lower_bound		REGPROCEDURE DEFAULT NULL,
+	upper_bound		REGPROCEDURE DEFAULT NULL)
+RETURNS VOID AS $$
+DECLARE
+	func			RECORD;
+	bound			REGPROCEDURE;
+	bound_func		RECORD;
+
+BEGIN
+	IF transform IS NULL THEN
+		RAISE EXCEPTION 'transform should not be NULL';
+	END IF;
+
+	SELECT * FROM pg_catalog.pg_proc WHERE oid = transform INTO func;
+
+	IF func.provolatile = 'v' THEN
+		RAISE EXCEPTION 'transform should not be volatile';
+	END IF;
+
+	IF key_arg IS NULL OR key_arg < 1 OR key_arg > func.pronargs THEN
+		RAISE EXCEPTION 'key_arg should be between 1 and %', func.pronargs;
+	END IF;
+
+	IF lower_bound IS NULL AND upper_bound IS NOT NULL THEN
+		RAISE EXCEPTION 'upper_bound requires lower_bound';
+	END IF;
+
+	FOREACH bound IN ARRAY ARRAY[lower_bound, upper_bound]
+	LOOP
+		CONTINUE WHEN bound IS NULL;
+
+		SELECT * FROM pg_catalog.pg_proc WHERE oid = bound INTO bound_func;
+
+		IF bound_func.provolatile = 'v' THEN
+			RAISE EXCEPTION 'function % should not be volatile', bound;
+		END IF;
+
+		IF bound_func.pronargs != func.pronargs OR
+		   bound_func.proargtypes[key_arg - 1] != func.prorettype OR
+		   bound_func.prorettype != func.proargtypes[key_arg - 1] THEN
+			RAISE EXCEPTION 'function % does not match signature of %',
+							bound, transform;
+		END IF;
+	END LOOP;
+
+	INSERT INTO @extschema@.pathman_monotonic_transforms
+	VALUES (transform, key_arg, lower_bound, upper_bound, false);
+END
+$$ LANGUAGE plpgsql;
+
+/*
+ * Unregister a monotonic function.
+ */
+CREATE FUNCTION @extschema@.remove_monotonic_transform(
+	transform		REGPROCEDURE)
+RETURNS VOID AS $$
+BEGIN
+	DELETE FROM @extschema@.pathman_monotonic_transforms mt
+	WHERE mt.transform = remove_monotonic_transform.transform;
+
+	IF NOT FOUND THEN
+		RAISE EXCEPTION 'function % is not registered', transform;
+	END IF;
+END
+$$ LANGUAGE plpgsql STRICT;
+
+
+CREATE OR REPLACE FUNCTION @extschema@.disable_pathman_for(
+	parent_relid	REGCLASS)
+RETURNS VOID AS $$
+BEGIN
+	PERFORM @extschema@.validate_relname(parent_relid);
+
+	/* Delete rows from all config tables */
+	DELETE FROM @extschema@.pathman_config WHERE partrel = parent_relid;
+	DELETE FROM @extschema@.pathman_config_params WHERE partrel = parent_relid;
+	DELETE FROM @extschema@.pathman_zone_maps WHERE partrel = parent_relid;
+END
+$$ LANGUAGE plpgsql STRICT;
+
+
+CREATE OR REPLACE FUNCTION @extschema@.pathman_ddl_trigger_func()
+RETURNS event_trigger AS $$
+DECLARE
+	obj				RECORD;
+	pg_class_oid	OID;
+	relids			REGCLASS[];
+
+BEGIN
+	pg_class_oid = 'pg_catalog.pg_class'::regclass;
+
+	/* Find relids to remove from config */
+	SELECT pg_catalog.array_agg(cfg.partrel) INTO relids
+	FROM pg_catalog.pg_event_trigger_dropped_objects() AS events
+	JOIN @extschema@.pathman_config AS cfg ON cfg.partrel::oid = events.objid
+	WHERE events.classid = pg_class_oid AND events.objsubid = 0;
+
+	/* Cleanup pathman_config */
+	DELETE FROM @extschema@.pathman_config WHERE partrel = ANY(relids);
+
+	/* Cleanup params table too */
+	DELETE FROM @extschema@.pathman_config_params WHERE partrel = ANY(relids);
+
+	/* Cleanup zone maps of both parents and dropped partitions */
+	DELETE FROM @extschema@.pathman_zone_maps
+	WHERE partrel = ANY(relids) OR partition::OID IN
+		(SELECT events.objid
+		 FROM pg_catalog.pg_event_trigger_dropped_objects() AS events
+		 WHERE events.classid = pg_class_oid AND events.objsubid = 0);
+END
+$$ LANGUAGE plpgsql;
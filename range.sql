@@ -801,6 +801,15 @@ CREATE FUNCTION @extschema@.drop_range_partition_expand_next(
 RETURNS VOID AS 'pg_pathman', 'drop_range_partition_expand_next'
 LANGUAGE C STRICT;
 
+/*
+ * Append partitions, so that there are 'premake' (see pathman_config_params)
+ * unused partitions after the last used one. Returns number of new partitions.
+ */
+CREATE FUNCTION @extschema@.premake_range_partitions(
+	parent_relid	REGCLASS)
+RETURNS INTEGER AS 'pg_pathman', 'premake_range_partitions'
+LANGUAGE C STRICT;
+
 CREATE FUNCTION @extschema@.create_range_partitions_internal(
 	parent_relid	REGCLASS,
 	bounds			ANYARRAY,
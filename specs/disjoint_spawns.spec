@@ -0,0 +1,32 @@
+setup
+{
+	CREATE EXTENSION pg_pathman;
+	CREATE TABLE range_rel(id INT4 NOT NULL);
+	SELECT create_range_partitions('range_rel', 'id', 1, 100, 1);
+}
+
+teardown
+{
+	DROP TABLE range_rel CASCADE;
+	DROP EXTENSION pg_pathman;
+}
+
+session "s1"
+step "s1_bgw"				{ SELECT set_spawn_using_bgw('range_rel', true); }
+step "s1b"					{ BEGIN; }
+step "s1_insert_150"		{ INSERT INTO range_rel VALUES (150); }
+step "s1c"					{ COMMIT; }
+
+session "s2"
+step "s2b"					{ BEGIN; }
+step "s2_insert_neg_50"		{ INSERT INTO range_rel VALUES (-50); }
+step "s2c"					{ COMMIT; }
+step "s2_show_partitions"	{ SELECT partition, range_min, range_max FROM pathman_partition_list
+							  WHERE parent = 'range_rel'::REGCLASS
+							  ORDER BY range_min::INT4; }
+
+# SpawnPartitionsWorkers create disjoint partitions without waiting for each other
+permutation "s1_bgw" "s1b" "s1_insert_150" "s2b" "s2_insert_neg_50" "s2c" "s1c" "s2_show_partitions"
+
+# Backends keep the parent's lock till commit, so the second one has to wait
+permutation "s1b" "s1_insert_150" "s2b" "s2_insert_neg_50" "s1c" "s2c" "s2_show_partitions"
@@ -145,5 +145,113 @@ DROP TABLE test_bgw.conc_part CASCADE;
 
 
 
+/*
+ * Test ahead-of-time provisioning of partitions ('premake')
+ */
+CREATE TABLE test_bgw.premake(val INT4 NOT NULL);
+SELECT create_range_partitions('test_bgw.premake', 'val', 1, 10, 2);
+SELECT set_premake('test_bgw.premake', 2);
+SELECT premake_range_partitions('test_bgw.premake');		/* nothing to do */
+INSERT INTO test_bgw.premake VALUES (5);
+SELECT premake_range_partitions('test_bgw.premake');		/* 1 partition */
+INSERT INTO test_bgw.premake VALUES (25);				/* no spawn */
+SELECT premake_range_partitions('test_bgw.premake');		/* 2 partitions */
+SELECT partition, range_min, range_max
+FROM pathman_partition_list
+WHERE parent = 'test_bgw.premake'::REGCLASS
+ORDER BY range_min::INT4;
+SELECT premade >= 3 FROM pathman_spawn_stats;
+DROP TABLE test_bgw.premake CASCADE;
+
+
+
+/*
+ * Test sparse and bulk creation of partitions
+ */
+CREATE TABLE test_bgw.sparse(val INT4 NOT NULL);
+SELECT create_range_partitions('test_bgw.sparse', 'val', 1, 10, 2);
+SELECT set_spawn_sparse('test_bgw.sparse', true);
+INSERT INTO test_bgw.sparse VALUES (95);				/* only [91, 101) */
+INSERT INTO test_bgw.sparse VALUES (45);				/* fill the gap */
+INSERT INTO test_bgw.sparse VALUES (-15);				/* only [-19, -9) */
+SELECT set_spawn_sparse('test_bgw.sparse', false);
+INSERT INTO test_bgw.sparse VALUES (135);				/* 4 partitions at once */
+INSERT INTO test_bgw.sparse VALUES (55);				/* ERROR: gap */
+SELECT val, tableoid::REGCLASS FROM test_bgw.sparse ORDER BY val;
+SELECT partition, range_min, range_max
+FROM pathman_partition_list
+WHERE parent = 'test_bgw.sparse'::REGCLASS
+ORDER BY range_min::INT4;
+DROP TABLE test_bgw.sparse CASCADE;
+
+
+
+/*
+ * Test asynchronous creation of partitions
+ */
+CREATE TABLE test_bgw.async(val INT4 NOT NULL);
+SELECT create_range_partitions('test_bgw.async', 'val', 1, 10, 2);
+SELECT set_spawn_using_bgw('test_bgw.async', true);
+SET pg_pathman.enable_async_spawn = t;
+INSERT INTO test_bgw.async SELECT generate_series(1, 45);
+SELECT tableoid::REGCLASS, count(*), min(val), max(val)
+FROM test_bgw.async GROUP BY 1 ORDER BY 3;
+SELECT partition, range_min, range_max
+FROM pathman_partition_list
+WHERE parent = 'test_bgw.async'::REGCLASS
+ORDER BY range_min::INT4;
+DROP TABLE test_bgw.async CASCADE;
+
+/* Other rows are inserted while BGW is creating a partition */
+CREATE TABLE test_bgw.async_log(id SERIAL, val INT4);
+
+CREATE OR REPLACE FUNCTION test_bgw.log_row()
+RETURNS TRIGGER AS $$
+BEGIN
+	INSERT INTO test_bgw.async_log(val) VALUES (NEW.val);
+	RETURN NEW;
+END
+$$ language plpgsql;
+
+CREATE OR REPLACE FUNCTION test_bgw.slow_init(args JSONB)
+RETURNS VOID AS $$
+BEGIN
+	EXECUTE format('CREATE TRIGGER log_row BEFORE INSERT ON %I.%I
+					FOR EACH ROW EXECUTE PROCEDURE test_bgw.log_row()',
+				   args->>'partition_schema', args->>'partition');
+	PERFORM pg_sleep(1);
+END
+$$ language plpgsql;
+
+CREATE TABLE test_bgw.async_order(val INT4 NOT NULL);
+SELECT create_range_partitions('test_bgw.async_order', 'val', 1, 10, 2);
+CREATE TRIGGER log_row BEFORE INSERT ON test_bgw.async_order_1
+FOR EACH ROW EXECUTE PROCEDURE test_bgw.log_row();
+CREATE TRIGGER log_row BEFORE INSERT ON test_bgw.async_order_2
+FOR EACH ROW EXECUTE PROCEDURE test_bgw.log_row();
+SELECT set_spawn_using_bgw('test_bgw.async_order', true);
+SELECT set_init_callback('test_bgw.async_order', 'test_bgw.slow_init(jsonb)');
+INSERT INTO test_bgw.async_order VALUES (1), (25), (2), (3);
+SELECT array_agg(val ORDER BY id) FROM test_bgw.async_log; /* 25 should be the last one */
+
+RESET pg_pathman.enable_async_spawn;
+DROP TABLE test_bgw.async_order CASCADE;
+DROP TABLE test_bgw.async_log;
+DROP FUNCTION test_bgw.slow_init(JSONB);
+DROP FUNCTION test_bgw.log_row();
+
+/* parallel COPY of a tiny file, some workers get no rows at all */
+CREATE TABLE test_bgw.tiny_copy(val INT4 NOT NULL);
+SELECT create_hash_partitions('test_bgw.tiny_copy', 'val', 2);
+COPY (SELECT generate_series(1, 3)) TO '/tmp/pathman_tiny_copy.txt';
+SELECT copy_from_parallel('test_bgw.tiny_copy', '/tmp/pathman_tiny_copy.txt', 32);
+SELECT count(*) FROM test_bgw.tiny_copy;
+DROP TABLE test_bgw.tiny_copy CASCADE;
+
+/* pool of SpawnPartitionsWorkers is disabled by default */
+SELECT count(*) FROM pathman_spawn_workers;
+
+
+
 DROP SCHEMA test_bgw;
 DROP EXTENSION pg_pathman;
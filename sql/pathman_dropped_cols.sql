@@ -100,5 +100,18 @@ EXPLAIN (COSTS OFF) EXECUTE getbyroot(2);
 
 DEALLOCATE getbyroot;
 DROP TABLE root_dict CASCADE;
+/* translations of columns are cached along with bounds */
+CREATE TABLE dropped_cols.test_trans(a INT, b TEXT, key INT NOT NULL);
+ALTER TABLE dropped_cols.test_trans DROP COLUMN a;
+SELECT create_range_partitions('dropped_cols.test_trans', 'key', 1, 10, 2);
+ALTER TABLE dropped_cols.test_trans ADD COLUMN c INT;
+SELECT append_range_partition('dropped_cols.test_trans');
+INSERT INTO dropped_cols.test_trans SELECT i::TEXT, i, i * 10 FROM generate_series(1, 30) i;
+SELECT * FROM dropped_cols.test_trans WHERE key IN (5, 15, 25) ORDER BY key;
+SELECT * FROM dropped_cols.test_trans WHERE key IN (5, 15, 25) ORDER BY key;
+ALTER TABLE dropped_cols.test_trans DROP COLUMN b;
+SELECT * FROM dropped_cols.test_trans WHERE key IN (5, 15, 25) ORDER BY key;
+DROP TABLE dropped_cols.test_trans CASCADE;
+
 DROP SCHEMA dropped_cols;
 DROP EXTENSION pg_pathman;
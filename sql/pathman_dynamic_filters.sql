@@ -0,0 +1,84 @@
+\set VERBOSITY terse
+SET search_path = 'public';
+CREATE SCHEMA pathman;
+CREATE EXTENSION pg_pathman SCHEMA pathman;
+CREATE SCHEMA test;
+
+CREATE TABLE test.fact(id INT4 NOT NULL, val TEXT);
+SELECT pathman.create_range_partitions('test.fact', 'id', 1, 100, 10);
+INSERT INTO test.fact SELECT g, g::TEXT FROM generate_series(1, 1000) AS g;
+
+CREATE TABLE test.dim(id INT4, name TEXT);
+INSERT INTO test.dim VALUES (150, 'a'), (750, 'b');
+VACUUM ANALYZE;
+
+/* Returns partitions scanned by RuntimeAppend on the probe side of HashJoin */
+create or replace function test.dynamic_filter_test(query text) returns text as $$
+declare
+	plan jsonb;
+	result text;
+begin
+	execute 'explain (analyze, format json) ' || query into plan;
+
+	if (plan->0->'Plan'->>'Node Type') is distinct from 'Hash Join' then
+		raise exception 'wrong plan type';
+	end if;
+
+	if (plan->0->'Plan'->'Plans'->0->>'Custom Plan Provider') is distinct from 'RuntimeAppend' then
+		raise exception 'wrong outer plan provider';
+	end if;
+
+	if (plan->0->'Plan'->'Plans'->1->'Plans'->0->>'Custom Plan Provider') is distinct from 'DynamicFilterSource' then
+		raise exception 'wrong inner plan provider';
+	end if;
+
+	select string_agg(child->>'Relation Name', ', ' order by child->>'Relation Name')
+	from jsonb_array_elements(plan->0->'Plan'->'Plans'->0->'Plans') child
+	into result;
+
+	return result;
+end;
+$$ language plpgsql;
+
+SET enable_nestloop = OFF;
+SET enable_mergejoin = OFF;
+SET pg_pathman.enable_dynamic_filters = ON;
+
+/* Only partitions containing keys of test.dim should be scanned */
+SELECT test.dynamic_filter_test('SELECT * FROM test.fact f JOIN test.dim d ON f.id = d.id');
+SELECT * FROM test.fact f JOIN test.dim d ON f.id = d.id ORDER BY f.id;
+
+/* Keys which don't belong to any partition are ignored */
+INSERT INTO test.dim VALUES (5000, 'c'), (NULL, 'd'), (160, 'e');
+SELECT test.dynamic_filter_test('SELECT * FROM test.fact f JOIN test.dim d ON f.id = d.id');
+SELECT * FROM test.fact f JOIN test.dim d ON f.id = d.id ORDER BY f.id;
+
+/* IN (subquery) is planned as a semi-join or a join with unique keys */
+SELECT test.dynamic_filter_test('SELECT * FROM test.fact WHERE id IN (SELECT id FROM test.dim)');
+SELECT * FROM test.fact WHERE id IN (SELECT id FROM test.dim) ORDER BY id;
+
+/* HASH partitions are supported as well */
+CREATE TABLE test.hash_fact(id INT4 NOT NULL, val TEXT);
+SELECT pathman.create_hash_partitions('test.hash_fact', 'id', 10);
+INSERT INTO test.hash_fact SELECT g, g::TEXT FROM generate_series(1, 1000) AS g;
+ANALYZE test.hash_fact;
+SELECT test.dynamic_filter_test('SELECT * FROM test.hash_fact WHERE id IN (SELECT id FROM test.dim)') =
+	   (SELECT string_agg(DISTINCT format('hash_fact_%s', pathman.get_hash_part_idx(hashint4(id), 10)), ', ')
+		FROM test.dim WHERE id IS NOT NULL) AS ok;
+SELECT * FROM test.hash_fact WHERE id IN (SELECT id FROM test.dim) ORDER BY id;
+
+/* Every partition is scanned if the filter is disabled */
+SET pg_pathman.enable_dynamic_filters = OFF;
+SELECT test.dynamic_filter_test('SELECT * FROM test.fact f JOIN test.dim d ON f.id = d.id');
+
+RESET pg_pathman.enable_dynamic_filters;
+RESET enable_mergejoin;
+RESET enable_nestloop;
+
+DROP TABLE test.fact CASCADE;
+DROP TABLE test.hash_fact CASCADE;
+DROP TABLE test.dim;
+DROP FUNCTION test.dynamic_filter_test(text);
+DROP SCHEMA test;
+DROP EXTENSION pg_pathman CASCADE;
+DROP SCHEMA pathman;
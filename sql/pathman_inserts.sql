@@ -223,6 +223,60 @@ DROP TABLE test_inserts.special_2;
 DROP TABLE test_inserts.test_special_only CASCADE;
 
 
+/* batched inserts */
+SET pg_pathman.enable_batch_inserts = t;
+CREATE TABLE test_inserts.test_batch(val INT NOT NULL, comment TEXT);
+CREATE INDEX ON test_inserts.test_batch(val);
+SELECT create_range_partitions('test_inserts.test_batch', 'val', 1, 1000, 3);
+CREATE FUNCTION test_inserts.batch_stats(query TEXT) RETURNS SETOF TEXT AS $$
+DECLARE
+	plan	JSONB;
+
+BEGIN
+	EXECUTE 'EXPLAIN (ANALYZE, FORMAT JSON) ' || query INTO plan;
+
+	RETURN QUERY
+		SELECT format('%s: rows=%s batches=%s',
+					  part->>'Relation Name', part->>'Rows', part->>'Batches')
+		FROM jsonb_array_elements(plan->0->'Plan'->'Plans'->0->'Batched Inserts') part;
+END
+$$ LANGUAGE plpgsql;
+SELECT * FROM test_inserts.batch_stats('INSERT INTO test_inserts.test_batch SELECT generate_series(1, 2500)');
+SELECT tableoid::REGCLASS, count(*) FROM test_inserts.test_batch GROUP BY 1 ORDER BY 1;
+SELECT * FROM test_inserts.test_batch WHERE val = 1500;
+/* ModifyTable doesn't see batched tuples, but they are counted */
+DO $$
+DECLARE
+	n	INT;
+
+BEGIN
+	INSERT INTO test_inserts.test_batch SELECT generate_series(1, 10);
+	GET DIAGNOSTICS n = ROW_COUNT;
+	RAISE NOTICE 'inserted % rows', n;
+END
+$$;
+/* partitions with row triggers are filled row by row */
+TRUNCATE test_inserts.test_batch;
+CREATE FUNCTION test_inserts.test_batch_trigger() RETURNS TRIGGER AS $$
+BEGIN
+	RAISE NOTICE 'BEFORE INSERT ROW (%): %, rows in test_batch_1: %',
+		TG_TABLE_NAME, NEW.val, (SELECT count(*) FROM test_inserts.test_batch_1);
+	RETURN NEW;
+END
+$$ LANGUAGE plpgsql;
+CREATE TRIGGER test_batch_trigger BEFORE INSERT ON test_inserts.test_batch_2
+	FOR EACH ROW EXECUTE PROCEDURE test_inserts.test_batch_trigger();
+INSERT INTO test_inserts.test_batch VALUES (1, 'batch'), (1001, 'row'), (2, 'batch'), (3, 'batch'), (1002, 'row');
+SELECT *, tableoid::REGCLASS FROM test_inserts.test_batch ORDER BY val;
+/* RETURNING disables batch mode */
+INSERT INTO test_inserts.test_batch VALUES (4, 'returning') RETURNING *, tableoid::REGCLASS;
+SELECT * FROM test_inserts.batch_stats('INSERT INTO test_inserts.test_batch VALUES (5) RETURNING *');
+DROP TABLE test_inserts.test_batch CASCADE;
+DROP FUNCTION test_inserts.test_batch_trigger();
+DROP FUNCTION test_inserts.batch_stats(TEXT);
+RESET pg_pathman.enable_batch_inserts;
+
+
 DROP TABLE test_inserts.storage CASCADE;
 DROP FUNCTION test_inserts.set_triggers(jsonb);
 DROP FUNCTION test_inserts.print_cols_before_change();
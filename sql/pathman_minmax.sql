@@ -0,0 +1,42 @@
+\set VERBOSITY terse
+
+SET search_path = 'public';
+CREATE EXTENSION pg_pathman;
+CREATE SCHEMA minmax;
+
+
+
+/* Index on partitioning key for some partitions only, last ones are empty */
+CREATE TABLE minmax.range_rel(id INT4 NOT NULL, val TEXT);
+INSERT INTO minmax.range_rel SELECT g, g::TEXT FROM generate_series(1, 300) g;
+SELECT create_range_partitions('minmax.range_rel', 'id', 1, 100, 5);
+CREATE INDEX ON minmax.range_rel_1(id);
+CREATE INDEX ON minmax.range_rel_5(id);
+VACUUM ANALYZE minmax.range_rel;
+
+SELECT min(id), max(id) FROM minmax.range_rel;
+SELECT max(id) FROM minmax.range_rel WHERE id < 150;
+SELECT min(id) FROM minmax.range_rel WHERE id > 150;
+SELECT id FROM minmax.range_rel ORDER BY id DESC LIMIT 3;
+SELECT id FROM minmax.range_rel ORDER BY id LIMIT 3;
+
+
+
+/* Parent's rows don't follow bounds order */
+CREATE TABLE minmax.parent_rel(id INT4 NOT NULL);
+CREATE INDEX ON minmax.parent_rel(id);
+INSERT INTO minmax.parent_rel VALUES (150);
+SELECT create_range_partitions('minmax.parent_rel', 'id', 1, 100, 3, false);
+INSERT INTO minmax.parent_rel SELECT generate_series(1, 50);
+VACUUM ANALYZE minmax.parent_rel;
+
+SELECT min(id), max(id) FROM minmax.parent_rel;
+SELECT id FROM minmax.parent_rel ORDER BY id LIMIT 1;
+SELECT id FROM minmax.parent_rel ORDER BY id DESC LIMIT 1;
+
+
+
+DROP TABLE minmax.range_rel CASCADE;
+DROP TABLE minmax.parent_rel CASCADE;
+DROP SCHEMA minmax;
+DROP EXTENSION pg_pathman;
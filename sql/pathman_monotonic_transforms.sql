@@ -0,0 +1,150 @@
+\set VERBOSITY terse
+
+SET search_path = 'public';
+CREATE EXTENSION pg_pathman;
+CREATE SCHEMA mt;
+
+
+
+/* Returns names of partitions which are scanned by the plan */
+CREATE FUNCTION mt.scanned_partitions(query TEXT) RETURNS TEXT AS $$
+DECLARE
+	plan_line	TEXT;
+	result		TEXT[] := '{}';
+
+BEGIN
+	FOR plan_line IN EXECUTE 'EXPLAIN (COSTS OFF) ' || query
+	LOOP
+		IF plan_line ~ 'Scan on ' THEN
+			result := result || substring(plan_line from 'Scan on (\S+)');
+		END IF;
+	END LOOP;
+
+	RETURN array_to_string(result, ', ');
+END
+$$ LANGUAGE plpgsql;
+
+
+
+/* Built-in transforms */
+SELECT count(*) FROM pathman_monotonic_transforms WHERE builtin;
+
+
+
+/* Partitioned by TIMESTAMP, queried through date_trunc() and ::DATE */
+CREATE TABLE mt.events(ts TIMESTAMP NOT NULL, val INT4);
+SELECT create_range_partitions('mt.events', 'ts', '2015-01-01'::TIMESTAMP, '1 day'::INTERVAL, 10);
+
+SELECT mt.scanned_partitions('SELECT * FROM mt.events WHERE date_trunc(''day'', ts) = ''2015-01-03''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.events WHERE date_trunc(''day'', ts) = ''2015-01-03 12:00''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.events WHERE date_trunc(''day'', ts) >= ''2015-01-08''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.events WHERE date_trunc(''day'', ts) > ''2015-01-08 12:00''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.events WHERE date_trunc(''day'', ts) <= ''2015-01-02''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.events WHERE date_trunc(''month'', ts) < ''2015-01-01''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.events WHERE ts::DATE = ''2015-01-05''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.events WHERE ts::DATE > ''2015-01-08''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.events WHERE ''2015-01-02'' >= ts::DATE');
+
+/* Original condition is still checked */
+INSERT INTO mt.events SELECT '2015-01-01'::TIMESTAMP + g * '1 hour'::INTERVAL, g FROM generate_series(0, 239) g;
+SELECT count(*) FROM mt.events WHERE date_trunc('day', ts) = '2015-01-03';
+SELECT count(*) FROM mt.events WHERE ts::DATE BETWEEN '2015-01-04' AND '2015-01-05';
+
+
+
+/* Partitioned by DATE, queried through ::TIMESTAMP */
+CREATE TABLE mt.days(d DATE NOT NULL);
+SELECT create_range_partitions('mt.days', 'd', '2015-01-01'::DATE, '1 day'::INTERVAL, 5);
+
+SELECT mt.scanned_partitions('SELECT * FROM mt.days WHERE d::TIMESTAMP < ''2015-01-03 12:00''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.days WHERE d::TIMESTAMP = ''2015-01-03 12:00''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.days WHERE d::TIMESTAMP >= ''2015-01-03 12:00''');
+
+
+
+/* Partitioned by ts::DATE, queried through ts */
+CREATE TABLE mt.by_date(ts TIMESTAMP NOT NULL);
+SELECT create_range_partitions('mt.by_date', 'ts::DATE', '2015-01-01'::DATE, '1 day'::INTERVAL, 5);
+
+SELECT mt.scanned_partitions('SELECT * FROM mt.by_date WHERE ts = ''2015-01-03 05:00''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.by_date WHERE ts >= ''2015-01-04 10:00''');
+SELECT mt.scanned_partitions('SELECT * FROM mt.by_date WHERE ts < ''2015-01-02''');
+
+
+
+/* User-defined transform */
+CREATE TABLE mt.nums(id INT4 NOT NULL);
+SELECT create_range_partitions('mt.nums', 'id', 1, 100, 10);
+
+CREATE FUNCTION mt.hundreds(val INT4) RETURNS INT4 AS $$
+BEGIN
+	RETURN val / 100;
+END
+$$ LANGUAGE plpgsql IMMUTABLE STRICT;
+
+CREATE FUNCTION mt.hundreds_lower_bound(val INT4) RETURNS INT4 AS $$
+BEGIN
+	RETURN val * 100;
+END
+$$ LANGUAGE plpgsql IMMUTABLE STRICT;
+
+CREATE FUNCTION mt.hundreds_upper_bound(val INT4) RETURNS INT4 AS $$
+BEGIN
+	RETURN val * 100 + 100;
+END
+$$ LANGUAGE plpgsql IMMUTABLE STRICT;
+
+SELECT mt.scanned_partitions('SELECT * FROM mt.nums WHERE mt.hundreds(id) = 3');
+
+/* Should fail */
+SELECT add_monotonic_transform('mt.hundreds(INT4)', 2, 'mt.hundreds_lower_bound(INT4)');
+SELECT add_monotonic_transform('mt.hundreds(INT4)', 1, NULL, 'mt.hundreds_upper_bound(INT4)');
+
+SELECT add_monotonic_transform('mt.hundreds(INT4)', 1, 'mt.hundreds_lower_bound(INT4)', 'mt.hundreds_upper_bound(INT4)');
+SELECT mt.scanned_partitions('SELECT * FROM mt.nums WHERE mt.hundreds(id) = 3');
+SELECT mt.scanned_partitions('SELECT * FROM mt.nums WHERE mt.hundreds(id) > 7');
+
+SELECT remove_monotonic_transform('mt.hundreds(INT4)');
+SELECT mt.scanned_partitions('SELECT * FROM mt.nums WHERE mt.hundreds(id) = 3');
+
+
+/* Transform without upper bound, not every INT4 is its value */
+CREATE TABLE mt.evens(id INT4 NOT NULL);
+SELECT create_range_partitions('mt.evens', 'id', 1, 1, 6);
+INSERT INTO mt.evens SELECT generate_series(1, 6);
+
+CREATE FUNCTION mt.twice(val INT4) RETURNS INT4 AS $$
+BEGIN
+	RETURN val * 2;
+END
+$$ LANGUAGE plpgsql IMMUTABLE STRICT;
+
+CREATE FUNCTION mt.twice_inverse(val INT4) RETURNS INT4 AS $$
+BEGIN
+	RETURN (val + 1) / 2;
+END
+$$ LANGUAGE plpgsql IMMUTABLE STRICT;
+
+SELECT add_monotonic_transform('mt.twice(INT4)', 1, 'mt.twice_inverse(INT4)');
+SELECT mt.scanned_partitions('SELECT * FROM mt.evens WHERE mt.twice(id) > 5');
+SELECT mt.scanned_partitions('SELECT * FROM mt.evens WHERE mt.twice(id) = 5');
+SELECT mt.scanned_partitions('SELECT * FROM mt.evens WHERE mt.twice(id) < 5');
+SELECT count(*) FROM mt.evens WHERE mt.twice(id) > 5;
+SELECT count(*) FROM mt.evens WHERE mt.twice(id) <= 6;
+SELECT remove_monotonic_transform('mt.twice(INT4)');
+
+
+
+DROP TABLE mt.events CASCADE;
+DROP TABLE mt.days CASCADE;
+DROP TABLE mt.by_date CASCADE;
+DROP TABLE mt.nums CASCADE;
+DROP TABLE mt.evens CASCADE;
+DROP FUNCTION mt.hundreds(INT4);
+DROP FUNCTION mt.hundreds_lower_bound(INT4);
+DROP FUNCTION mt.hundreds_upper_bound(INT4);
+DROP FUNCTION mt.twice(INT4);
+DROP FUNCTION mt.twice_inverse(INT4);
+DROP FUNCTION mt.scanned_partitions(TEXT);
+DROP SCHEMA mt;
+DROP EXTENSION pg_pathman;
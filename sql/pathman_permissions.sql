@@ -165,6 +165,63 @@ ORDER BY attrelid::regclass::text; /* check ACL for each column (+1 partition) *
 DROP TABLE permissions.dropped_column CASCADE;
 
 
+/* Permissions of partitions are checked even if they've been used before */
+SET ROLE pathman_user1;
+CREATE TABLE permissions.cached_acl(id INT4 NOT NULL);
+SELECT create_range_partitions('permissions.cached_acl', 'id', 1, 10, 2);
+GRANT INSERT ON permissions.cached_acl TO pathman_user2;
+GRANT INSERT ON permissions.cached_acl_1 TO pathman_user2;
+
+SET ROLE pathman_user2;
+INSERT INTO permissions.cached_acl VALUES (1);
+DO $$
+BEGIN
+	INSERT INTO permissions.cached_acl VALUES (11); /* no INSERT on "cached_acl_2" */
+EXCEPTION
+	WHEN insufficient_privilege THEN
+		RAISE NOTICE 'Insufficient priviliges';
+END$$;
+
+SET ROLE pathman_user1;
+REVOKE INSERT ON permissions.cached_acl_1 FROM pathman_user2;
+
+SET ROLE pathman_user2;
+DO $$
+BEGIN
+	INSERT INTO permissions.cached_acl VALUES (2);
+EXCEPTION
+	WHEN insufficient_privilege THEN
+		RAISE NOTICE 'Insufficient priviliges';
+END$$;
+
+/* Same for privileges granted via role membership */
+RESET ROLE;
+CREATE ROLE pathman_inserters;
+GRANT INSERT ON permissions.cached_acl_1 TO pathman_inserters;
+GRANT pathman_inserters TO pathman_user2;
+
+SET ROLE pathman_user2;
+INSERT INTO permissions.cached_acl VALUES (3);
+
+RESET ROLE;
+REVOKE pathman_inserters FROM pathman_user2;
+
+SET ROLE pathman_user2;
+DO $$
+BEGIN
+	INSERT INTO permissions.cached_acl VALUES (4);
+EXCEPTION
+	WHEN insufficient_privilege THEN
+		RAISE NOTICE 'Insufficient priviliges';
+END$$;
+
+SET ROLE pathman_user1;
+SELECT * FROM permissions.cached_acl ORDER BY id;
+DROP TABLE permissions.cached_acl CASCADE;
+RESET ROLE;
+DROP ROLE pathman_inserters;
+
+
 /* Finally reset user */
 RESET ROLE;
 
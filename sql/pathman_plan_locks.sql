@@ -0,0 +1,66 @@
+/*
+ * Partitions pruned by RuntimeAppend are still locked by a generic plan:
+ * AcquireExecutorLocks() locks every relation of the cached plan's range
+ * table before the executor starts, and an extension can't defer it.
+ * This test compares the number of locked partitions of a custom plan
+ * and a generic one.
+ */
+
+\set VERBOSITY terse
+
+SET search_path = 'public';
+CREATE EXTENSION pg_pathman;
+CREATE SCHEMA plan_locks;
+
+
+CREATE TABLE plan_locks.test(id INT4 NOT NULL, val INT4);
+INSERT INTO plan_locks.test SELECT i, i FROM generate_series(1, 1000) i;
+SELECT create_range_partitions('plan_locks.test', 'id', 1, 200);
+ANALYZE;
+
+/* Number of partitions locked by current transaction */
+CREATE FUNCTION plan_locks.locked_partitions() RETURNS INT8 AS $$
+	SELECT count(*) FROM pg_catalog.pg_locks
+	WHERE pid = pg_catalog.pg_backend_pid() AND
+		  locktype = 'relation' AND
+		  relation IN (SELECT partition FROM pathman_partition_list
+					   WHERE parent = 'plan_locks.test'::REGCLASS);
+$$ LANGUAGE sql;
+
+
+PREPARE q(INT4) AS SELECT count(*) FROM plan_locks.test WHERE id = $1;
+
+/* Custom plan: only the matching partition is locked */
+BEGIN;
+EXECUTE q(1);
+SELECT plan_locks.locked_partitions();
+COMMIT;
+
+/* Make sure that the generic plan is cached (5 custom plans on < 12) */
+DO $$
+BEGIN
+	IF current_setting('server_version_num')::INT4 >= 120000 THEN
+		SET plan_cache_mode = 'force_generic_plan';
+	END IF;
+END
+$$ LANGUAGE plpgsql;
+
+EXECUTE q(1);
+EXECUTE q(1);
+EXECUTE q(1);
+EXECUTE q(1);
+EXECUTE q(1);
+
+/* Generic plan: every partition is locked */
+BEGIN;
+EXECUTE q(1);
+SELECT plan_locks.locked_partitions();
+COMMIT;
+
+DEALLOCATE q;
+
+
+DROP TABLE plan_locks.test CASCADE;
+DROP FUNCTION plan_locks.locked_partitions();
+DROP SCHEMA plan_locks;
+DROP EXTENSION pg_pathman;
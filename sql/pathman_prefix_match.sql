@@ -0,0 +1,57 @@
+\set VERBOSITY terse
+
+SET search_path = 'public';
+CREATE EXTENSION pg_pathman;
+CREATE SCHEMA prefix_match;
+
+
+
+/* Returns names of partitions which are scanned by the plan */
+CREATE FUNCTION prefix_match.scanned_partitions(query TEXT) RETURNS TEXT AS $$
+DECLARE
+	plan_line	TEXT;
+	result		TEXT[] := '{}';
+
+BEGIN
+	FOR plan_line IN EXECUTE 'EXPLAIN (COSTS OFF) ' || query
+	LOOP
+		IF plan_line ~ 'Scan on ' THEN
+			result := result || substring(plan_line from 'Scan on (\S+)');
+		END IF;
+	END LOOP;
+
+	RETURN array_to_string(result, ', ');
+END
+$$ LANGUAGE plpgsql;
+
+
+
+/* Prefix ranges require "C" collation */
+CREATE TABLE prefix_match.codes(code TEXT COLLATE "C" NOT NULL);
+SELECT create_range_partitions('prefix_match.codes', 'code', ARRAY['a', 'c', 'e', 'g', 'i']::TEXT[]);
+INSERT INTO prefix_match.codes VALUES ('bz'), ('cat'), ('cow'), ('d'), ('e%x'), ('golf'), ('hotel');
+
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code LIKE ''cat%''');
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code LIKE ''c_t''');
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code LIKE ''bz%''');
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code LIKE ''e\%%''');
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code LIKE ''golf''');
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code LIKE ''%o%''');
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code LIKE ''c%'' OR code LIKE ''g%''');
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code ILIKE ''c%''');
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code ~ ''^co''');
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code ~ ''^dx*''');
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code ~ ''^co|^g''');
+SELECT prefix_match.scanned_partitions('SELECT * FROM prefix_match.codes WHERE code ~ ''o''');
+
+/* Original condition is still checked */
+SELECT * FROM prefix_match.codes WHERE code LIKE 'c%' ORDER BY code;
+SELECT * FROM prefix_match.codes WHERE code LIKE 'e\%%';
+SELECT * FROM prefix_match.codes WHERE code ~ '^go';
+
+
+
+DROP TABLE prefix_match.codes CASCADE;
+DROP FUNCTION prefix_match.scanned_partitions(TEXT);
+DROP SCHEMA prefix_match;
+DROP EXTENSION pg_pathman;
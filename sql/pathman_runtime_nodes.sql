@@ -241,6 +241,127 @@ $$ language plpgsql
 set enable_hashjoin = off
 set enable_mergejoin = off;
 
+create or replace function test.pathman_test_6() returns text as $$
+declare
+	plan jsonb;
+	num int;
+	evicts bool := current_setting('server_version_num')::int >= 130000;
+begin
+	plan = test.pathman_test('select * from test.runtime_test_1 a join ' ||
+							 '(select val % 3 + 1 as val from test.run_values limit 100) b ' ||
+							 'on a.id = b.val');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Node Type')::text,
+							   '"Nested Loop"',
+							   'wrong plan type');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Plans'->1->'Custom Plan Provider')::text,
+							   '"RuntimeAppend"',
+							   'wrong plan provider');
+
+	num = plan->0->'Plan'->'Actual Rows';
+	perform test.pathman_equal(num::text, '100', 'expected 100 rows');
+
+	/* only 3 distinct PARAM values, most rescans should hit the cache */
+	num = plan->0->'Plan'->'Plans'->1->'Prune Cache Hits';
+	perform test.pathman_assert(num > 0, 'expected prune cache hits');
+
+	return 'ok';
+end;
+$$ language plpgsql
+set enable_mergejoin = off
+set enable_hashjoin = off;
+
+create or replace function test.pathman_test_7() returns text as $$
+declare
+	plan jsonb;
+	num int;
+	evicts bool := current_setting('server_version_num')::int >= 130000;
+begin
+	plan = test.pathman_test('select * from test.runtime_test_1 a join ' ||
+							 '(select val from test.run_values limit 100) b ' ||
+							 'on a.id = b.val'); /* children are shut down and initialized again */
+
+	perform test.pathman_equal((plan->0->'Plan'->'Plans'->1->'Custom Plan Provider')::text,
+							   '"RuntimeAppend"',
+							   'wrong plan provider');
+
+	num = plan->0->'Plan'->'Actual Rows';
+	perform test.pathman_equal(num::text, '100', 'expected 100 rows');
+
+	/* children are evicted only on PG 13+ */
+	num = plan->0->'Plan'->'Plans'->1->'Evicted Children';
+	perform test.pathman_assert((num > 0) = evicts, 'wrong number of evicted children');
+
+	select count(*) from jsonb_array_elements_text(plan->0->'Plan'->'Plans'->1->'Plans') into num;
+	perform test.pathman_assert((num <= 2) = evicts, 'wrong number of child plans');
+
+	plan = test.pathman_test('select * from test.category c, lateral' ||
+							 '(select * from test.runtime_test_2 g where g.category_id = c.id order by rating limit 4) as tg');
+
+	/* same for RuntimeMergeAppend (Limit -> Custom Scan) */
+	perform test.pathman_equal((plan->0->'Plan'->'Plans'->1->'Plans'->0->'Custom Plan Provider')::text,
+							   '"RuntimeMergeAppend"',
+							   'wrong plan provider');
+
+	num = plan->0->'Plan'->'Actual Rows';
+	perform test.pathman_equal(num::text, '16', 'expected 16 rows');
+
+	num = plan->0->'Plan'->'Plans'->1->'Plans'->0->'Evicted Children';
+	perform test.pathman_assert((num > 0) = evicts, 'wrong number of evicted children');
+
+	return 'ok';
+end;
+$$ language plpgsql
+set enable_mergejoin = off
+set enable_hashjoin = off
+set pg_pathman.runtimeappend_max_children = 2;
+
+create or replace function test.runtime_test_4_key() returns int as $$
+begin
+	return 4500;
+end;
+$$ language plpgsql stable;
+
+create or replace function test.pathman_test_8() returns text as $$
+declare
+	plan jsonb;
+	num int;
+begin
+	plan = test.pathman_test('select * from test.runtime_test_4 where id = test.runtime_test_4_key()');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Custom Plan Provider')::text,
+							   '"RuntimeAppend"',
+							   'wrong plan provider');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Plans'->0->'Relation Name')::text,
+							   '"runtime_test_4_3"',
+							   'wrong partition');
+
+	select count(*) from jsonb_array_elements_text(plan->0->'Plan'->'Plans') into num;
+	perform test.pathman_equal(num::text, '1', 'expected 1 child plan for custom scan');
+
+	return 'ok';
+end;
+$$ language plpgsql;
+
+create or replace function test.pathman_test_9() returns text as $$
+declare
+	plan jsonb;
+	num int;
+begin
+	plan = test.pathman_test('select * from test.runtime_test_4 where id = 4500 + (random() * 0)::int');
+
+	perform test.pathman_assert((plan->0->'Plan'->'Node Type')::text != '"Custom Scan"',
+								'volatile clause must not produce RuntimeAppend');
+
+	select count(*) from jsonb_array_elements_text(plan->0->'Plan'->'Plans') into num;
+	perform test.pathman_equal(num::text, '5', 'expected 5 child plans for append');
+
+	return 'ok';
+end;
+$$ language plpgsql;
+
 
 
 create table test.run_values as select generate_series(1, 10000) val;
@@ -277,6 +398,10 @@ select test.pathman_test_2(); /* RuntimeAppend (select ... where id = any(subque
 select test.pathman_test_3(); /* RuntimeAppend (a join b on a.id = b.val) */
 select test.pathman_test_4(); /* RuntimeMergeAppend (lateral) */
 select test.pathman_test_5(); /* projection tests for RuntimeXXX nodes */
+select test.pathman_test_6(); /* RuntimeAppend (pruning cache) */
+select test.pathman_test_7(); /* RuntimeXXX nodes (limited number of children) */
+select test.pathman_test_8(); /* RuntimeAppend (stable functions) */
+select test.pathman_test_9(); /* no RuntimeAppend (volatile functions) */
 
 
 /* RuntimeAppend (join, enabled parent) */
@@ -341,6 +466,11 @@ DROP FUNCTION test.pathman_test_2();
 DROP FUNCTION test.pathman_test_3();
 DROP FUNCTION test.pathman_test_4();
 DROP FUNCTION test.pathman_test_5();
+DROP FUNCTION test.pathman_test_6();
+DROP FUNCTION test.pathman_test_7();
+DROP FUNCTION test.pathman_test_8();
+DROP FUNCTION test.pathman_test_9();
+DROP FUNCTION test.runtime_test_4_key();
 DROP SCHEMA test;
 --
 --
@@ -0,0 +1,91 @@
+/*
+ * UPDATE | DELETE targets are pruned on PostgreSQL 14+ only,
+ * upd_del_pruning.pruned() is always true on older versions.
+ */
+
+\set VERBOSITY terse
+
+SET search_path = 'public';
+CREATE EXTENSION pg_pathman;
+CREATE SCHEMA upd_del_pruning;
+
+
+/* Count result relations of all ModifyTable nodes (parent is one of them) */
+CREATE OR REPLACE FUNCTION upd_del_pruning.targets(query TEXT)
+RETURNS INT4 AS $$
+DECLARE
+	plan	JSON;
+	result	INT4;
+
+BEGIN
+	EXECUTE 'EXPLAIN (COSTS OFF, FORMAT JSON) ' || query INTO plan;
+
+	WITH RECURSIVE nodes(node) AS (
+		SELECT plan->0->'Plan'
+		UNION ALL
+		SELECT child.node FROM nodes, json_array_elements(nodes.node->'Plans') AS child(node)
+	)
+	SELECT sum(coalesce(json_array_length(node->'Target Tables'), 1))
+	FROM nodes
+	WHERE node->>'Node Type' = 'ModifyTable'
+	INTO result;
+
+	RETURN result;
+END
+$$ LANGUAGE plpgsql;
+
+CREATE OR REPLACE FUNCTION upd_del_pruning.pruned(query TEXT, max_targets INT4)
+RETURNS BOOL AS $$
+BEGIN
+	IF current_setting('server_version_num')::INT4 < 140000 THEN
+		RETURN true;
+	END IF;
+
+	RETURN upd_del_pruning.targets(query) <= max_targets;
+END
+$$ LANGUAGE plpgsql;
+
+/* Plans a query over the same table while the caller is being planned */
+CREATE OR REPLACE FUNCTION upd_del_pruning.nested(key INT4)
+RETURNS INT4 AS $$
+BEGIN
+	PERFORM count(*) FROM upd_del_pruning.test WHERE id IN (5, 6, 7);
+
+	RETURN key;
+END
+$$ LANGUAGE plpgsql IMMUTABLE;
+
+
+CREATE TABLE upd_del_pruning.test(id INT4 NOT NULL, val INT4);
+INSERT INTO upd_del_pruning.test SELECT i, i FROM generate_series(1, 1000) i;
+SELECT create_hash_partitions('upd_del_pruning.test', 'id', 10);
+
+
+/* Only matching partitions should be kept */
+SELECT upd_del_pruning.pruned('UPDATE upd_del_pruning.test SET val = 0 WHERE id IN (1, 2)', 3);
+SELECT upd_del_pruning.pruned('DELETE FROM upd_del_pruning.test WHERE id = 3 OR id = 4', 3);
+
+/* Nothing to prune */
+SELECT upd_del_pruning.targets('DELETE FROM upd_del_pruning.test WHERE val = 5');
+
+/* Same parent in several subqueries */
+SELECT upd_del_pruning.pruned('WITH d AS (DELETE FROM upd_del_pruning.test WHERE id IN (3, 4) RETURNING *)
+							   UPDATE upd_del_pruning.test SET val = 0 WHERE id IN (1, 2)', 6);
+
+/* Nested planner() call */
+SELECT upd_del_pruning.pruned('UPDATE upd_del_pruning.test SET val = 0 WHERE id IN (1, upd_del_pruning.nested(2))', 3);
+
+
+/* Make sure that matching rows are still processed */
+UPDATE upd_del_pruning.test SET val = 0 WHERE id IN (1, upd_del_pruning.nested(2));
+DELETE FROM upd_del_pruning.test WHERE id = 3 OR id = 4;
+SELECT count(*) FROM upd_del_pruning.test WHERE val = 0;
+SELECT count(*) FROM upd_del_pruning.test;
+
+
+DROP TABLE upd_del_pruning.test CASCADE;
+DROP FUNCTION upd_del_pruning.nested(INT4);
+DROP FUNCTION upd_del_pruning.pruned(TEXT, INT4);
+DROP FUNCTION upd_del_pruning.targets(TEXT);
+DROP SCHEMA upd_del_pruning;
+DROP EXTENSION pg_pathman;
@@ -154,8 +154,55 @@ COPY copy_stmt_hooking.test2(t) FROM stdin;
 \.
 SELECT COUNT(*) FROM copy_stmt_hooking.test2;
 
+/* COPY FROM (partitions with row triggers are filled row by row) */
+CREATE TABLE copy_stmt_hooking.test3(val INT NOT NULL, comment TEXT);
+CREATE INDEX ON copy_stmt_hooking.test3(val);
+SELECT create_range_partitions('copy_stmt_hooking.test3', 'val', 1, 10, 2);
+CREATE FUNCTION copy_stmt_hooking.test3_trigger() RETURNS TRIGGER AS $$
+BEGIN
+	RAISE NOTICE 'BEFORE INSERT ROW (%): %, rows in test3_1: %',
+		TG_TABLE_NAME, NEW.val, (SELECT count(*) FROM copy_stmt_hooking.test3_1);
+	RETURN NEW;
+END
+$$ LANGUAGE plpgsql;
+CREATE TRIGGER test3_trigger BEFORE INSERT ON copy_stmt_hooking.test3_2
+	FOR EACH ROW EXECUTE PROCEDURE copy_stmt_hooking.test3_trigger();
+COPY copy_stmt_hooking.test3 FROM stdin;
+1	buffered
+11	row
+2	buffered
+3	buffered
+12	row
+\.
+SELECT *, tableoid::REGCLASS FROM copy_stmt_hooking.test3 ORDER BY val;
+SELECT * FROM copy_stmt_hooking.test3 WHERE val = 3;
+
+/* COPY FROM (least recently used partitions are closed) */
+CREATE TABLE copy_stmt_hooking.test4(val INT NOT NULL, comment TEXT);
+CREATE INDEX ON copy_stmt_hooking.test4(val);
+SELECT create_range_partitions('copy_stmt_hooking.test4', 'val', 1, 10, 4);
+SET pg_pathman.max_open_partitions = 2;
+COPY copy_stmt_hooking.test4 FROM stdin;
+1	first
+11	first
+21	first
+31	first
+2	reopened
+12	reopened
+22	reopened
+32	reopened
+3	reopened
+\.
+RESET pg_pathman.max_open_partitions;
+SELECT * FROM pathman_copy_stats;
+SELECT tableoid::REGCLASS, count(*) FROM copy_stmt_hooking.test4 GROUP BY 1 ORDER BY 1;
+SELECT * FROM copy_stmt_hooking.test4 WHERE val = 22;
+
 DROP TABLE copy_stmt_hooking.test CASCADE;
 DROP TABLE copy_stmt_hooking.test2 CASCADE;
+DROP TABLE copy_stmt_hooking.test3 CASCADE;
+DROP TABLE copy_stmt_hooking.test4 CASCADE;
+DROP FUNCTION copy_stmt_hooking.test3_trigger();
 DROP SCHEMA copy_stmt_hooking;
 
 
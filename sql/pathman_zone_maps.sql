@@ -0,0 +1,143 @@
+\set VERBOSITY terse
+
+SET search_path = 'public';
+CREATE EXTENSION pg_pathman;
+CREATE SCHEMA zone_maps;
+
+
+
+/* Returns names of partitions which are scanned by the plan */
+CREATE FUNCTION zone_maps.scanned_partitions(query TEXT) RETURNS TEXT AS $$
+DECLARE
+	plan_line	TEXT;
+	result		TEXT[] := '{}';
+
+BEGIN
+	FOR plan_line IN EXECUTE 'EXPLAIN (COSTS OFF) ' || query
+	LOOP
+		IF plan_line ~ 'Scan on ' THEN
+			result := result || substring(plan_line from 'Scan on (\S+)');
+		END IF;
+	END LOOP;
+
+	RETURN array_to_string(result, ', ');
+END
+$$ LANGUAGE plpgsql;
+
+
+
+/* Column 'tenant' is clustered by partitioning key */
+CREATE TABLE zone_maps.test(id INT4 NOT NULL, tenant INT4);
+INSERT INTO zone_maps.test SELECT g, (g - 1) / 100 FROM generate_series(1, 1000) g;
+SELECT create_range_partitions('zone_maps.test', 'id', 1, 100, 10);
+
+/* Should fail */
+SELECT set_zone_map_columns('zone_maps.test', '{missing}');
+
+SELECT set_zone_map_columns('zone_maps.test', '{tenant}');
+SELECT refresh_zone_maps('zone_maps.test');
+SELECT partition, min_value, max_value, valid FROM pathman_zone_maps ORDER BY partition;
+
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE tenant = 3');
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE 3 > tenant');
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE tenant IN (1, 8)');
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE tenant >= 8 AND id < 901');
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE tenant = 1 OR tenant = 5');
+SELECT count(*) FROM zone_maps.test WHERE tenant = 3;
+
+
+/* Row which doesn't fit the summary invalidates it */
+INSERT INTO zone_maps.test VALUES (150, 9);
+SELECT partition, valid FROM pathman_zone_maps WHERE NOT valid;
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE tenant = 9');
+SELECT count(*) FROM zone_maps.test WHERE tenant = 9;
+
+/* Row which fits the summary doesn't */
+INSERT INTO zone_maps.test VALUES (250, 2);
+UPDATE zone_maps.test SET tenant = 4 WHERE id = 401;
+SELECT partition, valid FROM pathman_zone_maps WHERE NOT valid;
+
+/* Refresh a single partition */
+SELECT refresh_zone_maps('zone_maps.test', 'zone_maps.test_2');
+SELECT count(*) FROM pathman_zone_maps WHERE NOT valid;
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE tenant = 9');
+
+/* Summaries are not used until invalidation is committed */
+BEGIN;
+INSERT INTO zone_maps.test VALUES (350, 9);
+SELECT count(*) FROM pathman_zone_maps WHERE NOT valid;
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE tenant = 9');
+COMMIT;
+SELECT partition, valid FROM pathman_zone_maps WHERE NOT valid;
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE tenant = 9');
+SELECT refresh_zone_maps('zone_maps.test', 'zone_maps.test_4');
+
+/* Partitions containing only NULLs are excluded as well */
+UPDATE zone_maps.test SET tenant = NULL WHERE id <= 100;
+SELECT refresh_zone_maps('zone_maps.test', 'zone_maps.test_1');
+SELECT min_value, max_value FROM pathman_zone_maps WHERE partition = 'zone_maps.test_1'::REGCLASS;
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE tenant < 2');
+
+
+/* Batches of rows are checked against zone maps as well */
+SET pg_pathman.enable_batch_inserts = t;
+CREATE FUNCTION zone_maps.batch_stats(query TEXT) RETURNS SETOF TEXT AS $$
+DECLARE
+	plan	JSONB;
+
+BEGIN
+	EXECUTE 'EXPLAIN (ANALYZE, FORMAT JSON) ' || query INTO plan;
+
+	RETURN QUERY
+		SELECT format('%s: rows=%s batches=%s',
+					  part->>'Relation Name', part->>'Rows', part->>'Batches')
+		FROM jsonb_array_elements(plan->0->'Plan'->'Plans'->0->'Batched Inserts') part;
+END
+$$ LANGUAGE plpgsql;
+SELECT * FROM zone_maps.batch_stats('INSERT INTO zone_maps.test SELECT g, 5 FROM generate_series(501, 510) g');
+SELECT * FROM zone_maps.batch_stats('INSERT INTO zone_maps.test SELECT g, 9 FROM generate_series(601, 610) g');
+RESET pg_pathman.enable_batch_inserts;
+COPY zone_maps.test FROM stdin;
+801	8
+901	1
+\.
+SELECT partition, valid FROM pathman_zone_maps WHERE NOT valid ORDER BY partition;
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE tenant = 9');
+
+
+/* Non-owners invalidate summaries on their own behalf (triggers & RLS apply) */
+SELECT refresh_zone_maps('zone_maps.test');
+CREATE ROLE zone_maps_writer;
+GRANT USAGE ON SCHEMA zone_maps TO zone_maps_writer;
+GRANT INSERT ON zone_maps.test, zone_maps.test_6 TO zone_maps_writer;
+CREATE FUNCTION zone_maps.notify_invalidation() RETURNS TRIGGER AS $$
+BEGIN
+	RAISE NOTICE '% invalidated by %', NEW.partition, current_user;
+	RETURN NEW;
+END
+$$ LANGUAGE plpgsql;
+CREATE TRIGGER notify_invalidation
+AFTER UPDATE ON pathman_zone_maps
+FOR EACH ROW WHEN (OLD.valid AND NOT NEW.valid)
+EXECUTE PROCEDURE zone_maps.notify_invalidation();
+SET ROLE zone_maps_writer;
+INSERT INTO zone_maps.test VALUES (550, 9);
+RESET ROLE;
+SELECT partition, valid FROM pathman_zone_maps WHERE NOT valid;
+DROP TRIGGER notify_invalidation ON pathman_zone_maps;
+DROP FUNCTION zone_maps.notify_invalidation();
+
+
+/* Disable zone maps */
+SELECT set_zone_map_columns('zone_maps.test', NULL);
+SELECT count(*) FROM pathman_zone_maps;
+SELECT zone_maps.scanned_partitions('SELECT * FROM zone_maps.test WHERE tenant = 3 AND id > 800');
+
+
+
+DROP TABLE zone_maps.test CASCADE;
+DROP FUNCTION zone_maps.scanned_partitions(TEXT);
+DROP FUNCTION zone_maps.batch_stats(TEXT);
+DROP SCHEMA zone_maps;
+DROP ROLE zone_maps_writer;
+DROP EXTENSION pg_pathman;
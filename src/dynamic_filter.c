@@ -0,0 +1,471 @@
+/* ------------------------------------------------------------------------
+ *
+ * dynamic_filter.c
+ *		Partition pruning using inner side of a hash join
+ *
+ * DynamicFilterSource is placed below the Hash node. It passes tuples
+ * through and collects partitions of the probe side which might match
+ * inner keys. RuntimeAppend on the probe side uses them once the hash
+ * table has been built (see exec_append_common()).
+ *
+ * Copyright (c) 2026, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "compat/pg_compat.h"
+
+#include "dynamic_filter.h"
+#include "rangeset.h"
+
+#include "catalog/pg_collation.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/cost.h"
+#include "utils/datum.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+
+bool				pg_pathman_enable_dynamic_filters = false;
+
+CustomPathMethods	dynamic_filter_path_methods;
+CustomScanMethods	dynamic_filter_plan_methods;
+CustomExecMethods	dynamic_filter_exec_methods;
+
+
+static void reset_dynamic_filter(DynamicFilterSourceState *state);
+static void add_key_to_dynamic_filter(DynamicFilterSourceState *state,
+									  ExprContext *econtext);
+static void flush_dynamic_filter_batch(DynamicFilterSourceState *state);
+static int cmp_batch_keys(const void *a, const void *b, void *arg);
+
+
+void
+init_dynamic_filter_static_data(void)
+{
+	dynamic_filter_path_methods.CustomName				= DYNAMIC_FILTER_NODE_NAME;
+	dynamic_filter_path_methods.PlanCustomPath			= create_dynamic_filter_source_plan;
+
+	dynamic_filter_plan_methods.CustomName				= DYNAMIC_FILTER_NODE_NAME;
+	dynamic_filter_plan_methods.CreateCustomScanState	= dynamic_filter_create_scan_state;
+
+	dynamic_filter_exec_methods.CustomName				= DYNAMIC_FILTER_NODE_NAME;
+	dynamic_filter_exec_methods.BeginCustomScan			= dynamic_filter_begin;
+	dynamic_filter_exec_methods.ExecCustomScan			= dynamic_filter_exec;
+	dynamic_filter_exec_methods.EndCustomScan			= dynamic_filter_end;
+	dynamic_filter_exec_methods.ReScanCustomScan		= dynamic_filter_rescan;
+	dynamic_filter_exec_methods.MarkPosCustomScan		= NULL;
+	dynamic_filter_exec_methods.RestrPosCustomScan		= NULL;
+	dynamic_filter_exec_methods.ExplainCustomScan		= dynamic_filter_explain;
+
+	DefineCustomBoolVariable("pg_pathman.enable_dynamic_filters",
+							 "Enables pruning of hash join's outer partitions "
+							 "using keys of its inner side.",
+							 NULL,
+							 &pg_pathman_enable_dynamic_filters,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	RegisterCustomScanMethods(&dynamic_filter_plan_methods);
+}
+
+
+Path *
+create_dynamic_filter_source_path(PlannerInfo *root,
+								  Path *subpath,
+								  Oid relid,
+								  Node *key,
+								  int paramid)
+{
+	DynamicFilterSourcePath *result;
+
+	result = (DynamicFilterSourcePath *) palloc0(sizeof(DynamicFilterSourcePath));
+	NodeSetTag(result, T_CustomPath);
+
+	result->cpath.path.pathtype = T_CustomScan;
+	result->cpath.path.parent = subpath->parent;
+	result->cpath.path.param_info = subpath->param_info;
+	result->cpath.path.pathkeys = subpath->pathkeys;
+#if PG_VERSION_NUM >= 90600
+	result->cpath.path.pathtarget = subpath->pathtarget;
+#endif
+	result->cpath.path.rows = subpath->rows;
+
+	/* Each key is looked up among partitions */
+	result->cpath.path.startup_cost = subpath->startup_cost;
+	result->cpath.path.total_cost = subpath->total_cost +
+			2 * cpu_operator_cost * subpath->rows;
+
+	result->cpath.flags = 0;
+	result->cpath.methods = &dynamic_filter_path_methods;
+	result->cpath.custom_paths = list_make1(subpath);
+
+	result->relid = relid;
+	result->key = key;
+	result->paramid = paramid;
+
+	return &result->cpath.path;
+}
+
+Plan *
+create_dynamic_filter_source_plan(PlannerInfo *root, RelOptInfo *rel,
+								  CustomPath *best_path, List *tlist,
+								  List *clauses, List *custom_plans)
+{
+	DynamicFilterSourcePath	   *path = (DynamicFilterSourcePath *) best_path;
+	Plan					   *subplan = (Plan *) linitial(custom_plans);
+	CustomScan				   *cscan;
+
+	cscan = makeNode(CustomScan);
+
+	/* Restrictions have already been checked by subplan */
+	cscan->scan.plan.qual = NIL;
+	cscan->scan.plan.targetlist = tlist;
+
+	/* Since we're not scanning any real table directly */
+	cscan->scan.scanrelid = 0;
+
+	/* Tuples (and key) will be taken from subplan */
+	cscan->custom_scan_tlist = subplan->targetlist;
+	cscan->custom_exprs = list_make1(path->key);
+	cscan->custom_plans = custom_plans;
+	cscan->custom_private = list_make2(makeInteger(path->relid),
+									   makeInteger(path->paramid));
+	cscan->methods = &dynamic_filter_plan_methods;
+
+	return &cscan->scan.plan;
+}
+
+Node *
+dynamic_filter_create_scan_state(CustomScan *node)
+{
+	DynamicFilterSourceState *state;
+
+	state = (DynamicFilterSourceState *) palloc0(sizeof(DynamicFilterSourceState));
+	NodeSetTag(state, T_CustomScanState);
+
+	state->css.flags	= node->flags;
+	state->css.methods	= &dynamic_filter_exec_methods;
+
+	/* Extract necessary variables */
+	state->relid	= (Oid) intVal(linitial(node->custom_private));
+	state->paramid	= intVal(lsecond(node->custom_private));
+	state->key		= (Node *) linitial(node->custom_exprs);
+
+	/* There should be exactly one subplan */
+	Assert(list_length(node->custom_plans) == 1);
+
+	return (Node *) state;
+}
+
+void
+dynamic_filter_begin(CustomScanState *node, EState *estate, int eflags)
+{
+	DynamicFilterSourceState   *state = (DynamicFilterSourceState *) node;
+	CustomScan				   *cscan = (CustomScan *) node->ss.ps.plan;
+	ParamExecData			   *prm;
+
+	/* It's convenient to store PlanState in 'custom_ps' */
+	node->custom_ps = list_make1(ExecInitNode((Plan *) linitial(cscan->custom_plans),
+											  estate, eflags));
+
+	state->key_state = ExecInitExpr((Expr *) state->key, &node->ss.ps);
+	state->key_type = exprType(state->key);
+	get_typlenbyval(state->key_type, &state->key_typlen, &state->key_typbyval);
+
+	/* NOTE: we don't prune anything if table is not partitioned anymore */
+	state->prel = get_pathman_relation_info(state->relid);
+
+	/* Keys are mapped to partitions in batches */
+	if (state->prel)
+	{
+		state->batch = (Datum *) palloc(sizeof(Datum) * DYNAMIC_FILTER_BATCH_SIZE);
+		state->batch_mcxt = AllocSetContextCreate(estate->es_query_cxt,
+												  "DynamicFilterSource batch",
+												  ALLOCSET_DEFAULT_SIZES);
+
+		fmgr_info(state->prel->parttype == PT_RANGE ?
+					state->prel->cmp_proc :
+					state->prel->hash_proc,
+				  &state->lookup_finfo);
+	}
+
+	state->filter = (DynamicFilter *) palloc0(sizeof(DynamicFilter));
+	reset_dynamic_filter(state);
+
+	/* Publish filter for RuntimeAppend */
+	prm = &estate->es_param_exec_vals[state->paramid];
+	prm->execPlan = NULL;
+	prm->value = PointerGetDatum(state->filter);
+	prm->isnull = false;
+}
+
+TupleTableSlot *
+dynamic_filter_exec(CustomScanState *node)
+{
+	DynamicFilterSourceState   *state = (DynamicFilterSourceState *) node;
+	ExprContext				   *econtext = node->ss.ps.ps_ExprContext;
+	TupleTableSlot			   *slot;
+
+	slot = ExecProcNode((PlanState *) linitial(node->custom_ps));
+
+	/* Inner side is done, RuntimeAppend may use the filter */
+	if (TupIsNull(slot))
+	{
+		if (!state->filter->all)
+			flush_dynamic_filter_batch(state);
+
+		state->filter->ready = true;
+		return NULL;
+	}
+
+	ResetExprContext(econtext);
+	econtext->ecxt_scantuple = slot;
+
+	if (!state->filter->all)
+		add_key_to_dynamic_filter(state, econtext);
+
+	if (node->ss.ps.ps_ProjInfo)
+	{
+		node->ss.ps.ps_ProjInfo->pi_exprContext->ecxt_scantuple = slot;
+#if PG_VERSION_NUM >= 100000
+		return ExecProject(node->ss.ps.ps_ProjInfo);
+#else
+		return ExecProject(node->ss.ps.ps_ProjInfo, NULL);
+#endif
+	}
+
+#if PG_VERSION_NUM >= 120000
+	/* See comment in exec_append_common() */
+	return ExecCopySlot(node->ss.ps.ps_ResultTupleSlot, slot);
+#else
+	return slot;
+#endif
+}
+
+void
+dynamic_filter_end(CustomScanState *node)
+{
+	DynamicFilterSourceState *state = (DynamicFilterSourceState *) node;
+
+	Assert(list_length(node->custom_ps) == 1);
+	ExecEndNode((PlanState *) linitial(node->custom_ps));
+
+	if (state->prel)
+		close_pathman_relation_info(state->prel);
+}
+
+void
+dynamic_filter_rescan(CustomScanState *node)
+{
+	DynamicFilterSourceState   *state = (DynamicFilterSourceState *) node;
+	PlanState				   *child = (PlanState *) linitial(node->custom_ps);
+
+	/* Inner side will be scanned once again */
+	reset_dynamic_filter(state);
+
+	if (node->ss.ps.chgParam)
+		UpdateChangedParamSet(child, node->ss.ps.chgParam);
+
+	/* ExecProcNode() will rescan child with changed params */
+	if (child->chgParam == NULL)
+		ExecReScan(child);
+}
+
+void
+dynamic_filter_explain(CustomScanState *node, List *ancestors, ExplainState *es)
+{
+	DynamicFilterSourceState *state = (DynamicFilterSourceState *) node;
+
+	/* Show how many partitions will be scanned */
+	if (es->analyze && state->filter && state->filter->ready)
+		ExplainPropertyIntegerCompat("Partitions Selected",
+									 state->filter->all ?
+										state->filter->nparts :
+										bms_num_members(state->filter->parts),
+									 es);
+}
+
+
+/*
+ * Transform filter into partition ranges,
+ * select everything if it's not ready yet.
+ */
+List *
+dynamic_filter_ranges(const DynamicFilter *filter,
+					  const PartRelationInfo *prel)
+{
+	List   *ranges = NIL;
+	int		i = -1,
+			first = -1,
+			last = -1;
+
+	/* NOTE: partitions might have been added concurrently */
+	if (!filter->ready || filter->all ||
+		filter->nparts != PrelChildrenCount(prel))
+		return list_make1_irange_full(prel, IR_COMPLETE);
+
+	/* Glue adjacent partitions together */
+	while ((i = bms_next_member(filter->parts, i)) >= 0)
+	{
+		if (first >= 0 && i == last + 1)
+		{
+			last = i;
+			continue;
+		}
+
+		if (first >= 0)
+			ranges = lappend_irange(ranges, make_irange(first, last, IR_COMPLETE));
+
+		first = last = i;
+	}
+
+	if (first >= 0)
+		ranges = lappend_irange(ranges, make_irange(first, last, IR_COMPLETE));
+
+	return ranges;
+}
+
+
+/* Forget everything we've learned about inner keys */
+static void
+reset_dynamic_filter(DynamicFilterSourceState *state)
+{
+	DynamicFilter *filter = state->filter;
+
+	bms_free(filter->parts);
+	filter->parts = NULL;
+
+	filter->ready = false;
+	filter->all = (state->prel == NULL);
+	filter->nparts = state->prel ? PrelChildrenCount(state->prel) : 0;
+
+	if (state->batch_mcxt)
+		MemoryContextReset(state->batch_mcxt);
+	state->nbatch = 0;
+}
+
+/* Save current inner key, it will be looked up later */
+static void
+add_key_to_dynamic_filter(DynamicFilterSourceState *state,
+						  ExprContext *econtext)
+{
+	MemoryContext	old_mcxt;
+	Datum			value;
+	bool			isnull;
+
+	old_mcxt = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+	value = ExecEvalExprCompat(state->key_state, econtext, &isnull);
+
+	/* NULL never matches anything */
+	if (!isnull)
+	{
+		MemoryContextSwitchTo(state->batch_mcxt);
+		state->batch[state->nbatch++] = datumCopy(value,
+												  state->key_typbyval,
+												  state->key_typlen);
+	}
+
+	MemoryContextSwitchTo(old_mcxt);
+
+	if (state->nbatch == DYNAMIC_FILTER_BATCH_SIZE)
+		flush_dynamic_filter_batch(state);
+}
+
+/*
+ * Add partitions of saved keys to filter. RANGE keys are sorted, so that
+ * we could find their partitions in a single pass over bounds.
+ */
+static void
+flush_dynamic_filter_batch(DynamicFilterSourceState *state)
+{
+	DynamicFilter	   *filter = state->filter;
+	PartRelationInfo   *prel = state->prel;
+	MemoryContext		old_mcxt;
+	int					i;
+
+	if (state->nbatch == 0)
+		return;
+
+	/* Bitmapset should live as long as the filter */
+	old_mcxt = MemoryContextSwitchTo(state->css.ss.ps.state->es_query_cxt);
+
+	switch (prel->parttype)
+	{
+		case PT_HASH:
+			{
+				for (i = 0; i < state->nbatch; i++)
+				{
+					Datum	hash;
+					uint32	idx;
+
+					/* See handle_const() */
+					hash = FunctionCall1Coll(&state->lookup_finfo,
+											 DEFAULT_COLLATION_OID,
+											 state->batch[i]);
+					idx = hash_to_part_index(DatumGetInt32(hash),
+											 PrelChildrenCount(prel));
+
+					filter->parts = bms_add_member(filter->parts, idx);
+				}
+			}
+			break;
+
+		case PT_RANGE:
+			{
+				RangeEntry *ranges = PrelGetRangesArray(prel);
+				uint32		nranges = PrelChildrenCount(prel),
+							j = 0;
+
+				qsort_arg(state->batch, state->nbatch, sizeof(Datum),
+						  cmp_batch_keys, (void *) state);
+
+				for (i = 0; i < state->nbatch && j < nranges; i++)
+				{
+					Bound key = MakeBound(state->batch[i]);
+
+					/* Skip partitions to the left of this key */
+					while (j < nranges &&
+						   cmp_bounds(&state->lookup_finfo, prel->ev_collid,
+									  &key, &ranges[j].max) >= 0)
+						j++;
+
+					/* Key might fall into a gap between partitions */
+					if (j < nranges &&
+						cmp_bounds(&state->lookup_finfo, prel->ev_collid,
+								   &key, &ranges[j].min) >= 0)
+						filter->parts = bms_add_member(filter->parts, j);
+				}
+			}
+			break;
+
+		default:
+			WrongPartType(prel->parttype);
+	}
+
+	/* Stop wasting time if nothing can be pruned */
+	if (bms_num_members(filter->parts) >= filter->nparts)
+		filter->all = true;
+
+	MemoryContextSwitchTo(old_mcxt);
+
+	MemoryContextReset(state->batch_mcxt);
+	state->nbatch = 0;
+}
+
+/* qsort() comparison function for inner keys */
+static int
+cmp_batch_keys(const void *a, const void *b, void *arg)
+{
+	DynamicFilterSourceState *state = (DynamicFilterSourceState *) arg;
+
+	return DatumGetInt32(FunctionCall2Coll(&state->lookup_finfo,
+										   state->prel->ev_collid,
+										   *(const Datum *) a,
+										   *(const Datum *) b));
+}
@@ -18,8 +18,11 @@
 #endif
 
 #include "declarative.h"
+#include "dynamic_filter.h"
 #include "hooks.h"
 #include "init.h"
+#include "monotonic_transforms.h"
+#include "partition_creation.h"
 #include "partition_filter.h"
 #include "partition_overseer.h"
 #include "partition_router.h"
@@ -30,6 +33,7 @@
 #include "utility_stmt_hooking.h"
 #include "utils.h"
 #include "xact_handling.h"
+#include "zone_maps.h"
 
 #include "access/transam.h"
 #include "access/xact.h"
@@ -43,6 +47,8 @@
 #include "utils/typcache.h"
 #include "utils/snapmgr.h"
 
+#include <math.h>
+
 
 #ifdef USE_ASSERT_CHECKING
 #define USE_RELCACHE_LOGGING
@@ -79,6 +85,176 @@ ProcessUtility_hook_type		pathman_process_utility_hook_next		= NULL;
 ExecutorStart_hook_type			pathman_executor_start_hook_prev		= NULL;
 
 
+/*
+ * Build HashJoin which prunes partitions of outer (probe) relation using keys
+ * of its inner side (see dynamic_filter.c). Partitioned table is scanned by
+ * RuntimeAppend which waits until hash table has been built.
+ */
+static void
+add_dynamic_filter_hashjoin_path(PlannerInfo *root,
+								 RelOptInfo *joinrel,
+								 RelOptInfo *outerrel,
+								 RelOptInfo *innerrel,
+								 JoinType jointype,
+								 JoinPathExtraData *extra)
+{
+	JoinCostWorkspace		workspace;
+	RangeTblEntry		   *outer_rte;
+	PartRelationInfo	   *outer_prel;
+	AppendPath			   *outer_append = NULL;
+	Path				   *outer,
+						   *inner;
+	HashPath			   *hash_path;
+	List				   *hashclauses = NIL;
+	Node				   *part_expr,
+						   *key = NULL;
+	Oid						opfamily;
+	double					sel;
+	int						paramid;
+	ListCell			   *lc;
+
+	/* Hash table should be built before outer relation is scanned */
+	if (!pg_pathman_enable_dynamic_filters || !enable_hashjoin)
+		return;
+
+	/* Unmatched outer rows must not be emitted */
+	if (jointype != JOIN_INNER &&
+		jointype != JOIN_SEMI &&
+		jointype != JOIN_UNIQUE_INNER)
+		return;
+
+	/* We should only consider base outer relations */
+	if (outerrel->reloptkind != RELOPT_BASEREL)
+		return;
+
+	outer_rte = root->simple_rte_array[outerrel->relid];
+
+	/* We shouldn't process functions, tables with active children etc */
+	if (outer_rte->rtekind != RTE_RELATION || outer_rte->inh)
+		return;
+
+	/* Result relations are expanded differently */
+	if (root->parse->resultRelation == outerrel->relid)
+		return;
+
+	/* Inner side is hashed, so it can't be parameterized */
+	inner = innerrel->cheapest_total_path;
+	if (!inner || inner->param_info)
+		return;
+
+	/* IN (subquery) might be turned into a join with unique inner keys */
+	if (jointype == JOIN_UNIQUE_INNER)
+	{
+		inner = (Path *) create_unique_path(root, innerrel, inner, extra->sjinfo);
+		if (!inner)
+			return;
+
+		jointype = JOIN_INNER;
+	}
+
+	/* Proceed iff relation 'outerrel' is partitioned */
+	if ((outer_prel = get_pathman_relation_info(outer_rte->relid)) == NULL)
+		return;
+
+	/* Select cheapest unparameterized Append of outerrel */
+	foreach (lc, outerrel->pathlist)
+	{
+		Path *path = (Path *) lfirst(lc);
+
+		if (IsA(path, AppendPath) && !path->param_info &&
+			(!outer_append || path->total_cost < outer_append->path.total_cost))
+			outer_append = (AppendPath *) path;
+	}
+
+	if (!outer_append)
+		goto cleanup;
+
+	part_expr = PrelExpressionForRelid(outer_prel, outerrel->relid);
+	opfamily = lookup_type_cache(outer_prel->ev_type,
+								 TYPECACHE_BTREE_OPFAMILY)->btree_opf;
+
+	/* Collect hash clauses just like hash_inner_and_outer() does */
+	foreach (lc, extra->restrictlist)
+	{
+		RestrictInfo   *rinfo = (RestrictInfo *) lfirst(lc);
+		OpExpr		   *clause = (OpExpr *) rinfo->clause;
+		Node		   *outer_arg,
+					   *inner_arg;
+
+		if (!rinfo->can_join || !OidIsValid(rinfo->hashjoinoperator))
+			continue;
+
+		if (bms_is_subset(rinfo->left_relids, outerrel->relids) &&
+			bms_is_subset(rinfo->right_relids, innerrel->relids))
+			rinfo->outer_is_left = true;
+		else if (bms_is_subset(rinfo->left_relids, innerrel->relids) &&
+				 bms_is_subset(rinfo->right_relids, outerrel->relids))
+			rinfo->outer_is_left = false;
+		else
+			continue;
+
+		hashclauses = lappend(hashclauses, rinfo);
+
+		/* We need only one clause on partitioning expression */
+		if (key)
+			continue;
+
+		outer_arg = rinfo->outer_is_left ? linitial(clause->args) : lsecond(clause->args);
+		inner_arg = rinfo->outer_is_left ? lsecond(clause->args) : linitial(clause->args);
+
+		/* Inner key will be looked up among partitions as is */
+		if (match_expr_to_operand(part_expr, outer_arg) &&
+			exprType(inner_arg) == outer_prel->ev_type &&
+			(!OidIsValid(clause->inputcollid) ||
+			 clause->inputcollid == outer_prel->ev_collid) &&
+			OidIsValid(opfamily) &&
+			get_op_opfamily_strategy(clause->opno, opfamily) == BTEqualStrategyNumber)
+		{
+			key = inner_arg;
+		}
+	}
+
+	if (!key)
+		goto cleanup;
+
+	/* Expected share of partitions containing at least one inner key */
+	sel = 1.0 - pow(1.0 - 1.0 / Max(PrelChildrenCount(outer_prel), 1),
+					clamp_row_est(inner->rows));
+	sel = Min(Max(sel, 0.0), 1.0);
+
+	outer = create_runtime_append_path(root, outer_append, NULL, sel);
+	if (!outer)
+		goto cleanup;
+
+	/* DynamicFilterSource will pass partitions to RuntimeAppend */
+	paramid = assign_special_exec_param_compat(root);
+	((RuntimeAppendPath *) outer)->dyn_filter_paramid = paramid;
+	inner = create_dynamic_filter_source_path(root, inner, outer_rte->relid,
+											  copyObject(key), paramid);
+
+	initial_cost_hashjoin_compat(root, &workspace, jointype, hashclauses,
+								 outer, inner, extra, false);
+
+	hash_path = create_hashjoin_path_compat(root, joinrel, jointype,
+											&workspace, extra, outer, inner,
+											false, extra->restrictlist,
+											NULL, hashclauses);
+
+	/*
+	 * HashJoin fetches first outer tuple before building hash table if
+	 * that's cheap (see ExecHashJoin()). Make sure it won't happen, but
+	 * don't let it affect the cost of the join.
+	 */
+	outer->startup_cost = Max(outer->startup_cost, inner->total_cost);
+	outer->total_cost = Max(outer->total_cost, outer->startup_cost);
+
+	add_path(joinrel, (Path *) hash_path);
+
+cleanup:
+	/* Don't forget to close 'outer_prel'! */
+	close_pathman_relation_info(outer_prel);
+}
+
 /* Take care of joins */
 void
 pathman_join_pathlist_hook(PlannerInfo *root,
@@ -108,6 +284,10 @@ pathman_join_pathlist_hook(PlannerInfo *root,
 	if (!IsPathmanReady() || !pg_pathman_enable_runtimeappend)
 		return;
 
+	/* Partitioned table might be on the probe side of HashJoin */
+	add_dynamic_filter_hashjoin_path(root, joinrel, outerrel,
+									 innerrel, jointype, extra);
+
 	/* We should only consider base inner relations */
 	if (innerrel->reloptkind != RELOPT_BASEREL)
 		return;
@@ -198,7 +378,13 @@ pathman_join_pathlist_hook(PlannerInfo *root,
 
 		InitWalkerContext(&context, part_expr, inner_prel, NULL);
 		wrap = walk_expr_tree((Expr *) lfirst(lc), &context);
-		paramsel *= wrap->paramsel;
+
+		/* Zone maps might be more selective than partitioning key */
+		if (wrap->paramsel < 1.0)
+			paramsel *= wrap->paramsel;
+		else
+			paramsel *= zone_map_paramsel((Node *) lfirst(lc), inner_prel,
+										  innerrel->relid);
 	}
 
 	foreach (lc, innerrel->pathlist)
@@ -314,6 +500,133 @@ pathman_join_pathlist_hook(PlannerInfo *root,
 	close_pathman_relation_info(inner_prel);
 }
 
+#if PG_VERSION_NUM >= 140000
+/*
+ * Rangeset of UPDATE | DELETE target, see prune_result_relation_child().
+ * It's shared by all children of this parent, so clauses are walked
+ * only once per parent.
+ */
+typedef struct
+{
+	PlannerInfo	   *root;
+	RelOptInfo	   *parent_rel;
+	List		   *ranges;
+	bool			all_selected;
+} ResultRelRanges;
+
+/*
+ * List of ResultRelRanges built by the innermost planner() call (or NULL).
+ * Every call of pathman_planner_hook() has its own list, so PlannerInfo
+ * can't be confused with a freed one of another (e.g. nested) call.
+ */
+static List **result_rel_ranges = NULL;
+
+/* Find (or build) rangeset of 'parent_rel' */
+static ResultRelRanges *
+get_result_rel_ranges(PlannerInfo *root,
+					  RelOptInfo *parent_rel,
+					  Index parent_rti,
+					  const PartRelationInfo *prel)
+{
+	ResultRelRanges	   *entry;
+	WalkerContext		context;
+	Node			   *part_expr;
+	List			   *ranges;
+	ListCell		   *lc;
+
+	if (result_rel_ranges)
+	{
+		foreach (lc, *result_rel_ranges)
+		{
+			entry = (ResultRelRanges *) lfirst(lc);
+
+			if (entry->root == root && entry->parent_rel == parent_rel)
+				return entry;
+		}
+	}
+
+	part_expr = PrelExpressionForRelid(prel, parent_rti);
+	ranges = list_make1_irange_full(prel, IR_COMPLETE);
+
+	/* Collect final rangeset just like we do for SELECT */
+	InitWalkerContext(&context, part_expr, prel, NULL);
+	foreach (lc, parent_rel->baserestrictinfo)
+	{
+		RestrictInfo   *rinfo = (RestrictInfo *) lfirst(lc);
+		WrapperNode	   *wrap = walk_expr_tree(rinfo->clause, &context);
+
+		ranges = irange_list_intersection(ranges, wrap->rangeset);
+	}
+
+	entry = palloc(sizeof(ResultRelRanges));
+	entry->root = root;
+	entry->parent_rel = parent_rel;
+	entry->ranges = ranges;
+	entry->all_selected = irange_list_length(ranges) >= PrelChildrenCount(prel);
+
+	/* Not called by pathman_planner_hook(), don't remember it */
+	if (result_rel_ranges)
+		*result_rel_ranges = lappend(*result_rel_ranges, entry);
+
+	return entry;
+}
+
+/*
+ * UPDATE | DELETE targets are expanded by standard inheritance, which
+ * can only exclude partitions using their CHECK constraints (this doesn't
+ * work for HASH partitions and some expressions). Check partition 'rel'
+ * against the rangeset of its parent and mark it as dummy if it can't
+ * contain any matching rows. Dummy leaf rels are omitted by ModifyTable.
+ */
+static void
+prune_result_relation_child(PlannerInfo *root, RelOptInfo *rel, Index rti)
+{
+	AppendRelInfo	   *appinfo;
+	RelOptInfo		   *parent_rel;
+	PartRelationInfo   *prel;
+	ResultRelRanges	   *entry;
+	Oid					child_oid;
+	int					idx;
+
+	if (rel->reloptkind != RELOPT_OTHER_MEMBER_REL ||
+		!bms_is_member(rti, root->all_result_relids) ||
+		IS_DUMMY_REL(rel))
+		return;
+
+	appinfo = root->append_rel_array ? root->append_rel_array[rti] : NULL;
+	if (!appinfo)
+		return;
+
+	/* Parent might be scanned as its own child */
+	child_oid = root->simple_rte_array[rti]->relid;
+	if (child_oid == appinfo->parent_reloid)
+		return;
+
+	/* Nothing to do if there are no quals */
+	parent_rel = root->simple_rel_array[appinfo->parent_relid];
+	if (!parent_rel || parent_rel->baserestrictinfo == NIL)
+		return;
+
+	if ((prel = get_pathman_relation_info(appinfo->parent_reloid)) == NULL)
+		return;
+
+	entry = get_result_rel_ranges(root, parent_rel, appinfo->parent_relid, prel);
+
+	/* Don't bother looking for partition if everything's selected */
+	if (!entry->all_selected)
+	{
+		/* Might be a plain inheritance child, see get_index_of_partition() */
+		idx = get_index_of_partition(child_oid, prel);
+
+		if (idx >= 0 && !irange_list_find(entry->ranges, idx, NULL))
+			mark_dummy_rel(rel);
+	}
+
+	/* Don't forget to close 'prel'! */
+	close_pathman_relation_info(prel);
+}
+#endif
+
 /* Cope with simple relations */
 void
 pathman_rel_pathlist_hook(PlannerInfo *root,
@@ -330,6 +643,8 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 	PathKey			   *pathkeyAsc = NULL,
 					   *pathkeyDesc = NULL;
 	double				paramsel = 1.0;		/* default part selectivity */
+	BulkChildContext	bulk,
+					   *bulk_ptr = NULL;	/* for lots of children */
 	WalkerContext		context;
 	Node			   *part_expr;
 	List			   *part_clauses;
@@ -345,6 +660,11 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 	if (!IsPathmanReady())
 		return;
 
+#if PG_VERSION_NUM >= 140000
+	/* Exclude partitions of UPDATE | DELETE target that don't match quals */
+	prune_result_relation_child(root, rel, rti);
+#endif
+
 	/* We shouldn't process tables with active children */
 	if (rte->inh)
 		return;
@@ -437,7 +757,11 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 	/* Get partitioning-related clauses (do this before append_child_relation()) */
 	part_clauses = get_partitioning_clauses(rel->baserestrictinfo, prel, rti);
 
-	if (prel->parttype == PT_RANGE)
+	/*
+	 * Parent's rows may belong to any range, thus partitions
+	 * can't be scanned in bound order if parent is enabled.
+	 */
+	if (prel->parttype == PT_RANGE && !prel->enable_parent)
 	{
 		/*
 		 * Get pathkeys for ascending and descending sort by partitioned column.
@@ -472,11 +796,19 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 
 		wrap = walk_expr_tree(rinfo->clause, &context);
 
-		paramsel *= wrap->paramsel;
+		/* Zone maps might be more selective than partitioning key */
+		if (wrap->paramsel < 1.0)
+			paramsel *= wrap->paramsel;
+		else
+			paramsel *= zone_map_paramsel((Node *) rinfo->clause, prel, rti);
+
 		wrappers = lappend(wrappers, wrap);
 		ranges = irange_list_intersection(ranges, wrap->rangeset);
 	}
 
+	/* Exclude partitions using summaries of non-key columns */
+	ranges = zone_map_prune_ranges(ranges, rel->baserestrictinfo, prel, rti, NULL);
+
 	/* Get number of selected partitions */
 	irange_len = irange_list_length(ranges);
 	if (prel->enable_parent)
@@ -523,6 +855,12 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 		root->simple_rel_array_size = new_len;
 	}
 
+	/* Share planning work between partitions if there are lots of them */
+	if (pg_pathman_bulk_children_threshold > 0 &&
+		irange_len >= pg_pathman_bulk_children_threshold &&
+		init_bulk_child_context(&bulk, rel->baserestrictinfo, rti))
+		bulk_ptr = &bulk;
+
 	/* Parent has already been locked by rewriter */
 	parent_rel = heap_open_compat(rte->relid, NoLock);
 
@@ -531,7 +869,7 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 	/* Add parent if asked to */
 	if (prel->enable_parent)
 		append_child_relation(root, parent_rel, parent_rowmark,
-							  rti, 0, rte->relid, NULL);
+							  rti, 0, rte->relid, NULL, NULL);
 
 	/* Iterate all indexes in rangeset and append child relations */
 	foreach(lc, ranges)
@@ -540,7 +878,7 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 
 		for (i = irange_lower(irange); i <= irange_upper(irange); i++)
 			append_child_relation(root, parent_rel, parent_rowmark,
-								  rti, i, children[i], wrappers);
+								  rti, i, children[i], wrappers, bulk_ptr);
 	}
 
 	/* Now close parent relation */
@@ -568,8 +906,8 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 		  pg_pathman_enable_runtime_merge_append))
 		goto cleanup;
 
-	/* Skip if there's no PARAMs in partitioning-related clauses */
-	if (!clause_contains_params((Node *) part_clauses))
+	/* Skip if there's no PARAMs or stable functions in partitioning clauses */
+	if (!clause_contains_runtime_values((Node *) part_clauses))
 		goto cleanup;
 
 	/* Generate Runtime[Merge]Append paths if needed */
@@ -745,6 +1083,15 @@ pathman_planner_hook(Query *parse, int cursorOptions, ParamListInfo boundParams)
 
 	/* Save the result in case it changes */
 	bool			pathman_ready = IsPathmanReady();
+	bool			pathman_relevant = false;
+
+#if PG_VERSION_NUM >= 140000
+	/* Rangesets of UPDATE | DELETE targets planned by this call */
+	List		   *this_call_ranges = NIL,
+				  **prev_call_ranges = result_rel_ranges;
+
+	result_rel_ranges = &this_call_ranges;
+#endif
 
 	PG_TRY();
 	{
@@ -753,8 +1100,12 @@ pathman_planner_hook(Query *parse, int cursorOptions, ParamListInfo boundParams)
 			/* Increase planner() calls count */
 			incr_planner_calls_count();
 
+			/* Don't walk trees of queries over plain tables */
+			pathman_relevant = pathman_query_is_relevant(parse);
+
 			/* Modify query tree if needed */
-			pathman_transform_query(parse, boundParams);
+			if (pathman_relevant)
+				pathman_transform_query(parse, boundParams);
 		}
 
 		/* Invoke original hook if needed */
@@ -771,7 +1122,7 @@ pathman_planner_hook(Query *parse, int cursorOptions, ParamListInfo boundParams)
 			result = standard_planner(parse, cursorOptions, boundParams);
 #endif
 
-		if (pathman_ready)
+		if (pathman_ready && pathman_relevant)
 		{
 			int		lastPlanNodeId = 0;
 			ListCell *l;
@@ -782,9 +1133,6 @@ pathman_planner_hook(Query *parse, int cursorOptions, ParamListInfo boundParams)
 			/* Add PartitionRouter node for UPDATE queries */
 			execute_for_plantree(result, add_partition_routers);
 
-			/* Decrement planner() calls count */
-			decr_planner_calls_count();
-
 			/* remake parsed tree presentation fixes due to possible adding nodes */
 			result->planTree = plan_tree_visitor(result->planTree, reset_plan_node_ids, &lastPlanNodeId);
 			foreach(l, result->subplans)
@@ -795,6 +1143,16 @@ pathman_planner_hook(Query *parse, int cursorOptions, ParamListInfo boundParams)
 			/* HACK: restore queryId set by pg_stat_statements */
 			result->queryId = query_id;
 		}
+
+		if (pathman_ready)
+		{
+			/* Decrement planner() calls count */
+			decr_planner_calls_count();
+		}
+
+#if PG_VERSION_NUM >= 140000
+		result_rel_ranges = prev_call_ranges;
+#endif
 	}
 	/* We must decrease parenthood statuses refcount on ERROR */
 	PG_CATCH();
@@ -805,6 +1163,10 @@ pathman_planner_hook(Query *parse, int cursorOptions, ParamListInfo boundParams)
 			decr_planner_calls_count();
 		}
 
+#if PG_VERSION_NUM >= 140000
+		result_rel_ranges = prev_call_ranges;
+#endif
+
 		/* Rethrow ERROR further */
 		PG_RE_THROW();
 	}
@@ -938,16 +1300,15 @@ pathman_post_parse_analyze_hook(ParseState *pstate, Query *query)
 		}
 
 		/* Modify query tree if needed */
-		pathman_transform_query(query, NULL);
+		if (pathman_query_is_relevant(query))
+			pathman_transform_query(query, NULL);
 		return;
 	}
 
-#if PG_VERSION_NUM >= 100000
-	/*
-	 * for now this call works only for declarative partitioning so
-	 * we disabled it
-	 */
-	pathman_post_analyze_query(query);
+#ifdef ENABLE_DECLARATIVE
+	/* Only ALTER TABLE is modified for declarative partitioning */
+	if (query->commandType == CMD_UTILITY)
+		pathman_post_analyze_query(query);
 #endif
 }
 
@@ -964,6 +1325,10 @@ pathman_shmem_startup_hook(void)
 	/* Allocate shared memory objects */
 	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
 	init_concurrent_part_task_slots();
+	init_provisioning_shmem();
+	init_spawn_pool();
+	init_spawned_partitions();
+	init_zone_maps_shmem();
 	LWLockRelease(AddinShmemInitLock);
 }
 
@@ -988,6 +1353,8 @@ pathman_relcache_hook(Datum arg, Oid relid)
 		invalidate_bounds_cache();
 		invalidate_parents_cache();
 		invalidate_status_cache();
+		invalidate_monotonic_transforms();
+		invalidate_partition_templates();
 		delay_pathman_shutdown();  /* see below */
 	}
 
@@ -1004,6 +1371,12 @@ pathman_relcache_hook(Datum arg, Oid relid)
 		delay_pathman_shutdown();
 	}
 
+	/* Invalidation event for registry of monotonic transforms */
+	else if (relid == get_pathman_monotonic_transforms_relid(true))
+	{
+		invalidate_monotonic_transforms();
+	}
+
 	/* Invalidation event for some user table */
 	else if (relid >= FirstNormalObjectId)
 	{
@@ -1015,6 +1388,9 @@ pathman_relcache_hook(Datum arg, Oid relid)
 
 		/* Invalidate PartParentInfo entry if needed */
 		forget_parent_of_partition(relid);
+
+		/* Invalidate PartitionTemplate entry if needed */
+		forget_partition_template(relid);
 	}
 }
 
@@ -1235,6 +1611,10 @@ pathman_executor_start_hook(QueryDesc *queryDesc, int eflags)
 	/*
 	 * HACK for compatibility with pgpro_stats.
 	 * Fix possibly broken planstate tree.
+	 *
+	 * PartitionRouter can only be found in UPDATE or data-modifying CTE.
 	 */
-	state_tree_visitor(queryDesc->planstate, fix_mt_refs, NULL);
+	if (queryDesc->plannedstmt->commandType == CMD_UPDATE ||
+		queryDesc->plannedstmt->hasModifyingCTE)
+		state_tree_visitor(queryDesc->planstate, fix_mt_refs, NULL);
 }
@@ -316,6 +316,45 @@
 #endif /* PG_VERSION_NUM */
 
 
+/*
+ * create_append_path() for ordered Append (children scanned in bound order).
+ * Only 12+ is able to add Sort nodes to unsorted children of an Append.
+ */
+#if PG_VERSION_NUM >= 140000
+#define create_ordered_append_path_compat(root, rel, subpaths, pathkeys) \
+	create_append_path((root), (rel), (subpaths), NIL, (pathkeys), NULL, \
+					   0, false, -1)
+#elif PG_VERSION_NUM >= 130000
+#define create_ordered_append_path_compat(root, rel, subpaths, pathkeys) \
+	create_append_path((root), (rel), (subpaths), NIL, (pathkeys), NULL, \
+					   0, false, NIL, -1)
+#elif PG_VERSION_NUM >= 120000
+
+#ifndef PGPRO_VERSION
+#define create_ordered_append_path_compat(root, rel, subpaths, pathkeys) \
+	create_append_path((root), (rel), (subpaths), NIL, (pathkeys), NULL, \
+					   0, false, NIL, -1)
+#else
+#define create_ordered_append_path_compat(root, rel, subpaths, pathkeys) \
+	create_append_path((root), (rel), (subpaths), NIL, (pathkeys), NULL, \
+					   0, false, NIL, -1, false)
+#endif /* PGPRO_VERSION */
+
+#endif /* PG_VERSION_NUM */
+
+
+/*
+ * ExplainPropertyInteger()
+ */
+#if PG_VERSION_NUM >= 110000
+#define ExplainPropertyIntegerCompat(qlabel, value, es) \
+		ExplainPropertyInteger((qlabel), NULL, (value), (es))
+#elif PG_VERSION_NUM >= 90500
+#define ExplainPropertyIntegerCompat(qlabel, value, es) \
+		ExplainPropertyLong((qlabel), (value), (es))
+#endif
+
+
 /*
  * create_merge_append_path()
  */
@@ -543,6 +582,56 @@ char get_rel_persistence(Oid relid);
 #endif
 
 
+/*
+ * create_hashjoin_path()
+ */
+#if PG_VERSION_NUM >= 110000
+#define create_hashjoin_path_compat(root, joinrel, jointype, workspace, extra, \
+									outer, inner, parallel_hash, \
+									restrict_clauses, required_outer, hashclauses) \
+		create_hashjoin_path((root), (joinrel), (jointype), (workspace), (extra), \
+							 (outer), (inner), (parallel_hash), (restrict_clauses), \
+							 (required_outer), (hashclauses))
+#elif PG_VERSION_NUM >= 100000 || (defined(PGPRO_VERSION) && PG_VERSION_NUM >= 90603)
+#define create_hashjoin_path_compat(root, joinrel, jointype, workspace, extra, \
+									outer, inner, parallel_hash, \
+									restrict_clauses, required_outer, hashclauses) \
+		create_hashjoin_path((root), (joinrel), (jointype), (workspace), (extra), \
+							 (outer), (inner), (restrict_clauses), \
+							 (required_outer), (hashclauses))
+#elif PG_VERSION_NUM >= 90500
+#define create_hashjoin_path_compat(root, joinrel, jointype, workspace, extra, \
+									outer, inner, parallel_hash, \
+									restrict_clauses, required_outer, hashclauses) \
+		create_hashjoin_path((root), (joinrel), (jointype), (workspace), \
+							 (extra)->sjinfo, &(extra)->semifactors, (outer), \
+							 (inner), (restrict_clauses), (required_outer), \
+							 (hashclauses))
+#endif
+
+
+/*
+ * initial_cost_hashjoin()
+ */
+#if PG_VERSION_NUM >= 110000
+#define initial_cost_hashjoin_compat(root, workspace, jointype, hashclauses, \
+									 outer_path, inner_path, extra, parallel_hash) \
+		initial_cost_hashjoin((root), (workspace), (jointype), (hashclauses), \
+							  (outer_path), (inner_path), (extra), (parallel_hash))
+#elif PG_VERSION_NUM >= 100000 || (defined(PGPRO_VERSION) && PG_VERSION_NUM >= 90603)
+#define initial_cost_hashjoin_compat(root, workspace, jointype, hashclauses, \
+									 outer_path, inner_path, extra, parallel_hash) \
+		initial_cost_hashjoin((root), (workspace), (jointype), (hashclauses), \
+							  (outer_path), (inner_path), (extra))
+#elif PG_VERSION_NUM >= 90500
+#define initial_cost_hashjoin_compat(root, workspace, jointype, hashclauses, \
+									 outer_path, inner_path, extra, parallel_hash) \
+		initial_cost_hashjoin((root), (workspace), (jointype), (hashclauses), \
+							  (outer_path), (inner_path), (extra)->sjinfo, \
+							  &(extra)->semifactors)
+#endif
+
+
 /*
  * initial_cost_nestloop()
  */
@@ -920,6 +1009,18 @@ extern AttrNumber *convert_tuples_by_name_map(TupleDesc indesc,
 	BackgroundWorkerInitializeConnectionByOid((dboid), (useroid))
 #endif
 
+/*
+ * WaitLatch()
+ * In >=10 new argument 'wait_event_info' was added
+ */
+#if PG_VERSION_NUM >= 100000
+#define WaitLatchCompat(latch, wakeEvents, timeout) \
+		WaitLatch((latch), (wakeEvents), (timeout), PG_WAIT_EXTENSION)
+#else
+#define WaitLatchCompat(latch, wakeEvents, timeout) \
+		WaitLatch((latch), (wakeEvents), (timeout))
+#endif
+
 /*
  * heap_delete()
  */
@@ -993,6 +1094,15 @@ extern AttrNumber *convert_tuples_by_name_map(TupleDesc indesc,
 #define is_andclause_compat(clause) and_clause(clause)
 #endif
 
+/*
+ * is_orclause
+ */
+#if PG_VERSION_NUM >= 120000
+#define is_orclause_compat(clause) is_orclause(clause)
+#else
+#define is_orclause_compat(clause) or_clause(clause)
+#endif
+
 /*
  * GetDefaultTablespace
  */
@@ -1252,4 +1362,50 @@ void set_append_rel_size_compat(PlannerInfo *root, RelOptInfo *rel, Index rti);
 #define EvalPlanQualInit_compat(epqstate, parentestate, subplan, auxrowmarks, epqParam)    EvalPlanQualInit(epqstate, parentestate, subplan, auxrowmarks, epqParam)
 #endif
 
+/*
+ * F_TEXT_STARTS_WITH
+ * In >=14 fmgroids are named after pg_proc.proname
+ */
+#if PG_VERSION_NUM >= 140000
+#define F_TEXT_STARTS_WITH_COMPAT	F_STARTS_WITH
+#elif PG_VERSION_NUM >= 110000
+#define F_TEXT_STARTS_WITH_COMPAT	F_TEXT_STARTS_WITH
+#endif
+
+/*
+ * SS_assign_special_param()
+ * In >=12 function was moved to paramassign.c and renamed
+ */
+#if PG_VERSION_NUM >= 120000
+#include "optimizer/paramassign.h"
+#define assign_special_exec_param_compat(root)	assign_special_exec_param(root)
+#else
+#include "optimizer/subselect.h"
+#define assign_special_exec_param_compat(root)	SS_assign_special_param(root)
+#endif
+
+/*
+ * shm_mq_send()
+ * In >=15 new argument 'force_flush' was added
+ */
+#if PG_VERSION_NUM >= 150000
+#define shm_mq_send_compat(mqh, nbytes, data, nowait) \
+		shm_mq_send((mqh), (nbytes), (data), (nowait), false)
+#else
+#define shm_mq_send_compat(mqh, nbytes, data, nowait) \
+		shm_mq_send((mqh), (nbytes), (data), (nowait))
+#endif
+
+/*
+ * shm_mq_detach()
+ * In >=10 function accepts shm_mq_handle instead of shm_mq
+ */
+#if PG_VERSION_NUM >= 100000
+#define shm_mq_detach_compat(mqh) \
+		shm_mq_detach(mqh)
+#else
+#define shm_mq_detach_compat(mqh) \
+		shm_mq_detach(shm_mq_get_queue(mqh))
+#endif
+
 #endif /* PG_COMPAT_H */
@@ -0,0 +1,117 @@
+/* ------------------------------------------------------------------------
+ *
+ * dynamic_filter.h
+ *		Partition pruning using inner side of a hash join
+ *
+ * Copyright (c) 2026, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef DYNAMIC_FILTER_H
+#define DYNAMIC_FILTER_H
+
+
+#include "pathman.h"
+#include "relation_info.h"
+
+#include "postgres.h"
+#include "commands/explain.h"
+#include "nodes/bitmapset.h"
+#include "optimizer/pathnode.h"
+
+#if PG_VERSION_NUM >= 90600
+#include "nodes/extensible.h"
+#endif
+
+
+#define DYNAMIC_FILTER_NODE_NAME "DynamicFilterSource"
+
+/* Number of inner keys looked up at once */
+#define DYNAMIC_FILTER_BATCH_SIZE	1024
+
+
+/*
+ * Partitions which might contain matches for inner keys of a hash join.
+ * Stored in a PARAM_EXEC slot, see DynamicFilterSourceState.
+ */
+typedef struct
+{
+	bool				ready;		/* inner side has been fully scanned */
+	bool				all;		/* every partition might match */
+	Bitmapset		   *parts;		/* indexes of matching partitions */
+	uint32				nparts;		/* number of partitions of 'prel' */
+} DynamicFilter;
+
+typedef struct
+{
+	CustomPath			cpath;
+	Oid					relid;		/* relid of the partitioned table */
+	Node			   *key;		/* inner side of the hash clause */
+	int					paramid;	/* PARAM_EXEC slot for DynamicFilter */
+} DynamicFilterSourcePath;
+
+typedef struct
+{
+	CustomScanState		css;
+	Oid					relid;		/* relid of the partitioned table */
+	int					paramid;	/* PARAM_EXEC slot for DynamicFilter */
+
+	/* Inner key and its type */
+	Node			   *key;
+	ExprState		   *key_state;
+	Oid					key_type;
+	int16				key_typlen;
+	bool				key_typbyval;
+
+	PartRelationInfo   *prel;
+	DynamicFilter	   *filter;
+
+	/* Keys waiting to be mapped to partitions */
+	Datum			   *batch;
+	int					nbatch;
+	MemoryContext		batch_mcxt;
+	FmgrInfo			lookup_finfo;	/* 'cmp_proc' or 'hash_proc' of prel */
+} DynamicFilterSourceState;
+
+
+extern bool					pg_pathman_enable_dynamic_filters;
+
+extern CustomPathMethods	dynamic_filter_path_methods;
+extern CustomScanMethods	dynamic_filter_plan_methods;
+extern CustomExecMethods	dynamic_filter_exec_methods;
+
+
+void init_dynamic_filter_static_data(void);
+
+Path *create_dynamic_filter_source_path(PlannerInfo *root,
+										Path *subpath,
+										Oid relid,
+										Node *key,
+										int paramid);
+
+Plan *create_dynamic_filter_source_plan(PlannerInfo *root, RelOptInfo *rel,
+										CustomPath *best_path, List *tlist,
+										List *clauses, List *custom_plans);
+
+Node *dynamic_filter_create_scan_state(CustomScan *node);
+
+void dynamic_filter_begin(CustomScanState *node,
+						  EState *estate,
+						  int eflags);
+
+TupleTableSlot *dynamic_filter_exec(CustomScanState *node);
+
+void dynamic_filter_end(CustomScanState *node);
+
+void dynamic_filter_rescan(CustomScanState *node);
+
+void dynamic_filter_explain(CustomScanState *node,
+							List *ancestors,
+							ExplainState *es);
+
+List *dynamic_filter_ranges(const DynamicFilter *filter,
+							const PartRelationInfo *prel);
+
+
+#endif /* DYNAMIC_FILTER_H */
@@ -150,6 +150,8 @@ simplify_mcxt_name(MemoryContext mcxt)
 #define DEFAULT_PATHMAN_AUTO				true
 #define DEFAULT_PATHMAN_INIT_CALLBACK		InvalidOid
 #define DEFAULT_PATHMAN_SPAWN_USING_BGW		false
+#define DEFAULT_PATHMAN_PREMAKE				0
+#define DEFAULT_PATHMAN_SPAWN_SPARSE		false
 
 /* Other default values (for GUCs etc) */
 #define DEFAULT_PATHMAN_ENABLE				true
@@ -157,10 +159,10 @@ simplify_mcxt_name(MemoryContext mcxt)
 
 
 /* Lowest version of Pl/PgSQL frontend compatible with internals */
-#define LOWEST_COMPATIBLE_FRONT		"1.5.0"
+#define LOWEST_COMPATIBLE_FRONT		"1.6.0"
 
 /* Current version of native C library */
-#define CURRENT_LIB_VERSION			"1.5.12"
+#define CURRENT_LIB_VERSION			"1.6.0"
 
 
 void *pathman_cache_search_relid(HTAB *cache_table,
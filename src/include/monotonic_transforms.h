@@ -0,0 +1,38 @@
+/* ------------------------------------------------------------------------
+ *
+ * monotonic_transforms.h
+ *		Registry of monotonic functions of partitioning expression
+ *
+ * Copyright (c) 2026, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef PATHMAN_MONOTONIC_TRANSFORMS_H
+#define PATHMAN_MONOTONIC_TRANSFORMS_H
+
+
+#include "postgres.h"
+#include "fmgr.h"
+
+
+/*
+ * Non-decreasing function of one of its arguments,
+ * see table "pathman_monotonic_transforms".
+ */
+typedef struct MonotonicTransform
+{
+	Oid			transform;		/* key */
+	int			key_arg;		/* monotonic argument (starting with 0) */
+	Oid			lower_bound;	/* min X such that transform(X) >= value */
+	Oid			upper_bound;	/* min X such that transform(X) > value, or
+								   InvalidOid if 'lower_bound' is an inverse
+								   of strictly increasing 'transform' */
+} MonotonicTransform;
+
+
+const MonotonicTransform *get_monotonic_transform(Oid funcid);
+void invalidate_monotonic_transforms(void);
+
+
+#endif /* PATHMAN_MONOTONIC_TRANSFORMS_H */
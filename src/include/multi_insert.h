@@ -0,0 +1,105 @@
+/* ------------------------------------------------------------------------
+ *
+ * multi_insert.h
+ *		Buffered insertion of tuples into partitions
+ *
+ * Copyright (c) 2026, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef PATHMAN_MULTI_INSERT_H
+#define PATHMAN_MULTI_INSERT_H
+
+
+#include "partition_filter.h"
+
+#include "postgres.h"
+#include "access/heapam.h"
+#include "executor/tuptable.h"
+#include "nodes/execnodes.h"
+#include "nodes/pg_list.h"
+
+
+/* Flush all buffers once they hold this many tuples (see copy.c) */
+#define MULTI_INSERT_MAX_TUPLES			1000
+
+/* ... or this many bytes */
+#define MULTI_INSERT_MAX_BYTES			65535
+
+/* Max number of partitions having their own buffers */
+#define MULTI_INSERT_MAX_PARTITIONS		32
+
+
+/*
+ * Number of tuples and batches inserted into a partition.
+ */
+typedef struct
+{
+	Oid						partid;
+	uint64					ntuples;
+	uint64					nbatches;
+} MultiInsertStats;
+
+/*
+ * Tuples waiting to be inserted into a single partition.
+ */
+typedef struct
+{
+	ResultRelInfoHolder	   *rri_holder;		/* target partition */
+	BulkInsertState			bistate;
+	MultiInsertStats	   *stats;			/* might be NULL */
+	bool					check_zone_maps;	/* see zone_maps_check_tuples() */
+
+#if PG_VERSION_NUM >= 120000
+	TupleTableSlot		   *slots[MULTI_INSERT_MAX_TUPLES];
+#else
+	HeapTuple				tuples[MULTI_INSERT_MAX_TUPLES];
+#endif
+	int						ntuples;
+	Size					nbytes;			/* approximate size of tuples */
+} MultiInsertBuffer;
+
+/*
+ * Per-partition buffers of a single INSERT or COPY.
+ */
+typedef struct MultiInsertState
+{
+	EState				   *estate;
+	CommandId				cid;
+
+	List				   *buffers;		/* MultiInsertBuffers */
+	MultiInsertBuffer	   *last_buffer;	/* most recently used buffer */
+
+	int						ntuples;		/* tuples in all buffers */
+	Size					nbytes;			/* their approximate size */
+
+	MemoryContext			flush_mcxt;		/* reset after each flush */
+
+	bool					track_stats;
+	List				   *stats;			/* MultiInsertStats */
+
+#if PG_VERSION_NUM < 120000
+	MemoryContext			mcxt;			/* holds buffered HeapTuples */
+	TupleTableSlot		   *index_slot;		/* for ExecInsertIndexTuples() */
+#endif
+} MultiInsertState;
+
+
+void init_multi_insert_state(MultiInsertState *mistate, EState *estate,
+							 bool track_stats);
+void fini_multi_insert_state(MultiInsertState *mistate);
+
+bool multi_insert_allowed(ResultRelInfoHolder *rri_holder);
+
+void multi_insert_add_tuple(MultiInsertState *mistate,
+							ResultRelInfoHolder *rri_holder,
+							TupleTableSlot *slot);
+
+void multi_insert_flush(MultiInsertState *mistate);
+
+void multi_insert_forget(MultiInsertState *mistate,
+						 ResultRelInfoHolder *rri_holder);
+
+
+#endif /* PATHMAN_MULTI_INSERT_H */
@@ -16,6 +16,7 @@
 
 #include "postgres.h"
 #include "commands/explain.h"
+#include "lib/ilist.h"
 #include "optimizer/planner.h"
 
 #if PG_VERSION_NUM >= 90600
@@ -47,6 +48,14 @@ typedef struct
 	}			content;
 
 	int			original_order;		/* for sorting in EXPLAIN */
+
+	/* Bookkeeping for initialized children (see RuntimeAppendState) */
+	dlist_node	lru_node;			/* position in LRU list */
+	uint64		last_used;			/* last rescan that selected this child */
+	MemoryContext mcxt;				/* holds child's PlanState */
+	List	   *slots;				/* TupleTableSlots made by ExecInitNode() */
+	List	   *exprcontexts;		/* ExprContexts made by ExecInitNode() */
+	Index		opened_rti;			/* es_relations entry opened by child, or 0 */
 } ChildScanCommonData;
 
 typedef ChildScanCommonData *ChildScanCommon;
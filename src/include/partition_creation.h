@@ -12,6 +12,7 @@
 #define PARTITION_CREATION_H
 
 
+#include "pathman_workers.h"
 #include "relation_info.h"
 
 #include "postgres.h"
@@ -25,6 +26,13 @@
 /* Create RANGE partitions to store some value */
 Oid create_partitions_for_value(Oid relid, Datum value, Oid value_type);
 Oid create_partitions_for_value_internal(Oid relid, Datum value, Oid value_type);
+SpawnPartitionsTask *create_partitions_for_value_async(Oid relid, Datum value,
+													  Oid value_type);
+
+
+/* Shmem for partitions spawned by concurrent backends */
+Size estimate_spawned_partitions_size(void);
+void init_spawned_partitions(void);
 
 
 /* Create one RANGE partition */
@@ -35,6 +43,14 @@ Oid create_single_range_partition_internal(Oid parent_relid,
 										   RangeVar *partition_rv,
 										   char *tablespace);
 
+/* Create a series of RANGE partitions */
+void create_range_partitions_bulk(Oid parent_relid,
+								  const Bound *bounds,
+								  int nbounds,
+								  Oid value_type,
+								  RangeVar **partition_rvs,
+								  char **tablespaces);
+
 /* Create one HASH partition */
 Oid create_single_hash_partition_internal(Oid parent_relid,
 										  uint32 part_idx,
@@ -18,7 +18,9 @@
 #include "postgres.h"
 #include "access/tupconvert.h"
 #include "commands/explain.h"
+#include "lib/ilist.h"
 #include "optimizer/planner.h"
+#include "utils/tuplestore.h"
 
 #if PG_VERSION_NUM >= 90600
 #include "nodes/extensible.h"
@@ -52,6 +54,11 @@ typedef struct
 
 	PartRelationInfo   *prel;					/* this child might be a parent... */
 	ExprState		   *prel_expr_state;		/* and have its own part. expression */
+
+	bool				evictable;				/* may it be closed before the end? */
+	dlist_node			lru_node;				/* element of 'lru_list' if evictable */
+	MemoryContext		mcxt;					/* owns ResultRelInfo etc, may be NULL */
+	int					rri_index;				/* position in es_result_relations */
 } ResultRelInfoHolder;
 
 
@@ -68,12 +75,26 @@ typedef struct
 struct ResultPartsStorage;
 typedef struct ResultPartsStorage ResultPartsStorage;
 
+/* Forward declaration (see multi_insert.h) */
+struct MultiInsertState;
+
 /*
  * Callback to be fired at rri_holder creation/destruction.
  */
 typedef void (*rri_holder_cb)(ResultRelInfoHolder *rri_holder,
 							  const ResultPartsStorage *rps_storage);
 
+/*
+ * Callback to be fired if there's no partition for 'value'.
+ * Returns true if 'slot' has been put aside till it's created.
+ */
+typedef bool (*defer_spawn_cb)(ResultPartsStorage *rps_storage,
+							   Oid parent_relid,
+							   Datum value,
+							   Oid value_type,
+							   TupleTableSlot *slot,
+							   void *arg);
+
 /*
  * Cached ResultRelInfos of partitions.
  */
@@ -95,6 +116,14 @@ struct ResultPartsStorage
 	rri_holder_cb		fini_rri_holder_cb;
 	void			   *fini_rri_holder_cb_arg;
 
+	/* Called before partition is closed due to 'max_open_partitions' */
+	rri_holder_cb		evict_rri_holder_cb;
+	void			   *evict_rri_holder_cb_arg;
+
+	/* Called instead of creating partitions, see select_partition_for_insert() */
+	defer_spawn_cb		defer_cb;
+	void			   *defer_cb_arg;
+
 	bool				close_relations;
 	LOCKMODE			head_open_lock_mode;
 
@@ -104,6 +133,23 @@ struct ResultPartsStorage
 #if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
 	ResultRelInfo	   *init_rri;				/* first initialized ResultRelInfo */
 #endif
+
+	/* Same for all partitions, see prepare_first_touch() */
+	bool				first_touch_ready;
+	RangeTblEntry	   *parent_rte;				/* RTE of 'base_rri' */
+	Relation			translation_rel;		/* source of Var translations */
+	bool				use_templates;			/* may we use cached metadata? */
+#if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
+	RTEPermissionInfo  *parent_perminfo;		/* permissions of 'init_rri' */
+#endif
+
+	/* Budget of open partitions, see evict_result_parts_storage() */
+	int					max_open_partitions;	/* 0 means "no limit" */
+	dlist_head			lru_list;				/* most recently used go first */
+	List			   *free_rt_indexes;		/* RTEs of evicted partitions */
+	List			   *free_rri_indexes;		/* their es_result_relations slots */
+	uint64				partitions_opened;		/* statistics for tuning */
+	uint64				partitions_evicted;
 };
 
 typedef struct
@@ -120,6 +166,15 @@ typedef struct
 
 	TupleTableSlot	   *tup_convert_slot;		/* slot for rebuilt tuples */
 
+	bool				can_set_tag;			/* see ModifyTable */
+	struct MultiInsertState *multi_insert;		/* not NULL in batch mode */
+
+	/* Tuples waiting for partitions being created by BGWs */
+	List			   *pending_spawns;			/* PendingSpawns */
+	Tuplestorestate	   *replay_rows;			/* partitions are ready */
+	TupleTableSlot	   *replay_slot;			/* slot for 'replay_rows' */
+	bool				subplan_done;			/* subplan returned NULL */
+
 #if PG_VERSION_NUM >= 160000 /* for commit 178ee1d858 */
 	Index				parent_rti;				/* Parent RT index for use of EXPLAIN,
 												   see "ModifyTable::nominalRelation" */
@@ -128,7 +183,10 @@ typedef struct
 
 
 extern bool					pg_pathman_enable_partition_filter;
+extern bool					pg_pathman_enable_batch_inserts;
+extern bool					pg_pathman_enable_async_spawn;
 extern int					pg_pathman_insert_into_fdw;
+extern int					pg_pathman_max_open_partitions;
 
 extern CustomScanMethods	partition_filter_plan_methods;
 extern CustomExecMethods	partition_filter_exec_methods;
@@ -180,6 +238,10 @@ ResultRelInfoHolder * scan_result_parts_storage(EState *estate, ResultPartsStora
 /* Refresh PartRelationInfo in storage */
 PartRelationInfo * refresh_result_parts_storage(ResultPartsStorage *parts_storage, Oid partid);
 
+/* Invalidate cached metadata of partitions */
+void forget_partition_template(Oid partid);
+void invalidate_partition_templates(void);
+
 TupleConversionMap * build_part_tuple_map(Relation parent_rel, Relation child_rel);
 
 TupleConversionMap * build_part_tuple_map_child(Relation child_rel);
@@ -202,7 +264,8 @@ Plan * make_partition_filter(Plan *subplan,
 							 Index parent_rti,
 							 OnConflictAction conflict_action,
 							 CmdType command_type,
-							 List *returning_list);
+							 List *returning_list,
+							 bool can_set_tag);
 
 
 Node * partition_filter_create_scan_state(CustomScan *node);
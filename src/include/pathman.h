@@ -58,12 +58,39 @@
  * Definitions for the "pathman_config_params" table.
  */
 #define PATHMAN_CONFIG_PARAMS						"pathman_config_params"
-#define Natts_pathman_config_params					5
+#define Natts_pathman_config_params					8
 #define Anum_pathman_config_params_partrel			1	/* primary key */
 #define Anum_pathman_config_params_enable_parent	2	/* include parent into plan */
 #define Anum_pathman_config_params_auto				3	/* auto partitions creation */
 #define Anum_pathman_config_params_init_callback	4	/* partition action callback */
 #define Anum_pathman_config_params_spawn_using_bgw	5	/* should we use spawn BGW? */
+#define Anum_pathman_config_params_zone_map_columns	6	/* summarized columns (text[]) */
+#define Anum_pathman_config_params_premake			7	/* partitions to create ahead */
+#define Anum_pathman_config_params_spawn_sparse		8	/* skip intermediate partitions */
+
+/*
+ * Definitions for the "pathman_zone_maps" table.
+ */
+#define PATHMAN_ZONE_MAPS					"pathman_zone_maps"
+#define Natts_pathman_zone_maps				7
+#define Anum_pathman_zone_maps_partrel		1	/* parent relation (regclass) */
+#define Anum_pathman_zone_maps_partition	2	/* summarized partition (regclass) */
+#define Anum_pathman_zone_maps_attname		3	/* summarized column (text) */
+#define Anum_pathman_zone_maps_atttype		4	/* type of column (regtype) */
+#define Anum_pathman_zone_maps_valid		5	/* is summary up to date? */
+#define Anum_pathman_zone_maps_min_value	6	/* min value (text) */
+#define Anum_pathman_zone_maps_max_value	7	/* max value (text) */
+
+/*
+ * Definitions for the "pathman_monotonic_transforms" table.
+ */
+#define PATHMAN_MONOTONIC_TRANSFORMS		"pathman_monotonic_transforms"
+#define Natts_pathman_monotonic_transforms	5
+#define Anum_pathman_mt_transform			1	/* monotonic function (regprocedure) */
+#define Anum_pathman_mt_key_arg				2	/* its monotonic argument (int4) */
+#define Anum_pathman_mt_lower_bound			3	/* min X: f(X) >= value (regprocedure) */
+#define Anum_pathman_mt_upper_bound			4	/* min X: f(X) > value (regprocedure) */
+#define Anum_pathman_mt_builtin				5	/* is it shipped with pg_pathman? */
 
 /*
  * Definitions for the "pathman_partition_list" view.
@@ -87,21 +114,51 @@
 #define Anum_pathman_cs_used				3	/* used space */
 #define Anum_pathman_cs_entries				4	/* number of cache entries */
 
+/*
+ * Definitions for the "pathman_copy_stats" view.
+ */
+#define Natts_pathman_copy_stats			3
+#define Anum_pathman_cps_parent				1	/* target of the last COPY FROM */
+#define Anum_pathman_cps_opened				2	/* partitions opened */
+#define Anum_pathman_cps_evicted			3	/* partitions evicted */
+
 
 /*
  * Cache current PATHMAN_CONFIG relid (set during load_config()).
  */
 extern Oid	pathman_config_relid;
 extern Oid	pathman_config_params_relid;
+extern Oid	pathman_zone_maps_relid;
+extern Oid	pathman_monotonic_transforms_relid;
 
 /*
  * Just to clarify our intentions (return the corresponding relid).
  */
 Oid get_pathman_config_relid(bool invalid_is_ok);
 Oid get_pathman_config_params_relid(bool invalid_is_ok);
+Oid get_pathman_zone_maps_relid(bool invalid_is_ok);
+Oid get_pathman_monotonic_transforms_relid(bool invalid_is_ok);
 Oid get_pathman_schema(void);
 
 
+/*
+ * Min number of selected partitions which enables bulk child mode.
+ */
+extern int	pg_pathman_bulk_children_threshold;
+
+/*
+ * State shared by partitions expanded in bulk child mode.
+ */
+typedef struct
+{
+	List	   *translated_vars;	/* translation of the first cached child */
+	List	   *entries;			/* restrictions for each seen set of clauses */
+} BulkChildContext;
+
+bool init_bulk_child_context(BulkChildContext *bulk,
+							 List *restrictinfo,
+							 Index parent_rti);
+
 /*
  * Create RelOptInfo & RTE for a selected partition.
  */
@@ -111,7 +168,8 @@ Index append_child_relation(PlannerInfo *root,
 							Index parent_rti,
 							int ir_index,
 							Oid child_oid,
-							List *wrappers);
+							List *wrappers,
+							BulkChildContext *bulk);
 
 
 /*
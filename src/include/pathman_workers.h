@@ -2,12 +2,15 @@
  *
  * pathman_workers.h
  *
- *		There are two purposes of this subsystem:
+ *		There are five purposes of this subsystem:
  *
  *			* Create new partitions for INSERT in separate transaction
  *			* Process concurrent partitioning operations
+ *			* Refresh zone maps one partition at a time
+ *			* Load data using several COPY workers
+ *			* Create RANGE partitions ahead of time
  *
- *		Background worker API is used for both cases.
+ *		Background worker API is used for all cases.
  *
  * Copyright (c) 2015-2016, Postgres Professional
  *
@@ -19,6 +22,9 @@
 
 
 #include "postgres.h"
+#include "postmaster/bgworker.h"
+#include "storage/dsm.h"
+#include "storage/latch.h"
 #include "storage/spin.h"
 
 #if PG_VERSION_NUM >= 90600
@@ -53,6 +59,171 @@ typedef struct
 } SpawnPartitionArgs;
 
 
+/*
+ * SpawnPartitionsWorker started by start_partitions_bg_worker().
+ */
+typedef struct SpawnPartitionsTask
+{
+	Oid						relid;		/* partitioned table */
+	dsm_segment			   *segment;	/* contains SpawnPartitionArgs */
+	BackgroundWorkerHandle *handle;		/* NULL if it's a pool's request */
+	int						request_idx;	/* index in SpawnWorkerPool->requests */
+} SpawnPartitionsTask;
+
+
+typedef enum
+{
+	SPR_FREE = 0,	/* entry is empty */
+	SPR_QUEUED,		/* waiting for a worker of the pool */
+	SPR_RUNNING,	/* worker is creating partitions */
+	SPR_DONE,		/* result has been written to segment */
+	SPR_ABANDONED	/* requester has gone, worker will free the entry */
+} SpawnRequestStatus;
+
+/*
+ * Request to create partitions sent to SpawnWorkerPool.
+ */
+typedef struct
+{
+	SpawnRequestStatus status;
+
+	Oid			userid;			/* requester (worker connects as this user) */
+	Oid			dbid;			/* database which stores 'relid' */
+	Oid			relid;			/* partitioned table */
+	dsm_handle	segment;		/* contains SpawnPartitionArgs */
+	Latch	   *requester;		/* latch to be set once request is done */
+	int			worker_idx;		/* worker processing this request */
+} SpawnRequest;
+
+/*
+ * Execution status of a single long-lived SpawnPartitionsWorker.
+ */
+typedef struct
+{
+	ConcurrentPartSlotStatus worker_status;	/* FREE or WORKING */
+
+	pid_t		pid;			/* worker's PID */
+	Latch	   *latch;			/* NULL until worker has started */
+	Oid			userid;			/* user to be served */
+	Oid			dbid;			/* database to be served */
+	Oid			relid;			/* table of current request (if any) */
+	int64		processed;		/* number of served requests */
+} SpawnWorkerSlot;
+
+/* Max number of requests waiting for the pool */
+#define SPAWN_QUEUE_SIZE			32
+
+/*
+ * Queue of SpawnPartitionsWorkers' pool (a few workers per database & user).
+ * Worker slots are stored separately, but protected by the same mutex.
+ */
+typedef struct
+{
+	slock_t			mutex;		/* protects all requests and worker slots */
+	SpawnRequest	requests[SPAWN_QUEUE_SIZE];
+} SpawnWorkerPool;
+
+/* How long should backends sleep between checks of a request? (ms) */
+#define SPAWN_POOL_POLL_INTERVAL	1000
+
+
+/*
+ * Definitions for the "pathman_spawn_workers" view.
+ */
+#define Natts_pathman_spawn_workers				6
+#define Anum_pathman_spawn_workers_userid		1
+#define Anum_pathman_spawn_workers_pid			2
+#define Anum_pathman_spawn_workers_dbid			3
+#define Anum_pathman_spawn_workers_relid		4
+#define Anum_pathman_spawn_workers_processed	5
+#define Anum_pathman_spawn_workers_status		6
+
+
+extern int pg_pathman_spawn_pool_size;
+extern int pg_pathman_spawn_worker_idle_timeout;
+
+
+/*
+ * Pool of SpawnPartitionsWorkers is stored in shmem.
+ */
+Size estimate_spawn_pool_size(void);
+void init_spawn_pool(void);
+
+
+/*
+ * Args of RefreshZoneMapsWorker (passed via bgw_extra).
+ */
+typedef struct
+{
+	Oid		userid;			/* connect as a specified user */
+	Oid		dbid;			/* database which stores 'relid' */
+	Oid		relid;			/* partitioned table */
+} RefreshZoneMapsArgs;
+
+
+/*
+ * Args of ParallelCopyWorker (passed via bgw_extra).
+ */
+typedef struct
+{
+	dsm_handle	segment;		/* contains ParallelCopyShared */
+	int			worker_idx;		/* index in ParallelCopyShared->workers */
+} ParallelCopyArgs;
+
+typedef enum
+{
+	PCW_STARTING = 0,	/* worker is inserting tuples */
+	PCW_READY,			/* all tuples inserted, waiting for decision */
+	PCW_COMMITTED,		/* transaction has been committed */
+	PCW_FAILED			/* something went wrong */
+} ParallelCopyWorkerStatus;
+
+typedef enum
+{
+	PCD_UNDECIDED = 0,	/* leader is still waiting for workers */
+	PCD_COMMIT,			/* every worker should commit */
+	PCD_ABORT			/* every worker should abort */
+} ParallelCopyDecision;
+
+/*
+ * Execution status of a single ParallelCopyWorker.
+ */
+typedef struct
+{
+	slock_t						mutex;
+	ParallelCopyWorkerStatus	status;
+	uint64						processed;	/* number of inserted tuples */
+} ParallelCopyWorkerState;
+
+/*
+ * Shared state of a parallel COPY. Segment also contains
+ * a shm_mq (PARALLEL_COPY_QUEUE_SIZE bytes) for each worker.
+ */
+typedef struct
+{
+	slock_t		mutex;			/* protects 'done' and 'decision' */
+
+	Oid			userid;			/* connect as a specified user */
+	Oid			dbid;			/* database which stores 'relid' */
+	Oid			relid;			/* partitioned table */
+
+	bool		done;			/* leader has sent all tuples */
+	ParallelCopyDecision decision;
+
+	int			nworkers;
+	ParallelCopyWorkerState workers[FLEXIBLE_ARRAY_MEMBER];
+} ParallelCopyShared;
+
+/* Max number of ParallelCopyWorkers per COPY */
+#define PARALLEL_COPY_MAX_WORKERS	32
+
+/* Size of a queue of parsed tuples */
+#define PARALLEL_COPY_QUEUE_SIZE	(256 * 1024)
+
+/* How long should we sleep while waiting for workers? */
+#define PARALLEL_COPY_POLL_INTERVAL	0.01
+
+
 typedef enum
 {
 	CPS_FREE = 0,	/* slot is empty */
@@ -160,6 +331,68 @@ Size estimate_concurrent_part_task_slots_size(void);
 void init_concurrent_part_task_slots(void);
 
 
+/*
+ * Store args and execution status of a single ProvisioningWorker
+ * (one per database).
+ */
+typedef struct
+{
+	slock_t	mutex;			/* protect slot from race conditions */
+
+	ConcurrentPartSlotStatus worker_status;	/* status of a particular worker */
+
+	Oid		userid;			/* connect as a specified user */
+	pid_t	pid;			/* worker's PID */
+	Oid		dbid;			/* database to be served */
+	float8	naptime;		/* how long should we sleep between rounds? */
+	int64	premade;		/* partitions created by this worker */
+	bool	auto_started;	/* started by ProvisioningLauncher? */
+} ProvisioningSlot;
+
+/*
+ * How many times did INSERTs have to create partitions?
+ * If 'premake' is big enough, spawn counters stay still.
+ */
+typedef struct
+{
+	slock_t	mutex;
+
+	int64	backend_spawns;		/* created by INSERTing backend */
+	int64	bgw_spawns;			/* created by SpawnPartitionsWorker */
+	int64	premade;			/* created ahead of time */
+} PathmanSpawnStats;
+
+/* Provisioning worker wakes up this often to check its status */
+#define PROVISIONING_POLL_INTERVAL	1.0
+
+/* ProvisioningLauncher is restarted after this many seconds */
+#define PROVISIONING_LAUNCHER_RESTART	10
+
+/* ProvisioningLauncher starts workers every N seconds (0 disables it) */
+extern int pg_pathman_provisioning_naptime;
+
+
+/*
+ * Definitions for the "pathman_spawn_stats" view.
+ */
+#define Natts_pathman_spawn_stats				3	/* see show_spawn_stats() */
+#define Anum_pathman_spawn_stats_backend_spawns	1
+#define Anum_pathman_spawn_stats_bgw_spawns		2
+#define Anum_pathman_spawn_stats_premade		3
+
+
+/*
+ * Provisioning slots and spawn statistics are stored in shmem.
+ */
+Size estimate_provisioning_shmem_size(void);
+void init_provisioning_shmem(void);
+
+void register_provisioning_launcher(void);
+
+void count_partition_spawn(bool using_bgw);
+void count_premade_partitions(int64 count);
+
+
 /*
  * Useful datum packing\unpacking functions for BGW.
  */
@@ -213,5 +446,12 @@ UnpackDatumFromByteArray(Datum *datum, Size datum_size, bool typbyval,
  */
 Oid create_partitions_for_value_bg_worker(Oid relid, Datum value, Oid value_type);
 
+/*
+ * Same, but don't wait for BGW to finish.
+ */
+SpawnPartitionsTask *start_partitions_bg_worker(Oid relid, Datum value, Oid value_type);
+bool partitions_bg_worker_finished(SpawnPartitionsTask *task);
+Oid finish_partitions_bg_worker(SpawnPartitionsTask *task);
+
 
 #endif /* PATHMAN_WORKERS_H */
@@ -35,6 +35,7 @@ void state_tree_visitor(PlanState *state,
 						void *context);
 
 /* Query tree rewriting utilities */
+bool pathman_query_is_relevant(Query *parse);
 void pathman_transform_query(Query *parse, ParamListInfo params);
 void pathman_post_analyze_query(Query *parse);
 
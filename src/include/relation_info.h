@@ -182,6 +182,13 @@ typedef struct PartBoundInfo
 
 	/* For HASH partitions */
 	uint32			part_idx;
+
+	/* Translation of parent's columns (see make_inh_translation_list()) */
+	Oid				trans_parent;		/* parent it was built for */
+	int				trans_parent_natts;
+	int				trans_child_natts;
+	AttrNumber	   *trans_attnos;		/* partition's attno for each parent's
+										   column (0 if dropped) */
 } PartBoundInfo;
 
 static inline void
@@ -192,8 +199,36 @@ FreePartBoundInfo(PartBoundInfo *pbin)
 		FreeBound(&pbin->range_min, pbin->byval);
 		FreeBound(&pbin->range_max, pbin->byval);
 	}
+
+	if (pbin->trans_attnos)
+		pfree(pbin->trans_attnos);
 }
 
+/*
+ * PartZoneMap
+ *		Min/max summary of a non-key column (zone map).
+ *		Arrays are indexed the same way as PartRelationInfo->children.
+ */
+typedef struct PartZoneMap
+{
+	char		   *attname;		/* summarized column */
+	AttrNumber		attnum;			/* its number in parent */
+
+	Oid				typid;			/* type of column */
+	Oid				collid;			/* collation of column */
+	bool			byval;
+	int16			len;
+
+	Oid				btree_opf;		/* default btree opfamily of 'typid' */
+	FmgrInfo		cmp_finfo;		/* comparison function for 'typid' */
+
+	bool		   *valid;			/* is summary up to date? */
+	bool		   *has_values;		/* are there any non-NULL values? */
+	TransactionId  *refresh_xids;	/* xmin of summary's row */
+	Datum		   *min_values;
+	Datum		   *max_values;
+} PartZoneMap;
+
 /*
  * PartRelationInfo
  *		Per-relation partitioning information.
@@ -231,6 +266,11 @@ typedef struct PartRelationInfo
 	Oid				cmp_proc,		/* comparison function for 'ev_type' */
 					hash_proc;		/* hash function for 'ev_type' */
 
+	/* Zone maps of non-key columns */
+	PartZoneMap	   *zone_maps;		/* array of summarized columns or NULL */
+	int				nzone_maps;
+	uint64			zone_maps_version;	/* shared version they were loaded at */
+
 #ifdef USE_RELINFO_LEAK_TRACKER
 	List		   *owners;			/* saved callers of get_pathman_relation_info() */
 	uint64			access_total;	/* total amount of accesses to this entry */
@@ -374,9 +414,16 @@ void shout_if_prel_is_invalid(const Oid parent_oid,
 /* Bounds cache */
 void forget_bounds_of_rel(Oid partition);
 PartBoundInfo *get_bounds_of_partition(Oid partition, const PartRelationInfo *prel);
+int get_index_of_partition(Oid partition, const PartRelationInfo *prel);
 Expr *get_partition_constraint_expr(Oid partition, bool raise_error);
 void invalidate_bounds_cache(void);
 
+const AttrNumber *get_translation_of_partition(Oid partition, Oid parent,
+											   int parent_natts, int child_natts);
+void cache_translation_of_partition(Oid partition, Oid parent,
+									const AttrNumber *attnos,
+									int parent_natts, int child_natts);
+
 /* Parents cache */
 void cache_parent_of_partition(Oid partition, Oid parent);
 void forget_parent_of_partition(Oid partition);
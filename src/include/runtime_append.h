@@ -23,6 +23,9 @@
 
 #define RUNTIME_APPEND_NODE_NAME "RuntimeAppend"
 
+/* Number of slots in RuntimeAppend's partition pruning cache */
+#define RUNTIME_PRUNE_CACHE_SIZE	64
+
 
 typedef struct
 {
@@ -31,8 +34,24 @@ typedef struct
 
 	ChildScanCommon	   *children;		/* all available plans */
 	int					nchildren;
+
+	int					dyn_filter_paramid;	/* see dynamic_filter.c, or -1 */
 } RuntimeAppendPath;
 
+/*
+ * Partition pruning result for a set of PARAM values.
+ */
+typedef struct
+{
+	bool				valid;		/* does this slot contain anything? */
+	uint32				hash;		/* hash of PARAM values */
+	Datum			   *values;		/* copies of PARAM values */
+	bool			   *isnull;
+
+	ChildScanCommon	   *plans;		/* selected plans */
+	int					nplans;
+} RuntimePruneCacheEntry;
+
 typedef struct
 {
 	CustomScanState		css;
@@ -52,10 +71,37 @@ typedef struct
 	HTAB			   *children_table;
 	HASHCTL				children_table_config;
 
+	/* Same plans \ plan states addressed by partition index */
+	ChildScanCommon	   *children_by_index;
+	ChildScanCommon		parent_child;		/* plan of parent (if any) */
+
 	/* Currently selected plans \ plan states */
 	ChildScanCommon	   *cur_plans;
 	int					ncur_plans;
 
+	/* PARAMs which affect partition pruning */
+	List			   *prune_params;		/* list of ExprStates */
+	int16			   *prune_params_typlen;
+	bool			   *prune_params_typbyval;
+	int					nprune_params;
+
+	/* Initialized children, most recently used first */
+	dlist_head			active_children;
+	int					nactive_children;
+	int					max_active_children;	/* 0 means no limit */
+	uint64				nrescans;
+	uint64				nevicted_children;		/* for EXPLAIN ANALYZE */
+
+	/* Pruning results for recently seen PARAM values */
+	RuntimePruneCacheEntry *prune_cache;
+	MemoryContext		prune_cache_mcxt;
+	uint64				prune_cache_hits;
+
+	/* Partitions of hash join's inner side (see dynamic_filter.c) */
+	int					dyn_filter_paramid;	/* -1 if there's no filter */
+	bool				dyn_filter_pending;	/* should be applied on Exec */
+	ChildScanCommon	   *dyn_filter_plans;	/* plans selected using filter */
+
 	/* Should we include parent table? Cached for prepared statements */
 	bool				enable_parent;
 
@@ -68,6 +114,7 @@ typedef struct
 
 
 extern bool					pg_pathman_enable_runtimeappend;
+extern int					pg_pathman_runtimeappend_max_children;
 
 extern CustomPathMethods	runtimeappend_path_methods;
 extern CustomScanMethods	runtimeappend_plan_methods;
@@ -17,7 +17,30 @@
 
 #include "postgres.h"
 #include "commands/copy.h"
+#include "nodes/execnodes.h"
 #include "nodes/nodes.h"
+#include "utils/rel.h"
+
+
+/*
+ * Source of tuples for PathmanCopyFromTuples().
+ * Returns false when there are no tuples left.
+ */
+typedef bool (*CopyNextTupleFunc)(void *arg, ExprContext *econtext,
+								  Datum *values, bool *nulls,
+								  Oid *tuple_oid);
+
+/*
+ * Statistics of the last COPY FROM in this backend, see show_copy_stats().
+ */
+typedef struct
+{
+	Oid		parent_relid;			/* InvalidOid if there was no COPY yet */
+	uint64	partitions_opened;		/* including reopened ones */
+	uint64	partitions_evicted;		/* closed due to max_open_partitions */
+} PathmanCopyStats;
+
+extern PathmanCopyStats last_copy_stats;
 
 
 /* Various traits */
@@ -34,6 +57,10 @@ bool is_pathman_related_alter_column_type(Node *parsetree,
 void PathmanDoCopy(const CopyStmt *stmt, const char *queryString,
 				   int stmt_location, int stmt_len, uint64 *processed);
 
+uint64 PathmanCopyFromTuples(Relation parent_rel,
+							 CopyNextTupleFunc next_tuple,
+							 void *next_tuple_arg);
+
 void PathmanRenameConstraint(Oid partition_relid, const RenameStmt *rename_stmt);
 void PathmanRenameSequence(Oid parent_relid, const RenameStmt *rename_stmt);
 
@@ -21,6 +21,8 @@
  * Various traits.
  */
 bool clause_contains_params(Node *clause);
+bool clause_contains_runtime_values(Node *clause);
+bool is_runtime_const_expr(Node *node);
 bool is_date_type_internal(Oid typid);
 bool check_security_policy_internal(Oid relid, Oid role);
 bool match_expr_to_operand(const Node *expr, const Node *operand);
@@ -17,15 +17,25 @@
 #include "postgres.h"
 
 
+/*
+ * Advisory locks on ranges of new partitions use this 'field4'
+ * (user-level advisory locks use 1 and 2).
+ */
+#define SPAWN_RANGE_LOCKTAG_CLASS	0x5050
+
+
 /*
  * Transaction locks.
  */
 LockAcquireResult xact_lock_rel(Oid relid, LOCKMODE lockmode, bool nowait);
+void xact_lock_spawn_range(Oid relid, uint32 range_key);
 
 /*
  * Utility checks.
  */
 bool xact_bgw_conflicting_lock_exists(Oid relid);
+bool xact_spawn_lock_held(Oid relid);
+bool xact_insert_conflicting_lock_held(Oid relid);
 bool xact_is_level_read_committed(void);
 bool xact_is_transaction_stmt(Node *stmt);
 bool xact_is_set_stmt(Node *stmt, const char *name);
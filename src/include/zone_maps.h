@@ -0,0 +1,55 @@
+/* ------------------------------------------------------------------------
+ *
+ * zone_maps.h
+ *		Partition pruning using min/max summaries of non-key columns
+ *
+ * Copyright (c) 2026, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef PATHMAN_ZONE_MAPS_H
+#define PATHMAN_ZONE_MAPS_H
+
+
+#include "relation_info.h"
+
+#include "postgres.h"
+#include "access/htup.h"
+#include "nodes/execnodes.h"
+#include "nodes/pg_list.h"
+#include "utils/relcache.h"
+
+
+/* Name of trigger which invalidates zone maps of a partition */
+#define ZONE_MAP_TRIGGER_NAME		"pathman_zone_map_trigger"
+
+
+Size estimate_zone_maps_shmem_size(void);
+void init_zone_maps_shmem(void);
+
+void fill_prel_with_zone_maps(PartRelationInfo *prel, Datum columns);
+bool zone_maps_need_reload(const PartRelationInfo *prel);
+
+void zone_maps_check_tuples(Relation rel, HeapTuple *tuples, int ntuples);
+
+bool clause_refers_to_zone_map(Node *clause,
+							   const PartRelationInfo *prel,
+							   Index varno);
+
+List *zone_map_vars(List *clauses,
+					const PartRelationInfo *prel,
+					Index varno);
+
+double zone_map_paramsel(Node *clause,
+						 const PartRelationInfo *prel,
+						 Index varno);
+
+List *zone_map_prune_ranges(List *ranges,
+							List *clauses,
+							const PartRelationInfo *prel,
+							Index varno,
+							ExprContext *econtext);
+
+
+#endif /* PATHMAN_ZONE_MAPS_H */
@@ -15,10 +15,14 @@
 
 #include "hooks.h"
 #include "init.h"
+#include "monotonic_transforms.h"
+#include "partition_creation.h"
+#include "partition_filter.h"
 #include "pathman.h"
 #include "pathman_workers.h"
 #include "relation_info.h"
 #include "utils.h"
+#include "zone_maps.h"
 
 #include "access/htup_details.h"
 #include "access/heapam.h"
@@ -49,6 +53,7 @@
 #include "catalog/pg_inherits_fn.h"
 #endif
 
+#include <limits.h>
 #include <stdlib.h>
 
 
@@ -193,6 +198,64 @@ init_main_pathman_toggles(void)
 							 NULL,
 							 NULL,
 							 NULL);
+	/* Planning of lots of partitions */
+	DefineCustomIntVariable("pg_pathman.bulk_children_threshold",
+							"Sets the minimum number of selected partitions "
+							"which enables bulk child mode.",
+							"Partitions of the same layout share restrictions "
+							"and skip constraint exclusion, 0 disables this mode.",
+							&pg_pathman_bulk_children_threshold,
+							1000,
+							0, INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	/* Long-lived workers creating partitions for INSERT */
+	DefineCustomIntVariable("pg_pathman.spawn_pool_size",
+							"Sets the maximum number of long-lived "
+							"SpawnPartitionsWorkers per database.",
+							"0 means that a new worker is started for each request.",
+							&pg_pathman_spawn_pool_size,
+							0,
+							0, 1024,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_pathman.spawn_worker_idle_timeout",
+							"Sets the time after which an idle "
+							"SpawnPartitionsWorker exits.",
+							NULL,
+							&pg_pathman_spawn_worker_idle_timeout,
+							60,
+							1, INT_MAX / 1000,
+							PGC_SIGHUP,
+							GUC_UNIT_S,
+							NULL,
+							NULL,
+							NULL);
+
+	/* Start ProvisioningWorkers automatically */
+	DefineCustomIntVariable("pg_pathman.provisioning_naptime",
+							"Sets the delay between rounds of ProvisioningWorkers "
+							"started automatically.",
+							"Databases are checked for tables with premake > 0 "
+							"this often, 0 disables automatic start. "
+							"ProvisioningLauncher is started only if "
+							"it's not 0 at server start.",
+							&pg_pathman_provisioning_naptime,
+							0,
+							0, INT_MAX / 1000,
+							PGC_SIGHUP,
+							GUC_UNIT_S,
+							NULL,
+							NULL,
+							NULL);
 }
 
 /*
@@ -262,7 +325,11 @@ unload_config(void)
 Size
 estimate_pathman_shmem_size(void)
 {
-	return estimate_concurrent_part_task_slots_size();
+	return estimate_concurrent_part_task_slots_size() +
+		   estimate_provisioning_shmem_size() +
+		   estimate_spawn_pool_size() +
+		   estimate_spawned_partitions_size() +
+		   estimate_zone_maps_shmem_size();
 }
 
 /*
@@ -286,6 +353,17 @@ init_pathman_relation_oids(void)
 	if (pathman_config_params_relid == InvalidOid)
 		return false;
 
+	/*
+	 * Cache PATHMAN_ZONE_MAPS relation's Oid. It might be missing if
+	 * frontend is outdated, validate_plpgsql_frontend_version() will
+	 * complain about it a bit later.
+	 */
+	pathman_zone_maps_relid = get_relname_relid(PATHMAN_ZONE_MAPS, schema);
+
+	/* Same for PATHMAN_MONOTONIC_TRANSFORMS */
+	pathman_monotonic_transforms_relid =
+			get_relname_relid(PATHMAN_MONOTONIC_TRANSFORMS, schema);
+
 	/* NOTE: add more relations to be cached right here ^^^ */
 
 	/* Everything is fine, proceed */
@@ -300,6 +378,8 @@ fini_pathman_relation_oids(void)
 {
 	pathman_config_relid = InvalidOid;
 	pathman_config_params_relid = InvalidOid;
+	pathman_zone_maps_relid = InvalidOid;
+	pathman_monotonic_transforms_relid = InvalidOid;
 
 	/* NOTE: add more relations to be forgotten right here ^^^ */
 }
@@ -404,6 +484,9 @@ fini_local_cache(void)
 	status_cache	= NULL;
 	bounds_cache	= NULL;
 
+	invalidate_monotonic_transforms();
+	invalidate_partition_templates();
+
 	if (prel_resowner != NULL)
 	{
 		hash_destroy(prel_resowner);
@@ -755,6 +838,8 @@ read_pathman_params(Oid relid, Datum *values, bool *isnull)
 		Assert(!isnull[Anum_pathman_config_params_enable_parent - 1]);
 		Assert(!isnull[Anum_pathman_config_params_auto - 1]);
 		Assert(!isnull[Anum_pathman_config_params_spawn_using_bgw - 1]);
+		Assert(!isnull[Anum_pathman_config_params_premake - 1]);
+		Assert(!isnull[Anum_pathman_config_params_spawn_sparse - 1]);
 	}
 
 	/* Clean resources */
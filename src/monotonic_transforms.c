@@ -0,0 +1,256 @@
+/* ------------------------------------------------------------------------
+ *
+ * monotonic_transforms.c
+ *		Registry of monotonic functions of partitioning expression
+ *
+ * Copyright (c) 2026, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "compat/pg_compat.h"
+
+#include "init.h"
+#include "monotonic_transforms.h"
+#include "pathman.h"
+
+#include "access/htup_details.h"
+#include "access/heapam.h"
+#if PG_VERSION_NUM >= 120000
+#include "access/relscan.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#endif
+#include "catalog/pg_proc.h"
+#include "commands/trigger.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+#include "utils/syscache.h"
+
+
+PG_FUNCTION_INFO_V1( pathman_monotonic_transforms_trigger_func );
+
+
+/* Contents of PATHMAN_MONOTONIC_TRANSFORMS, loaded on first use */
+static HTAB	   *transforms_cache = NULL;
+static bool		transforms_cache_loaded = false;
+
+
+static void load_monotonic_transforms(void);
+static bool check_bound_function(Oid funcid, int nargs);
+
+
+/*
+ * Return transform for function 'funcid' or NULL if it's not registered.
+ */
+const MonotonicTransform *
+get_monotonic_transform(Oid funcid)
+{
+	if (!transforms_cache_loaded)
+		load_monotonic_transforms();
+
+	if (!transforms_cache)
+		return NULL;
+
+	return (const MonotonicTransform *) hash_search(transforms_cache,
+													(const void *) &funcid,
+													HASH_FIND, NULL);
+}
+
+/* Forget all cached transforms */
+void
+invalidate_monotonic_transforms(void)
+{
+	if (transforms_cache)
+		hash_destroy(transforms_cache);
+
+	transforms_cache = NULL;
+	transforms_cache_loaded = false;
+}
+
+/* Read PATHMAN_MONOTONIC_TRANSFORMS into transforms_cache */
+static void
+load_monotonic_transforms(void)
+{
+	Oid				relid = get_pathman_monotonic_transforms_relid(true);
+	HASHCTL			ctl;
+	Relation		rel;
+#if PG_VERSION_NUM >= 120000
+	TableScanDesc	scan;
+#else
+	HeapScanDesc	scan;
+#endif
+	Snapshot		snapshot;
+	HeapTuple		htup;
+
+	/* We might have failed in the middle of previous attempt */
+	invalidate_monotonic_transforms();
+
+	/* Frontend might be outdated */
+	if (!OidIsValid(relid))
+	{
+		transforms_cache_loaded = true;
+		return;
+	}
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(MonotonicTransform);
+	ctl.hcxt = TopPathmanContext;
+
+	transforms_cache = hash_create(PATHMAN_MONOTONIC_TRANSFORMS, 16, &ctl,
+								   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	rel = heap_open_compat(relid, AccessShareLock);
+	snapshot = RegisterSnapshot(GetLatestSnapshot());
+#if PG_VERSION_NUM >= 120000
+	scan = table_beginscan(rel, snapshot, 0, NULL);
+#else
+	scan = heap_beginscan(rel, snapshot, 0, NULL);
+#endif
+
+	while ((htup = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		Datum				values[Natts_pathman_monotonic_transforms];
+		bool				isnull[Natts_pathman_monotonic_transforms];
+		MonotonicTransform *mt;
+		HeapTuple			proctup;
+		Oid					transform,
+							lower_bound,
+							upper_bound;
+		int					key_arg,
+							nargs;
+
+		heap_deform_tuple(htup, RelationGetDescr(rel), values, isnull);
+
+		transform = DatumGetObjectId(values[Anum_pathman_mt_transform - 1]);
+		key_arg = DatumGetInt32(values[Anum_pathman_mt_key_arg - 1]) - 1;
+		lower_bound = isnull[Anum_pathman_mt_lower_bound - 1] ?
+						InvalidOid :
+						DatumGetObjectId(values[Anum_pathman_mt_lower_bound - 1]);
+		upper_bound = isnull[Anum_pathman_mt_upper_bound - 1] ?
+						InvalidOid :
+						DatumGetObjectId(values[Anum_pathman_mt_upper_bound - 1]);
+
+		/* Function might have been dropped */
+		proctup = SearchSysCache1(PROCOID, ObjectIdGetDatum(transform));
+		if (!HeapTupleIsValid(proctup))
+			continue;
+
+		nargs = ((Form_pg_proc) GETSTRUCT(proctup))->pronargs;
+		ReleaseSysCache(proctup);
+
+		/* Skip malformed entries */
+		if (key_arg < 0 || key_arg >= nargs ||
+			(OidIsValid(lower_bound) && !check_bound_function(lower_bound, nargs)) ||
+			(OidIsValid(upper_bound) && !check_bound_function(upper_bound, nargs)) ||
+			(OidIsValid(upper_bound) && !OidIsValid(lower_bound)))
+			continue;
+
+		mt = (MonotonicTransform *) hash_search(transforms_cache,
+												(const void *) &transform,
+												HASH_ENTER, NULL);
+		mt->key_arg = key_arg;
+		mt->lower_bound = lower_bound;
+		mt->upper_bound = upper_bound;
+	}
+
+#if PG_VERSION_NUM >= 120000
+	table_endscan(scan);
+#else
+	heap_endscan(scan);
+#endif
+	UnregisterSnapshot(snapshot);
+	heap_close_compat(rel, AccessShareLock);
+
+	transforms_cache_loaded = true;
+}
+
+/* Bound function should accept the same number of args and be non-volatile */
+static bool
+check_bound_function(Oid funcid, int nargs)
+{
+	HeapTuple		proctup;
+	Form_pg_proc	procform;
+	bool			result;
+
+	proctup = SearchSysCache1(PROCOID, ObjectIdGetDatum(funcid));
+	if (!HeapTupleIsValid(proctup))
+		return false;
+
+	procform = (Form_pg_proc) GETSTRUCT(proctup);
+	result = (procform->pronargs == nargs &&
+			  procform->provolatile != PROVOLATILE_VOLATILE &&
+			  !procform->proretset);
+
+	ReleaseSysCache(proctup);
+
+	return result;
+}
+
+
+/*
+ * Invalidate cached transforms in all backends, as well
+ * as cached plans of partitioned tables (they might depend on them).
+ */
+Datum
+pathman_monotonic_transforms_trigger_func(PG_FUNCTION_ARGS)
+{
+	TriggerData	   *trigdata = (TriggerData *) fcinfo->context;
+	Oid				pathman_config = get_pathman_config_relid(true);
+
+	/* Handle user calls */
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "this function should not be called directly");
+
+	/* Handle wrong fire mode */
+	if (!TRIGGER_FIRED_FOR_STATEMENT(trigdata->tg_event))
+		elog(ERROR, "%s: must be fired for statement",
+			 trigdata->tg_trigger->tgname);
+
+	CacheInvalidateRelcacheByRelid(RelationGetRelid(trigdata->tg_relation));
+
+	/* Handle "pg_pathman.enabled = f" case */
+	if (OidIsValid(pathman_config))
+	{
+		Relation		rel;
+#if PG_VERSION_NUM >= 120000
+		TableScanDesc	scan;
+#else
+		HeapScanDesc	scan;
+#endif
+		Snapshot		snapshot;
+		HeapTuple		htup;
+
+		rel = heap_open_compat(pathman_config, AccessShareLock);
+		snapshot = RegisterSnapshot(GetLatestSnapshot());
+#if PG_VERSION_NUM >= 120000
+		scan = table_beginscan(rel, snapshot, 0, NULL);
+#else
+		scan = heap_beginscan(rel, snapshot, 0, NULL);
+#endif
+
+		while ((htup = heap_getnext(scan, ForwardScanDirection)) != NULL)
+		{
+			Datum	partrel;
+			bool	isnull;
+
+			partrel = heap_getattr(htup, Anum_pathman_config_partrel,
+								   RelationGetDescr(rel), &isnull);
+
+			if (!isnull && SearchSysCacheExists1(RELOID, partrel))
+				CacheInvalidateRelcacheByRelid(DatumGetObjectId(partrel));
+		}
+
+#if PG_VERSION_NUM >= 120000
+		table_endscan(scan);
+#else
+		heap_endscan(scan);
+#endif
+		UnregisterSnapshot(snapshot);
+		heap_close_compat(rel, AccessShareLock);
+	}
+
+	PG_RETURN_POINTER(NULL);
+}
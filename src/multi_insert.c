@@ -0,0 +1,462 @@
+/* ------------------------------------------------------------------------
+ *
+ * multi_insert.c
+ *		Buffered insertion of tuples into partitions
+ *
+ * Copyright (c) 2026, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "compat/pg_compat.h"
+#include "multi_insert.h"
+#include "zone_maps.h"
+
+#include "access/heapam.h"
+#if PG_VERSION_NUM >= 120000
+#include "access/tableam.h"
+#endif
+#include "catalog/pg_trigger.h"
+#include "executor/executor.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+
+static bool has_zone_map_trigger(ResultRelInfo *rri, bool *others_out);
+static MultiInsertBuffer *get_multi_insert_buffer(MultiInsertState *mistate,
+												  ResultRelInfoHolder *rri_holder);
+static void flush_multi_insert_buffer(MultiInsertState *mistate,
+									  MultiInsertBuffer *buffer);
+static void free_multi_insert_buffer(MultiInsertBuffer *buffer);
+static void free_multi_insert_buffers(MultiInsertState *mistate);
+
+
+/*
+ * Prepare MultiInsertState for a new statement.
+ */
+void
+init_multi_insert_state(MultiInsertState *mistate, EState *estate,
+						bool track_stats)
+{
+	memset(mistate, 0, sizeof(MultiInsertState));
+
+	mistate->estate = estate;
+	mistate->cid = GetCurrentCommandId(true);
+	mistate->track_stats = track_stats;
+
+	mistate->flush_mcxt = AllocSetContextCreate(estate->es_query_cxt,
+												"MultiInsertFlush",
+												ALLOCSET_DEFAULT_SIZES);
+#if PG_VERSION_NUM < 120000
+	mistate->mcxt = AllocSetContextCreate(estate->es_query_cxt,
+										  "MultiInsertTuples",
+										  ALLOCSET_DEFAULT_SIZES);
+	mistate->index_slot = ExecInitExtraTupleSlotCompat(estate, NULL, nothing_here);
+#endif
+}
+
+/*
+ * Insert remaining tuples and release all buffers.
+ * Statistics are kept until the end of query.
+ */
+void
+fini_multi_insert_state(MultiInsertState *mistate)
+{
+	multi_insert_flush(mistate);
+	free_multi_insert_buffers(mistate);
+
+	MemoryContextDelete(mistate->flush_mcxt);
+#if PG_VERSION_NUM < 120000
+	MemoryContextDelete(mistate->mcxt);
+#endif
+}
+
+/*
+ * Can tuples be inserted into this partition in batches?
+ *
+ * Row triggers should see all previously inserted tuples (and are
+ * expected to fire in the order of insertion), while FDWs have no
+ * API for that, so such partitions are filled tuple by tuple.
+ * The same goes for WITH CHECK OPTIONs and generated columns.
+ * pathman_zone_map_trigger is the exception, since zone maps
+ * are checked once per batch instead.
+ */
+bool
+multi_insert_allowed(ResultRelInfoHolder *rri_holder)
+{
+	ResultRelInfo  *rri = rri_holder->result_rel_info;
+#if PG_VERSION_NUM >= 120000
+	TupleDesc		tupdesc = RelationGetDescr(rri->ri_RelationDesc);
+
+	if (tupdesc->constr && tupdesc->constr->has_generated_stored)
+		return false;
+#endif
+
+	if (rri->ri_FdwRoutine || rri->ri_WithCheckOptions != NIL)
+		return false;
+
+	if (rri->ri_TrigDesc &&
+		(rri->ri_TrigDesc->trig_insert_before_row ||
+		 rri->ri_TrigDesc->trig_insert_instead_row))
+		return false;
+
+	if (rri->ri_TrigDesc && rri->ri_TrigDesc->trig_insert_after_row)
+	{
+		bool other_triggers;
+
+		(void) has_zone_map_trigger(rri, &other_triggers);
+
+		if (other_triggers)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Put a copy of 'slot' into partition's buffer.
+ * Flushes all buffers once they become too large.
+ */
+void
+multi_insert_add_tuple(MultiInsertState *mistate,
+					   ResultRelInfoHolder *rri_holder,
+					   TupleTableSlot *slot)
+{
+	MultiInsertBuffer  *buffer = get_multi_insert_buffer(mistate, rri_holder);
+	Size				tuple_len;
+
+#if PG_VERSION_NUM >= 120000
+	if (buffer->slots[buffer->ntuples] == NULL)
+	{
+		MemoryContext old_mcxt = MemoryContextSwitchTo(mistate->estate->es_query_cxt);
+
+		buffer->slots[buffer->ntuples] =
+				table_slot_create(rri_holder->result_rel_info->ri_RelationDesc, NULL);
+
+		MemoryContextSwitchTo(old_mcxt);
+	}
+
+	ExecCopySlot(buffer->slots[buffer->ntuples], slot);
+
+	/* Buffer slot already contains a materialized tuple */
+	tuple_len = ExecFetchSlotHeapTuple(buffer->slots[buffer->ntuples],
+									   false, NULL)->t_len;
+#else
+	{
+		MemoryContext old_mcxt = MemoryContextSwitchTo(mistate->mcxt);
+
+		buffer->tuples[buffer->ntuples] = ExecCopySlotTuple(slot);
+		tuple_len = buffer->tuples[buffer->ntuples]->t_len;
+
+		MemoryContextSwitchTo(old_mcxt);
+	}
+#endif
+
+	buffer->ntuples++;
+	buffer->nbytes += tuple_len;
+	mistate->ntuples++;
+	mistate->nbytes += tuple_len;
+
+	if (buffer->ntuples >= MULTI_INSERT_MAX_TUPLES ||
+		mistate->ntuples >= MULTI_INSERT_MAX_TUPLES ||
+		mistate->nbytes >= MULTI_INSERT_MAX_BYTES)
+		multi_insert_flush(mistate);
+}
+
+/*
+ * Insert all buffered tuples.
+ */
+void
+multi_insert_flush(MultiInsertState *mistate)
+{
+	ListCell *lc;
+
+	if (mistate->ntuples == 0)
+		return;
+
+	foreach (lc, mistate->buffers)
+		flush_multi_insert_buffer(mistate, (MultiInsertBuffer *) lfirst(lc));
+
+	mistate->ntuples = 0;
+	mistate->nbytes = 0;
+
+#if PG_VERSION_NUM < 120000
+	MemoryContextReset(mistate->mcxt);
+#endif
+}
+
+/*
+ * Insert buffered tuples of a partition and release its buffer,
+ * e.g. because partition is about to be closed.
+ */
+void
+multi_insert_forget(MultiInsertState *mistate,
+					ResultRelInfoHolder *rri_holder)
+{
+	MultiInsertBuffer  *buffer = NULL;
+	ListCell		   *lc;
+
+	foreach (lc, mistate->buffers)
+	{
+		if (((MultiInsertBuffer *) lfirst(lc))->rri_holder == rri_holder)
+		{
+			buffer = (MultiInsertBuffer *) lfirst(lc);
+			break;
+		}
+	}
+
+	if (!buffer)
+		return;
+
+#if PG_VERSION_NUM >= 120000
+	mistate->ntuples -= buffer->ntuples;
+	mistate->nbytes -= buffer->nbytes;
+
+	flush_multi_insert_buffer(mistate, buffer);
+#else
+	/* Tuples of all buffers share memory context */
+	multi_insert_flush(mistate);
+#endif
+
+	mistate->buffers = list_delete_ptr(mistate->buffers, buffer);
+	if (mistate->last_buffer == buffer)
+		mistate->last_buffer = NULL;
+
+	free_multi_insert_buffer(buffer);
+}
+
+
+/*
+ * Does partition have AFTER ROW INSERT pathman_zone_map_trigger?
+ * Also tell if it has any other AFTER ROW INSERT triggers.
+ */
+static bool
+has_zone_map_trigger(ResultRelInfo *rri, bool *others_out)
+{
+	TriggerDesc	   *trigdesc = rri->ri_TrigDesc;
+	bool			found = false;
+	int				i;
+
+	*others_out = false;
+
+	if (!trigdesc || !trigdesc->trig_insert_after_row)
+		return false;
+
+	for (i = 0; i < trigdesc->numtriggers; i++)
+	{
+		Trigger *trigger = &trigdesc->triggers[i];
+
+		if (!TRIGGER_TYPE_MATCHES(trigger->tgtype,
+								  TRIGGER_TYPE_ROW,
+								  TRIGGER_TYPE_AFTER,
+								  TRIGGER_TYPE_INSERT))
+			continue;
+
+		if (strcmp(trigger->tgname, ZONE_MAP_TRIGGER_NAME) == 0)
+			found = true;
+		else
+			*others_out = true;
+	}
+
+	return found;
+}
+
+/* Find (or create) buffer of a partition */
+static MultiInsertBuffer *
+get_multi_insert_buffer(MultiInsertState *mistate,
+						ResultRelInfoHolder *rri_holder)
+{
+	MultiInsertBuffer  *buffer;
+	MemoryContext		old_mcxt;
+	ListCell		   *lc;
+	bool				other_triggers;
+
+	/* Fast path: rows usually come in groups */
+	if (mistate->last_buffer && mistate->last_buffer->rri_holder == rri_holder)
+		return mistate->last_buffer;
+
+	foreach (lc, mistate->buffers)
+	{
+		buffer = (MultiInsertBuffer *) lfirst(lc);
+
+		if (buffer->rri_holder == rri_holder)
+		{
+			mistate->last_buffer = buffer;
+			return buffer;
+		}
+	}
+
+	/* Don't keep too many partitions (and their slots) around */
+	if (list_length(mistate->buffers) >= MULTI_INSERT_MAX_PARTITIONS)
+	{
+		multi_insert_flush(mistate);
+		free_multi_insert_buffers(mistate);
+	}
+
+	old_mcxt = MemoryContextSwitchTo(mistate->estate->es_query_cxt);
+
+	buffer = (MultiInsertBuffer *) palloc0(sizeof(MultiInsertBuffer));
+	buffer->rri_holder = rri_holder;
+	buffer->bistate = GetBulkInsertState();
+	buffer->check_zone_maps = has_zone_map_trigger(rri_holder->result_rel_info,
+												   &other_triggers);
+
+	if (mistate->track_stats)
+	{
+		MultiInsertStats *stats = NULL;
+
+		foreach (lc, mistate->stats)
+		{
+			if (((MultiInsertStats *) lfirst(lc))->partid == rri_holder->partid)
+			{
+				stats = (MultiInsertStats *) lfirst(lc);
+				break;
+			}
+		}
+
+		/* It's the first time we see this partition */
+		if (!stats)
+		{
+			stats = (MultiInsertStats *) palloc0(sizeof(MultiInsertStats));
+			stats->partid = rri_holder->partid;
+
+			mistate->stats = lappend(mistate->stats, stats);
+		}
+
+		buffer->stats = stats;
+	}
+
+	mistate->buffers = lappend(mistate->buffers, buffer);
+	mistate->last_buffer = buffer;
+
+	MemoryContextSwitchTo(old_mcxt);
+
+	return buffer;
+}
+
+/* Insert tuples of a single partition and create index entries */
+static void
+flush_multi_insert_buffer(MultiInsertState *mistate,
+						  MultiInsertBuffer *buffer)
+{
+	EState		   *estate = mistate->estate;
+	ResultRelInfo  *rri = buffer->rri_holder->result_rel_info,
+				   *saved_rri = estate->es_result_relation_info;
+	MemoryContext	old_mcxt;
+	int				i;
+
+	if (buffer->ntuples == 0)
+		return;
+
+	old_mcxt = MemoryContextSwitchTo(mistate->flush_mcxt);
+
+	/* ExecInsertIndexTuples() might look for it in EState */
+	estate->es_result_relation_info = rri;
+
+#if PG_VERSION_NUM >= 120000
+	table_multi_insert(rri->ri_RelationDesc,
+					   buffer->slots, buffer->ntuples,
+					   mistate->cid, 0, buffer->bistate);
+#else
+	heap_multi_insert(rri->ri_RelationDesc,
+					  buffer->tuples, buffer->ntuples,
+					  mistate->cid, 0, buffer->bistate);
+#endif
+
+	/* Do the job of pathman_zone_map_trigger, which hasn't been fired */
+	if (buffer->check_zone_maps)
+	{
+#if PG_VERSION_NUM >= 120000
+		HeapTuple *tuples = palloc(buffer->ntuples * sizeof(HeapTuple));
+
+		for (i = 0; i < buffer->ntuples; i++)
+			tuples[i] = ExecFetchSlotHeapTuple(buffer->slots[i], false, NULL);
+
+		zone_maps_check_tuples(rri->ri_RelationDesc, tuples, buffer->ntuples);
+#else
+		zone_maps_check_tuples(rri->ri_RelationDesc, buffer->tuples, buffer->ntuples);
+#endif
+	}
+
+	for (i = 0; i < buffer->ntuples; i++)
+	{
+		if (rri->ri_NumIndices > 0)
+		{
+			List *recheckIndexes;
+
+#if PG_VERSION_NUM >= 120000
+			recheckIndexes = ExecInsertIndexTuplesCompat(rri, buffer->slots[i], NULL,
+														 estate, false, false,
+														 NULL, NIL, false);
+#else
+			HeapTuple tuple = buffer->tuples[i];
+
+			ExecSetSlotDescriptor(mistate->index_slot,
+								  RelationGetDescr(rri->ri_RelationDesc));
+			ExecStoreTuple(tuple, mistate->index_slot, InvalidBuffer, false);
+
+			recheckIndexes = ExecInsertIndexTuplesCompat(rri, mistate->index_slot,
+														 &(tuple->t_self),
+														 estate, false, false,
+														 NULL, NIL, false);
+#endif
+			list_free(recheckIndexes);
+		}
+
+#if PG_VERSION_NUM >= 120000
+		ExecClearTuple(buffer->slots[i]);
+#endif
+	}
+
+#if PG_VERSION_NUM < 120000
+	if (rri->ri_NumIndices > 0)
+		ExecClearTuple(mistate->index_slot);
+#endif
+
+	if (buffer->stats)
+	{
+		buffer->stats->ntuples += buffer->ntuples;
+		buffer->stats->nbatches++;
+	}
+
+	buffer->ntuples = 0;
+	buffer->nbytes = 0;
+
+	estate->es_result_relation_info = saved_rri;
+
+	MemoryContextSwitchTo(old_mcxt);
+	MemoryContextReset(mistate->flush_mcxt);
+}
+
+/* Release slots and bulk insert state of an empty buffer */
+static void
+free_multi_insert_buffer(MultiInsertBuffer *buffer)
+{
+	Assert(buffer->ntuples == 0);
+
+#if PG_VERSION_NUM >= 120000
+	{
+		int i;
+
+		for (i = 0; i < MULTI_INSERT_MAX_TUPLES && buffer->slots[i]; i++)
+			ExecDropSingleTupleTableSlot(buffer->slots[i]);
+	}
+#endif
+
+	FreeBulkInsertState(buffer->bistate);
+	pfree(buffer);
+}
+
+/* Release all (empty) buffers */
+static void
+free_multi_insert_buffers(MultiInsertState *mistate)
+{
+	ListCell *lc;
+
+	foreach (lc, mistate->buffers)
+		free_multi_insert_buffer((MultiInsertBuffer *) lfirst(lc));
+
+	list_free(mistate->buffers);
+	mistate->buffers = NIL;
+	mistate->last_buffer = NULL;
+}
@@ -10,10 +10,17 @@
 #include "compat/pg_compat.h"
 
 #include "init.h"
+#include "dynamic_filter.h"
 #include "nodes_common.h"
 #include "runtime_append.h"
 #include "utils.h"
+#include "zone_maps.h"
 
+#if PG_VERSION_NUM >= 130000
+#include "common/hashfn.h"
+#else
+#include "access/hash.h"
+#endif
 #include "nodes/nodeFuncs.h"
 #if PG_VERSION_NUM >= 120000
 #include "optimizer/optimizer.h"
@@ -23,6 +30,8 @@
 #endif
 #include "optimizer/tlist.h"
 #include "rewrite/rewriteManip.h"
+#include "utils/datum.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/ruleutils.h"
 
@@ -47,6 +56,252 @@ cmp_child_scan_common_by_orig_order(const void *ap,
 		return 0;
 }
 
+/* Find range table index of partition scanned by child plan */
+static Index
+child_plan_scanrelid(Plan *plan)
+{
+	/* Scan might be wrapped into Sort, Result etc */
+	while (plan)
+	{
+		switch (nodeTag(plan))
+		{
+			case T_SeqScan:
+			case T_SampleScan:
+			case T_IndexScan:
+			case T_IndexOnlyScan:
+			case T_BitmapHeapScan:
+			case T_TidScan:
+			case T_ForeignScan:
+			case T_CustomScan:
+				return ((Scan *) plan)->scanrelid;
+
+			default:
+				plan = plan->lefttree;
+		}
+	}
+
+	return 0;
+}
+
+#if PG_VERSION_NUM >= 130000
+/*
+ * Executor keeps lists of slots & ExprContexts in es_query_cxt. If such
+ * a list has been created while es_query_cxt pointed to child's context,
+ * move it to es_query_cxt, so that it would outlive this child.
+ * NOTE: since PG 13 (commit 1cff1b95ab6) cells are stored in list's chunk.
+ */
+static List *
+move_list_out_of_child_context(List *list, MemoryContext child_mcxt,
+							   MemoryContext query_mcxt)
+{
+	MemoryContext	old_mcxt;
+	List		   *result;
+
+	if (list == NIL || GetMemoryChunkContext(list) != child_mcxt)
+		return list;
+
+	old_mcxt = MemoryContextSwitchTo(query_mcxt);
+	result = list_copy(list);
+	MemoryContextSwitchTo(old_mcxt);
+
+	return result;
+}
+#endif
+
+/*
+ * Initialize child's PlanState in a dedicated memory context,
+ * so that we could get rid of it later (see evict_child_plan_state()).
+ * This is only done if children might be evicted (PG 13+).
+ */
+static PlanState *
+init_child_plan_state(RuntimeAppendState *scan_state,
+					  ChildScanCommon child,
+					  EState *estate)
+{
+#if PG_VERSION_NUM >= 130000
+	MemoryContext	old_mcxt,
+					query_mcxt = estate->es_query_cxt;
+	ListCell	   *lc;
+	Index			rti;
+	bool			rel_was_open;
+	int				nslots,
+					nexprcontexts,
+					i;
+#endif
+	PlanState	   *ps;
+
+	child->slots = NIL;
+	child->exprcontexts = NIL;
+	child->opened_rti = 0;
+
+	/* Children are never evicted, initialize them as usual */
+	if (scan_state->max_active_children <= 0)
+	{
+		ps = ExecInitNode(child->content.plan, estate, 0);
+		goto init_child_plan_state_done;
+	}
+
+#if PG_VERSION_NUM >= 130000
+	child->mcxt = AllocSetContextCreate(estate->es_query_cxt,
+										"RuntimeAppend child",
+										ALLOCSET_DEFAULT_SIZES);
+
+	/* Remember which slots and ExprContexts will belong to this child */
+	nslots = list_length(estate->es_tupleTable);
+	nexprcontexts = list_length(estate->es_exprcontexts);
+
+	rti = child_plan_scanrelid(child->content.plan);
+	rel_was_open = (rti == 0 || estate->es_relations[rti - 1] != NULL);
+
+	old_mcxt = MemoryContextSwitchTo(child->mcxt);
+
+	/* CreateExprContext() and others allocate in es_query_cxt, redirect them */
+	estate->es_query_cxt = child->mcxt;
+
+	PG_TRY();
+	{
+		ps = ExecInitNode(child->content.plan, estate, 0);
+	}
+	PG_CATCH();
+	{
+		estate->es_query_cxt = query_mcxt;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	estate->es_query_cxt = query_mcxt;
+
+	estate->es_tupleTable =
+			move_list_out_of_child_context(estate->es_tupleTable,
+										   child->mcxt, query_mcxt);
+	estate->es_exprcontexts =
+			move_list_out_of_child_context(estate->es_exprcontexts,
+										   child->mcxt, query_mcxt);
+
+	i = 0;
+	foreach (lc, estate->es_tupleTable)
+	{
+		if (i++ >= nslots)
+			child->slots = lappend(child->slots, lfirst(lc));
+	}
+
+	/* CreateExprContext() puts new ExprContexts first */
+	i = list_length(estate->es_exprcontexts) - nexprcontexts;
+	foreach (lc, estate->es_exprcontexts)
+	{
+		if (i-- <= 0)
+			break;
+
+		child->exprcontexts = lappend(child->exprcontexts, lfirst(lc));
+	}
+	MemoryContextSwitchTo(old_mcxt);
+
+	/* Child will release relation it has opened (see ExecGetRangeTableRelation()) */
+	if (!rel_was_open && estate->es_relations[rti - 1] != NULL)
+		child->opened_rti = rti;
+#else
+	elog(ERROR, "RuntimeAppend children can't be evicted on this PostgreSQL version");
+#endif
+
+init_child_plan_state_done:
+	child->content.plan_state = ps;
+	child->content_type = CHILD_PLAN_STATE; /* update content type */
+
+	/* Explain and clear_plan_states rely on this list */
+	scan_state->css.custom_ps = lappend(scan_state->css.custom_ps, ps);
+
+	dlist_push_head(&scan_state->active_children, &child->lru_node);
+	scan_state->nactive_children++;
+
+	return ps;
+}
+
+/*
+ * Shut down child's PlanState (release buffers, scans, memory etc),
+ * it will be initialized again if needed. Locks are kept until
+ * the end of transaction, as usual.
+ */
+static void
+evict_child_plan_state(RuntimeAppendState *scan_state,
+					   ChildScanCommon child,
+					   EState *estate)
+{
+	PlanState	   *ps = child->content.plan_state;
+	ListCell	   *lc;
+
+	Assert(child->content_type == CHILD_PLAN_STATE);
+
+	scan_state->css.custom_ps = list_delete_ptr(scan_state->css.custom_ps, ps);
+
+	dlist_delete(&child->lru_node);
+	scan_state->nactive_children--;
+
+	child->content.plan = ps->plan;
+	child->content_type = CHILD_PLAN;
+
+	ExecEndNode(ps);
+
+	/* ExecEndNode() only unlinks ExprContexts from PlanStates */
+	foreach (lc, child->exprcontexts)
+	{
+		ExprContext *econtext = (ExprContext *) lfirst(lc);
+
+		if (list_member_ptr(estate->es_exprcontexts, econtext))
+			FreeExprContext(econtext, true);
+	}
+	list_free(child->exprcontexts);
+	child->exprcontexts = NIL;
+
+#if PG_VERSION_NUM >= 130000
+	/* Drop relcache reference, relation will be opened again if needed */
+	if (child->opened_rti > 0)
+	{
+		heap_close_compat(estate->es_relations[child->opened_rti - 1], NoLock);
+		estate->es_relations[child->opened_rti - 1] = NULL;
+		child->opened_rti = 0;
+	}
+#endif
+
+	/* Slots live in child's memory context, forget them */
+	foreach (lc, child->slots)
+	{
+		TupleTableSlot *slot = (TupleTableSlot *) lfirst(lc);
+
+		estate->es_tupleTable = list_delete_ptr(estate->es_tupleTable, slot);
+		ExecDropSingleTupleTableSlot(slot);
+	}
+	child->slots = NIL;
+
+	MemoryContextDelete(child->mcxt);
+	child->mcxt = NULL;
+
+	scan_state->nevicted_children++;
+}
+
+/* Make room for one more child if we've hit the limit */
+static void
+evict_least_recently_used_child(RuntimeAppendState *scan_state,
+								EState *estate)
+{
+	ChildScanCommon child;
+
+	if (scan_state->max_active_children <= 0 ||
+		scan_state->nactive_children < scan_state->max_active_children)
+		return;
+
+	if (dlist_is_empty(&scan_state->active_children))
+		return;
+
+	child = dlist_tail_element(ChildScanCommonData, lru_node,
+							   &scan_state->active_children);
+
+	/* Never touch children selected by the current rescan */
+	if (child->last_used == scan_state->nrescans)
+		return;
+
+	evict_child_plan_state(scan_state, child, estate);
+}
+
 static void
 transform_plans_into_states(RuntimeAppendState *scan_state,
 							ChildScanCommon *selected_plans, int n,
@@ -54,6 +309,22 @@ transform_plans_into_states(RuntimeAppendState *scan_state,
 {
 	int i;
 
+	scan_state->nrescans++;
+
+	/* Mark selected children as recently used */
+	for (i = 0; i < n; i++)
+	{
+		ChildScanCommon child;
+
+		Assert(selected_plans);
+		child = selected_plans[i];
+
+		child->last_used = scan_state->nrescans;
+
+		if (child->content_type == CHILD_PLAN_STATE)
+			dlist_move_head(&scan_state->active_children, &child->lru_node);
+	}
+
 	for (i = 0; i < n; i++)
 	{
 		ChildScanCommon		child;
@@ -67,12 +338,8 @@ transform_plans_into_states(RuntimeAppendState *scan_state,
 		{
 			Assert(child->content_type == CHILD_PLAN); /* no paths allowed */
 
-			ps = ExecInitNode(child->content.plan, estate, 0);
-			child->content.plan_state = ps;
-			child->content_type = CHILD_PLAN_STATE; /* update content type */
-
-			/* Explain and clear_plan_states rely on this list */
-			scan_state->css.custom_ps = lappend(scan_state->css.custom_ps, ps);
+			evict_least_recently_used_child(scan_state, estate);
+			ps = init_child_plan_state(scan_state, child, estate);
 		}
 		else
 			ps = child->content.plan_state;
@@ -93,24 +360,38 @@ transform_plans_into_states(RuntimeAppendState *scan_state,
 }
 
 static ChildScanCommon *
-select_required_plans(HTAB *children_table, Oid *parts, int nparts, int *nres)
+select_required_plans(RuntimeAppendState *scan_state, List *ranges, int *nres)
 {
 	uint32				allocated,
 						used;
 	ChildScanCommon	   *result;
-	int					i;
+	ListCell		   *lc;
 
 	ArrayAlloc(result, allocated, used, INITIAL_ALLOC_NUM);
 
-	for (i = 0; i < nparts; i++)
+	/* If required, add parent to result */
+	if (scan_state->enable_parent && scan_state->parent_child)
+		ArrayPush(result, allocated, used, scan_state->parent_child);
+
+	/* Deal with selected partitions */
+	foreach (lc, ranges)
 	{
-		ChildScanCommon child = hash_search(children_table,
-											(const void *) &parts[i],
-											HASH_FIND, NULL);
-		if (!child)
-			continue; /* no plan for this partition */
+		uint32	i;
+		uint32	a = irange_lower(lfirst_irange(lc)),
+				b = irange_upper(lfirst_irange(lc));
 
-		ArrayPush(result, allocated, used, child);
+		for (i = a; i <= b; i++)
+		{
+			ChildScanCommon child;
+
+			Assert(i < PrelChildrenCount(scan_state->prel));
+			child = scan_state->children_by_index[i];
+
+			if (!child)
+				continue; /* no plan for this partition */
+
+			ArrayPush(result, allocated, used, child);
+		}
 	}
 
 	/* Get rid of useless array */
@@ -124,6 +405,229 @@ select_required_plans(HTAB *children_table, Oid *parts, int nparts, int *nres)
 	return result;
 }
 
+/* Address plans stored in 'children_table' by partition index */
+static void
+build_children_by_index(RuntimeAppendState *scan_state)
+{
+	PartRelationInfo   *prel = scan_state->prel;
+	Oid				   *children = PrelGetChildrenArray(prel);
+	uint32				nchildren = PrelChildrenCount(prel);
+	Oid					parent_relid = PrelParentRelid(prel);
+	uint32				i;
+
+	scan_state->children_by_index = (ChildScanCommon *)
+			palloc(Max(nchildren, 1) * sizeof(ChildScanCommon));
+
+	for (i = 0; i < nchildren; i++)
+	{
+		/* NOTE: partition might have been added after planning */
+		scan_state->children_by_index[i] =
+				hash_search(scan_state->children_table,
+							(const void *) &children[i],
+							HASH_FIND, NULL);
+	}
+
+	scan_state->parent_child = hash_search(scan_state->children_table,
+										   (const void *) &parent_relid,
+										   HASH_FIND, NULL);
+}
+
+/* Collect distinct PARAMs which might be used for partition pruning */
+static bool
+pull_prune_params_walker(Node *node, List **params)
+{
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, Param))
+	{
+		ListCell *lc;
+
+		foreach (lc, *params)
+		{
+			if (equal(node, lfirst(lc)))
+				return false;
+		}
+
+		*params = lappend(*params, node);
+		return false;
+	}
+
+	return expression_tree_walker(node, pull_prune_params_walker,
+								  (void *) params);
+}
+
+/*
+ * Prepare partition pruning cache.
+ *
+ * Pruning clauses can only be evaluated by walk_expr_tree() using the values
+ * of their PARAMs (see IsConstValue()), so these values make up a cache key.
+ * Stable functions (e.g. now()) don't change their results within a single
+ * statement, and this cache lives no longer than that.
+ */
+static void
+init_prune_cache(RuntimeAppendState *scan_state, EState *estate)
+{
+	List	   *params = NIL;
+	ListCell   *lc;
+	int			i;
+
+	pull_prune_params_walker((Node *) scan_state->canon_custom_exprs, &params);
+
+	scan_state->nprune_params = list_length(params);
+	scan_state->prune_params = NIL;
+	scan_state->prune_params_typlen = palloc(sizeof(int16) *
+											 Max(scan_state->nprune_params, 1));
+	scan_state->prune_params_typbyval = palloc(sizeof(bool) *
+											   Max(scan_state->nprune_params, 1));
+
+	i = 0;
+	foreach (lc, params)
+	{
+		Param *param = (Param *) lfirst(lc);
+
+		scan_state->prune_params = lappend(scan_state->prune_params,
+										   ExecInitExpr((Expr *) param, NULL));
+
+		get_typlenbyval(param->paramtype,
+						&scan_state->prune_params_typlen[i],
+						&scan_state->prune_params_typbyval[i]);
+		i++;
+	}
+
+	scan_state->prune_cache_mcxt =
+			AllocSetContextCreate(estate->es_query_cxt,
+								  "RuntimeAppend pruning cache",
+								  ALLOCSET_SMALL_SIZES);
+
+	scan_state->prune_cache = (RuntimePruneCacheEntry *)
+			MemoryContextAllocZero(scan_state->prune_cache_mcxt,
+								   RUNTIME_PRUNE_CACHE_SIZE *
+								   sizeof(RuntimePruneCacheEntry));
+	scan_state->prune_cache_hits = 0;
+
+	list_free(params);
+}
+
+/* Evaluate PARAMs and compute hash of their values */
+static uint32
+eval_prune_params(RuntimeAppendState *scan_state, ExprContext *econtext,
+				  Datum *values, bool *isnull)
+{
+	uint32		hash = 0;
+	ListCell   *lc;
+	int			i;
+
+	i = 0;
+	foreach (lc, scan_state->prune_params)
+	{
+		ExprState  *param_state = (ExprState *) lfirst(lc);
+		int16		typlen = scan_state->prune_params_typlen[i];
+		bool		typbyval = scan_state->prune_params_typbyval[i];
+
+		values[i] = ExecEvalExprCompat(param_state, econtext, &isnull[i]);
+
+		/* Rotate hash left 1 bit at each step */
+		hash = (hash << 1) | ((hash & 0x80000000) ? 1 : 0);
+
+		if (!isnull[i])
+		{
+			Datum value_hash;
+
+			if (typbyval)
+				value_hash = hash_any((unsigned char *) &values[i],
+									  sizeof(Datum));
+			else
+				value_hash = hash_any((unsigned char *) DatumGetPointer(values[i]),
+									  datumGetSize(values[i], typbyval, typlen));
+
+			hash ^= DatumGetUInt32(value_hash);
+		}
+
+		i++;
+	}
+
+	return hash;
+}
+
+/* Check that cache entry contains exactly these PARAM values */
+static bool
+prune_cache_entry_matches(RuntimeAppendState *scan_state,
+						  RuntimePruneCacheEntry *entry, uint32 hash,
+						  Datum *values, bool *isnull)
+{
+	int i;
+
+	if (!entry->valid || entry->hash != hash)
+		return false;
+
+	for (i = 0; i < scan_state->nprune_params; i++)
+	{
+		if (entry->isnull[i] != isnull[i])
+			return false;
+
+		if (!isnull[i] &&
+			!datumIsEqual(entry->values[i], values[i],
+						  scan_state->prune_params_typbyval[i],
+						  scan_state->prune_params_typlen[i]))
+			return false;
+	}
+
+	return true;
+}
+
+/* Replace contents of cache entry with a new set of PARAM values */
+static void
+reset_prune_cache_entry(RuntimeAppendState *scan_state,
+						RuntimePruneCacheEntry *entry, uint32 hash,
+						Datum *values, bool *isnull)
+{
+	MemoryContext	old_mcxt;
+	int				i;
+
+	/* Free previous contents */
+	if (entry->valid)
+	{
+		for (i = 0; i < scan_state->nprune_params; i++)
+		{
+			if (!entry->isnull[i] && !scan_state->prune_params_typbyval[i])
+				pfree(DatumGetPointer(entry->values[i]));
+		}
+
+		if (entry->plans)
+			pfree(entry->plans); /* shallow free since plans
+								  * belong to children_table */
+	}
+	else
+	{
+		int nparams = Max(scan_state->nprune_params, 1);
+
+		entry->values = MemoryContextAlloc(scan_state->prune_cache_mcxt,
+										   sizeof(Datum) * nparams);
+		entry->isnull = MemoryContextAlloc(scan_state->prune_cache_mcxt,
+										   sizeof(bool) * nparams);
+	}
+
+	old_mcxt = MemoryContextSwitchTo(scan_state->prune_cache_mcxt);
+
+	for (i = 0; i < scan_state->nprune_params; i++)
+	{
+		entry->isnull[i] = isnull[i];
+		entry->values[i] = isnull[i] ?
+				(Datum) 0 :
+				datumCopy(values[i],
+						  scan_state->prune_params_typbyval[i],
+						  scan_state->prune_params_typlen[i]);
+	}
+
+	MemoryContextSwitchTo(old_mcxt);
+
+	entry->hash = hash;
+	entry->plans = NULL;
+	entry->nplans = 0;
+	entry->valid = true;
+}
+
 /* Adapt child's tlist for parent relation (change varnos and varattnos) */
 static List *
 build_parent_tlist(List *tlist, AppendRelInfo *appinfo)
@@ -240,17 +744,17 @@ tlist_is_var_subset(List *a, List *b)
 	return false;
 }
 
-/* Append partition attribute in case it's not present in target list */
+/* Append attributes of 'part_vars' in case they're not present in target list */
 static List *
 append_part_attr_to_tlist(List *tlist,
 						  AppendRelInfo *appinfo,
-						  const PartRelationInfo *prel)
+						  List *part_vars)
 {
 	ListCell   *lc,
 			   *lc_var;
 	List	   *vars_not_found = NIL;
 
-	foreach (lc_var, prel->expr_vars)
+	foreach (lc_var, part_vars)
 	{
 		bool	part_attr_found		= false;
 		Var		*expr_var			= (Var *) lfirst(lc_var),
@@ -314,11 +818,12 @@ pack_runtimeappend_private(CustomScan *cscan, RuntimeAppendPath *path,
 		pfree(children[i]);
 	}
 
-	/* Save parent & partition Oids and a flag as first element of 'custom_private' */
+	/* Save parent & partition Oids, flag and filter as first element of 'custom_private' */
 	custom_private = lappend(custom_private,
-							 list_make3(list_make1_oid(path->relid),
+							 list_make4(list_make1_oid(path->relid),
 										custom_oids, /* list of Oids */
-										list_make1_int(enable_parent)));
+										list_make1_int(enable_parent),
+										list_make1_int(path->dyn_filter_paramid)));
 
 	/* Store freshly built 'custom_private' */
 	cscan->custom_private = custom_private;
@@ -365,12 +870,16 @@ unpack_runtimeappend_private(RuntimeAppendState *scan_state, CustomScan *cscan)
 		child->content_type = CHILD_PLAN;
 		child->content.plan = (Plan *) lfirst(plan_cell);
 		child->original_order = i++; /* will be used in EXPLAIN */
+		child->last_used = 0;
+		child->mcxt = NULL;
+		child->slots = NIL;
 	}
 
 	/* Finally fill 'scan_state' with unpacked elements */
 	scan_state->children_table = children_table;
 	scan_state->relid = linitial_oid(linitial(runtimeappend_private));
 	scan_state->enable_parent = (bool) linitial_int(lthird(runtimeappend_private));
+	scan_state->dyn_filter_paramid = linitial_int(lfourth(runtimeappend_private));
 }
 
 
@@ -447,7 +956,8 @@ get_partitioning_clauses(List *restrictinfo_list,
 
 		prel_expr = PrelExpressionForRelid(prel, partitioned_rel);
 
-		if (clause_contains_prel_expr((Node *) rinfo->clause, prel_expr))
+		if (clause_contains_prel_expr((Node *) rinfo->clause, prel_expr) ||
+			clause_refers_to_zone_map((Node *) rinfo->clause, prel, partitioned_rel))
 			result = lappend(result, rinfo->clause);
 	}
 	return result;
@@ -526,6 +1036,9 @@ create_append_path_common(PlannerInfo *root,
 	Assert(inner_entry->relid != 0);
 	result->relid = inner_entry->relid;
 
+	/* Hash join will set it if needed */
+	result->dyn_filter_paramid = -1;
+
 	result->nchildren = list_length(inner_append->subpaths);
 	result->children = (ChildScanCommon *)
 							palloc(result->nchildren * sizeof(ChildScanCommon));
@@ -599,6 +1112,8 @@ create_append_plan_common(PlannerInfo *root, RelOptInfo *rel,
 	RuntimeAppendPath  *rpath = (RuntimeAppendPath *) best_path;
 	PartRelationInfo   *prel;
 	CustomScan		   *cscan;
+	List			   *custom_exprs,
+					   *part_vars;
 
 	prel = get_pathman_relation_info(rpath->relid);
 	if (!prel)
@@ -609,6 +1124,11 @@ create_append_plan_common(PlannerInfo *root, RelOptInfo *rel,
 	cscan = makeNode(CustomScan);
 	cscan->custom_scan_tlist = NIL; /* initial value (empty list) */
 
+	/* Children must emit columns of both partitioning key & zone maps */
+	custom_exprs = get_partitioning_clauses(clauses, prel, rel->relid);
+	part_vars = list_concat(list_copy(prel->expr_vars),
+							zone_map_vars(custom_exprs, prel, rel->relid));
+
 	if (custom_plans)
 	{
 		ListCell   *lc1,
@@ -651,7 +1171,7 @@ create_append_plan_common(PlannerInfo *root, RelOptInfo *rel,
 
 			/* Add partition attribute if necessary (for ExecQual()) */
 			child_plan->targetlist = append_part_attr_to_tlist(child_plan->targetlist,
-															   appinfo, prel);
+															   appinfo, part_vars);
 
 			/* Now make custom_scan_tlist match child plans' targetlists */
 			if (!cscan->custom_scan_tlist)
@@ -666,7 +1186,7 @@ create_append_plan_common(PlannerInfo *root, RelOptInfo *rel,
 	/* Since we're not scanning any real table directly */
 	cscan->scan.scanrelid = 0;
 
-	cscan->custom_exprs = get_partitioning_clauses(clauses, prel, rel->relid);
+	cscan->custom_exprs = custom_exprs;
 	cscan->custom_plans = custom_plans;
 	cscan->methods = scan_methods;
 
@@ -699,6 +1219,9 @@ create_append_scan_state_common(CustomScan *node,
 	scan_state->ncur_plans = 0;
 	scan_state->running_idx = 0;
 
+	scan_state->dyn_filter_pending = false;
+	scan_state->dyn_filter_plans = NULL;
+
 	return (Node *) scan_state;
 }
 
@@ -728,6 +1251,103 @@ begin_append_common(CustomScanState *node, EState *estate, int eflags)
 	/* Prepare custom expression according to set_set_customscan_references() */
 	scan_state->canon_custom_exprs =
 			canonicalize_custom_exprs(scan_state->custom_exprs);
+
+	/* Prepare cache of partition pruning results */
+	init_prune_cache(scan_state, estate);
+
+	/* Make plans addressable by partition index */
+	build_children_by_index(scan_state);
+
+	/* Prepare LRU list of initialized children */
+	dlist_init(&scan_state->active_children);
+	scan_state->nactive_children = 0;
+	scan_state->nrescans = 0;
+	scan_state->nevicted_children = 0;
+
+	/*
+	 * EXPLAIN ANALYZE will only show children which haven't been evicted.
+	 * Older executors keep list cells of child's state in its memory
+	 * context, so children are never evicted there.
+	 */
+#if PG_VERSION_NUM >= 130000
+	scan_state->max_active_children = pg_pathman_runtimeappend_max_children;
+#else
+	scan_state->max_active_children = 0;
+#endif
+}
+
+/* Select partitions using clauses on partitioning expression and zone maps */
+static List *
+prune_ranges(RuntimeAppendState *scan_state, ExprContext *econtext)
+{
+	PartRelationInfo   *prel = scan_state->prel;
+	List			   *ranges;
+	ListCell		   *lc;
+	WalkerContext		wcxt;
+
+	/* First we select all available partitions... */
+	ranges = list_make1_irange_full(prel, IR_COMPLETE);
+
+	InitWalkerContext(&wcxt, scan_state->prel_expr, prel, econtext);
+	foreach (lc, scan_state->canon_custom_exprs)
+	{
+		WrapperNode *wrap;
+
+		/* ... then we cut off irrelevant ones using the provided clauses */
+		wrap = walk_expr_tree((Expr *) lfirst(lc), &wcxt);
+		ranges = irange_list_intersection(ranges, wrap->rangeset);
+	}
+
+	/* Finally, check summaries of non-key columns */
+	return zone_map_prune_ranges(ranges, scan_state->canon_custom_exprs,
+								 prel, INDEX_VAR, econtext);
+}
+
+/*
+ * Select plans using partitions of hash join's inner side.
+ * NOTE: we don't use pruning cache, since filter changes on each ReScan.
+ */
+static void
+select_plans_using_dynamic_filter(RuntimeAppendState *scan_state)
+{
+	ExprContext		   *econtext = scan_state->css.ss.ps.ps_ExprContext;
+	EState			   *estate = scan_state->css.ss.ps.state;
+	ParamExecData	   *prm;
+	List			   *ranges;
+	MemoryContext		old_mcxt;
+
+	ranges = prune_ranges(scan_state, econtext);
+
+	/* Filter is published by DynamicFilterSource */
+	prm = &econtext->ecxt_param_exec_vals[scan_state->dyn_filter_paramid];
+	if (!prm->isnull && DatumGetPointer(prm->value) != NULL)
+	{
+		DynamicFilter *filter = (DynamicFilter *) DatumGetPointer(prm->value);
+
+		ranges = irange_list_intersection(ranges,
+										  dynamic_filter_ranges(filter,
+																scan_state->prel));
+	}
+
+	/* Previous selection is useless now */
+	if (scan_state->dyn_filter_plans)
+		pfree(scan_state->dyn_filter_plans);
+
+	old_mcxt = MemoryContextSwitchTo(estate->es_query_cxt);
+	scan_state->dyn_filter_plans = select_required_plans(scan_state, ranges,
+														 &scan_state->ncur_plans);
+	MemoryContextSwitchTo(old_mcxt);
+
+	scan_state->cur_plans = scan_state->dyn_filter_plans;
+	scan_state->dyn_filter_pending = false;
+
+	/* Transform selected plans into executable plan states */
+	transform_plans_into_states(scan_state,
+								scan_state->cur_plans,
+								scan_state->ncur_plans,
+								estate);
+
+	scan_state->running_idx = 0;
 }
 
 TupleTableSlot *
@@ -738,9 +1358,13 @@ exec_append_common(CustomScanState *node,
 	TupleTableSlot	   *result;
 
 	/* ReScan if no plans are selected */
-	if (scan_state->ncur_plans == 0)
+	if (scan_state->ncur_plans == 0 && !scan_state->dyn_filter_pending)
 		ExecReScan(&node->ss.ps);
 
+	/* By now hash join should have built its hash table */
+	if (scan_state->dyn_filter_pending)
+		select_plans_using_dynamic_filter(scan_state);
+
 #if PG_VERSION_NUM >= 100000
 	fetch_next_tuple(node); /* use specific callback */
 
@@ -817,6 +1441,7 @@ end_append_common(CustomScanState *node)
 
 	clear_plan_states(&scan_state->css);
 	hash_destroy(scan_state->children_table);
+	MemoryContextDelete(scan_state->prune_cache_mcxt);
 	close_pathman_relation_info(scan_state->prel);
 }
 
@@ -825,37 +1450,55 @@ rescan_append_common(CustomScanState *node)
 {
 	RuntimeAppendState *scan_state = (RuntimeAppendState *) node;
 	ExprContext		   *econtext = node->ss.ps.ps_ExprContext;
-	PartRelationInfo   *prel = scan_state->prel;
-	List			   *ranges;
-	ListCell		   *lc;
-	WalkerContext		wcxt;
-	Oid				   *parts;
-	int					nparts;
+	RuntimePruneCacheEntry *entry;
+	Datum			   *values;
+	bool			   *isnull;
+	uint32				hash;
 
-	/* First we select all available partitions... */
-	ranges = list_make1_irange_full(prel, IR_COMPLETE);
+	/* Hash table isn't ready yet, postpone selection until Exec */
+	if (scan_state->dyn_filter_paramid >= 0)
+	{
+		scan_state->dyn_filter_pending = true;
+		scan_state->cur_plans = NULL;
+		scan_state->ncur_plans = 0;
+		scan_state->running_idx = 0;
+		return;
+	}
 
-	InitWalkerContext(&wcxt, scan_state->prel_expr, prel, econtext);
-	foreach (lc, scan_state->canon_custom_exprs)
+	values = palloc(sizeof(Datum) * Max(scan_state->nprune_params, 1));
+	isnull = palloc(sizeof(bool) * Max(scan_state->nprune_params, 1));
+
+	/* Have we already seen these PARAM values? */
+	hash = eval_prune_params(scan_state, econtext, values, isnull);
+	entry = &scan_state->prune_cache[hash % RUNTIME_PRUNE_CACHE_SIZE];
+
+	if (prune_cache_entry_matches(scan_state, entry, hash, values, isnull))
 	{
-		WrapperNode *wrap;
+		scan_state->prune_cache_hits++;
+	}
+	else
+	{
+		List		   *ranges;
+		MemoryContext	old_mcxt;
 
-		/* ... then we cut off irrelevant ones using the provided clauses */
-		wrap = walk_expr_tree((Expr *) lfirst(lc), &wcxt);
-		ranges = irange_list_intersection(ranges, wrap->rangeset);
+		/* Evict previous PARAM values (cur_plans might point there) */
+		reset_prune_cache_entry(scan_state, entry, hash, values, isnull);
+
+		ranges = prune_ranges(scan_state, econtext);
+
+		/* Select new plans for this run using 'ranges' (stored in cache) */
+		old_mcxt = MemoryContextSwitchTo(scan_state->prune_cache_mcxt);
+		entry->plans = select_required_plans(scan_state, ranges,
+											 &entry->nplans);
+		MemoryContextSwitchTo(old_mcxt);
 	}
 
-	/* Get Oids of the required partitions */
-	parts = get_partition_oids(ranges, &nparts, prel, scan_state->enable_parent);
+	pfree(values);
+	pfree(isnull);
 
-	/* Select new plans for this run using 'parts' */
-	if (scan_state->cur_plans)
-		pfree(scan_state->cur_plans); /* shallow free since cur_plans
-									   * belong to children_table  */
-	scan_state->cur_plans = select_required_plans(scan_state->children_table,
-												  parts, nparts,
-												  &scan_state->ncur_plans);
-	pfree(parts);
+	/* NOTE: cur_plans belong to pruning cache */
+	scan_state->cur_plans = entry->plans;
+	scan_state->ncur_plans = entry->nplans;
 
 	/* Transform selected plans into executable plan states */
 	transform_plans_into_states(scan_state,
@@ -895,7 +1538,20 @@ explain_append_common(CustomScanState *node,
 								 deparse_context, true, false);
 
 	/* And add to es->str */
-	ExplainPropertyText("Prune by", exprstr, es);
+	if (custom_exprs)
+		ExplainPropertyText("Prune by", exprstr, es);
+
+	/* Show how many times we've managed to skip pruning */
+	if (es->analyze)
+		ExplainPropertyIntegerCompat("Prune Cache Hits",
+									 ((RuntimeAppendState *) node)->prune_cache_hits,
+									 es);
+
+	/* Show how many children have been shut down to fit the limit */
+	if (es->analyze)
+		ExplainPropertyIntegerCompat("Evicted Children",
+									 ((RuntimeAppendState *) node)->nevicted_children,
+									 es);
 
 	/* Construct excess PlanStates */
 	if (!es->analyze)
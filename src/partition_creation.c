@@ -16,6 +16,11 @@
 #include "compat/pg_compat.h"
 #include "xact_handling.h"
 
+#if PG_VERSION_NUM >= 130000
+#include "common/hashfn.h"
+#else
+#include "access/hash.h"
+#endif
 #include "access/htup_details.h"
 #include "access/reloptions.h"
 #include "access/sysattr.h"
@@ -45,7 +50,10 @@
 #if PG_VERSION_NUM >= 130000
 #include "utils/acl.h"
 #endif
+#include "utils/array.h"
 #include "utils/builtins.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
 #include "utils/datum.h"
 #include "utils/fmgroids.h"
 #include "utils/inval.h"
@@ -59,6 +67,36 @@
 #include "utils/regproc.h"
 #endif
 
+/* Max length of a range in SpawnedPartition */
+#define SPAWNED_RANGE_NAME_LEN		(NAMEDATALEN * 2)
+
+/* Number of recently spawned partitions kept in shmem */
+#define SPAWNED_PARTITIONS_SIZE		64
+
+/*
+ * RANGE partition created by some backend. Backends which have been
+ * waiting for the same range use it instead of rebuilding PartRelationInfo.
+ */
+typedef struct
+{
+	Oid			dbid;
+	Oid			parent_relid;
+	Oid			partition_relid;
+	char		range_name[SPAWNED_RANGE_NAME_LEN];	/* see spawned_range_name() */
+} SpawnedPartition;
+
+typedef struct
+{
+	slock_t				mutex;
+	int					next;		/* entry to be overwritten next */
+	SpawnedPartition	parts[SPAWNED_PARTITIONS_SIZE];
+} SpawnedPartitions;
+
+static SpawnedPartitions *spawned_partitions = NULL;
+
+
+static bool can_spawn_partitions_using_bgw(Oid relid, Datum value, Oid value_type);
+
 static Oid spawn_partitions_val(Oid parent_relid,
 								const Bound *range_bound_min,
 								const Bound *range_bound_max,
@@ -67,7 +105,36 @@ static Oid spawn_partitions_val(Oid parent_relid,
 								Oid interval_type,
 								Datum value,
 								Oid value_type,
-								Oid collid);
+								Oid collid,
+								bool sparse,
+								const Bound *gap_end,
+								bool *retry);
+static Oid spawn_single_partition(Oid parent_relid,
+								  Datum start,
+								  Datum end,
+								  Oid bounds_type,
+								  bool *retry);
+static Oid spawn_partitions_bulk(Oid parent_relid,
+								 Datum *bounds,
+								 int nbounds,
+								 Oid bounds_type,
+								 bool *retry);
+
+static char *spawned_range_name(const Bound *start, const Bound *end,
+								Oid value_type);
+static Oid find_spawned_partition(Oid parent_relid, const char *range_name);
+static void remember_spawned_partition(Oid parent_relid, const char *range_name,
+									   Oid partition_relid);
+
+static void check_range_parent(Oid parent_relid);
+static Oid create_range_partition_using_expr(Oid parent_relid,
+											 const Bound *start_value,
+											 const Bound *end_value,
+											 Oid value_type,
+											 RangeVar *partition_rv,
+											 char *tablespace,
+											 Node *expr,
+											 List *trigger_columns);
 
 static void create_single_partition_common(Oid parent_relid,
 										   Oid partition_relid,
@@ -119,15 +186,63 @@ create_single_range_partition_internal(Oid parent_relid,
 									   RangeVar *partition_rv,
 									   char *tablespace)
 {
-	Oid						partition_relid;
-	Constraint			   *check_constr;
-	init_callback_params	callback_params;
-	List				   *trigger_columns = NIL;
-	Node				   *expr;
-	Datum		values[Natts_pathman_config];
-	bool		isnull[Natts_pathman_config];
+	List	   *trigger_columns = NIL;
+	Node	   *expr;
+
+	check_range_parent(parent_relid);
+
+	/* Check pathman config anld fill variables */
+	expr = build_partitioning_expression(parent_relid, NULL, &trigger_columns);
 
+	return create_range_partition_using_expr(parent_relid,
+											 start_value,
+											 end_value,
+											 value_type,
+											 partition_rv,
+											 tablespace,
+											 expr,
+											 trigger_columns);
+}
 
+/*
+ * Create RANGE partitions [bounds[0], bounds[1]), [bounds[1], bounds[2]), ...
+ * This is cheaper than a series of create_single_range_partition_internal()
+ * calls, since partitioning expression is built only once.
+ *
+ * 'partition_rvs' and 'tablespaces' may be NULL.
+ */
+void
+create_range_partitions_bulk(Oid parent_relid,
+							 const Bound *bounds,
+							 int nbounds,
+							 Oid value_type,
+							 RangeVar **partition_rvs,
+							 char **tablespaces)
+{
+	List	   *trigger_columns = NIL;
+	Node	   *expr;
+	int			i;
+
+	check_range_parent(parent_relid);
+
+	/* Check pathman config anld fill variables */
+	expr = build_partitioning_expression(parent_relid, NULL, &trigger_columns);
+
+	for (i = 0; i < nbounds - 1; i++)
+		(void) create_range_partition_using_expr(parent_relid,
+												 &bounds[i],
+												 &bounds[i + 1],
+												 value_type,
+												 partition_rvs ? partition_rvs[i] : NULL,
+												 tablespaces ? tablespaces[i] : NULL,
+												 expr,
+												 trigger_columns);
+}
+
+/* Check that we can create RANGE partitions of 'parent_relid' */
+static void
+check_range_parent(Oid parent_relid)
+{
 	/*
 	 * Sanity check. Probably needed only if some absurd init_callback
 	 * decides to drop the table while we are creating partitions.
@@ -137,10 +252,26 @@ create_single_range_partition_internal(Oid parent_relid,
 	 * tests fail for not immediately obvious reasons. Don't want to dig
 	 * into this now.
 	 */
-	if (!pathman_config_contains_relation(parent_relid, values, isnull, NULL, NULL))
+	if (!pathman_config_contains_relation(parent_relid, NULL, NULL, NULL, NULL))
 	{
 		elog(ERROR, "Can't create range partition: relid %u doesn't exist or not partitioned", parent_relid);
 	}
+}
+
+/* Create one RANGE partition using prebuilt partitioning expression */
+static Oid
+create_range_partition_using_expr(Oid parent_relid,
+								  const Bound *start_value,
+								  const Bound *end_value,
+								  Oid value_type,
+								  RangeVar *partition_rv,
+								  char *tablespace,
+								  Node *expr,
+								  List *trigger_columns)
+{
+	Oid						partition_relid;
+	Constraint			   *check_constr;
+	init_callback_params	callback_params;
 
 	/* Generate a name if asked to */
 	if (!partition_rv)
@@ -154,9 +285,6 @@ create_single_range_partition_internal(Oid parent_relid,
 		partition_rv = makeRangeVar(parent_nsp_name, partition_name, -1);
 	}
 
-	/* Check pathman config anld fill variables */
-	expr = build_partitioning_expression(parent_relid, NULL, &trigger_columns);
-
 	/* Create a partition & get 'partitioning expression' */
 	partition_relid = create_single_partition_internal(parent_relid,
 													   partition_rv,
@@ -282,56 +410,31 @@ create_single_partition_common(Oid parent_relid,
 Oid
 create_partitions_for_value(Oid relid, Datum value, Oid value_type)
 {
-	TransactionId	rel_xmin;
-	Oid				last_partition = InvalidOid;
+	Oid				last_partition;
 
-	/* Check that table is partitioned and fetch xmin */
-	if (pathman_config_contains_relation(relid, NULL, NULL, &rel_xmin, NULL))
+	/*
+	 * If table has been partitioned in some previous xact AND
+	 * we don't hold any conflicting locks, run BGWorker.
+	 */
+	if (can_spawn_partitions_using_bgw(relid, value, value_type))
 	{
-		/* Take default values */
-		bool	spawn_using_bgw	= DEFAULT_PATHMAN_SPAWN_USING_BGW,
-				enable_auto		= DEFAULT_PATHMAN_AUTO;
-
-		/* Values to be extracted from PATHMAN_CONFIG_PARAMS */
-		Datum	values[Natts_pathman_config_params];
-		bool	isnull[Natts_pathman_config_params];
-
-		/* Try fetching options from PATHMAN_CONFIG_PARAMS */
-		if (read_pathman_params(relid, values, isnull))
-		{
-			enable_auto = values[Anum_pathman_config_params_auto - 1];
-			spawn_using_bgw = values[Anum_pathman_config_params_spawn_using_bgw - 1];
-		}
-
-		/* Emit ERROR if automatic partition creation is disabled */
-		if (!enable_auto || !IsAutoPartitionEnabled())
-			elog(ERROR, ERR_PART_ATTR_NO_PART, datum_to_cstring(value, value_type));
+		elog(DEBUG2, "create_partitions(): chose BGWorker [%u]", MyProcPid);
+		last_partition = create_partitions_for_value_bg_worker(relid,
+															   value,
+															   value_type);
 
-		/*
-		 * If table has been partitioned in some previous xact AND
-		 * we don't hold any conflicting locks, run BGWorker.
-		 */
-		if (spawn_using_bgw &&
-			xact_object_is_visible(rel_xmin) &&
-			!xact_bgw_conflicting_lock_exists(relid))
-		{
-			elog(DEBUG2, "create_partitions(): chose BGWorker [%u]", MyProcPid);
-			last_partition = create_partitions_for_value_bg_worker(relid,
-																   value,
-																   value_type);
-		}
-		/* Else it'd be better for the current backend to create partitions */
-		else
-		{
-			elog(DEBUG2, "create_partitions(): chose backend [%u]", MyProcPid);
-			last_partition = create_partitions_for_value_internal(relid,
-																  value,
-																  value_type);
-		}
+		count_partition_spawn(true);
 	}
+	/* Else it'd be better for the current backend to create partitions */
 	else
-		elog(ERROR, "table \"%s\" is not partitioned",
-			 get_rel_name_or_relid(relid));
+	{
+		elog(DEBUG2, "create_partitions(): chose backend [%u]", MyProcPid);
+		last_partition = create_partitions_for_value_internal(relid,
+															  value,
+															  value_type);
+
+		count_partition_spawn(false);
+	}
 
 	/* Check that 'last_partition' is valid */
 	if (last_partition == InvalidOid)
@@ -344,6 +447,66 @@ create_partitions_for_value(Oid relid, Datum value, Oid value_type)
 	return last_partition;
 }
 
+/*
+ * Start BGW which will create RANGE partitions to store 'value'.
+ *
+ * Returns NULL if partitions should be created by current backend
+ * (use create_partitions_for_value() in this case).
+ */
+SpawnPartitionsTask *
+create_partitions_for_value_async(Oid relid, Datum value, Oid value_type)
+{
+	SpawnPartitionsTask *task;
+
+	if (!can_spawn_partitions_using_bgw(relid, value, value_type))
+		return NULL;
+
+	elog(DEBUG2, "create_partitions(): chose async BGWorker [%u]", MyProcPid);
+	task = start_partitions_bg_worker(relid, value, value_type);
+
+	count_partition_spawn(true);
+
+	return task;
+}
+
+/*
+ * Check that partitions of 'relid' may be created automatically
+ * and decide whether BGW should be used for that.
+ */
+static bool
+can_spawn_partitions_using_bgw(Oid relid, Datum value, Oid value_type)
+{
+	TransactionId	rel_xmin;
+
+	/* Take default values */
+	bool	spawn_using_bgw	= DEFAULT_PATHMAN_SPAWN_USING_BGW,
+			enable_auto		= DEFAULT_PATHMAN_AUTO;
+
+	/* Values to be extracted from PATHMAN_CONFIG_PARAMS */
+	Datum	values[Natts_pathman_config_params];
+	bool	isnull[Natts_pathman_config_params];
+
+	/* Check that table is partitioned and fetch xmin */
+	if (!pathman_config_contains_relation(relid, NULL, NULL, &rel_xmin, NULL))
+		elog(ERROR, "table \"%s\" is not partitioned",
+			 get_rel_name_or_relid(relid));
+
+	/* Try fetching options from PATHMAN_CONFIG_PARAMS */
+	if (read_pathman_params(relid, values, isnull))
+	{
+		enable_auto = values[Anum_pathman_config_params_auto - 1];
+		spawn_using_bgw = values[Anum_pathman_config_params_spawn_using_bgw - 1];
+	}
+
+	/* Emit ERROR if automatic partition creation is disabled */
+	if (!enable_auto || !IsAutoPartitionEnabled())
+		elog(ERROR, ERR_PART_ATTR_NO_PART, datum_to_cstring(value, value_type));
+
+	return spawn_using_bgw &&
+		   xact_object_is_visible(rel_xmin) &&
+		   !xact_bgw_conflicting_lock_exists(relid);
+}
+
 
 /*
  * --------------------
@@ -367,37 +530,45 @@ create_partitions_for_value_internal(Oid relid, Datum value, Oid value_type)
 	/* Get both PartRelationInfo & PATHMAN_CONFIG contents for this relation */
 	if (pathman_config_contains_relation(relid, values, isnull, NULL, NULL))
 	{
-		PartRelationInfo   *prel;
-		LockAcquireResult	lock_result;		/* could we lock the parent? */
-		Oid					base_bound_type;	/* base type of prel->ev_type */
-		Oid					base_value_type;	/* base type of value_type */
-
-		/* Prevent modifications of partitioning scheme */
-		lock_result = xact_lock_rel(relid, ShareUpdateExclusiveLock, false);
-
-		/* Fetch PartRelationInfo by 'relid' */
-		prel = get_pathman_relation_info(relid);
-		shout_if_prel_is_invalid(relid, prel, PT_RANGE);
+		bool				retry;				/* partitions changed under us */
+		bool				sparse = DEFAULT_PATHMAN_SPAWN_SPARSE;
+		Datum				param_values[Natts_pathman_config_params];
+		bool				param_isnull[Natts_pathman_config_params];
 
-		/* Fetch base types of prel->ev_type & value_type */
-		base_bound_type = getBaseType(prel->ev_type);
-		base_value_type = getBaseType(value_type);
+		/* Should we skip intermediate partitions? */
+		if (read_pathman_params(relid, param_values, param_isnull))
+			sparse = DatumGetBool(param_values[Anum_pathman_config_params_spawn_sparse - 1]);
 
 		/*
-		 * Search for a suitable partition if we didn't hold it,
-		 * since somebody might have just created it for us.
-		 *
-		 * If the table is locked, it means that we've
-		 * already failed to find a suitable partition
-		 * and called this function to do the job.
+		 * We don't lock the parent here, so that sessions spawning
+		 * disjoint ranges don't wait for each other. Instead, each new
+		 * partition is protected by a lock on its range, see
+		 * spawn_partitions_val().
 		 */
-		Assert(lock_result != LOCKACQUIRE_NOT_AVAIL);
-		if (lock_result == LOCKACQUIRE_OK)
+		AcceptInvalidationMessages();
+
+		do
 		{
-			Oid	   *parts;
-			int		nparts;
+			PartRelationInfo   *prel;
+			Oid					base_bound_type;	/* base type of prel->ev_type */
+			Oid					base_value_type;	/* base type of value_type */
+			Oid				   *parts;
+			int					nparts;
+
+			retry = false;
+
+			/* Fetch PartRelationInfo by 'relid' */
+			prel = get_pathman_relation_info(relid);
+			shout_if_prel_is_invalid(relid, prel, PT_RANGE);
 
-			/* Search for matching partitions */
+			/* Fetch base types of prel->ev_type & value_type */
+			base_bound_type = getBaseType(prel->ev_type);
+			base_value_type = getBaseType(value_type);
+
+			/*
+			 * Search for a suitable partition,
+			 * since somebody might have just created it for us.
+			 */
 			parts = find_partitions_for_value(value, value_type, prel, &nparts);
 
 			/* Shout if there's more than one */
@@ -406,66 +577,98 @@ create_partitions_for_value_internal(Oid relid, Datum value, Oid value_type)
 
 			/* It seems that we got a partition! */
 			else if (nparts == 1)
-			{
-				/* Unlock the parent (we're not going to spawn) */
-				UnlockRelationOid(relid, ShareUpdateExclusiveLock);
-
-				/* Simply return the suitable partition */
 				partid = parts[0];
-			}
 
 			/* Don't forget to free */
 			pfree(parts);
-		}
-
-		/* Else spawn a new one (we hold a lock on the parent) */
-		if (partid == InvalidOid)
-		{
-			RangeEntry *ranges = PrelGetRangesArray(prel);
-			Bound		bound_min,			/* absolute MIN */
-				bound_max;			/* absolute MAX */
-
-			Oid			interval_type = InvalidOid;
-			Datum		interval_binary, /* assigned 'width' of one partition */
-				interval_text;
-
-			/* Copy datums in order to protect them from cache invalidation */
-			bound_min = CopyBound(&ranges[0].min,
-								  prel->ev_byval,
-								  prel->ev_len);
-
-			bound_max = CopyBound(&ranges[PrelLastChild(prel)].max,
-								  prel->ev_byval,
-								  prel->ev_len);
 
-			/* Check if interval is set */
-			if (isnull[Anum_pathman_config_range_interval - 1])
+			/* Else spawn a new one */
+			if (partid == InvalidOid)
 			{
-				ereport(ERROR,
-						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-						 errmsg("cannot spawn new partition for key '%s'",
-								datum_to_cstring(value, value_type)),
-						 errdetail("default range interval is NULL")));
-			}
+				RangeEntry *ranges = PrelGetRangesArray(prel);
+				Bound		bound_min,			/* absolute MIN */
+					bound_max,			/* absolute MAX */
+					gap_end,			/* MIN of partition after the gap */
+				   *gap_end_ptr = NULL;
+
+				Oid			interval_type = InvalidOid;
+				Datum		interval_binary, /* assigned 'width' of one partition */
+					interval_text;
+
+				/* Copy datums in order to protect them from cache invalidation */
+				bound_min = CopyBound(&ranges[0].min,
+									  prel->ev_byval,
+									  prel->ev_len);
+
+				bound_max = CopyBound(&ranges[PrelLastChild(prel)].max,
+									  prel->ev_byval,
+									  prel->ev_len);
+
+				/* Sparse partitions leave gaps, which we have to fill */
+				if (sparse)
+				{
+					FmgrInfo	cmp_value_bound_finfo;
+					Bound		value_bound = MakeBound(value);
+					uint32		i;
+
+					fill_type_cmp_fmgr_info(&cmp_value_bound_finfo,
+											base_value_type,
+											base_bound_type);
+
+					for (i = 0; i < PrelLastChild(prel); i++)
+					{
+						if (cmp_bounds(&cmp_value_bound_finfo, prel->ev_collid,
+									   &value_bound, &ranges[i].max) >= 0 &&
+							cmp_bounds(&cmp_value_bound_finfo, prel->ev_collid,
+									   &value_bound, &ranges[i + 1].min) < 0)
+						{
+							/* Append partition to the one before the gap */
+							bound_max = CopyBound(&ranges[i].max,
+												  prel->ev_byval,
+												  prel->ev_len);
+
+							gap_end = CopyBound(&ranges[i + 1].min,
+												prel->ev_byval,
+												prel->ev_len);
+							gap_end_ptr = &gap_end;
+							break;
+						}
+					}
+				}
 
-			/* Retrieve interval as TEXT from tuple */
-			interval_text = values[Anum_pathman_config_range_interval - 1];
+				/* Check if interval is set */
+				if (isnull[Anum_pathman_config_range_interval - 1])
+				{
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("cannot spawn new partition for key '%s'",
+									datum_to_cstring(value, value_type)),
+							 errdetail("default range interval is NULL")));
+				}
 
-			/* Convert interval to binary representation */
-			interval_binary = extract_binary_interval_from_text(interval_text,
-																base_bound_type,
-																&interval_type);
+				/* Retrieve interval as TEXT from tuple */
+				interval_text = values[Anum_pathman_config_range_interval - 1];
+
+				/* Convert interval to binary representation */
+				interval_binary = extract_binary_interval_from_text(interval_text,
+																	base_bound_type,
+																	&interval_type);
+
+				/* At last, spawn partitions to store the value */
+				partid = spawn_partitions_val(PrelParentRelid(prel),
+											  &bound_min, &bound_max, base_bound_type,
+											  interval_binary, interval_type,
+											  value, base_value_type,
+											  prel->ev_collid,
+											  sparse, gap_end_ptr,
+											  &retry);
+			}
 
-			/* At last, spawn partitions to store the value */
-			partid = spawn_partitions_val(PrelParentRelid(prel),
-										  &bound_min, &bound_max, base_bound_type,
-										  interval_binary, interval_type,
-										  value, base_value_type,
-										  prel->ev_collid);
+			/* Don't forget to close 'prel'! */
+			close_pathman_relation_info(prel);
 		}
-
-		/* Don't forget to close 'prel'! */
-		close_pathman_relation_info(prel);
+		/* We hold the lock on the parent now, so the next try will succeed */
+		while (retry);
 	}
 	else
 		elog(ERROR, "table \"%s\" is not partitioned",
@@ -477,6 +680,14 @@ create_partitions_for_value_internal(Oid relid, Datum value, Oid value_type)
 /*
  * Append\prepend partitions if there's no partition to store 'value'.
  * NOTE: Used by create_partitions_for_value_internal().
+ *
+ * If 'sparse' is set, only the partition for 'value' is created; 'gap_end'
+ * is the lower bound of the next partition if 'value' falls into a gap
+ * after 'range_bound_max'.
+ *
+ * Sets 'retry' and returns InvalidOid if the caller should look for
+ * partition again, e.g. if partitions of 'parent_relid' don't match
+ * 'range_bound_min' and 'range_bound_max' anymore.
  */
 static Oid
 spawn_partitions_val(Oid parent_relid,				/* parent's Oid */
@@ -487,7 +698,10 @@ spawn_partitions_val(Oid parent_relid,				/* parent's Oid */
 					 Oid interval_type,				/* INTERVALOID or prel->ev_type */
 					 Datum value,					/* value to be INSERTed */
 					 Oid value_type,				/* type of value */
-					 Oid collid)					/* collation id */
+					 Oid collid,					/* collation id */
+					 bool sparse,					/* skip intermediate partitions? */
+					 const Bound *gap_end,			/* next partition or NULL */
+					 bool *retry)					/* start over? */
 {
 	bool		should_append;				/* append or prepend? */
 
@@ -497,12 +711,15 @@ spawn_partitions_val(Oid parent_relid,				/* parent's Oid */
 	FmgrInfo	cmp_value_bound_finfo,		/* exec 'value (>=|<) bound' */
 				move_bound_finfo;			/* exec 'bound + interval' */
 
-	Datum		cur_leading_bound,			/* boundaries of a new partition */
-				cur_following_bound;
+	Datum		cur_leading_bound;			/* last computed boundary */
 
-	Bound		value_bound = MakeBound(value);
+	Datum	   *bounds;						/* boundaries of new partitions */
+	int			nbounds = 0,
+				max_bounds;
+
+	Datum		gap_end_value = gap_end ? BoundGetValue(gap_end) : (Datum) 0;
 
-	Oid			last_partition = InvalidOid;
+	Bound		value_bound = MakeBound(value);
 
 
 	fill_type_cmp_fmgr_info(&cmp_value_bound_finfo, value_type, range_bound_type);
@@ -548,6 +765,12 @@ spawn_partitions_val(Oid parent_relid,				/* parent's Oid */
 											  move_bound_op_ret_type,
 											  NULL); /* might emit ERROR */
 
+		if (gap_end)
+			gap_end_value = perform_type_cast(gap_end_value,
+											  range_bound_type,
+											  move_bound_op_ret_type,
+											  NULL); /* might emit ERROR */
+
 		/* Update 'range_bound_type' */
 		range_bound_type = move_bound_op_ret_type;
 
@@ -571,82 +794,365 @@ spawn_partitions_val(Oid parent_relid,				/* parent's Oid */
 	/* Get operator's underlying function */
 	fmgr_info(move_bound_op_func, &move_bound_finfo);
 
+	/*
+	 * Compute bounds of all partitions up to the one for 'value'.
+	 * In sparse mode we only need the last two of them.
+	 */
+	max_bounds = sparse ? 2 : 16;
+	bounds = palloc(sizeof(Datum) * max_bounds);
+	bounds[nbounds++] = cur_leading_bound;
+
 	/* Execute comparison function cmp(value, cur_leading_bound) */
 	while (should_append ?
 				check_ge(&cmp_value_bound_finfo, collid, value, cur_leading_bound) :
 				check_lt(&cmp_value_bound_finfo, collid, value, cur_leading_bound))
 	{
-		Bound bounds[2];
-		int			rc;
-		bool		isnull;
-		char	   *create_sql;
-		HeapTuple	typeTuple;
-		char	   *typname;
-		Oid			parent_nsp = get_rel_namespace(parent_relid);
-		char	   *parent_nsp_name = get_namespace_name(parent_nsp);
-		char	   *partition_name = choose_range_partition_name(parent_relid, parent_nsp);
-
-		/* Assign the 'following' boundary to current 'leading' value */
-		cur_following_bound = cur_leading_bound;
-
 		/* Move leading bound by interval (exec 'leading (+|-) INTERVAL') */
 		cur_leading_bound = FunctionCall2(&move_bound_finfo,
 										  cur_leading_bound,
 										  interval_binary);
 
-		bounds[0] = MakeBound(should_append ? cur_following_bound : cur_leading_bound);
-		bounds[1] = MakeBound(should_append ? cur_leading_bound : cur_following_bound);
+		/* Skip intermediate partitions if asked to */
+		if (sparse && nbounds == 2)
+		{
+			bounds[0] = bounds[1];
+			nbounds = 1;
+		}
+
+		if (nbounds >= max_bounds)
+		{
+			max_bounds *= 2;
+			bounds = repalloc(bounds, sizeof(Datum) * max_bounds);
+		}
+
+		bounds[nbounds++] = cur_leading_bound;
+	}
 
-		/*
-		 * Instead of directly calling create_single_range_partition_internal()
-		 * we are going to call it through SPI, to make it possible for various
-		 * DDL-replicating extensions to catch that call and do something about
-		 * it. --sk
-		 */
+	if (sparse)
+	{
+		Assert(nbounds == 2);
+
+		/* Don't overlap with the partition which follows the gap */
+		if (gap_end)
+		{
+			FmgrInfo cmp_bounds_finfo;
+
+			fill_type_cmp_fmgr_info(&cmp_bounds_finfo,
+									range_bound_type,
+									range_bound_type);
+
+			if (check_lt(&cmp_bounds_finfo, collid, gap_end_value, bounds[1]))
+				bounds[1] = gap_end_value;
+		}
+	}
+
+	/* Make bounds ascending */
+	if (!should_append)
+	{
+		int i;
+
+		for (i = 0; i < nbounds / 2; i++)
+		{
+			Datum tmp = bounds[i];
 
-		/* Get typname of range_bound_type to perform cast */
-		typeTuple = SearchSysCache1(TYPEOID, ObjectIdGetDatum(range_bound_type));
-		Assert(HeapTupleIsValid(typeTuple));
-		typname = pstrdup(NameStr(((Form_pg_type) GETSTRUCT(typeTuple))->typname));
-		ReleaseSysCache(typeTuple);
-
-		/* Construct call to create_single_range_partition() */
-		create_sql = psprintf(
-			"select %s.create_single_range_partition('%s.%s'::regclass, '%s'::%s, '%s'::%s, '%s.%s', NULL::text)",
-			quote_identifier(get_namespace_name(get_pathman_schema())),
-			quote_identifier(parent_nsp_name),
-			quote_identifier(get_rel_name(parent_relid)),
-			IsInfinite(&bounds[0]) ? "NULL" : datum_to_cstring(bounds[0].value, range_bound_type),
-			typname,
-			IsInfinite(&bounds[1]) ? "NULL" : datum_to_cstring(bounds[1].value, range_bound_type),
-			typname,
-			quote_identifier(parent_nsp_name),
-			quote_identifier(partition_name)
-		);
-
-		/* ...and call it. */
-		SPI_connect();
-		PushActiveSnapshot(GetTransactionSnapshot());
-		rc = SPI_execute(create_sql, false, 0);
-		if (rc <= 0 || SPI_processed != 1)
-			elog(ERROR, "Failed to create range partition");
-		last_partition = DatumGetObjectId(SPI_getbinval(SPI_tuptable->vals[0],
-														SPI_tuptable->tupdesc,
-														1, &isnull));
-		Assert(!isnull);
-		SPI_finish();
-		PopActiveSnapshot();
+			bounds[i] = bounds[nbounds - 1 - i];
+			bounds[nbounds - 1 - i] = tmp;
+		}
+	}
 
 #ifdef USE_ASSERT_CHECKING
-		elog(DEBUG2, "%s partition with following='%s' & leading='%s' [%u]",
-			 (should_append ? "Appending" : "Prepending"),
-			 DebugPrintDatum(cur_following_bound, range_bound_type),
-			 DebugPrintDatum(cur_leading_bound, range_bound_type),
-			 MyProcPid);
+	elog(DEBUG2, "%s %d partition(s) between '%s' and '%s' [%u]",
+		 (should_append ? "Appending" : "Prepending"),
+		 nbounds - 1,
+		 DebugPrintDatum(bounds[0], range_bound_type),
+		 DebugPrintDatum(bounds[nbounds - 1], range_bound_type),
+		 MyProcPid);
 #endif
+
+	if (nbounds == 2)
+		return spawn_single_partition(parent_relid,
+									  bounds[0], bounds[1],
+									  range_bound_type,
+									  retry);
+	else
+		return spawn_partitions_bulk(parent_relid,
+									 bounds, nbounds,
+									 range_bound_type,
+									 retry);
+}
+
+/*
+ * Create RANGE partition [start, end) unless another backend
+ * has just done it. NOTE: Used by spawn_partitions_val().
+ */
+static Oid
+spawn_single_partition(Oid parent_relid,
+					   Datum start,
+					   Datum end,
+					   Oid bounds_type,
+					   bool *retry)
+{
+	Bound		bounds[2];
+	int			rc;
+	bool		isnull;
+	char	   *create_sql;
+	HeapTuple	typeTuple;
+	char	   *typname;
+	char	   *range_name;
+	Oid			partid;
+	Oid			parent_nsp = get_rel_namespace(parent_relid);
+	char	   *parent_nsp_name = get_namespace_name(parent_nsp);
+	char	   *partition_name;
+
+	bounds[0] = MakeBound(start);
+	bounds[1] = MakeBound(end);
+
+	range_name = spawned_range_name(&bounds[0], &bounds[1], bounds_type);
+
+	/*
+	 * Wait for backends which are creating the same partition,
+	 * unless we hold the lock on parent (they can't proceed anyway).
+	 */
+	if (!xact_spawn_lock_held(parent_relid))
+	{
+		xact_lock_spawn_range(parent_relid,
+							  DatumGetUInt32(hash_any((unsigned char *) range_name,
+													  strlen(range_name))));
+
+		/* Maybe one of them has just created it for us */
+		partid = find_spawned_partition(parent_relid, range_name);
+		if (OidIsValid(partid))
+			return partid;
 	}
 
-	return last_partition;
+	/*
+	 * Prevent modifications of partitioning scheme (CREATE TABLE would
+	 * take this lock anyway) and check that nobody has outrun us,
+	 * e.g. by calling append_range_partition().
+	 */
+	xact_lock_rel(parent_relid, ShareUpdateExclusiveLock, false);
+	if (!check_range_available(parent_relid, &bounds[0], &bounds[1],
+							   bounds_type, false))
+	{
+		*retry = true;
+		return InvalidOid;
+	}
+
+	partition_name = choose_range_partition_name(parent_relid, parent_nsp);
+
+	/*
+	 * Instead of directly calling create_single_range_partition_internal()
+	 * we are going to call it through SPI, to make it possible for various
+	 * DDL-replicating extensions to catch that call and do something about
+	 * it. --sk
+	 */
+
+	/* Get typname of bounds_type to perform cast */
+	typeTuple = SearchSysCache1(TYPEOID, ObjectIdGetDatum(bounds_type));
+	Assert(HeapTupleIsValid(typeTuple));
+	typname = pstrdup(NameStr(((Form_pg_type) GETSTRUCT(typeTuple))->typname));
+	ReleaseSysCache(typeTuple);
+
+	/* Construct call to create_single_range_partition() */
+	create_sql = psprintf(
+		"select %s.create_single_range_partition('%s.%s'::regclass, '%s'::%s, '%s'::%s, '%s.%s', NULL::text)",
+		quote_identifier(get_namespace_name(get_pathman_schema())),
+		quote_identifier(parent_nsp_name),
+		quote_identifier(get_rel_name(parent_relid)),
+		datum_to_cstring(start, bounds_type),
+		typname,
+		datum_to_cstring(end, bounds_type),
+		typname,
+		quote_identifier(parent_nsp_name),
+		quote_identifier(partition_name)
+	);
+
+	/* ...and call it. */
+	SPI_connect();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	rc = SPI_execute(create_sql, false, 0);
+	if (rc <= 0 || SPI_processed != 1)
+		elog(ERROR, "Failed to create range partition");
+	partid = DatumGetObjectId(SPI_getbinval(SPI_tuptable->vals[0],
+											SPI_tuptable->tupdesc,
+											1, &isnull));
+	Assert(!isnull);
+	SPI_finish();
+	PopActiveSnapshot();
+
+	/* Let backends waiting for this range know about it */
+	remember_spawned_partition(parent_relid, range_name, partid);
+
+	return partid;
+}
+
+/*
+ * Create RANGE partitions [bounds[0], bounds[1]), ... at once.
+ * NOTE: Used by spawn_partitions_val().
+ *
+ * Always sets 'retry', since caller will have to find the partition
+ * for its value anyway. This way PartRelationInfo is rebuilt only once.
+ *
+ * NOTE: partitions are created by a single create_range_partitions_internal()
+ * call, so DDL-replicating extensions which catch the calls of
+ * create_single_range_partition() won't see them one by one.
+ */
+static Oid
+spawn_partitions_bulk(Oid parent_relid,
+					  Datum *bounds,
+					  int nbounds,
+					  Oid bounds_type,
+					  bool *retry)
+{
+	Bound		first = MakeBound(bounds[0]),
+				last = MakeBound(bounds[nbounds - 1]);
+	int16		typlen;
+	bool		typbyval;
+	char		typalign;
+	Oid			argtypes[2];
+	Datum		args[2];
+	char	   *create_sql;
+	int			rc;
+
+	/* There might be lots of ranges, so we don't lock each of them */
+	xact_lock_rel(parent_relid, ShareUpdateExclusiveLock, false);
+	if (!check_range_available(parent_relid, &first, &last,
+							   bounds_type, false))
+	{
+		*retry = true;
+		return InvalidOid;
+	}
+
+	argtypes[0] = REGCLASSOID;
+	argtypes[1] = get_array_type(bounds_type);
+	if (!OidIsValid(argtypes[1]))
+		elog(ERROR, "could not find array type for %s",
+			 format_type_be(bounds_type));
+
+	get_typlenbyvalalign(bounds_type, &typlen, &typbyval, &typalign);
+
+	args[0] = ObjectIdGetDatum(parent_relid);
+	args[1] = PointerGetDatum(construct_array(bounds, nbounds, bounds_type,
+											  typlen, typbyval, typalign));
+
+	/* Same as in spawn_single_partition(), use SPI */
+	create_sql = psprintf("select %s.create_range_partitions_internal($1, $2, NULL, NULL)",
+						  quote_identifier(get_namespace_name(get_pathman_schema())));
+
+	SPI_connect();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	rc = SPI_execute_with_args(create_sql, 2, argtypes, args, NULL, false, 0);
+	if (rc != SPI_OK_SELECT)
+		elog(ERROR, "Failed to create range partitions");
+	SPI_finish();
+	PopActiveSnapshot();
+
+	*retry = true;
+	return InvalidOid;
+}
+
+/*
+ * -------------------------------------
+ *  Recently spawned partitions (shmem)
+ * -------------------------------------
+ */
+
+/*
+ * Estimate amount of shmem needed for recently spawned partitions.
+ */
+Size
+estimate_spawned_partitions_size(void)
+{
+	return sizeof(SpawnedPartitions);
+}
+
+/*
+ * Initialize shared memory needed for recently spawned partitions.
+ */
+void
+init_spawned_partitions(void)
+{
+	bool	found;
+
+	spawned_partitions = (SpawnedPartitions *)
+			ShmemInitStruct("pg_pathman's recently spawned partitions",
+							sizeof(SpawnedPartitions), &found);
+
+	if (!found)
+	{
+		memset(spawned_partitions, 0, sizeof(SpawnedPartitions));
+		SpinLockInit(&spawned_partitions->mutex);
+	}
+}
+
+/* Build a string which identifies range [start, end) */
+static char *
+spawned_range_name(const Bound *start, const Bound *end, Oid value_type)
+{
+	return psprintf("%s:%s",
+					BoundToCString(start, value_type),
+					BoundToCString(end, value_type));
+}
+
+/*
+ * Find a partition recently spawned by another backend.
+ * NOTE: caller should hold the lock on range, so that creator's
+ * transaction is already over.
+ */
+static Oid
+find_spawned_partition(Oid parent_relid, const char *range_name)
+{
+	Oid		partition_relid = InvalidOid;
+	int		i;
+
+	SpinLockAcquire(&spawned_partitions->mutex);
+
+	for (i = 0; i < SPAWNED_PARTITIONS_SIZE; i++)
+	{
+		SpawnedPartition *part = &spawned_partitions->parts[i];
+
+		if (part->dbid == MyDatabaseId &&
+			part->parent_relid == parent_relid &&
+			strcmp(part->range_name, range_name) == 0)
+		{
+			partition_relid = part->partition_relid;
+			break;
+		}
+	}
+
+	SpinLockRelease(&spawned_partitions->mutex);
+
+	/* Creator might have rolled back, or partition might have been dropped */
+	if (OidIsValid(partition_relid) &&
+		get_parent_of_partition(partition_relid) != parent_relid)
+		partition_relid = InvalidOid;
+
+	return partition_relid;
+}
+
+/* Publish a partition spawned by current backend */
+static void
+remember_spawned_partition(Oid parent_relid, const char *range_name,
+						   Oid partition_relid)
+{
+	SpawnedPartition *part;
+
+	/* Waiting backends will have to check PartRelationInfo */
+	if (strlen(range_name) >= SPAWNED_RANGE_NAME_LEN)
+		return;
+
+	SpinLockAcquire(&spawned_partitions->mutex);
+
+	/* Overwrite the oldest entry */
+	part = &spawned_partitions->parts[spawned_partitions->next];
+	spawned_partitions->next = (spawned_partitions->next + 1) % SPAWNED_PARTITIONS_SIZE;
+
+	part->dbid = MyDatabaseId;
+	part->parent_relid = parent_relid;
+	part->partition_relid = partition_relid;
+	strcpy(part->range_name, range_name);
+
+	SpinLockRelease(&spawned_partitions->mutex);
 }
 
 /* Choose a good name for a RANGE partition */
@@ -10,6 +10,7 @@
 
 #include "compat/pg_compat.h"
 #include "init.h"
+#include "multi_insert.h"
 #include "nodes_common.h"
 #include "pathman.h"
 #include "partition_creation.h"
@@ -26,15 +27,23 @@
 #include "catalog/pg_type.h"
 #include "foreign/fdwapi.h"
 #include "foreign/foreign.h"
+#include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
+#if PG_VERSION_NUM < 100000
+#include "optimizer/clauses.h"
+#endif
 #if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
 #include "parser/parse_relation.h"
 #endif
 #include "rewrite/rewriteManip.h"
+#include "executor/executor.h"
 #include "utils/guc.h"
+#include "utils/inval.h"
 #include "utils/memutils.h"
 #include "utils/syscache.h"
 
+#include <limits.h>
+
 
 #define ALLOC_EXP	2
 
@@ -53,6 +62,39 @@ typedef struct
 	bool	estate_not_modified;		/* did we modify EState somehow? */
 } estate_mod_data;
 
+/*
+ * Metadata of a partition which doesn't depend on a statement, so that
+ * the first access to a partition in scan_result_parts_storage() is cheap.
+ * Entry is removed on relcache invalidation of the partition (schema
+ * changes of parent are propagated to partitions as well).
+ */
+typedef struct
+{
+	Oid					partid;				/* key */
+	Oid					parent_relid;		/* entry was built for this parent */
+	bool				valid;				/* false if invalidated while pinned */
+
+	List			   *translated_vars;	/* see make_inh_translation_list() */
+	bool				tuple_map_needed;	/* do row types differ? */
+
+	/* Last successful permission check (reset on changes of roles) */
+	bool				perms_checked;
+	Oid					checked_userid;
+	AclMode				checked_perms;
+	Bitmapset		   *checked_inserted_cols;
+	Bitmapset		   *checked_updated_cols;
+} PartitionTemplate;
+
+/*
+ * Tuples of a partitioned table waiting for a BGW to create partitions.
+ */
+typedef struct
+{
+	Oid					parent_relid;
+	SpawnPartitionsTask *task;
+	Tuplestorestate	   *rows;
+} PendingSpawn;
+
 /*
  * Allow INSERTs into any FDW \ postgres_fdw \ no FDWs at all.
  */
@@ -72,12 +114,23 @@ static const struct config_enum_entry pg_pathman_insert_into_fdw_options[] = {
 
 
 bool				pg_pathman_enable_partition_filter = true;
+bool				pg_pathman_enable_batch_inserts = false;
+bool				pg_pathman_enable_async_spawn = false;
 int					pg_pathman_insert_into_fdw = PF_FDW_INSERT_POSTGRES;
+int					pg_pathman_max_open_partitions = 0;
 
 CustomScanMethods	partition_filter_plan_methods;
 CustomExecMethods	partition_filter_exec_methods;
 
 
+/* Cache of PartitionTemplates (partition relid -> template) */
+static HTAB				   *partition_templates = NULL;
+static MemoryContext		PartitionTemplatesContext = NULL;
+
+/* Template used by scan_result_parts_storage() right now */
+static PartitionTemplate   *pinned_template = NULL;
+
+
 static ExprState *prepare_expr_state(const PartRelationInfo *prel,
 									 Relation source_rel,
 									 EState *estate);
@@ -93,12 +146,41 @@ static void prepare_rri_fdw_for_insert(ResultRelInfoHolder *rri_holder,
 
 static Node *fix_returning_list_mutator(Node *node, void *state);
 
+static bool defer_spawn_for_insert(ResultPartsStorage *parts_storage,
+								   Oid parent_relid,
+								   Datum value,
+								   Oid value_type,
+								   TupleTableSlot *slot,
+								   void *arg);
+static TupleTableSlot *partition_filter_fetch_tuple(PartitionFilterState *state,
+													PlanState *child_ps);
+static TupleTableSlot *partition_filter_route_tuple(CustomScanState *node,
+													ResultRelInfoHolder **rri_holder_out);
+
 static Index append_rte_to_estate(EState *estate, RangeTblEntry *rte, Relation child_rel);
 static int append_rri_to_estate(EState *estate, ResultRelInfo *rri);
+static void replace_rel_in_estate(EState *estate, Index rti, Relation child_rel);
+static void replace_rri_in_estate(EState *estate, ResultRelInfo *rri, int rri_index);
 
 static void pf_memcxt_callback(void *arg);
 static estate_mod_data * fetch_estate_mod_data(EState *estate);
 
+static void prepare_first_touch(ResultPartsStorage *parts_storage);
+static void evict_result_parts_storage(ResultPartsStorage *parts_storage);
+static void close_rri_holder(ResultPartsStorage *parts_storage,
+							 ResultRelInfoHolder *rri_holder);
+static void prepare_rri_constraints(ResultRelInfo *rri, EState *estate,
+									MemoryContext mcxt);
+
+static PartitionTemplate *find_partition_template(Oid partid, Oid parent_relid);
+static PartitionTemplate *store_partition_template(Oid partid, Oid parent_relid,
+												   List *translated_vars,
+												   bool tuple_map_needed);
+static void remove_partition_template(PartitionTemplate *tmpl);
+static void unpin_partition_template(void);
+static void partition_templates_syscache_hook(Datum arg, int cacheid,
+											  uint32 hashvalue);
+
 
 void
 init_partition_filter_static_data(void)
@@ -126,6 +208,30 @@ init_partition_filter_static_data(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("pg_pathman.enable_batch_inserts",
+							 "Enables batched insertion of tuples into partitions by "
+							 INSERT_NODE_NAME " custom node.",
+							 NULL,
+							 &pg_pathman_enable_batch_inserts,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("pg_pathman.enable_async_spawn",
+							 "Lets " INSERT_NODE_NAME " insert other tuples while "
+							 "new partitions are being created by BGW.",
+							 NULL,
+							 &pg_pathman_enable_async_spawn,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomEnumVariable("pg_pathman.insert_into_fdw",
 							 "Allow INSERTS into FDW partitions.",
 							 NULL,
@@ -138,7 +244,219 @@ init_partition_filter_static_data(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomIntVariable("pg_pathman.max_open_partitions",
+							"Max number of partitions kept open by COPY FROM (0 means no limit).",
+							NULL,
+							&pg_pathman_max_open_partitions,
+							0,
+							0, INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	RegisterCustomScanMethods(&partition_filter_plan_methods);
+
+	/* Cached permission checks might depend on role memberships */
+	CacheRegisterSyscacheCallback(AUTHOID,
+								  partition_templates_syscache_hook,
+								  PointerGetDatum(NULL));
+	CacheRegisterSyscacheCallback(AUTHMEMROLEMEM,
+								  partition_templates_syscache_hook,
+								  PointerGetDatum(NULL));
+}
+
+
+/*
+ * ---------------------
+ *  Partition templates
+ * ---------------------
+ */
+
+/* Find a valid template of partition built for 'parent_relid' */
+static PartitionTemplate *
+find_partition_template(Oid partid, Oid parent_relid)
+{
+	PartitionTemplate *tmpl;
+
+	if (!partition_templates)
+		return NULL;
+
+	tmpl = (PartitionTemplate *) hash_search(partition_templates,
+											 (const void *) &partid,
+											 HASH_FIND, NULL);
+
+	if (!tmpl || !tmpl->valid || tmpl->parent_relid != parent_relid)
+		return NULL;
+
+	/* Invalidation must not free it while we're using it */
+	pinned_template = tmpl;
+
+	return tmpl;
+}
+
+/* Create (or rebuild) template of partition */
+static PartitionTemplate *
+store_partition_template(Oid partid, Oid parent_relid,
+						 List *translated_vars,
+						 bool tuple_map_needed)
+{
+	PartitionTemplate  *tmpl;
+	MemoryContext		old_mcxt;
+	bool				found;
+
+	if (!partition_templates)
+	{
+		HASHCTL ctl;
+
+		PartitionTemplatesContext =
+				AllocSetContextCreate(TopPathmanContext,
+									  "partition templates cache",
+									  ALLOCSET_DEFAULT_SIZES);
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(PartitionTemplate);
+		ctl.hcxt = PartitionTemplatesContext;
+
+		partition_templates = hash_create("partition templates cache",
+										  PART_RELS_SIZE * CHILD_FACTOR, &ctl,
+										  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	tmpl = (PartitionTemplate *) hash_search(partition_templates,
+											 (const void *) &partid,
+											 HASH_ENTER, &found);
+
+	/* Entry might have been invalidated while pinned */
+	if (found)
+	{
+		remove_partition_template(tmpl);
+		tmpl = (PartitionTemplate *) hash_search(partition_templates,
+												 (const void *) &partid,
+												 HASH_ENTER, NULL);
+	}
+
+	old_mcxt = MemoryContextSwitchTo(PartitionTemplatesContext);
+
+	tmpl->parent_relid = parent_relid;
+	tmpl->valid = true;
+	tmpl->translated_vars = copyObject(translated_vars);
+	tmpl->tuple_map_needed = tuple_map_needed;
+	tmpl->perms_checked = false;
+	tmpl->checked_userid = InvalidOid;
+	tmpl->checked_perms = 0;
+	tmpl->checked_inserted_cols = NULL;
+	tmpl->checked_updated_cols = NULL;
+
+	MemoryContextSwitchTo(old_mcxt);
+
+	pinned_template = tmpl;
+
+	return tmpl;
+}
+
+/* Free template and remove it from cache */
+static void
+remove_partition_template(PartitionTemplate *tmpl)
+{
+	ListCell *lc;
+
+	if (tmpl == pinned_template)
+		pinned_template = NULL;
+
+	/* NOTE: dropped columns are represented by NULLs */
+	foreach (lc, tmpl->translated_vars)
+	{
+		if (lfirst(lc))
+			pfree(lfirst(lc));
+	}
+	list_free(tmpl->translated_vars);
+
+	bms_free(tmpl->checked_inserted_cols);
+	bms_free(tmpl->checked_updated_cols);
+
+	hash_search(partition_templates,
+				(const void *) &tmpl->partid,
+				HASH_REMOVE, NULL);
+}
+
+/* Template is not used anymore, remove it if it's been invalidated */
+static void
+unpin_partition_template(void)
+{
+	PartitionTemplate *tmpl = pinned_template;
+
+	pinned_template = NULL;
+
+	if (tmpl && !tmpl->valid)
+		remove_partition_template(tmpl);
+}
+
+/* Forget template of a partition (relcache invalidation) */
+void
+forget_partition_template(Oid partid)
+{
+	PartitionTemplate *tmpl;
+
+	if (!partition_templates)
+		return;
+
+	tmpl = (PartitionTemplate *) hash_search(partition_templates,
+											 (const void *) &partid,
+											 HASH_FIND, NULL);
+
+	if (tmpl == NULL)
+		return;
+	else if (tmpl == pinned_template)
+		tmpl->valid = false;
+	else
+		remove_partition_template(tmpl);
+}
+
+/* Forget all templates */
+void
+invalidate_partition_templates(void)
+{
+	HASH_SEQ_STATUS		status;
+	PartitionTemplate  *tmpl;
+
+	if (!partition_templates)
+		return;
+
+	/* Fast path: nobody is using templates right now */
+	if (!pinned_template)
+	{
+		MemoryContextDelete(PartitionTemplatesContext);
+		PartitionTemplatesContext = NULL;
+		partition_templates = NULL;
+		return;
+	}
+
+	hash_seq_init(&status, partition_templates);
+	while ((tmpl = (PartitionTemplate *) hash_seq_search(&status)) != NULL)
+	{
+		if (tmpl == pinned_template)
+			tmpl->valid = false;
+		else
+			remove_partition_template(tmpl);
+	}
+}
+
+/* Roles have changed, forget all cached permission checks */
+static void
+partition_templates_syscache_hook(Datum arg, int cacheid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS		status;
+	PartitionTemplate  *tmpl;
+
+	if (!partition_templates)
+		return;
+
+	hash_seq_init(&status, partition_templates);
+	while ((tmpl = (PartitionTemplate *) hash_seq_search(&status)) != NULL)
+		tmpl->perms_checked = false;
 }
 
 
@@ -207,6 +525,25 @@ init_result_parts_storage(ResultPartsStorage *parts_storage,
 
 	/* Build expression context */
 	parts_storage->prel_econtext = CreateExprContext(parts_storage->estate);
+
+	/* See prepare_first_touch() */
+	parts_storage->first_touch_ready = false;
+
+	/* Executor closes relations on its own, so they can't be evicted */
+	parts_storage->max_open_partitions = close_relations ?
+											pg_pathman_max_open_partitions :
+											0;
+	dlist_init(&parts_storage->lru_list);
+	parts_storage->free_rt_indexes = NIL;
+	parts_storage->free_rri_indexes = NIL;
+	parts_storage->partitions_opened = 0;
+	parts_storage->partitions_evicted = 0;
+
+	parts_storage->evict_rri_holder_cb = NULL;
+	parts_storage->evict_rri_holder_cb_arg = NULL;
+
+	parts_storage->defer_cb = NULL;
+	parts_storage->defer_cb_arg = NULL;
 }
 
 /* Free ResultPartsStorage (close relations etc) */
@@ -218,38 +555,7 @@ fini_result_parts_storage(ResultPartsStorage *parts_storage)
 
 	hash_seq_init(&stat, parts_storage->result_rels_table);
 	while ((rri_holder = (ResultRelInfoHolder *) hash_seq_search(&stat)) != NULL)
-	{
-		/* Call finalization callback if needed */
-		if (parts_storage->fini_rri_holder_cb)
-			parts_storage->fini_rri_holder_cb(rri_holder, parts_storage);
-
-		/*
-		 * Close indices, unless ExecEndPlan won't do that for us (this is
-		 * is CopyFrom which misses it, not usual executor run, essentially).
-		 * Otherwise, it is always automaticaly closed; in <= 11, relcache
-		 * refs of rris managed heap_open/close on their own, and ExecEndPlan
-		 * closed them directly. Since 9ddef3, relcache management
-		 * of executor was centralized; now rri refs are copies of ones in
-		 * estate->es_relations, which are closed in ExecEndPlan.
-		 * So we push our rel there, and it is also automatically closed.
-		 */
-		if (parts_storage->close_relations)
-		{
-			ExecCloseIndices(rri_holder->result_rel_info);
-			/* And relation itself */
-			heap_close_compat(rri_holder->result_rel_info->ri_RelationDesc,
-				   NoLock);
-		}
-
-		/* Free conversion-related stuff */
-		destroy_tuple_map(rri_holder->tuple_map);
-
-		destroy_tuple_map(rri_holder->tuple_map_child);
-
-		/* Don't forget to close 'prel'! */
-		if (rri_holder->prel)
-			close_pathman_relation_info(rri_holder->prel);
-	}
+		close_rri_holder(parts_storage, rri_holder);
 
 	/* Finally destroy hash table */
 	hash_destroy(parts_storage->result_rels_table);
@@ -273,97 +579,253 @@ scan_result_parts_storage(EState *estate, ResultPartsStorage *parts_storage,
 							 (const void *) &partid,
 							 HASH_FIND, &found);
 
+	/* Partition has been used just now, keep it open */
+	if (found && rri_holder->evictable)
+	{
+		dlist_delete(&rri_holder->lru_node);
+		dlist_push_head(&parts_storage->lru_list, &rri_holder->lru_node);
+	}
+
 	/* If not found, create & cache new ResultRelInfo */
 	if (!found)
 	{
-		Relation		child_rel,
-						base_rel;
-		RangeTblEntry  *child_rte,
-					   *parent_rte;
-		Index			child_rte_idx;
-		ResultRelInfo  *child_result_rel_info;
-		List		   *translated_vars;
-		MemoryContext	old_mcxt;
+		Relation			child_rel,
+							base_rel;
+		RangeTblEntry	   *child_rte,
+						   *parent_rte;
+		Index				child_rte_idx;
+		ResultRelInfo	   *child_result_rel_info;
+		PartitionTemplate  *tmpl = NULL;
+		List			   *translated_vars;
+		Bitmapset		   *inserted_cols,
+						   *updated_cols;
+		AclMode				required_perms;
+		Oid					userid;
+		MemoryContext		old_mcxt,
+							holder_mcxt;
+		bool				reuse_slot;
 #if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
-		RTEPermissionInfo *parent_perminfo,
-						  *child_perminfo;
-		/* ResultRelInfo of partitioned table. */
-		RangeTblEntry  *init_rte;
+		RTEPermissionInfo  *parent_perminfo,
+						   *child_perminfo;
 #endif
 
-		/* Lock partition and check if it exists */
+		/* Compute things which are the same for all partitions */
+		if (!parts_storage->first_touch_ready)
+			prepare_first_touch(parts_storage);
+
+		parent_rte = parts_storage->parent_rte;
+		base_rel = parts_storage->base_rri->ri_RelationDesc;
+
+		/* Lock partition */
 		LockRelationOid(partid, parts_storage->head_open_lock_mode);
-		if (!SearchSysCacheExists1(RELOID, ObjectIdGetDatum(partid)))
+
+		/* Previous user might have failed to unpin the template */
+		unpin_partition_template();
+
+		/*
+		 * If partition has been dropped, invalidation has already
+		 * removed its template. Otherwise check if it still exists.
+		 */
+		if (parts_storage->use_templates)
+			tmpl = find_partition_template(partid, RelationGetRelid(base_rel));
+
+		if (!tmpl && !SearchSysCacheExists1(RELOID, ObjectIdGetDatum(partid)))
 		{
 			UnlockRelationOid(partid, parts_storage->head_open_lock_mode);
 			return NULL;
 		}
 
-		/* Switch to query-level mcxt for allocations */
-		old_mcxt = MemoryContextSwitchTo(parts_storage->estate->es_query_cxt);
+		/* Make room for this partition if there are too many of them */
+		if (parts_storage->max_open_partitions > 0 &&
+			hash_get_num_entries(parts_storage->result_rels_table) >=
+				parts_storage->max_open_partitions)
+			evict_result_parts_storage(parts_storage);
 
 		/* Create a new cache entry for this partition */
 		rri_holder = hash_search(parts_storage->result_rels_table,
 								 (const void *) &partid,
 								 HASH_ENTER, NULL);
 
-		parent_rte = rt_fetch(parts_storage->base_rri->ri_RangeTableIndex,
-							  parts_storage->estate->es_range_table);
+		/* Partition which might be evicted is freed along with its mcxt */
+		if (parts_storage->max_open_partitions > 0)
+		{
+			rri_holder->mcxt = AllocSetContextCreate(estate->es_query_cxt,
+													 "ResultRelInfoHolder",
+													 ALLOCSET_SMALL_SIZES);
+			holder_mcxt = rri_holder->mcxt;
+		}
+		else
+		{
+			rri_holder->mcxt = NULL;
+			holder_mcxt = estate->es_query_cxt;
+		}
+
+		/* Take EState slots of an evicted partition if there are any */
+		reuse_slot = (parts_storage->free_rt_indexes != NIL);
 
-		/* Get base relation */
-		base_rel = parts_storage->base_rri->ri_RelationDesc;
+		/* Switch to holder's mcxt for allocations */
+		old_mcxt = MemoryContextSwitchTo(holder_mcxt);
 
 		/* Open child relation and check if it is a valid target */
 		child_rel = heap_open_compat(partid, NoLock);
 
-		/* Create RangeTblEntry for partition */
-		child_rte = makeNode(RangeTblEntry);
+		/* Create RangeTblEntry for partition (it lives until end of query) */
+		if (reuse_slot)
+		{
+			child_rte_idx = linitial_int(parts_storage->free_rt_indexes);
+			child_rte = rt_fetch(child_rte_idx, estate->es_range_table);
+		}
+		else
+		{
+			child_rte_idx = 0; /* keep compiler happy */
+
+			MemoryContextSwitchTo(estate->es_query_cxt);
+			child_rte = makeNode(RangeTblEntry);
+			MemoryContextSwitchTo(holder_mcxt);
+		}
 		child_rte->rtekind			= RTE_RELATION;
 		child_rte->relid			= partid;
 		child_rte->relkind			= child_rel->rd_rel->relkind;
 		child_rte->eref				= parent_rte->eref;
-#if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
+
 		/* Build Var translation list for 'inserted_cols' */
-		make_inh_translation_list(parts_storage->init_rri->ri_RelationDesc,
-								  child_rel, 0, &translated_vars, NULL);
+		if (tmpl)
+			translated_vars = tmpl->translated_vars;
+		else
+			make_inh_translation_list(parts_storage->translation_rel,
+									  child_rel, 0, &translated_vars, NULL);
 
+#if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
 		/*
 		 * Need to use ResultRelInfo of partitioned table 'init_rri' because
 		 * 'base_rri' can be ResultRelInfo of partition without any
 		 * ResultRelInfo, see expand_single_inheritance_child().
 		 */
-		init_rte = rt_fetch(parts_storage->init_rri->ri_RangeTableIndex,
-							parts_storage->estate->es_range_table);
-		parent_perminfo = getRTEPermissionInfo(estate->es_rteperminfos, init_rte);
+		parent_perminfo = parts_storage->parent_perminfo;
 
-		child_rte->perminfoindex = 0;	/* expected by addRTEPermissionInfo() */
-		child_perminfo = addRTEPermissionInfo(&estate->es_rteperminfos, child_rte);
-		child_perminfo->requiredPerms	= parent_perminfo->requiredPerms;
+		inserted_cols = translate_col_privs(parent_perminfo->insertedCols,
+											translated_vars);
+		updated_cols = translate_col_privs(parent_perminfo->updatedCols,
+										   translated_vars);
+		required_perms = parent_perminfo->requiredPerms;
+		userid = OidIsValid(parent_perminfo->checkAsUser) ?
+					parent_perminfo->checkAsUser :
+					GetUserId();
+
+		MemoryContextSwitchTo(estate->es_query_cxt);
+
+		if (reuse_slot)
+			child_perminfo = getRTEPermissionInfo(estate->es_rteperminfos, child_rte);
+		else
+		{
+			child_rte->perminfoindex = 0;	/* expected by addRTEPermissionInfo() */
+			child_perminfo = addRTEPermissionInfo(&estate->es_rteperminfos, child_rte);
+		}
+
+		bms_free(child_perminfo->insertedCols);
+		bms_free(child_perminfo->updatedCols);
+
+		child_perminfo->requiredPerms	= required_perms;
 		child_perminfo->checkAsUser		= parent_perminfo->checkAsUser;
-		child_perminfo->insertedCols	= translate_col_privs(parent_perminfo->insertedCols,
-															  translated_vars);
-		child_perminfo->updatedCols		= translate_col_privs(parent_perminfo->updatedCols,
-															  translated_vars);
+		child_perminfo->insertedCols	= bms_copy(inserted_cols);
+		child_perminfo->updatedCols		= bms_copy(updated_cols);
 
-		/* Check permissions for one partition */
-		ExecCheckOneRtePermissions(child_rte, child_perminfo, true);
+		MemoryContextSwitchTo(holder_mcxt);
 #else
-		/* Build Var translation list for 'inserted_cols' */
-		make_inh_translation_list(base_rel, child_rel, 0, &translated_vars, NULL);
+		inserted_cols = translate_col_privs(parent_rte->insertedCols,
+											translated_vars);
+		updated_cols = translate_col_privs(parent_rte->updatedCols,
+										   translated_vars);
+		required_perms = parent_rte->requiredPerms;
+		userid = OidIsValid(parent_rte->checkAsUser) ?
+					parent_rte->checkAsUser :
+					GetUserId();
+
+		MemoryContextSwitchTo(estate->es_query_cxt);
+
+		bms_free(child_rte->insertedCols);
+		bms_free(child_rte->updatedCols);
 
-		child_rte->requiredPerms	= parent_rte->requiredPerms;
+		child_rte->requiredPerms	= required_perms;
 		child_rte->checkAsUser		= parent_rte->checkAsUser;
-		child_rte->insertedCols		= translate_col_privs(parent_rte->insertedCols,
-														  translated_vars);
-		child_rte->updatedCols		= translate_col_privs(parent_rte->updatedCols,
-														  translated_vars);
+		child_rte->insertedCols		= bms_copy(inserted_cols);
+		child_rte->updatedCols		= bms_copy(updated_cols);
 
-		/* Check permissions for partition */
-		ExecCheckRTPerms(list_make1(child_rte), true);
+		MemoryContextSwitchTo(holder_mcxt);
+#endif
+
+		/* Check permissions for partition (unless it's been done before) */
+		if (!(tmpl && tmpl->perms_checked &&
+			  ExecutorCheckPerms_hook == NULL &&
+			  tmpl->checked_userid == userid &&
+			  (required_perms & ~tmpl->checked_perms) == 0 &&
+			  bms_is_subset(inserted_cols, tmpl->checked_inserted_cols) &&
+			  bms_is_subset(updated_cols, tmpl->checked_updated_cols)))
+		{
+#if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
+			ExecCheckOneRtePermissions(child_rte, child_perminfo, true);
+#else
+			ExecCheckRTPerms(list_make1(child_rte), true);
 #endif
 
-		/* Append RangeTblEntry to estate->es_range_table */
-		child_rte_idx = append_rte_to_estate(parts_storage->estate, child_rte, child_rel);
+			/* Remember successful check */
+			if (parts_storage->use_templates)
+			{
+				/*
+				 * Generate parent->child tuple transformation map. We need to
+				 * convert tuples because e.g. parent's TupleDesc might have
+				 * dropped columns which child doesn't have at all because it
+				 * was created after the drop.
+				 */
+				if (!tmpl)
+				{
+					rri_holder->tuple_map = build_part_tuple_map(base_rel, child_rel);
+					tmpl = store_partition_template(partid,
+													RelationGetRelid(base_rel),
+													translated_vars,
+													rri_holder->tuple_map != NULL);
+				}
+				else if (tmpl->tuple_map_needed)
+					rri_holder->tuple_map = build_part_tuple_map(base_rel, child_rel);
+				else
+					rri_holder->tuple_map = NULL;
+
+				MemoryContextSwitchTo(PartitionTemplatesContext);
+
+				bms_free(tmpl->checked_inserted_cols);
+				bms_free(tmpl->checked_updated_cols);
+
+				tmpl->perms_checked = true;
+				tmpl->checked_userid = userid;
+				tmpl->checked_perms = required_perms;
+				tmpl->checked_inserted_cols = bms_copy(inserted_cols);
+				tmpl->checked_updated_cols = bms_copy(updated_cols);
+
+				MemoryContextSwitchTo(holder_mcxt);
+			}
+			else rri_holder->tuple_map = build_part_tuple_map(base_rel, child_rel);
+		}
+
+		/* We've already checked permissions */
+		else if (tmpl->tuple_map_needed)
+			rri_holder->tuple_map = build_part_tuple_map(base_rel, child_rel);
+		else
+			rri_holder->tuple_map = NULL;
+
+		/* We don't need template anymore */
+		unpin_partition_template();
+
+		/* Append RangeTblEntry to estate->es_range_table (or reuse it) */
+		MemoryContextSwitchTo(estate->es_query_cxt);
+		if (reuse_slot)
+		{
+			parts_storage->free_rt_indexes =
+					list_delete_first(parts_storage->free_rt_indexes);
+			replace_rel_in_estate(estate, child_rte_idx, child_rel);
+		}
+		else
+			child_rte_idx = append_rte_to_estate(estate, child_rte, child_rel);
+		MemoryContextSwitchTo(holder_mcxt);
 
 		/* Create ResultRelInfo for partition */
 		child_result_rel_info = makeNode(ResultRelInfo);
@@ -398,6 +860,11 @@ scan_result_parts_storage(EState *estate, ResultPartsStorage *parts_storage,
 		/* ri_ConstraintExprs will be initialized by ExecRelCheck() */
 		child_result_rel_info->ri_ConstraintExprs = NULL;
 
+		/* ... which would put them into es_query_cxt, though */
+		if (rri_holder->mcxt)
+			prepare_rri_constraints(child_result_rel_info, estate,
+									rri_holder->mcxt);
+
 		/* Check that this partition is a valid result relation */
 		CheckValidResultRelCompat(child_result_rel_info,
 								  parts_storage->command_type);
@@ -406,14 +873,6 @@ scan_result_parts_storage(EState *estate, ResultPartsStorage *parts_storage,
 		rri_holder->partid = partid;
 		rri_holder->result_rel_info = child_result_rel_info;
 
-		/*
-		 * Generate parent->child tuple transformation map. We need to
-		 * convert tuples because e.g. parent's TupleDesc might have dropped
-		 * columns which child doesn't have at all because it was created after
-		 * the drop.
-		 */
-		rri_holder->tuple_map = build_part_tuple_map(base_rel, child_rel);
-
 		/*
 		 * Field for child->child tuple transformation map. We need to
 		 * convert tuples because child TupleDesc might have extra
@@ -437,8 +896,36 @@ scan_result_parts_storage(EState *estate, ResultPartsStorage *parts_storage,
 		if (parts_storage->init_rri_holder_cb)
 			parts_storage->init_rri_holder_cb(rri_holder, parts_storage);
 
-		/* Append ResultRelInfo to storage->es_alloc_result_rels */
-		append_rri_to_estate(parts_storage->estate, child_result_rel_info);
+		/* Append ResultRelInfo to storage->es_alloc_result_rels (or reuse slot) */
+		MemoryContextSwitchTo(estate->es_query_cxt);
+		if (reuse_slot)
+		{
+			rri_holder->rri_index = linitial_int(parts_storage->free_rri_indexes);
+			parts_storage->free_rri_indexes =
+					list_delete_first(parts_storage->free_rri_indexes);
+			replace_rri_in_estate(estate, child_result_rel_info,
+								  rri_holder->rri_index);
+		}
+		else
+			rri_holder->rri_index = append_rri_to_estate(estate,
+														 child_result_rel_info);
+		MemoryContextSwitchTo(holder_mcxt);
+
+		/*
+		 * AFTER ROW triggers and FDWs need ResultRelInfo until the end
+		 * of statement, while sub-partitioned tables are used for routing.
+		 */
+		rri_holder->evictable =
+				parts_storage->max_open_partitions > 0 &&
+				rri_holder->prel == NULL &&
+				child_result_rel_info->ri_FdwRoutine == NULL &&
+				!(child_result_rel_info->ri_TrigDesc &&
+				  child_result_rel_info->ri_TrigDesc->trig_insert_after_row);
+
+		if (rri_holder->evictable)
+			dlist_push_head(&parts_storage->lru_list, &rri_holder->lru_node);
+
+		parts_storage->partitions_opened++;
 
 		/* Don't forget to switch back! */
 		MemoryContextSwitchTo(old_mcxt);
@@ -447,6 +934,193 @@ scan_result_parts_storage(EState *estate, ResultPartsStorage *parts_storage,
 	return rri_holder;
 }
 
+/*
+ * Close least recently used partition to keep the number of open
+ * relations under 'max_open_partitions'. Its memory is released, and
+ * its EState slots are taken by the next partition to be opened.
+ * It will be opened again on the next access if needed.
+ */
+static void
+evict_result_parts_storage(ResultPartsStorage *parts_storage)
+{
+	EState				   *estate = parts_storage->estate;
+	ResultRelInfoHolder	   *rri_holder;
+	ResultRelInfo		   *rri;
+	Oid						partid;
+	MemoryContext			old_mcxt;
+
+	/* Nothing to close, have to exceed the budget */
+	if (dlist_is_empty(&parts_storage->lru_list))
+		return;
+
+	rri_holder = dlist_container(ResultRelInfoHolder, lru_node,
+								 dlist_tail_node(&parts_storage->lru_list));
+	dlist_delete(&rri_holder->lru_node);
+
+	rri = rri_holder->result_rel_info;
+	partid = rri_holder->partid;
+
+	/* Let the owner insert pending tuples etc */
+	if (parts_storage->evict_rri_holder_cb)
+		parts_storage->evict_rri_holder_cb(rri_holder, parts_storage);
+
+	close_rri_holder(parts_storage, rri_holder);
+
+	/* Nobody should see closed relation in EState */
+#if PG_VERSION_NUM >= 140000 /* reworked in commit a04daa97a433 */
+	estate->es_result_relations[rri->ri_RangeTableIndex - 1] = NULL;
+	estate->es_opened_result_relations =
+			list_delete_ptr(estate->es_opened_result_relations, rri);
+#else
+	/* ExecGetTriggerResultRel() looks at each entry, leave a valid one */
+	estate->es_result_relations[rri_holder->rri_index] = *parts_storage->base_rri;
+#endif
+#if PG_VERSION_NUM >= 120000
+	estate->es_relations[rri->ri_RangeTableIndex - 1] = NULL;
+#endif
+
+	/* Next partition will take these slots instead of appending new ones */
+	old_mcxt = MemoryContextSwitchTo(estate->es_query_cxt);
+	parts_storage->free_rt_indexes =
+			lappend_int(parts_storage->free_rt_indexes, rri->ri_RangeTableIndex);
+	parts_storage->free_rri_indexes =
+			lappend_int(parts_storage->free_rri_indexes, rri_holder->rri_index);
+	MemoryContextSwitchTo(old_mcxt);
+
+	/* Release ResultRelInfo, indices info, constraints etc */
+	MemoryContextDelete(rri_holder->mcxt);
+
+	hash_search(parts_storage->result_rels_table,
+				(const void *) &partid,
+				HASH_REMOVE, NULL);
+
+	parts_storage->partitions_evicted++;
+}
+
+/* Release resources of a single ResultRelInfoHolder */
+static void
+close_rri_holder(ResultPartsStorage *parts_storage,
+				 ResultRelInfoHolder *rri_holder)
+{
+	/* Call finalization callback if needed */
+	if (parts_storage->fini_rri_holder_cb)
+		parts_storage->fini_rri_holder_cb(rri_holder, parts_storage);
+
+	/*
+	 * Close indices, unless ExecEndPlan won't do that for us (this is
+	 * is CopyFrom which misses it, not usual executor run, essentially).
+	 * Otherwise, it is always automaticaly closed; in <= 11, relcache
+	 * refs of rris managed heap_open/close on their own, and ExecEndPlan
+	 * closed them directly. Since 9ddef3, relcache management
+	 * of executor was centralized; now rri refs are copies of ones in
+	 * estate->es_relations, which are closed in ExecEndPlan.
+	 * So we push our rel there, and it is also automatically closed.
+	 */
+	if (parts_storage->close_relations)
+	{
+		ExecCloseIndices(rri_holder->result_rel_info);
+		/* And relation itself (lock is kept until the end of xact) */
+		heap_close_compat(rri_holder->result_rel_info->ri_RelationDesc,
+			   NoLock);
+	}
+
+	/* Free conversion-related stuff */
+	destroy_tuple_map(rri_holder->tuple_map);
+
+	destroy_tuple_map(rri_holder->tuple_map_child);
+
+	/* Don't forget to close 'prel'! */
+	if (rri_holder->prel)
+		close_pathman_relation_info(rri_holder->prel);
+}
+
+/*
+ * Build ri_ConstraintExprs in 'mcxt' like ExecRelCheck() does.
+ * It would put them into es_query_cxt, which outlives the partition.
+ */
+static void
+prepare_rri_constraints(ResultRelInfo *rri, EState *estate, MemoryContext mcxt)
+{
+	TupleConstr	   *constr = RelationGetDescr(rri->ri_RelationDesc)->constr;
+	MemoryContext	query_mcxt = estate->es_query_cxt,
+					old_mcxt;
+	int				ncheck,
+					i;
+
+	if (!constr || constr->num_check == 0)
+		return;
+
+	ncheck = constr->num_check;
+
+	/* ExecPrepareExpr() allocates in es_query_cxt, redirect it */
+	old_mcxt = MemoryContextSwitchTo(mcxt);
+	estate->es_query_cxt = mcxt;
+
+	PG_TRY();
+	{
+#if PG_VERSION_NUM >= 100000
+		rri->ri_ConstraintExprs = (ExprState **) palloc(ncheck * sizeof(ExprState *));
+
+		for (i = 0; i < ncheck; i++)
+		{
+			Expr *checkconstr = stringToNode(constr->check[i].ccbin);
+
+			rri->ri_ConstraintExprs[i] = ExecPrepareExpr(checkconstr, estate);
+		}
+#else
+		rri->ri_ConstraintExprs = (List **) palloc(ncheck * sizeof(List *));
+
+		for (i = 0; i < ncheck; i++)
+		{
+			List *qual = make_ands_implicit(stringToNode(constr->check[i].ccbin));
+
+			rri->ri_ConstraintExprs[i] = (List *) ExecPrepareExpr((Expr *) qual, estate);
+		}
+#endif
+	}
+	PG_CATCH();
+	{
+		estate->es_query_cxt = query_mcxt;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	estate->es_query_cxt = query_mcxt;
+	MemoryContextSwitchTo(old_mcxt);
+}
+
+/*
+ * Compute things needed by scan_result_parts_storage()
+ * which are the same for all partitions of a statement.
+ */
+static void
+prepare_first_touch(ResultPartsStorage *parts_storage)
+{
+	EState *estate = parts_storage->estate;
+#if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
+	RangeTblEntry *init_rte;
+#endif
+
+	parts_storage->parent_rte = rt_fetch(parts_storage->base_rri->ri_RangeTableIndex,
+										 estate->es_range_table);
+
+#if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
+	init_rte = rt_fetch(parts_storage->init_rri->ri_RangeTableIndex,
+						estate->es_range_table);
+	parts_storage->parent_perminfo = getRTEPermissionInfo(estate->es_rteperminfos,
+														  init_rte);
+	parts_storage->translation_rel = parts_storage->init_rri->ri_RelationDesc;
+#else
+	parts_storage->translation_rel = parts_storage->base_rri->ri_RelationDesc;
+#endif
+
+	/* Templates contain translation lists for 'base_rri' */
+	parts_storage->use_templates =
+			(parts_storage->translation_rel == parts_storage->base_rri->ri_RelationDesc);
+
+	parts_storage->first_touch_ready = true;
+}
+
 /* Refresh PartRelationInfo for the partition in storage */
 PartRelationInfo *
 refresh_result_parts_storage(ResultPartsStorage *parts_storage, Oid partid)
@@ -623,6 +1297,8 @@ find_partitions_for_value(Datum value, Oid value_type,
 
 /*
  * Smart wrapper for scan_result_parts_storage().
+ *
+ * Returns NULL if tuple has been deferred by 'defer_cb'.
  */
 ResultRelInfoHolder *
 select_partition_for_insert(EState *estate,
@@ -642,7 +1318,7 @@ select_partition_for_insert(EState *estate,
 
 	Oid					   *parts;
 	int						nparts;
-	ResultRelInfoHolder	   *result;
+	ResultRelInfoHolder	   *result = NULL;
 
 	do
 	{
@@ -671,6 +1347,22 @@ select_partition_for_insert(EState *estate,
 		}
 		else if (nparts == 0)
 		{
+			if (parts_storage->defer_cb)
+			{
+				/* Partition might have been created by BGW meanwhile */
+				if (!PrelIsFresh(prel))
+				{
+					prel = refresh_result_parts_storage(parts_storage, parent_relid);
+					continue;
+				}
+
+				/* Caller will get this tuple back once partition is ready */
+				if (parts_storage->defer_cb(parts_storage, parent_relid,
+											value, prel->ev_type, slot,
+											parts_storage->defer_cb_arg))
+					return NULL;
+			}
+
 			partition_relid = create_partitions_for_value(parent_relid,
 														  value, prel->ev_type);
 		}
@@ -788,7 +1480,8 @@ make_partition_filter(Plan *subplan,
 					  Index parent_rti,
 					  OnConflictAction conflict_action,
 					  CmdType command_type,
-					  List *returning_list)
+					  List *returning_list,
+					  bool can_set_tag)
 {
 	CustomScan *cscan = makeNode(CustomScan);
 
@@ -828,6 +1521,10 @@ make_partition_filter(Plan *subplan,
 									   makeInteger(command_type));
 #endif
 
+	/* Should we update estate->es_processed? */
+	cscan->custom_private = lappend(cscan->custom_private,
+									makeInteger(can_set_tag));
+
 	return &cscan->scan.plan;
 }
 
@@ -852,6 +1549,7 @@ partition_filter_create_scan_state(CustomScan *node)
 #if PG_VERSION_NUM >= 160000 /* for commit 178ee1d858 */
 	state->parent_rti			= (Index) intVal(lfirst(list_nth_cell(node->custom_private, 4)));
 #endif
+	state->can_set_tag			= (bool) intVal(llast(node->custom_private));
 
 	/* Check boundaries */
 	Assert(state->on_conflict_action >= ONCONFLICT_NONE ||
@@ -905,6 +1603,39 @@ partition_filter_begin(CustomScanState *node, EState *estate, int eflags)
 		}
 	}
 #endif
+
+	/*
+	 * We can insert tuples by ourselves (in batches) unless
+	 * ModifyTable has something to do with them afterwards.
+	 */
+	if (pg_pathman_enable_batch_inserts &&
+		state->command_type == CMD_INSERT &&
+		state->on_conflict_action == ONCONFLICT_NONE &&
+		state->returning_list == NIL &&
+		state->can_set_tag &&
+#if PG_VERSION_NUM >= 100000
+		/* transition tables are filled by ExecARInsertTriggers() */
+		!(current_rri->ri_TrigDesc &&
+		  current_rri->ri_TrigDesc->trig_insert_new_table) &&
+#endif
+		!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+	{
+		state->multi_insert = palloc(sizeof(MultiInsertState));
+		init_multi_insert_state(state->multi_insert, estate, true);
+	}
+
+	/*
+	 * Don't wait for BGW to create partitions, insert other
+	 * tuples meanwhile (order of insertion doesn't matter).
+	 */
+	if (pg_pathman_enable_async_spawn &&
+		state->command_type == CMD_INSERT &&
+		state->on_conflict_action == ONCONFLICT_NONE &&
+		!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+	{
+		state->result_parts.defer_cb = defer_spawn_for_insert;
+		state->result_parts.defer_cb_arg = (void *) state;
+	}
 }
 
 #if PG_VERSION_NUM >= 140000
@@ -935,6 +1666,52 @@ reint_partition_filter_state(PartitionFilterState *state, ResultRelInfo *current
 
 TupleTableSlot *
 partition_filter_exec(CustomScanState *node)
+{
+	PartitionFilterState   *state = (PartitionFilterState *) node;
+	EState				   *estate = node->ss.ps.state;
+	ResultRelInfoHolder	   *rri_holder;
+	TupleTableSlot		   *slot;
+
+	if (!state->multi_insert)
+		return partition_filter_route_tuple(node, &rri_holder);
+
+	/* Buffer tuples until we meet one that ModifyTable should insert */
+	while (!TupIsNull(slot = partition_filter_route_tuple(node, &rri_holder)))
+	{
+		ResultRelInfo *rri = rri_holder->result_rel_info;
+
+		if (!multi_insert_allowed(rri_holder))
+		{
+			/* Triggers should see all tuples inserted before this one */
+			multi_insert_flush(state->multi_insert);
+
+			return slot;
+		}
+
+		/* Check the constraints of the tuple (as ExecInsert() does) */
+		if (rri->ri_RelationDesc->rd_att->constr)
+			ExecConstraints(rri, slot, estate);
+
+		multi_insert_add_tuple(state->multi_insert, rri_holder, slot);
+
+		/* ModifyTable won't count this tuple */
+		estate->es_processed++;
+
+		ResetPerTupleExprContext(estate);
+	}
+
+	multi_insert_flush(state->multi_insert);
+
+	return NULL;
+}
+
+/*
+ * Fetch next tuple from subplan and
+ * convert it for a suitable partition.
+ */
+static TupleTableSlot *
+partition_filter_route_tuple(CustomScanState *node,
+							 ResultRelInfoHolder **rri_holder_out)
 {
 	PartitionFilterState   *state = (PartitionFilterState *) node;
 
@@ -943,7 +1720,8 @@ partition_filter_exec(CustomScanState *node)
 	PlanState			   *child_ps = (PlanState *) linitial(node->custom_ps);
 	TupleTableSlot		   *slot;
 
-	slot = ExecProcNode(child_ps);
+next_tuple:
+	slot = partition_filter_fetch_tuple(state, child_ps);
 
 	if (!TupIsNull(slot))
 	{
@@ -980,7 +1758,15 @@ partition_filter_exec(CustomScanState *node)
 		MemoryContextSwitchTo(old_mcxt);
 		ResetExprContext(econtext);
 
+		/* Tuple has been put aside till its partition is created */
+		if (!rri_holder)
+		{
+			ResetPerTupleExprContext(estate);
+			goto next_tuple;
+		}
+
 		rri = rri_holder->result_rel_info;
+		*rri_holder_out = rri_holder;
 
 		/* Magic: replace parent's ResultRelInfo with ours */
 		estate->es_result_relation_info = rri;
@@ -1065,10 +1851,148 @@ partition_filter_exec(CustomScanState *node)
 	return NULL;
 }
 
+/*
+ * Put tuple aside and let BGW create a partition for it.
+ * Returns false if current backend should create it instead.
+ */
+static bool
+defer_spawn_for_insert(ResultPartsStorage *parts_storage,
+					   Oid parent_relid,
+					   Datum value,
+					   Oid value_type,
+					   TupleTableSlot *slot,
+					   void *arg)
+{
+	PartitionFilterState   *state = (PartitionFilterState *) arg;
+	PendingSpawn		   *pending = NULL;
+	ListCell			   *lc;
+
+	/* Single BGW per table, its tuples will be checked afterwards */
+	foreach (lc, state->pending_spawns)
+	{
+		if (((PendingSpawn *) lfirst(lc))->parent_relid == parent_relid)
+		{
+			pending = (PendingSpawn *) lfirst(lc);
+			break;
+		}
+	}
+
+	if (!pending)
+	{
+		SpawnPartitionsTask	   *task;
+		MemoryContext			old_mcxt;
+
+		task = create_partitions_for_value_async(parent_relid, value, value_type);
+
+		/* BGW can't be used right now */
+		if (!task)
+			return false;
+
+		old_mcxt = MemoryContextSwitchTo(parts_storage->estate->es_query_cxt);
+
+		pending = (PendingSpawn *) palloc(sizeof(PendingSpawn));
+		pending->parent_relid = parent_relid;
+		pending->task = task;
+		pending->rows = tuplestore_begin_heap(false, false, work_mem);
+
+		state->pending_spawns = lappend(state->pending_spawns, pending);
+
+		MemoryContextSwitchTo(old_mcxt);
+	}
+
+	/* Spills to disk if there are too many tuples */
+	tuplestore_puttupleslot(pending->rows, slot);
+
+	return true;
+}
+
+/*
+ * Fetch next tuple from subplan or tuples
+ * whose partitions have been created by BGW.
+ */
+static TupleTableSlot *
+partition_filter_fetch_tuple(PartitionFilterState *state, PlanState *child_ps)
+{
+	TupleTableSlot *slot;
+
+	for (;;)
+	{
+		if (state->replay_rows)
+		{
+			if (tuplestore_gettupleslot(state->replay_rows, true, false,
+										state->replay_slot))
+				return state->replay_slot;
+
+			tuplestore_end(state->replay_rows);
+			state->replay_rows = NULL;
+		}
+
+		if (state->pending_spawns != NIL)
+		{
+			PendingSpawn *pending = (PendingSpawn *) linitial(state->pending_spawns);
+
+			/* Wait for BGW only if there's nothing else to do */
+			if (state->subplan_done ||
+				partitions_bg_worker_finished(pending->task))
+			{
+				state->pending_spawns = list_delete_first(state->pending_spawns);
+
+				finish_partitions_bg_worker(pending->task);
+
+				/* Make new partitions visible */
+				AcceptInvalidationMessages();
+
+				if (!state->replay_slot)
+				{
+					state->replay_slot = MakeTupleTableSlotCompat(&TTSOpsMinimalTuple);
+					ExecSetSlotDescriptor(state->replay_slot,
+										  ExecGetResultType(child_ps));
+				}
+
+				/* Route these tuples once again */
+				state->replay_rows = pending->rows;
+				pfree(pending);
+
+				continue;
+			}
+		}
+
+		if (state->subplan_done)
+			return NULL;
+
+		slot = ExecProcNode(child_ps);
+
+		if (!TupIsNull(slot) || state->pending_spawns == NIL)
+			return slot;
+
+		state->subplan_done = true;
+	}
+}
+
 void
 partition_filter_end(CustomScanState *node)
 {
 	PartitionFilterState   *state = (PartitionFilterState *) node;
+	ListCell			   *lc;
+
+	/* Subplan might have been stopped before the end */
+	foreach (lc, state->pending_spawns)
+	{
+		PendingSpawn *pending = (PendingSpawn *) lfirst(lc);
+
+		finish_partitions_bg_worker(pending->task);
+		tuplestore_end(pending->rows);
+	}
+
+	if (state->replay_rows)
+		tuplestore_end(state->replay_rows);
+
+	if (state->replay_slot)
+		ExecDropSingleTupleTableSlot(state->replay_slot);
+
+	/* Release buffers before partitions are closed */
+	if (state->multi_insert)
+		fini_multi_insert_state(state->multi_insert);
 
 	/* Executor will close rels via estate->es_result_relations */
 	fini_result_parts_storage(&state->result_parts);
@@ -1090,7 +2014,43 @@ partition_filter_rescan(CustomScanState *node)
 void
 partition_filter_explain(CustomScanState *node, List *ancestors, ExplainState *es)
 {
-	/* Nothing to do here now */
+	PartitionFilterState   *state = (PartitionFilterState *) node;
+	ListCell			   *lc;
+
+	/* Show tuples inserted in batches */
+	if (!es->analyze || !state->multi_insert)
+		return;
+
+	if (es->format != EXPLAIN_FORMAT_TEXT)
+		ExplainOpenGroup("Batched Inserts", "Batched Inserts", false, es);
+
+	foreach (lc, state->multi_insert->stats)
+	{
+		MultiInsertStats   *stats = (MultiInsertStats *) lfirst(lc);
+		char			   *partname = get_rel_name_or_relid(stats->partid);
+
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			ExplainPropertyText("Batched Inserts",
+								psprintf("%s (rows=" UINT64_FORMAT
+										 " batches=" UINT64_FORMAT ")",
+										 partname,
+										 stats->ntuples,
+										 stats->nbatches),
+								es);
+		}
+		else
+		{
+			ExplainOpenGroup("Partition", NULL, true, es);
+			ExplainPropertyText("Relation Name", partname, es);
+			ExplainPropertyIntegerCompat("Rows", stats->ntuples, es);
+			ExplainPropertyIntegerCompat("Batches", stats->nbatches, es);
+			ExplainCloseGroup("Partition", NULL, true, es);
+		}
+	}
+
+	if (es->format != EXPLAIN_FORMAT_TEXT)
+		ExplainCloseGroup("Batched Inserts", "Batched Inserts", false, es);
 }
 
 
@@ -1562,6 +2522,28 @@ append_rri_to_estate(EState *estate, ResultRelInfo *rri)
 #endif
 }
 
+/* Put relation of a reopened partition into its old es_relations slot */
+static void
+replace_rel_in_estate(EState *estate, Index rti, Relation child_rel)
+{
+#if PG_VERSION_NUM >= 120000
+	estate->es_relations[rti - 1] = child_rel;
+#endif
+}
+
+/* Put ResultRelInfo of a reopened partition into its old slot */
+static void
+replace_rri_in_estate(EState *estate, ResultRelInfo *rri, int rri_index)
+{
+#if PG_VERSION_NUM >= 140000 /* reworked in commit a04daa97a433 */
+	estate->es_result_relations[rri->ri_RangeTableIndex - 1] = rri;
+	estate->es_opened_result_relations =
+			lappend(estate->es_opened_result_relations, rri);
+#else
+	estate->es_result_relations[rri_index] = *rri;
+#endif
+}
+
 
 /*
  * --------------------------------------
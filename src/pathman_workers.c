@@ -2,64 +2,118 @@
  *
  * pathman_workers.c
  *
- *		There are two purposes of this subsystem:
+ *		There are five purposes of this subsystem:
  *
  *			* Create new partitions for INSERT in separate transaction
  *			* Process concurrent partitioning operations
+ *			* Refresh zone maps one partition at a time
+ *			* Load data using several COPY workers
+ *			* Create RANGE partitions ahead of time
  *
- *		Background worker API is used for both cases.
+ *		Background worker API is used for all cases.
  *
  * Copyright (c) 2015-2016, Postgres Professional
  *
  *-------------------------------------------------------------------------
  */
 
+#include "compat/pg_compat.h"
 #include "init.h"
 #include "partition_creation.h"
+#include "partition_filter.h"
 #include "pathman_workers.h"
 #include "relation_info.h"
+#include "utility_stmt_hooking.h"
 #include "utils.h"
 #include "xact_handling.h"
 
+#include "access/heapam.h"
 #include "access/htup_details.h"
+#if PG_VERSION_NUM >= 120000
+#include "access/relscan.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#endif
 #include "access/xact.h"
+#include "catalog/namespace.h"
+#include "catalog/pg_authid.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_database.h"
 #include "catalog/pg_type.h"
+#include "commands/copy.h"
+#include "commands/prepare.h"
+#include "executor/executor.h"
 #include "executor/spi.h"
 #include "funcapi.h"
 #include "miscadmin.h"
+#include "parser/parse_node.h"
+#include "pgstat.h"
 #include "postmaster/bgworker.h"
 #include "storage/dsm.h"
 #include "storage/ipc.h"
 #include "storage/latch.h"
 #include "storage/proc.h"
+#include "storage/shm_mq.h"
+#include "tcop/utility.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
+#include "utils/guc.h"
 #include "utils/lsyscache.h"
 #include "utils/syscache.h"
 #include "utils/typcache.h"
 #include "utils/resowner.h"
 #include "utils/snapmgr.h"
+#include "utils/timestamp.h"
+
 
 
+/* Declarations for SpawnPartitionsWorker */
+PG_FUNCTION_INFO_V1( show_spawn_workers_internal );
 
 /* Declarations for ConcurrentPartWorker */
 PG_FUNCTION_INFO_V1( partition_table_concurrently );
 PG_FUNCTION_INFO_V1( show_concurrent_part_tasks_internal );
 PG_FUNCTION_INFO_V1( stop_concurrent_part_task );
 
+/* Declarations for RefreshZoneMapsWorker */
+PG_FUNCTION_INFO_V1( refresh_zone_maps_concurrently );
+
+/* Declarations for ParallelCopyWorker */
+PG_FUNCTION_INFO_V1( copy_from_parallel );
+
+/* Declarations for ProvisioningWorker */
+PG_FUNCTION_INFO_V1( start_provisioning_worker );
+PG_FUNCTION_INFO_V1( stop_provisioning_worker );
+PG_FUNCTION_INFO_V1( show_spawn_stats_internal );
+
 
 /*
  * Dynamically resolve functions (for BGW API).
  */
 extern PGDLLEXPORT void bgw_main_spawn_partitions(Datum main_arg);
+extern PGDLLEXPORT void bgw_main_spawn_pool(Datum main_arg);
 extern PGDLLEXPORT void bgw_main_concurrent_part(Datum main_arg);
+extern PGDLLEXPORT void bgw_main_refresh_zone_maps(Datum main_arg);
+extern PGDLLEXPORT void bgw_main_parallel_copy(Datum main_arg);
+extern PGDLLEXPORT void bgw_main_provisioning(Datum main_arg);
+extern PGDLLEXPORT void bgw_main_provisioning_launcher(Datum main_arg);
 
 
 static void handle_sigterm(SIGNAL_ARGS);
+static void handle_sighup(SIGNAL_ARGS);
+static void start_spawn_partitions_worker(SpawnPartitionsTask *task);
+static bool enqueue_spawn_request(SpawnPartitionsTask *task);
+static SpawnRequestStatus spawn_request_status(int request_idx);
+static bool spawn_request_blocked_by_us(int request_idx);
+static void release_spawn_request(dsm_segment *segment, Datum arg);
 static void bg_worker_load_config(const char *bgw_name);
 static bool start_bgworker(const char *bgworker_name,
 							const char *bgworker_proc,
-							Datum bgw_arg, bool wait_for_shutdown);
+							Datum bgw_arg,
+							const void *bgw_extra, Size bgw_extra_size,
+							bool wait_for_shutdown,
+							BackgroundWorkerHandle **bgw_handle_out);
 
 
 /*
@@ -71,22 +125,52 @@ typedef struct
 } active_workers_cxt;
 
 
+/*
+ * Queue & slots of long-lived SpawnPartitionsWorkers.
+ */
+static SpawnWorkerPool	   *spawn_pool;
+static SpawnWorkerSlot	   *spawn_worker_slots;
+
 /*
  * Slots for concurrent partitioning tasks.
  */
 static ConcurrentPartSlot  *concurrent_part_slots;
 
+/*
+ * Slots for provisioning workers & spawn statistics.
+ */
+static ProvisioningSlot	   *provisioning_slots;
+static PathmanSpawnStats   *spawn_stats;
+
 
 /*
  * Available workers' names.
  */
 static const char		   *spawn_partitions_bgw	= "SpawnPartitionsWorker";
 static const char		   *concurrent_part_bgw		= "ConcurrentPartWorker";
+static const char		   *refresh_zone_maps_bgw	= "RefreshZoneMapsWorker";
+static const char		   *parallel_copy_bgw		= "ParallelCopyWorker";
+static const char		   *provisioning_bgw		= "ProvisioningWorker";
+static const char		   *provisioning_launcher_bgw = "ProvisioningLauncher";
 
 
 /* Used for preventing spawn bgw recursion trouble */
 static bool am_spawn_bgw = false;
 
+
+/* Max number of SpawnPartitionsWorkers per database (0 disables pool) */
+int pg_pathman_spawn_pool_size = 0;
+
+/* Idle SpawnPartitionsWorker exits after this many seconds */
+int pg_pathman_spawn_worker_idle_timeout = 60;
+
+/* ProvisioningLauncher starts workers this often (0 disables it) */
+int pg_pathman_provisioning_naptime = 0;
+
+/* Set by SIGHUP handler */
+static volatile sig_atomic_t got_sighup = false;
+
+
 /*
  * Estimate amount of shmem needed for concurrent partitioning.
  */
@@ -120,6 +204,86 @@ init_concurrent_part_task_slots(void)
 	}
 }
 
+/*
+ * Estimate amount of shmem needed for pool of SpawnPartitionsWorkers.
+ */
+Size
+estimate_spawn_pool_size(void)
+{
+	/* NOTE: we suggest that max_worker_processes is in PGC_POSTMASTER */
+	return sizeof(SpawnWorkerPool) +
+		   sizeof(SpawnWorkerSlot) * PART_WORKER_SLOTS;
+}
+
+/*
+ * Initialize shared memory needed for pool of SpawnPartitionsWorkers.
+ */
+void
+init_spawn_pool(void)
+{
+	bool	found;
+	Size	size = sizeof(SpawnWorkerSlot) * PART_WORKER_SLOTS;
+
+	spawn_pool = (SpawnWorkerPool *)
+			ShmemInitStruct("pg_pathman's SpawnWorkerPool",
+							sizeof(SpawnWorkerPool), &found);
+
+	if (!found)
+	{
+		memset(spawn_pool, 0, sizeof(SpawnWorkerPool));
+		SpinLockInit(&spawn_pool->mutex);
+	}
+
+	spawn_worker_slots = (SpawnWorkerSlot *)
+			ShmemInitStruct("array of SpawnWorkerSlots", size, &found);
+
+	if (!found)
+		memset(spawn_worker_slots, 0, size);
+}
+
+/*
+ * Estimate amount of shmem needed for provisioning workers.
+ */
+Size
+estimate_provisioning_shmem_size(void)
+{
+	/* NOTE: we suggest that max_worker_processes is in PGC_POSTMASTER */
+	return sizeof(PathmanSpawnStats) +
+		   sizeof(ProvisioningSlot) * PART_WORKER_SLOTS;
+}
+
+/*
+ * Initialize shared memory needed for provisioning workers.
+ */
+void
+init_provisioning_shmem(void)
+{
+	bool	found;
+	Size	size = sizeof(ProvisioningSlot) * PART_WORKER_SLOTS;
+	int		i;
+
+	spawn_stats = (PathmanSpawnStats *)
+			ShmemInitStruct("pg_pathman's spawn statistics",
+							sizeof(PathmanSpawnStats), &found);
+
+	if (!found)
+	{
+		memset(spawn_stats, 0, sizeof(PathmanSpawnStats));
+		SpinLockInit(&spawn_stats->mutex);
+	}
+
+	provisioning_slots = (ProvisioningSlot *)
+			ShmemInitStruct("array of ProvisioningSlots", size, &found);
+
+	if (!found)
+	{
+		memset(provisioning_slots, 0, size);
+
+		for (i = 0; i < PART_WORKER_SLOTS; i++)
+			SpinLockInit(&provisioning_slots[i].mutex);
+	}
+}
+
 
 /*
  * -------------------------------------------------
@@ -147,6 +311,20 @@ handle_sigterm(SIGNAL_ARGS)
 	errno = save_errno;
 }
 
+/*
+ * Handle SIGHUP in BGW's process (reload config on next iteration).
+ */
+static void
+handle_sighup(SIGNAL_ARGS)
+{
+	int save_errno = errno;
+
+	got_sighup = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
 /*
  * Initialize pg_pathman's local config in BGW's process.
  */
@@ -164,11 +342,15 @@ bg_worker_load_config(const char *bgw_name)
 
 /*
  * Common function to start background worker.
+ * Worker's handle is returned via 'bgw_handle_out' (if it's not NULL).
  */
 static bool
 start_bgworker(const char *bgworker_name,
 				const char *bgworker_proc,
-				Datum bgw_arg, bool wait_for_shutdown)
+				Datum bgw_arg,
+				const void *bgw_extra, Size bgw_extra_size,
+				bool wait_for_shutdown,
+				BackgroundWorkerHandle **bgw_handle_out)
 {
 #define HandleError(condition, new_state) \
 	if (condition) { exec_state = (new_state); goto handle_exec_state; }
@@ -204,6 +386,11 @@ start_bgworker(const char *bgworker_name,
 	worker.bgw_main_arg			= bgw_arg;
 	worker.bgw_notify_pid		= MyProcPid;
 
+	/* Pass additional args if needed */
+	Assert(bgw_extra_size <= BGW_EXTRALEN);
+	if (bgw_extra)
+		memcpy(worker.bgw_extra, bgw_extra, bgw_extra_size);
+
 	/* Start dynamic worker */
 	bgw_started = RegisterDynamicBackgroundWorker(&worker, &bgw_handle);
 	HandleError(bgw_started == false, BGW_COULD_NOT_START);
@@ -212,6 +399,9 @@ start_bgworker(const char *bgworker_name,
 	bgw_status = WaitForBackgroundWorkerStartup(bgw_handle, &pid);
 	HandleError(bgw_status == BGWH_POSTMASTER_DIED, BGW_PM_DIED);
 
+	if (bgw_handle_out)
+		*bgw_handle_out = bgw_handle;
+
 	/* Wait till the edn if we're asked to */
 	if (wait_for_shutdown)
 	{
@@ -313,40 +503,152 @@ create_partitions_bg_worker_segment(Oid relid, Datum value, Oid value_type)
 Oid
 create_partitions_for_value_bg_worker(Oid relid, Datum value, Oid value_type)
 {
-	dsm_segment			   *segment;
-	dsm_handle				segment_handle;
-	SpawnPartitionArgs	   *bgw_args;
-	Oid						child_oid = InvalidOid;
+	SpawnPartitionsTask *task;
+
+	task = start_partitions_bg_worker(relid, value, value_type);
+
+	return finish_partitions_bg_worker(task);
+}
+
+/*
+ * Starts background worker that will create new partitions.
+ * Use finish_partitions_bg_worker() to fetch the result.
+ */
+SpawnPartitionsTask *
+start_partitions_bg_worker(Oid relid, Datum value, Oid value_type)
+{
+	SpawnPartitionsTask	   *task;
 
 	if (am_spawn_bgw)
 		ereport(ERROR,
 				(errmsg("Attempt to spawn partition using bgw from bgw spawning partitions"),
 				 errhint("Probably init_callback has INSERT to its table?")));
 
+	task = palloc0(sizeof(SpawnPartitionsTask));
+	task->relid = relid;
+	task->request_idx = -1;
+
 	/* Create a dsm segment for the worker to pass arguments */
-	segment = create_partitions_bg_worker_segment(relid, value, value_type);
-	segment_handle = dsm_segment_handle(segment);
-	bgw_args = (SpawnPartitionArgs *) dsm_segment_address(segment);
+	task->segment = create_partitions_bg_worker_segment(relid, value, value_type);
+
+	/*
+	 * Long-lived workers don't have to connect & load config,
+	 * but they would wait for our locks (not in lock group).
+	 */
+	if (pg_pathman_spawn_pool_size > 0 &&
+		!xact_bgw_conflicting_lock_exists(relid) &&
+		enqueue_spawn_request(task))
+		return task;
 
+	start_spawn_partitions_worker(task);
+
+	return task;
+}
+
+/*
+ * Start a dedicated SpawnPartitionsWorker for the task, but don't wait for it.
+ */
+static void
+start_spawn_partitions_worker(SpawnPartitionsTask *task)
+{
 #if PG_VERSION_NUM >= 90600
 	/* Become locking group leader */
 	BecomeLockGroupLeader();
 #endif
 
-	/* Start worker and wait for it to finish */
 	if (!start_bgworker(spawn_partitions_bgw,
 						CppAsString(bgw_main_spawn_partitions),
-						UInt32GetDatum(segment_handle),
-						true))
+						UInt32GetDatum(dsm_segment_handle(task->segment)),
+						NULL, 0,
+						false, &task->handle))
 	{
 		start_bgworker_errmsg(spawn_partitions_bgw);
 	}
+}
+
+/*
+ * Check if worker started by start_partitions_bg_worker() has exited.
+ */
+bool
+partitions_bg_worker_finished(SpawnPartitionsTask *task)
+{
+	BgwHandleStatus	status;
+	pid_t			pid;
+
+	if (task->request_idx >= 0)
+		return spawn_request_status(task->request_idx) == SPR_DONE;
+
+	/* NOTE: worker might not have been started yet */
+	status = GetBackgroundWorkerPid(task->handle, &pid);
+
+	return status == BGWH_STOPPED || status == BGWH_POSTMASTER_DIED;
+}
+
+/*
+ * Wait for worker started by start_partitions_bg_worker() and
+ * return the result (new partition oid). Frees 'task'.
+ */
+Oid
+finish_partitions_bg_worker(SpawnPartitionsTask *task)
+{
+	SpawnPartitionArgs	   *bgw_args;
+	Oid						child_oid;
+	Oid						relid = task->relid;
+
+	if (task->request_idx >= 0)
+	{
+		/* Wait till some worker of the pool processes our request */
+		while (spawn_request_status(task->request_idx) != SPR_DONE)
+		{
+			int rc;
+
+			rc = WaitLatchCompat(MyLatch,
+								 WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+								 SPAWN_POOL_POLL_INTERVAL);
+
+			if (rc & WL_POSTMASTER_DEATH)
+				ereport(ERROR,
+						(errmsg("Postmaster died during the pg_pathman background worker process"),
+						 errhint("More details may be available in the server log.")));
+
+			ResetLatch(MyLatch);
+			CHECK_FOR_INTERRUPTS();
+
+			/* Worker can't proceed until we commit, use a dedicated one */
+			if (spawn_request_blocked_by_us(task->request_idx))
+			{
+				elog(DEBUG1, "%s: pooled worker is waiting for our lock, "
+							 "starting a dedicated one [%u]",
+					 spawn_partitions_bgw, MyProcPid);
+
+				/* Pooled worker will free the request */
+				cancel_on_dsm_detach(task->segment, release_spawn_request,
+									 Int32GetDatum(task->request_idx));
+				release_spawn_request(task->segment,
+									  Int32GetDatum(task->request_idx));
+				task->request_idx = -1;
+
+				start_spawn_partitions_worker(task);
+				break;
+			}
+		}
+	}
+
+	if (task->request_idx < 0 &&
+		WaitForBackgroundWorkerShutdown(task->handle) == BGWH_POSTMASTER_DIED)
+		ereport(ERROR,
+				(errmsg("Postmaster died during the pg_pathman background worker process"),
+				 errhint("More details may be available in the server log.")));
 
 	/* Save the result (partition Oid) */
+	bgw_args = (SpawnPartitionArgs *) dsm_segment_address(task->segment);
 	child_oid = bgw_args->result;
 
-	/* Free dsm segment */
-	dsm_detach(segment);
+	/* Free dsm segment (and request, see release_spawn_request()) */
+	dsm_detach(task->segment);
+	if (task->handle)
+		pfree(task->handle);
+	pfree(task);
 
 	if (child_oid == InvalidOid)
 		ereport(ERROR,
@@ -435,310 +737,2143 @@ bgw_main_spawn_partitions(Datum main_arg)
 
 
 /*
- * -------------------------------------
- *  ConcurrentPartWorker implementation
- * -------------------------------------
+ * ------------------------------------------
+ *  Pool of long-lived SpawnPartitionsWorkers
+ * ------------------------------------------
  */
 
-/* Free bgworker's CPS slot */
-static void
-free_cps_slot(int code, Datum arg)
-{
-	ConcurrentPartSlot *part_slot = (ConcurrentPartSlot *) DatumGetPointer(arg);
-
-	cps_set_status(part_slot, CPS_FREE);
-}
-
 /*
- * Entry point for ConcurrentPartWorker's process.
+ * Put request into the queue of the pool and make sure
+ * there's a worker to process it. Returns false if a
+ * worker should be started specially for this request.
  */
-void
-bgw_main_concurrent_part(Datum main_arg)
+static bool
+enqueue_spawn_request(SpawnPartitionsTask *task)
 {
-	ConcurrentPartSlot *part_slot;
-	char			   *sql = NULL;
-	int64				rows;
-	volatile bool		failed;
-	volatile int		failures_count = 0;
-	LOCKMODE			lockmode = RowExclusiveLock;
-
-	/* Update concurrent part slot */
-	part_slot = &concurrent_part_slots[DatumGetInt32(main_arg)];
-	part_slot->pid = MyProcPid;
+	SpawnRequest   *request;
+	Latch		   *idle_latch = NULL;
+	Oid				userid = ((SpawnPartitionArgs *)
+							  dsm_segment_address(task->segment))->userid;
+	int				request_idx = -1,
+					empty_slot_idx = -1,
+					nworkers = 0,		/* workers serving this database & user */
+					nidle = 0,			/* ... which don't have any request */
+					nqueued = 1,		/* requests of this database & user + ours */
+					i;
 
-	/* Establish atexit callback that will fre CPS slot */
-	on_proc_exit(free_cps_slot, PointerGetDatum(part_slot));
+	SpinLockAcquire(&spawn_pool->mutex);
 
-	/* Establish signal handlers before unblocking signals */
-	pqsignal(SIGTERM, handle_sigterm);
+	for (i = 0; i < SPAWN_QUEUE_SIZE; i++)
+	{
+		request = &spawn_pool->requests[i];
 
-	/* We're now ready to receive signals */
-	BackgroundWorkerUnblockSignals();
+		if (request->status == SPR_FREE)
+		{
+			if (request_idx < 0)
+				request_idx = i;
+		}
+		else if (request->status == SPR_QUEUED &&
+				 request->dbid == MyDatabaseId &&
+				 request->userid == userid)
+			nqueued++;
+	}
 
-	/* Create resource owner */
-	CurrentResourceOwner = ResourceOwnerCreate(NULL, concurrent_part_bgw);
+	for (i = 0; i < PART_WORKER_SLOTS; i++)
+	{
+		SpawnWorkerSlot *slot = &spawn_worker_slots[i];
 
-	/* Disable auto partition propagation */
-	SetAutoPartitionEnabled(false);
+		if (slot->worker_status == CPS_FREE)
+		{
+			if (empty_slot_idx < 0)
+				empty_slot_idx = i;
+		}
+		/* NOTE: stopping workers won't take new requests */
+		else if (slot->worker_status == CPS_WORKING &&
+				 slot->dbid == MyDatabaseId &&
+				 slot->userid == userid)
+		{
+			nworkers++;
 
-	/* Establish connection and start transaction */
-	BackgroundWorkerInitializeConnectionByOidCompat(part_slot->dbid, part_slot->userid);
+			if (!OidIsValid(slot->relid))
+			{
+				nidle++;
+				if (slot->latch)
+					idle_latch = slot->latch;
+			}
+		}
+	}
 
-	/* Initialize pg_pathman's local config */
-	StartTransactionCommand();
-	bg_worker_load_config(concurrent_part_bgw);
-	CommitTransactionCommand();
+	/* Queue is full, or nobody is going to process the request */
+	if (request_idx < 0 ||
+		(nworkers == 0 && empty_slot_idx < 0))
+	{
+		SpinLockRelease(&spawn_pool->mutex);
+		return false;
+	}
 
-	/* Do the job */
-	do
+	/* Don't start a new worker if existing ones can do the job */
+	if (nidle >= nqueued || nworkers >= pg_pathman_spawn_pool_size)
+		empty_slot_idx = -1;
+
+	request = &spawn_pool->requests[request_idx];
+	request->status = SPR_QUEUED;
+	request->userid = userid;
+	request->dbid = MyDatabaseId;
+	request->relid = task->relid;
+	request->segment = dsm_segment_handle(task->segment);
+	request->requester = MyLatch;
+	request->worker_idx = -1;
+
+	/* Occupy slot for a new worker */
+	if (empty_slot_idx >= 0)
 	{
-		MemoryContext old_mcxt;
+		SpawnWorkerSlot *slot = &spawn_worker_slots[empty_slot_idx];
+
+		slot->worker_status = CPS_WORKING;
+		slot->pid = 0;
+		slot->latch = NULL;
+		slot->userid = userid;
+		slot->dbid = MyDatabaseId;
+		slot->relid = InvalidOid;
+		slot->processed = 0;
+	}
 
-		Oid		types[2]	= { OIDOID,				INT4OID };
-		Datum	vals[2]		= { part_slot->relid,	part_slot->batch_size };
+	SpinLockRelease(&spawn_pool->mutex);
 
-		volatile bool	rel_locked = false;
+	/* Free request entry once we're done with it (even on ERROR) */
+	on_dsm_detach(task->segment, release_spawn_request,
+				  Int32GetDatum(request_idx));
+	task->request_idx = request_idx;
 
-		/* Reset loop variables */
-		failed = false;
-		rows = 0;
+	/* Wake up an idle worker */
+	if (idle_latch)
+		SetLatch(idle_latch);
 
-		CHECK_FOR_INTERRUPTS();
+	if (empty_slot_idx >= 0 &&
+		!start_bgworker(spawn_partitions_bgw,
+						CppAsString(bgw_main_spawn_pool),
+						Int32GetDatum(empty_slot_idx),
+						NULL, 0,
+						false, NULL))
+	{
+		bool withdrawn = false;
 
-		/* Start new transaction (syscache access etc.) */
-		StartTransactionCommand();
+		SpinLockAcquire(&spawn_pool->mutex);
 
-		/* We'll need this to recover from errors */
-		old_mcxt = CurrentMemoryContext;
+		spawn_worker_slots[empty_slot_idx].worker_status = CPS_FREE;
 
-		if (SPI_connect() != SPI_OK_CONNECT)
-			elog(ERROR, "could not connect using SPI");
+		/* There was no other worker, take our request back */
+		if (nworkers == 0 && request->status == SPR_QUEUED)
+		{
+			request->status = SPR_FREE;
+			withdrawn = true;
+		}
 
-		PushActiveSnapshot(GetTransactionSnapshot());
+		SpinLockRelease(&spawn_pool->mutex);
 
-		/* Prepare the query if needed */
-		if (sql == NULL)
+		if (withdrawn)
 		{
-			MemoryContext	current_mcxt;
+			cancel_on_dsm_detach(task->segment, release_spawn_request,
+								 Int32GetDatum(request_idx));
+			task->request_idx = -1;
 
-			/*
-			 * Allocate SQL query in TopPathmanContext because current
-			 * context will be destroyed after transaction finishes
-			 */
-			current_mcxt = MemoryContextSwitchTo(TopPathmanContext);
-			sql = psprintf("SELECT %s._partition_data_concurrent($1::regclass, NULL::text, NULL::text, p_limit:=$2)",
-						   get_namespace_name(get_pathman_schema()));
-			MemoryContextSwitchTo(current_mcxt);
+			return false;
 		}
+	}
 
-		/* Exec ret = _partition_data_concurrent() */
-		PG_TRY();
-		{
-			int		ret;
-			bool	isnull;
+	return true;
+}
 
-			/* Lock relation for DELETE and INSERT */
-			if (!ConditionalLockRelationOid(part_slot->relid, lockmode))
-			{
-				elog(ERROR, "could not take lock on relation %u", part_slot->relid);
-			}
+/*
+ * Fetch status of a request (see SpawnRequestStatus).
+ */
+static SpawnRequestStatus
+spawn_request_status(int request_idx)
+{
+	SpawnRequestStatus status;
 
-			/* Great, now relation is locked */
-			rel_locked = true;
+	SpinLockAcquire(&spawn_pool->mutex);
+	status = spawn_pool->requests[request_idx].status;
+	SpinLockRelease(&spawn_pool->mutex);
 
-			/* Make sure that relation exists */
-			if (!SearchSysCacheExists1(RELOID, ObjectIdGetDatum(part_slot->relid)))
-			{
-				/* Exit after we raise ERROR */
-				failures_count = PART_WORKER_MAX_ATTEMPTS;
+	return status;
+}
 
-				elog(ERROR, "relation %u does not exist", part_slot->relid);
-			}
+/*
+ * Check if worker processing the request waits for a lock held by us.
+ * Such a worker would wait till we commit, but we're waiting for it.
+ */
+static bool
+spawn_request_blocked_by_us(int request_idx)
+{
+#if PG_VERSION_NUM >= 90600
+	SpawnRequest   *request = &spawn_pool->requests[request_idx];
+	pid_t			pid = 0;
+	ArrayType	   *blockers;
+	Datum		   *elems;
+	int				nelems,
+					i;
 
-			/* Make sure that relation has partitions */
-			if (!has_pathman_relation_info(part_slot->relid))
-			{
-				/* Exit after we raise ERROR */
+	SpinLockAcquire(&spawn_pool->mutex);
+	if (request->status == SPR_RUNNING && request->worker_idx >= 0)
+		pid = spawn_worker_slots[request->worker_idx].pid;
+	SpinLockRelease(&spawn_pool->mutex);
+
+	if (pid == 0)
+		return false;
+
+	blockers = DatumGetArrayTypeP(DirectFunctionCall1(pg_blocking_pids,
+													  Int32GetDatum(pid)));
+	deconstruct_array(blockers, INT4OID, sizeof(int32), true, 'i',
+					  &elems, NULL, &nelems);
+
+	for (i = 0; i < nelems; i++)
+		if (DatumGetInt32(elems[i]) == MyProcPid)
+			return true;
+#endif
+
+	return false;
+}
+
+/*
+ * Free request entry once requester has detached from segment.
+ * If worker is still processing it, worker will free it.
+ */
+static void
+release_spawn_request(dsm_segment *segment, Datum arg)
+{
+	SpawnRequest *request = &spawn_pool->requests[DatumGetInt32(arg)];
+
+	SpinLockAcquire(&spawn_pool->mutex);
+
+	if (request->status == SPR_RUNNING)
+		request->status = SPR_ABANDONED;
+	else
+		request->status = SPR_FREE;
+
+	SpinLockRelease(&spawn_pool->mutex);
+}
+
+/*
+ * Mark request as processed and wake up requester.
+ */
+static void
+complete_spawn_request(int request_idx)
+{
+	SpawnRequest   *request = &spawn_pool->requests[request_idx];
+	Latch		   *requester = NULL;
+
+	SpinLockAcquire(&spawn_pool->mutex);
+
+	if (request->status == SPR_ABANDONED)
+		request->status = SPR_FREE;
+	else
+	{
+		request->status = SPR_DONE;
+		requester = request->requester;
+	}
+
+	SpinLockRelease(&spawn_pool->mutex);
+
+	if (requester)
+		SetLatch(requester);
+}
+
+/* Free worker's slot and don't leave its requests hanging */
+static void
+free_spawn_worker_slot(int code, Datum arg)
+{
+	int					worker_idx = DatumGetInt32(arg);
+	SpawnWorkerSlot	   *slot = &spawn_worker_slots[worker_idx];
+	Latch			   *requesters[SPAWN_QUEUE_SIZE];
+	int					nrequesters = 0;
+	bool				last_worker = true;
+	int					i;
+
+	SpinLockAcquire(&spawn_pool->mutex);
+
+	slot->worker_status = CPS_FREE;
+	slot->latch = NULL;
+	slot->relid = InvalidOid;
+
+	for (i = 0; i < PART_WORKER_SLOTS; i++)
+	{
+		if (spawn_worker_slots[i].worker_status == CPS_WORKING &&
+			spawn_worker_slots[i].dbid == slot->dbid &&
+			spawn_worker_slots[i].userid == slot->userid)
+			last_worker = false;
+	}
+
+	for (i = 0; i < SPAWN_QUEUE_SIZE; i++)
+	{
+		SpawnRequest *request = &spawn_pool->requests[i];
+
+		if (request->status == SPR_ABANDONED &&
+			request->worker_idx == worker_idx)
+		{
+			request->status = SPR_FREE;
+		}
+		/* Request we were processing, or nobody's left to process it */
+		else if ((request->status == SPR_RUNNING &&
+				  request->worker_idx == worker_idx) ||
+				 (request->status == SPR_QUEUED &&
+				  request->dbid == slot->dbid &&
+				  request->userid == slot->userid && last_worker))
+		{
+			/* Requester will see InvalidOid as result */
+			request->status = SPR_DONE;
+			requesters[nrequesters++] = request->requester;
+		}
+	}
+
+	SpinLockRelease(&spawn_pool->mutex);
+
+	for (i = 0; i < nrequesters; i++)
+		SetLatch(requesters[i]);
+}
+
+/*
+ * Take next request of worker's database & user.
+ * Returns -1 if there are no requests.
+ */
+static int
+claim_spawn_request(int worker_idx, dsm_handle *segment)
+{
+	SpawnWorkerSlot	   *slot = &spawn_worker_slots[worker_idx];
+	int					i;
+
+	/* NOTE: caller should hold spawn_pool->mutex */
+	for (i = 0; i < SPAWN_QUEUE_SIZE; i++)
+	{
+		SpawnRequest *request = &spawn_pool->requests[i];
+
+		if (request->status == SPR_QUEUED &&
+			request->dbid == slot->dbid &&
+			request->userid == slot->userid)
+		{
+			request->status = SPR_RUNNING;
+			request->worker_idx = worker_idx;
+
+			slot->relid = request->relid;
+			*segment = request->segment;
+
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Create partitions for a request of some backend.
+ * Errors are written to server log.
+ */
+static void
+process_spawn_request(dsm_handle handle, ResourceOwner owner,
+					  MemoryContext request_mcxt)
+{
+	dsm_segment			   *segment;
+	SpawnPartitionArgs	   *args;
+
+	/* Segment is gone if requester has gone */
+	CurrentResourceOwner = owner;
+	if ((segment = dsm_attach(handle)) == NULL)
+		return;
+
+	args = (SpawnPartitionArgs *) dsm_segment_address(segment);
+
+	MemoryContextSwitchTo(request_mcxt);
+
+	PG_TRY();
+	{
+		Datum	value;
+		Oid		result;
+		int		save_nestlevel;
+
+		/* Start new transaction (syscache access etc.) */
+		StartTransactionCommand();
+
+		/* Extension might have been re-created */
+		if (!IsPathmanInitialized())
+			bg_worker_load_config(spawn_partitions_bgw);
+
+		/* Callbacks must not change settings of next requests */
+		save_nestlevel = NewGUCNestLevel();
+
+		/* Upack Datum from segment to 'value' */
+		UnpackDatumFromByteArray(&value,
+								 args->value_size,
+								 args->value_byval,
+								 (const void *) args->value);
+
+		result = create_partitions_for_value_internal(args->partitioned_table,
+													  value, /* unpacked Datum */
+													  args->value_type);
+
+		/* Forget session state, as DISCARD ALL does (incl. plain SETs) */
+		AtEOXact_GUC(false, save_nestlevel);
+		ResetTempTableNamespace();
+		DropAllPreparedStatements();
+
+		/* Finish transaction in an appropriate way */
+		CommitTransactionCommand();
+		args->result = result;
+	}
+	PG_CATCH();
+	{
+		ErrorData *error;
+
+		/* Switch to the original context & copy edata */
+		MemoryContextSwitchTo(request_mcxt);
+		error = CopyErrorData();
+		FlushErrorState();
+
+		/* Print message for this BGWorker to server log */
+		ereport(LOG,
+				(errmsg("%s: %s", spawn_partitions_bgw, error->message),
+				 errdetail("relation: %u", args->partitioned_table)));
+
+		/* Finally, free error data */
+		FreeErrorData(error);
+
+		/* Requester will see InvalidOid as result */
+		AbortCurrentTransaction();
+	}
+	PG_END_TRY();
+
+	CurrentResourceOwner = owner;
+	dsm_detach(segment);
+
+	MemoryContextSwitchTo(TopMemoryContext);
+	MemoryContextReset(request_mcxt);
+}
+
+/*
+ * Entry point for long-lived SpawnPartitionsWorker's process.
+ * It serves requests of a single database & user until it stays idle
+ * for 'pg_pathman.spawn_worker_idle_timeout' seconds.
+ */
+void
+bgw_main_spawn_pool(Datum main_arg)
+{
+	int					worker_idx = DatumGetInt32(main_arg);
+	SpawnWorkerSlot	   *slot = &spawn_worker_slots[worker_idx];
+	ResourceOwner		owner;
+	MemoryContext		request_mcxt;
+	TimestampTz			idle_since;
+
+	/* Establish atexit callback that will free the slot */
+	on_proc_exit(free_spawn_worker_slot, Int32GetDatum(worker_idx));
+
+	/* Establish signal handlers before unblocking signals */
+	pqsignal(SIGTERM, handle_sigterm);
+
+	/* We're now ready to receive signals */
+	BackgroundWorkerUnblockSignals();
+
+	am_spawn_bgw = true;
+
+	/* Create resource owner */
+	owner = ResourceOwnerCreate(NULL, spawn_partitions_bgw);
+	CurrentResourceOwner = owner;
+
+	/* Establish connection (worker serves requests of a single user) */
+	BackgroundWorkerInitializeConnectionByOidCompat(slot->dbid, slot->userid);
+
+	/* Initialize pg_pathman's local config (caches will stay warm) */
+	StartTransactionCommand();
+	bg_worker_load_config(spawn_partitions_bgw);
+	CommitTransactionCommand();
+
+	request_mcxt = AllocSetContextCreate(TopMemoryContext,
+										 "SpawnPartitionsWorker request",
+										 ALLOCSET_DEFAULT_SIZES);
+
+	/* Now backends may wake us up */
+	SpinLockAcquire(&spawn_pool->mutex);
+	slot->pid = MyProcPid;
+	slot->latch = MyLatch;
+	SpinLockRelease(&spawn_pool->mutex);
+
+	idle_since = GetCurrentTimestamp();
+
+	for (;;)
+	{
+		dsm_handle	segment = 0;
+		int			request_idx;
+		bool		timed_out;
+		int			rc;
+
+		CHECK_FOR_INTERRUPTS();
+
+		timed_out = TimestampDifferenceExceeds(idle_since,
+											   GetCurrentTimestamp(),
+											   pg_pathman_spawn_worker_idle_timeout * 1000);
+
+		SpinLockAcquire(&spawn_pool->mutex);
+
+		request_idx = claim_spawn_request(worker_idx, &segment);
+
+		/* Leave only if nobody's waiting for us */
+		if (request_idx < 0 && timed_out)
+			slot->worker_status = CPS_STOPPING;
+
+		SpinLockRelease(&spawn_pool->mutex);
+
+		if (request_idx >= 0)
+		{
+			process_spawn_request(segment, owner, request_mcxt);
+			complete_spawn_request(request_idx);
+
+			SpinLockAcquire(&spawn_pool->mutex);
+			slot->relid = InvalidOid;
+			slot->processed++;
+			SpinLockRelease(&spawn_pool->mutex);
+
+			idle_since = GetCurrentTimestamp();
+			continue;
+		}
+
+		if (timed_out)
+			break;
+
+		rc = WaitLatchCompat(MyLatch,
+							 WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+							 SPAWN_POOL_POLL_INTERVAL);
+
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		ResetLatch(MyLatch);
+	}
+}
+
+
+/*
+ * Return list of long-lived SpawnPartitionsWorkers.
+ * NOTE: this is a set-returning-function (SRF).
+ */
+Datum
+show_spawn_workers_internal(PG_FUNCTION_ARGS)
+{
+	FuncCallContext		   *funcctx;
+	active_workers_cxt	   *userctx;
+	int						i;
+
+	/*
+	 * Initialize tuple descriptor & function call context.
+	 */
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc			tupdesc;
+		MemoryContext		old_mcxt;
+
+		funcctx = SRF_FIRSTCALL_INIT();
+
+		old_mcxt = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		userctx = (active_workers_cxt *) palloc(sizeof(active_workers_cxt));
+		userctx->cur_idx = 0;
+
+		/* Create tuple descriptor */
+		tupdesc = CreateTemplateTupleDescCompat(Natts_pathman_spawn_workers, false);
+
+		TupleDescInitEntry(tupdesc, Anum_pathman_spawn_workers_userid,
+						   "userid", REGROLEOID, -1, 0);
+		TupleDescInitEntry(tupdesc, Anum_pathman_spawn_workers_pid,
+						   "pid", INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, Anum_pathman_spawn_workers_dbid,
+						   "dbid", OIDOID, -1, 0);
+		TupleDescInitEntry(tupdesc, Anum_pathman_spawn_workers_relid,
+						   "relid", REGCLASSOID, -1, 0);
+		TupleDescInitEntry(tupdesc, Anum_pathman_spawn_workers_processed,
+						   "processed", INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, Anum_pathman_spawn_workers_status,
+						   "status", TEXTOID, -1, 0);
+
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+		funcctx->user_fctx = (void *) userctx;
+
+		MemoryContextSwitchTo(old_mcxt);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	userctx = (active_workers_cxt *) funcctx->user_fctx;
+
+	/* Iterate through worker slots */
+	for (i = userctx->cur_idx; i < PART_WORKER_SLOTS; i++)
+	{
+		SpawnWorkerSlot		slot_copy;
+		HeapTuple			htup = NULL;
+
+		/* Copy slot to process local memory */
+		SpinLockAcquire(&spawn_pool->mutex);
+		memcpy(&slot_copy, &spawn_worker_slots[i], sizeof(SpawnWorkerSlot));
+		SpinLockRelease(&spawn_pool->mutex);
+
+		if (slot_copy.worker_status != CPS_FREE)
+		{
+			Datum		values[Natts_pathman_spawn_workers];
+			bool		isnull[Natts_pathman_spawn_workers] = { 0 };
+			const char *status;
+
+			values[Anum_pathman_spawn_workers_userid - 1]	= slot_copy.userid;
+			values[Anum_pathman_spawn_workers_pid - 1]		= slot_copy.pid;
+			values[Anum_pathman_spawn_workers_dbid - 1]		= slot_copy.dbid;
+
+			/* Table of current request */
+			values[Anum_pathman_spawn_workers_relid - 1] = slot_copy.relid;
+			isnull[Anum_pathman_spawn_workers_relid - 1] = !OidIsValid(slot_copy.relid);
+
+			/* Record served requests */
+			values[Anum_pathman_spawn_workers_processed - 1] =
+					Int64GetDatum(slot_copy.processed);
+
+			/* Now build a status string */
+			if (slot_copy.worker_status == CPS_STOPPING)
+				status = cps_print_status(CPS_STOPPING);
+			else if (OidIsValid(slot_copy.relid))
+				status = cps_print_status(CPS_WORKING);
+			else
+				status = "idle";
+
+			values[Anum_pathman_spawn_workers_status - 1] =
+					CStringGetTextDatum(status);
+
+			/* Form output tuple */
+			htup = heap_form_tuple(funcctx->tuple_desc, values, isnull);
+
+			/* Switch to next worker */
+			userctx->cur_idx = i + 1;
+		}
+
+		/* Return tuple if needed */
+		if (htup)
+			SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(htup));
+	}
+
+	SRF_RETURN_DONE(funcctx);
+}
+
+
+/*
+ * -------------------------------------
+ *  ConcurrentPartWorker implementation
+ * -------------------------------------
+ */
+
+/* Free bgworker's CPS slot */
+static void
+free_cps_slot(int code, Datum arg)
+{
+	ConcurrentPartSlot *part_slot = (ConcurrentPartSlot *) DatumGetPointer(arg);
+
+	cps_set_status(part_slot, CPS_FREE);
+}
+
+/*
+ * Entry point for ConcurrentPartWorker's process.
+ */
+void
+bgw_main_concurrent_part(Datum main_arg)
+{
+	ConcurrentPartSlot *part_slot;
+	char			   *sql = NULL;
+	int64				rows;
+	volatile bool		failed;
+	volatile int		failures_count = 0;
+	LOCKMODE			lockmode = RowExclusiveLock;
+
+	/* Update concurrent part slot */
+	part_slot = &concurrent_part_slots[DatumGetInt32(main_arg)];
+	part_slot->pid = MyProcPid;
+
+	/* Establish atexit callback that will fre CPS slot */
+	on_proc_exit(free_cps_slot, PointerGetDatum(part_slot));
+
+	/* Establish signal handlers before unblocking signals */
+	pqsignal(SIGTERM, handle_sigterm);
+
+	/* We're now ready to receive signals */
+	BackgroundWorkerUnblockSignals();
+
+	/* Create resource owner */
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, concurrent_part_bgw);
+
+	/* Disable auto partition propagation */
+	SetAutoPartitionEnabled(false);
+
+	/* Establish connection and start transaction */
+	BackgroundWorkerInitializeConnectionByOidCompat(part_slot->dbid, part_slot->userid);
+
+	/* Initialize pg_pathman's local config */
+	StartTransactionCommand();
+	bg_worker_load_config(concurrent_part_bgw);
+	CommitTransactionCommand();
+
+	/* Do the job */
+	do
+	{
+		MemoryContext old_mcxt;
+
+		Oid		types[2]	= { OIDOID,				INT4OID };
+		Datum	vals[2]		= { part_slot->relid,	part_slot->batch_size };
+
+		volatile bool	rel_locked = false;
+
+		/* Reset loop variables */
+		failed = false;
+		rows = 0;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Start new transaction (syscache access etc.) */
+		StartTransactionCommand();
+
+		/* We'll need this to recover from errors */
+		old_mcxt = CurrentMemoryContext;
+
+		if (SPI_connect() != SPI_OK_CONNECT)
+			elog(ERROR, "could not connect using SPI");
+
+		PushActiveSnapshot(GetTransactionSnapshot());
+
+		/* Prepare the query if needed */
+		if (sql == NULL)
+		{
+			MemoryContext	current_mcxt;
+
+			/*
+			 * Allocate SQL query in TopPathmanContext because current
+			 * context will be destroyed after transaction finishes
+			 */
+			current_mcxt = MemoryContextSwitchTo(TopPathmanContext);
+			sql = psprintf("SELECT %s._partition_data_concurrent($1::regclass, NULL::text, NULL::text, p_limit:=$2)",
+						   get_namespace_name(get_pathman_schema()));
+			MemoryContextSwitchTo(current_mcxt);
+		}
+
+		/* Exec ret = _partition_data_concurrent() */
+		PG_TRY();
+		{
+			int		ret;
+			bool	isnull;
+
+			/* Lock relation for DELETE and INSERT */
+			if (!ConditionalLockRelationOid(part_slot->relid, lockmode))
+			{
+				elog(ERROR, "could not take lock on relation %u", part_slot->relid);
+			}
+
+			/* Great, now relation is locked */
+			rel_locked = true;
+
+			/* Make sure that relation exists */
+			if (!SearchSysCacheExists1(RELOID, ObjectIdGetDatum(part_slot->relid)))
+			{
+				/* Exit after we raise ERROR */
 				failures_count = PART_WORKER_MAX_ATTEMPTS;
 
-				elog(ERROR, "relation \"%s\" is not partitioned",
-					 get_rel_name(part_slot->relid));
-			}
+				elog(ERROR, "relation %u does not exist", part_slot->relid);
+			}
+
+			/* Make sure that relation has partitions */
+			if (!has_pathman_relation_info(part_slot->relid))
+			{
+				/* Exit after we raise ERROR */
+				failures_count = PART_WORKER_MAX_ATTEMPTS;
+
+				elog(ERROR, "relation \"%s\" is not partitioned",
+					 get_rel_name(part_slot->relid));
+			}
+
+			/* Call concurrent partitioning function */
+			ret = SPI_execute_with_args(sql, 2, types, vals, NULL, false, 0);
+			if (ret == SPI_OK_SELECT)
+			{
+				TupleDesc	tupdesc	= SPI_tuptable->tupdesc;
+				HeapTuple	tuple	= SPI_tuptable->vals[0];
+
+				/* There should be 1 result at most */
+				Assert(SPI_processed == 1);
+
+				/* Extract number of processed rows */
+				rows = DatumGetInt64(SPI_getbinval(tuple, tupdesc, 1, &isnull));
+				Assert(TupleDescAttr(tupdesc, 0)->atttypid == INT8OID); /* check type */
+				Assert(!isnull); /* ... and ofc it must not be NULL */
+			}
+			/* Else raise generic error */
+			else elog(ERROR, "partitioning function returned %u", ret);
+
+			/* Finally, unlock our partitioned table */
+			UnlockRelationOid(part_slot->relid, lockmode);
+		}
+		PG_CATCH();
+		{
+			/*
+			 * The most common exception we can catch here is a deadlock with
+			 * concurrent user queries. Check that attempts count doesn't exceed
+			 * some reasonable value.
+			 */
+			ErrorData *error;
+
+			/* Unlock relation if we caught ERROR too early */
+			if (rel_locked)
+				UnlockRelationOid(part_slot->relid, lockmode);
+
+			/* Increase number of failures and set 'failed' status */
+			failures_count++;
+			failed = true;
+
+			/* Switch to the original context & copy edata */
+			MemoryContextSwitchTo(old_mcxt);
+			error = CopyErrorData();
+			FlushErrorState();
+
+			/* Print message for this BGWorker to server log */
+			ereport(LOG,
+					(errmsg("%s: %s", concurrent_part_bgw, error->message),
+					 errdetail("attempt: %d/%d, sleep time: %.2f",
+							   failures_count,
+							   PART_WORKER_MAX_ATTEMPTS,
+							   (float) part_slot->sleep_time)));
+
+			/* Finally, free error data */
+			FreeErrorData(error);
+		}
+		PG_END_TRY();
+
+		SPI_finish();
+		PopActiveSnapshot();
+
+		/* We've run out of attempts, exit */
+		if (failures_count >= PART_WORKER_MAX_ATTEMPTS)
+		{
+			AbortCurrentTransaction();
+
+			/* Mark slot as FREE */
+			cps_set_status(part_slot, CPS_FREE);
+
+			elog(LOG,
+				 "concurrent partitioning worker has canceled the task because "
+				 "maximum amount of attempts (%d) had been exceeded, "
+				 "see the error message below",
+				 PART_WORKER_MAX_ATTEMPTS);
+
+			return; /* time to exit */
+		}
+
+		/* Failed this time, wait */
+		else if (failed)
+		{
+			/* Abort transaction */
+			AbortCurrentTransaction();
+
+			/* Sleep for a specified amount of time (default 1s) */
+			DirectFunctionCall1(pg_sleep, Float8GetDatum(part_slot->sleep_time));
+		}
+
+		/* Everything is fine */
+		else
+		{
+			/* Commit transaction and reset 'failures_count' */
+			CommitTransactionCommand();
+			failures_count = 0;
+
+			/* Add rows to total_rows */
+			SpinLockAcquire(&part_slot->mutex);
+			part_slot->total_rows += rows;
+			SpinLockRelease(&part_slot->mutex);
+
+#ifdef USE_ASSERT_CHECKING
+			/* Report debug message */
+			elog(DEBUG1, "%s: "
+						 "relocated" INT64_FORMAT "rows, "
+						 "total: " INT64_FORMAT,
+				 concurrent_part_bgw, rows, part_slot->total_rows);
+#endif
+		}
+
+		/* If other backend requested to stop us, quit */
+		if (cps_check_status(part_slot) == CPS_STOPPING)
+			break;
+	}
+	while(rows > 0 || failed); /* do while there's still rows to be relocated */
+}
+
+
+/*
+ * -----------------------------------------------
+ *  Public interface for the ConcurrentPartWorker
+ * -----------------------------------------------
+ */
+
+/*
+ * Start concurrent partitioning worker to redistribute rows.
+ * NOTE: this function returns immediately.
+ */
+Datum
+partition_table_concurrently(PG_FUNCTION_ARGS)
+{
+	Oid				relid = PG_GETARG_OID(0);
+	int32			batch_size = PG_GETARG_INT32(1);
+	float8			sleep_time = PG_GETARG_FLOAT8(2);
+	int				empty_slot_idx = -1,		/* do we have a slot for BGWorker? */
+					i;
+	TransactionId	rel_xmin;
+	LOCKMODE		lockmode = ShareUpdateExclusiveLock;
+
+	/* Check batch_size */
+	if (batch_size < 1 || batch_size > 10000)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("'batch_size' should not be less than 1"
+							   " or greater than 10000")));
+
+	/* Check sleep_time */
+	if (sleep_time < 0.5)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("'sleep_time' should not be less than 0.5")));
+
+	check_relation_oid(relid);
+
+	/* Prevent concurrent function calls */
+	LockRelationOid(relid, lockmode);
+
+	/* Check if relation is a partitioned table */
+	if (!has_pathman_relation_info(relid))
+		shout_if_prel_is_invalid(relid, NULL, PT_ANY);
+
+	/* Check that partitioning operation result is visible */
+	if (pathman_config_contains_relation(relid, NULL, NULL, &rel_xmin, NULL))
+	{
+		if (!xact_object_is_visible(rel_xmin))
+			ereport(ERROR, (errmsg("cannot start %s", concurrent_part_bgw),
+							errdetail("table is being partitioned now")));
+	}
+	else ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("relation \"%s\" is not partitioned",
+								get_rel_name_or_relid(relid))));
+
+	/*
+	 * Look for an empty slot and also check that a concurrent
+	 * partitioning operation for this table hasn't started yet.
+	 */
+	for (i = 0; i < PART_WORKER_SLOTS; i++)
+	{
+		ConcurrentPartSlot *cur_slot = &concurrent_part_slots[i];
+		bool				keep_this_lock = false;
+
+		/* Lock current slot */
+		SpinLockAcquire(&cur_slot->mutex);
+
+		/* Should we take this slot into account? (it should be FREE) */
+		if (empty_slot_idx < 0 && cur_slot->worker_status == CPS_FREE)
+		{
+			empty_slot_idx = i;		/* yes, remember this slot */
+			keep_this_lock = true;	/* also don't unlock it */
+		}
+
+		/* Oops, looks like we already have BGWorker for this table */
+		if (cur_slot->relid == relid &&
+			cur_slot->dbid == MyDatabaseId &&
+			cur_slot->worker_status != CPS_FREE)
+		{
+			/* Unlock current slot */
+			SpinLockRelease(&cur_slot->mutex);
+
+			/* Release borrowed slot for new BGWorker too */
+			if (empty_slot_idx >= 0 && empty_slot_idx != i)
+				SpinLockRelease(&concurrent_part_slots[empty_slot_idx].mutex);
+
+			ereport(ERROR, (errmsg("table \"%s\" is already being partitioned",
+								   get_rel_name(relid))));
+		}
+
+		/* Normally we don't want to keep it */
+		if (!keep_this_lock)
+			SpinLockRelease(&cur_slot->mutex);
+	}
+
+	/* Looks like we could not find an empty slot */
+	if (empty_slot_idx < 0)
+		ereport(ERROR, (errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+						errmsg("no empty worker slots found"),
+						errhint("consider increasing max_worker_processes")));
+	else
+	{
+		/* Initialize concurrent part slot */
+		InitConcurrentPartSlot(&concurrent_part_slots[empty_slot_idx],
+							   GetUserId(), CPS_WORKING, MyDatabaseId,
+							   relid, batch_size, sleep_time);
+
+		/* Now we can safely unlock slot for new BGWorker */
+		SpinLockRelease(&concurrent_part_slots[empty_slot_idx].mutex);
+	}
+
+	/* Start worker (we should not wait) */
+	if (!start_bgworker(concurrent_part_bgw,
+						CppAsString(bgw_main_concurrent_part),
+						Int32GetDatum(empty_slot_idx),
+						NULL, 0,
+						false, NULL))
+	{
+		/* Couldn't start, free CPS slot */
+		cps_set_status(&concurrent_part_slots[empty_slot_idx], CPS_FREE);
+
+		start_bgworker_errmsg(concurrent_part_bgw);
+	}
+
+	/* Tell user everything's fine */
+	elog(NOTICE,
+		 "worker started, you can stop it "
+		 "with the following command: select %s.%s('%s');",
+		 get_namespace_name(get_pathman_schema()),
+		 CppAsString(stop_concurrent_part_task),
+		 get_rel_name(relid));
+
+	/* We don't need this lock anymore */
+	UnlockRelationOid(relid, lockmode);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Return list of active concurrent partitioning workers.
+ * NOTE: this is a set-returning-function (SRF).
+ */
+Datum
+show_concurrent_part_tasks_internal(PG_FUNCTION_ARGS)
+{
+	FuncCallContext		   *funcctx;
+	active_workers_cxt	   *userctx;
+	int						i;
+
+	/*
+	 * Initialize tuple descriptor & function call context.
+	 */
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc			tupdesc;
+		MemoryContext		old_mcxt;
+
+		funcctx = SRF_FIRSTCALL_INIT();
+
+		old_mcxt = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		userctx = (active_workers_cxt *) palloc(sizeof(active_workers_cxt));
+		userctx->cur_idx = 0;
+
+		/* Create tuple descriptor */
+		tupdesc = CreateTemplateTupleDescCompat(Natts_pathman_cp_tasks, false);
+
+		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_userid,
+						   "userid", REGROLEOID, -1, 0);
+		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_pid,
+						   "pid", INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_dbid,
+						   "dbid", OIDOID, -1, 0);
+		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_relid,
+						   "relid", REGCLASSOID, -1, 0);
+		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_processed,
+						   "processed", INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_status,
+						   "status", TEXTOID, -1, 0);
+
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+		funcctx->user_fctx = (void *) userctx;
+
+		MemoryContextSwitchTo(old_mcxt);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	userctx = (active_workers_cxt *) funcctx->user_fctx;
+
+	/* Iterate through worker slots */
+	for (i = userctx->cur_idx; i < PART_WORKER_SLOTS; i++)
+	{
+		ConcurrentPartSlot *cur_slot = &concurrent_part_slots[i],
+							slot_copy;
+		HeapTuple			htup = NULL;
+
+		/* Copy slot to process local memory */
+		SpinLockAcquire(&cur_slot->mutex);
+		memcpy(&slot_copy, cur_slot, sizeof(ConcurrentPartSlot));
+		SpinLockRelease(&cur_slot->mutex);
+
+		if (slot_copy.worker_status != CPS_FREE)
+		{
+			Datum		values[Natts_pathman_cp_tasks];
+			bool		isnull[Natts_pathman_cp_tasks] = { 0 };
+
+			values[Anum_pathman_cp_tasks_userid - 1]	= slot_copy.userid;
+			values[Anum_pathman_cp_tasks_pid - 1]		= slot_copy.pid;
+			values[Anum_pathman_cp_tasks_dbid - 1]		= slot_copy.dbid;
+			values[Anum_pathman_cp_tasks_relid - 1]		= slot_copy.relid;
+
+			/* Record processed rows */
+			values[Anum_pathman_cp_tasks_processed - 1]	=
+					Int64GetDatum(slot_copy.total_rows);
+
+			/* Now build a status string */
+			values[Anum_pathman_cp_tasks_status - 1] =
+					CStringGetTextDatum(cps_print_status(slot_copy.worker_status));
+
+			/* Form output tuple */
+			htup = heap_form_tuple(funcctx->tuple_desc, values, isnull);
+
+			/* Switch to next worker */
+			userctx->cur_idx = i + 1;
+		}
+
+		/* Return tuple if needed */
+		if (htup)
+			SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(htup));
+	}
+
+	SRF_RETURN_DONE(funcctx);
+}
+
+/*
+ * Stop the specified concurrent partitioning worker.
+ * NOTE: worker will stop after it finishes a batch.
+ */
+Datum
+stop_concurrent_part_task(PG_FUNCTION_ARGS)
+{
+	Oid		relid = PG_GETARG_OID(0);
+	bool	worker_found = false;
+	int		i;
+
+	for (i = 0; i < PART_WORKER_SLOTS && !worker_found; i++)
+	{
+		ConcurrentPartSlot *cur_slot = &concurrent_part_slots[i];
+
+		SpinLockAcquire(&cur_slot->mutex);
+
+		if (cur_slot->worker_status != CPS_FREE &&
+			cur_slot->relid == relid &&
+			cur_slot->dbid == MyDatabaseId)
+		{
+			/* Change worker's state & set 'worker_found' */
+			cur_slot->worker_status = CPS_STOPPING;
+			worker_found = true;
+		}
+
+		SpinLockRelease(&cur_slot->mutex);
+	}
+
+	if (worker_found)
+	{
+		elog(NOTICE, "worker will stop after it finishes current batch");
+		PG_RETURN_BOOL(true);
+	}
+	else
+	{
+		elog(ERROR, "cannot find worker for relation \"%s\"",
+			 get_rel_name_or_relid(relid));
+
+		PG_RETURN_BOOL(false); /* keep compiler happy */
+	}
+}
+
+
+/*
+ * --------------------------------------
+ *  RefreshZoneMapsWorker implementation
+ * --------------------------------------
+ */
+
+/*
+ * Entry point for RefreshZoneMapsWorker's process.
+ * Each partition is processed in a separate transaction,
+ * thus writers are blocked only for a short period of time.
+ */
+void
+bgw_main_refresh_zone_maps(Datum main_arg)
+{
+	RefreshZoneMapsArgs		args;
+	PartRelationInfo	   *prel;
+	Oid					   *children;
+	uint32					children_count,
+							i;
+	char				   *sql;
+	MemoryContext			old_mcxt;
+
+	/* Read args passed via bgw_extra */
+	memcpy(&args, MyBgworkerEntry->bgw_extra, sizeof(RefreshZoneMapsArgs));
+
+	/* Establish signal handlers before unblocking signals */
+	pqsignal(SIGTERM, handle_sigterm);
+
+	/* We're now ready to receive signals */
+	BackgroundWorkerUnblockSignals();
+
+	/* Create resource owner */
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, refresh_zone_maps_bgw);
+
+	/* Establish connection and start transaction */
+	BackgroundWorkerInitializeConnectionByOidCompat(args.dbid, args.userid);
+
+	/* Initialize pg_pathman's local config */
+	StartTransactionCommand();
+	bg_worker_load_config(refresh_zone_maps_bgw);
+
+	if ((prel = get_pathman_relation_info(args.relid)) == NULL)
+	{
+		elog(LOG, "%s: relation %u is not partitioned",
+			 refresh_zone_maps_bgw, args.relid);
+
+		CommitTransactionCommand();
+		return;
+	}
+
+	/* Both will be used after this transaction finishes */
+	old_mcxt = MemoryContextSwitchTo(TopPathmanContext);
+
+	children_count = PrelChildrenCount(prel);
+	children = palloc(Max(children_count, 1) * sizeof(Oid));
+	memcpy(children, PrelGetChildrenArray(prel), children_count * sizeof(Oid));
+
+	sql = psprintf("SELECT %s.refresh_zone_maps($1, $2)",
+				   quote_identifier(get_namespace_name(get_pathman_schema())));
+
+	MemoryContextSwitchTo(old_mcxt);
+
+	close_pathman_relation_info(prel);
+	CommitTransactionCommand();
+
+	for (i = 0; i < children_count; i++)
+	{
+		Oid				types[2]	= { REGCLASSOID,	REGCLASSOID };
+		Datum			vals[2]		= { ObjectIdGetDatum(args.relid),
+										ObjectIdGetDatum(children[i]) };
+		volatile bool	failed = false;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Start new transaction (syscache access etc.) */
+		StartTransactionCommand();
+
+		/* We'll need this to recover from errors */
+		old_mcxt = CurrentMemoryContext;
+
+		if (SPI_connect() != SPI_OK_CONNECT)
+			elog(ERROR, "could not connect using SPI");
+
+		PushActiveSnapshot(GetTransactionSnapshot());
+
+		PG_TRY();
+		{
+			/* Partition might have been dropped meanwhile */
+			if (SearchSysCacheExists1(RELOID, ObjectIdGetDatum(children[i])) &&
+				SPI_execute_with_args(sql, 2, types, vals,
+									  NULL, false, 0) != SPI_OK_SELECT)
+				elog(ERROR, "could not refresh zone maps of partition %u",
+					 children[i]);
+		}
+		PG_CATCH();
+		{
+			ErrorData *error;
+
+			failed = true;
+
+			/* Switch to the original context & copy edata */
+			MemoryContextSwitchTo(old_mcxt);
+			error = CopyErrorData();
+			FlushErrorState();
+
+			/* Print message for this BGWorker to server log */
+			ereport(LOG,
+					(errmsg("%s: %s", refresh_zone_maps_bgw, error->message),
+					 errdetail("partition: %u", children[i])));
+
+			/* Finally, free error data */
+			FreeErrorData(error);
+		}
+		PG_END_TRY();
+
+		SPI_finish();
+		PopActiveSnapshot();
+
+		/* Move on to the next partition anyway */
+		if (failed)
+			AbortCurrentTransaction();
+		else
+			CommitTransactionCommand();
+	}
+
+	elog(LOG, "%s: processed %u partitions of relation %u [%u]",
+		 refresh_zone_maps_bgw, children_count, args.relid, MyProcPid);
+}
+
+/*
+ * Start a worker which will refresh zone maps of all partitions.
+ * NOTE: this function returns immediately.
+ */
+Datum
+refresh_zone_maps_concurrently(PG_FUNCTION_ARGS)
+{
+	Oid					relid = PG_GETARG_OID(0);
+	RefreshZoneMapsArgs	args;
+
+	check_relation_oid(relid);
+
+	/* Check if relation is a partitioned table */
+	if (!has_pathman_relation_info(relid))
+		shout_if_prel_is_invalid(relid, NULL, PT_ANY);
+
+	args.userid = GetUserId();
+	args.dbid = MyDatabaseId;
+	args.relid = relid;
+
+	/* Start worker (we should not wait) */
+	if (!start_bgworker(refresh_zone_maps_bgw,
+						CppAsString(bgw_main_refresh_zone_maps),
+						(Datum) 0,
+						&args, sizeof(RefreshZoneMapsArgs),
+						false, NULL))
+	{
+		start_bgworker_errmsg(refresh_zone_maps_bgw);
+	}
+
+	/* Tell user everything's fine */
+	elog(NOTICE, "worker started, zone maps of \"%s\" will be refreshed",
+		 get_rel_name(relid));
+
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * -----------------------------------
+ *  ParallelCopyWorker implementation
+ * -----------------------------------
+ */
+
+/* Tuple source of a ParallelCopyWorker (see PathmanCopyFromTuples()) */
+typedef struct
+{
+	ParallelCopyShared *shared;
+	shm_mq_handle	   *mqh;
+	TupleDesc			tupdesc;
+} ParallelCopyReceiver;
+
+/* Partition and the worker it has been assigned to */
+typedef struct
+{
+	Oid		partid;
+	int		worker_idx;
+} ParallelCopyRoute;
+
+
+/* Queues are placed right after the array of ParallelCopyWorkerStates */
+static Size
+parallel_copy_shared_size(int nworkers)
+{
+	return MAXALIGN(offsetof(ParallelCopyShared, workers) +
+					nworkers * sizeof(ParallelCopyWorkerState));
+}
+
+static shm_mq *
+parallel_copy_queue(ParallelCopyShared *shared, int worker_idx)
+{
+	return (shm_mq *) ((char *) shared +
+					   parallel_copy_shared_size(shared->nworkers) +
+					   (Size) worker_idx * PARALLEL_COPY_QUEUE_SIZE);
+}
+
+static inline ParallelCopyWorkerStatus
+pcw_check_status(ParallelCopyWorkerState *state)
+{
+	ParallelCopyWorkerStatus status;
+
+	SpinLockAcquire(&state->mutex);
+	status = state->status;
+	SpinLockRelease(&state->mutex);
+
+	return status;
+}
+
+static inline void
+pcw_set_status(ParallelCopyWorkerState *state, ParallelCopyWorkerStatus status)
+{
+	SpinLockAcquire(&state->mutex);
+	state->status = status;
+	SpinLockRelease(&state->mutex);
+}
+
+static inline ParallelCopyDecision
+pcw_check_decision(ParallelCopyShared *shared)
+{
+	ParallelCopyDecision decision;
+
+	SpinLockAcquire(&shared->mutex);
+	decision = shared->decision;
+	SpinLockRelease(&shared->mutex);
+
+	return decision;
+}
+
+/* Workers should not commit anything if leader has failed */
+static void
+parallel_copy_leader_detach(dsm_segment *segment, Datum arg)
+{
+	ParallelCopyShared *shared = (ParallelCopyShared *) DatumGetPointer(arg);
+
+	SpinLockAcquire(&shared->mutex);
+	if (shared->decision == PCD_UNDECIDED)
+		shared->decision = PCD_ABORT;
+	SpinLockRelease(&shared->mutex);
+}
+
+/* Let leader know that this worker has failed */
+static void
+parallel_copy_worker_detach(dsm_segment *segment, Datum arg)
+{
+	ParallelCopyWorkerState *state = (ParallelCopyWorkerState *) DatumGetPointer(arg);
+
+	SpinLockAcquire(&state->mutex);
+	if (state->status != PCW_COMMITTED)
+		state->status = PCW_FAILED;
+	SpinLockRelease(&state->mutex);
+}
+
+/* Fetch next tuple sent by leader */
+static bool
+parallel_copy_next_tuple(void *arg, ExprContext *econtext,
+						 Datum *values, bool *nulls,
+						 Oid *tuple_oid)
+{
+	ParallelCopyReceiver   *receiver = (ParallelCopyReceiver *) arg;
+	shm_mq_result			res;
+	Size					nbytes;
+	void				   *data;
+	HeapTupleData			tuple;
+	bool					done;
+
+	res = shm_mq_receive(receiver->mqh, &nbytes, &data, false);
+
+	if (res == SHM_MQ_DETACHED)
+	{
+		SpinLockAcquire(&receiver->shared->mutex);
+		done = receiver->shared->done;
+		SpinLockRelease(&receiver->shared->mutex);
+
+		/* Leader has sent all tuples */
+		if (done)
+			return false;
+
+		elog(ERROR, "%s: leader has detached unexpectedly [%u]",
+			 parallel_copy_bgw, MyProcPid);
+	}
+	else if (res != SHM_MQ_SUCCESS)
+		elog(ERROR, "%s: could not receive tuple [%u]",
+			 parallel_copy_bgw, MyProcPid);
+
+	/* Message might be overwritten by the next one */
+	tuple.t_len = nbytes;
+	tuple.t_data = (HeapTupleHeader) palloc(nbytes);
+	memcpy(tuple.t_data, data, nbytes);
+	ItemPointerSetInvalid(&tuple.t_self);
+	tuple.t_tableOid = InvalidOid;
+
+	heap_deform_tuple(&tuple, receiver->tupdesc, values, nulls);
+
+	return true;
+}
+
+/*
+ * Entry point for ParallelCopyWorker's process.
+ * Inserts tuples sent by leader and then waits for its decision.
+ */
+void
+bgw_main_parallel_copy(Datum main_arg)
+{
+	ParallelCopyArgs			args;
+	dsm_segment				   *segment;
+	ParallelCopyShared		   *shared;
+	ParallelCopyWorkerState	   *state;
+	ParallelCopyReceiver		receiver;
+	ParallelCopyDecision		decision;
+	shm_mq					   *mq;
+	Relation					rel;
+	uint64						processed;
+
+	/* Read args passed via bgw_extra */
+	memcpy(&args, MyBgworkerEntry->bgw_extra, sizeof(ParallelCopyArgs));
+
+	/* Establish signal handlers before unblocking signals */
+	pqsignal(SIGTERM, handle_sigterm);
+
+	/* We're now ready to receive signals */
+	BackgroundWorkerUnblockSignals();
+
+	/* Create resource owner */
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, parallel_copy_bgw);
+
+	/* Attach to dynamic shared memory */
+	if ((segment = dsm_attach(args.segment)) == NULL)
+		elog(ERROR, "%s: cannot attach to segment [%u]",
+			 parallel_copy_bgw, MyProcPid);
+	shared = (ParallelCopyShared *) dsm_segment_address(segment);
+	state = &shared->workers[args.worker_idx];
+
+	/* Don't let leader wait for us forever */
+	on_dsm_detach(segment, parallel_copy_worker_detach, PointerGetDatum(state));
+
+	/*
+	 * NOTE: we don't join leader's locking group: our transaction
+	 * commits independently, so we must respect locks held by
+	 * leader's transaction (e.g. uncommitted ALTER TABLE).
+	 */
+
+	/* Establish connection and start transaction */
+	BackgroundWorkerInitializeConnectionByOidCompat(shared->dbid, shared->userid);
+
+	/* Start new transaction (syscache access etc.) */
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+
+	/* Initialize pg_pathman's local config */
+	bg_worker_load_config(parallel_copy_bgw);
+
+	/* We're the only reader of this queue */
+	mq = parallel_copy_queue(shared, args.worker_idx);
+	shm_mq_set_receiver(mq, MyProc);
+
+	receiver.shared = shared;
+	receiver.mqh = shm_mq_attach(mq, segment, NULL);
+
+	rel = heap_open_compat(shared->relid, RowExclusiveLock);
+	receiver.tupdesc = RelationGetDescr(rel);
+
+	/* Insert tuples using routing of COPY FROM */
+	processed = PathmanCopyFromTuples(rel, parallel_copy_next_tuple, &receiver);
+
+	heap_close_compat(rel, NoLock);
+	PopActiveSnapshot();
+
+	/* Tell leader we're done */
+	SpinLockAcquire(&state->mutex);
+	state->status = PCW_READY;
+	state->processed = processed;
+	SpinLockRelease(&state->mutex);
+
+	/* Wait till every worker is ready (or some of them fails) */
+	while ((decision = pcw_check_decision(shared)) == PCD_UNDECIDED)
+		DirectFunctionCall1(pg_sleep, Float8GetDatum(PARALLEL_COPY_POLL_INTERVAL));
+
+	if (decision == PCD_COMMIT)
+	{
+		CommitTransactionCommand();
+		pcw_set_status(state, PCW_COMMITTED);
+	}
+	else AbortCurrentTransaction();
+
+	elog(LOG, "%s: %s " UINT64_FORMAT " rows of relation %u [%u]",
+		 parallel_copy_bgw,
+		 (decision == PCD_COMMIT ? "committed" : "rolled back"),
+		 processed, shared->relid, MyProcPid);
+
+	dsm_detach(segment);
+}
+
+/*
+ * Load rows of a server-side file into partitioned table using
+ * several ParallelCopyWorkers. Leader parses the file and sends
+ * tuples to workers; each partition is assigned to one of them.
+ *
+ * NOTE: workers commit their own transactions, thus rows
+ * remain in table even if caller's transaction is aborted.
+ */
+Datum
+copy_from_parallel(PG_FUNCTION_ARGS)
+{
+	Oid						relid = PG_GETARG_OID(0);
+	char				   *filename = TextDatumGetCString(PG_GETARG_DATUM(1));
+	int32					nworkers = PG_GETARG_INT32(2);
+	TransactionId			rel_xmin;
+	Size					segment_size;
+	dsm_segment			   *segment;
+	ParallelCopyShared	   *shared;
+	BackgroundWorkerHandle **handles;
+	shm_mq_handle		  **mqhs;
+	Relation				rel;
+	TupleDesc				tupdesc;
+	ParseState			   *pstate;
+#if PG_VERSION_NUM >= 140000 /* Structure changed in c532d15dddff */
+	CopyFromState			cstate;
+#else
+	CopyState				cstate;
+#endif
+	PartRelationInfo	   *prel;
+	EState				   *estate;
+	ExprContext			   *econtext;
+	ExprState			   *expr_state;
+	TupleTableSlot		   *slot;
+	Datum				   *values;
+	bool				   *nulls;
+	HTAB				   *routes;
+	HASHCTL					ctl;
+	int						next_worker = 0,
+							ncommitted = 0,
+							i;
+	bool					failed = false;
+	uint64					processed = 0;
+	MemoryContext			old_mcxt;
+
+	/* Workers read the file on behalf of current user */
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be superuser to COPY to or from a file")));
+
+	if (nworkers < 1 || nworkers > PARALLEL_COPY_MAX_WORKERS)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("'workers' should not be less than 1"
+							   " or greater than %d", PARALLEL_COPY_MAX_WORKERS)));
 
-			/* Call concurrent partitioning function */
-			ret = SPI_execute_with_args(sql, 2, types, vals, NULL, false, 0);
-			if (ret == SPI_OK_SELECT)
-			{
-				TupleDesc	tupdesc	= SPI_tuptable->tupdesc;
-				HeapTuple	tuple	= SPI_tuptable->vals[0];
+	check_relation_oid(relid);
 
-				/* There should be 1 result at most */
-				Assert(SPI_processed == 1);
+	/* Check if relation is a partitioned table */
+	if (!has_pathman_relation_info(relid))
+		shout_if_prel_is_invalid(relid, NULL, PT_ANY);
 
-				/* Extract number of processed rows */
-				rows = DatumGetInt64(SPI_getbinval(tuple, tupdesc, 1, &isnull));
-				Assert(TupleDescAttr(tupdesc, 0)->atttypid == INT8OID); /* check type */
-				Assert(!isnull); /* ... and ofc it must not be NULL */
-			}
-			/* Else raise generic error */
-			else elog(ERROR, "partitioning function returned %u", ret);
+	/* Workers can't see anything we haven't committed yet */
+	if (pathman_config_contains_relation(relid, NULL, NULL, &rel_xmin, NULL) &&
+		!xact_object_is_visible(rel_xmin))
+		ereport(ERROR, (errmsg("cannot start %s", parallel_copy_bgw),
+						errdetail("table is being partitioned now")));
+
+	/* Workers would wait for our transaction forever */
+	if (xact_insert_conflicting_lock_held(relid))
+		ereport(ERROR, (errmsg("cannot start %s", parallel_copy_bgw),
+						errdetail("table is locked by current transaction")));
+
+	if (get_rel_persistence(relid) == RELPERSISTENCE_TEMP)
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("cannot load temporary table \"%s\" in parallel",
+							   get_rel_name(relid))));
+
+	/* check read-only transaction and parallel mode */
+	PreventCommandIfReadOnly("COPY FROM");
+	PreventCommandIfParallelMode("COPY FROM");
+
+	/* Create a segment for shared state and queues */
+	segment_size = parallel_copy_shared_size(nworkers) +
+				   (Size) nworkers * PARALLEL_COPY_QUEUE_SIZE;
+	segment = dsm_create(segment_size, 0);
 
-			/* Finally, unlock our partitioned table */
-			UnlockRelationOid(part_slot->relid, lockmode);
-		}
-		PG_CATCH();
-		{
-			/*
-			 * The most common exception we can catch here is a deadlock with
-			 * concurrent user queries. Check that attempts count doesn't exceed
-			 * some reasonable value.
-			 */
-			ErrorData *error;
+	shared = (ParallelCopyShared *) dsm_segment_address(segment);
+	memset(shared, 0, parallel_copy_shared_size(nworkers));
 
-			/* Unlock relation if we caught ERROR too early */
-			if (rel_locked)
-				UnlockRelationOid(part_slot->relid, lockmode);
+	SpinLockInit(&shared->mutex);
+	shared->userid = GetUserId();
+	shared->dbid = MyDatabaseId;
+	shared->relid = relid;
+	shared->nworkers = nworkers;
+	shared->done = false;
+	shared->decision = PCD_UNDECIDED;
 
-			/* Increase number of failures and set 'failed' status */
-			failures_count++;
-			failed = true;
+	/* Abort workers' transactions if we fail */
+	on_dsm_detach(segment, parallel_copy_leader_detach, PointerGetDatum(shared));
 
-			/* Switch to the original context & copy edata */
-			MemoryContextSwitchTo(old_mcxt);
-			error = CopyErrorData();
-			FlushErrorState();
+	handles = (BackgroundWorkerHandle **) palloc(nworkers * sizeof(BackgroundWorkerHandle *));
+	mqhs = (shm_mq_handle **) palloc(nworkers * sizeof(shm_mq_handle *));
 
-			/* Print message for this BGWorker to server log */
-			ereport(LOG,
-					(errmsg("%s: %s", concurrent_part_bgw, error->message),
-					 errdetail("attempt: %d/%d, sleep time: %.2f",
-							   failures_count,
-							   PART_WORKER_MAX_ATTEMPTS,
-							   (float) part_slot->sleep_time)));
+	for (i = 0; i < nworkers; i++)
+	{
+		ParallelCopyArgs	args;
+		shm_mq			   *mq;
 
-			/* Finally, free error data */
-			FreeErrorData(error);
-		}
-		PG_END_TRY();
+		SpinLockInit(&shared->workers[i].mutex);
+		shared->workers[i].status = PCW_STARTING;
 
-		SPI_finish();
-		PopActiveSnapshot();
+		mq = shm_mq_create(parallel_copy_queue(shared, i), PARALLEL_COPY_QUEUE_SIZE);
+		shm_mq_set_sender(mq, MyProc);
 
-		/* We've run out of attempts, exit */
-		if (failures_count >= PART_WORKER_MAX_ATTEMPTS)
+		args.segment = dsm_segment_handle(segment);
+		args.worker_idx = i;
+
+		/* Start worker (we should not wait) */
+		if (!start_bgworker(parallel_copy_bgw,
+							CppAsString(bgw_main_parallel_copy),
+							(Datum) 0,
+							&args, sizeof(ParallelCopyArgs),
+							false, &handles[i]))
 		{
-			AbortCurrentTransaction();
+			start_bgworker_errmsg(parallel_copy_bgw);
+		}
 
-			/* Mark slot as FREE */
-			cps_set_status(part_slot, CPS_FREE);
+		/* Sending will fail if worker exits without attaching */
+		mqhs[i] = shm_mq_attach(mq, segment, handles[i]);
+	}
 
-			elog(LOG,
-				 "concurrent partitioning worker has canceled the task because "
-				 "maximum amount of attempts (%d) had been exceeded, "
-				 "see the error message below",
-				 PART_WORKER_MAX_ATTEMPTS);
+	/* Workers will take RowExclusiveLock as well */
+	rel = heap_open_compat(relid, AccessShareLock);
+	tupdesc = RelationGetDescr(rel);
 
-			return; /* time to exit */
+	pstate = make_parsestate(NULL);
+	cstate = BeginCopyFromCompat(pstate, rel, filename, false, NULL, NIL, NIL);
+
+	prel = get_pathman_relation_info(relid);
+	shout_if_prel_is_invalid(relid, prel, PT_ANY);
+
+	estate = CreateExecutorState();
+	econtext = GetPerTupleExprContext(estate);
+
+	old_mcxt = MemoryContextSwitchTo(estate->es_query_cxt);
+
+	/* Partitioning expression is computed only to choose a worker */
+	expr_state = ExecInitExpr((Expr *) PrelExpressionForRelid(prel, PART_EXPR_VARNO),
+							  NULL);
+	slot = ExecInitExtraTupleSlotCompat(estate, tupdesc, &TTSOpsHeapTuple);
+
+	values = (Datum *) palloc(tupdesc->natts * sizeof(Datum));
+	nulls = (bool *) palloc(tupdesc->natts * sizeof(bool));
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(ParallelCopyRoute);
+	ctl.hcxt = CurrentMemoryContext;
+
+	routes = hash_create("pg_pathman's parallel COPY routes", 64, &ctl,
+						 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	MemoryContextSwitchTo(old_mcxt);
+
+	for (;;)
+	{
+		HeapTuple			tuple;
+#if PG_VERSION_NUM < 120000
+		Oid					tuple_oid = InvalidOid;
+#endif
+		Datum				value;
+		bool				isnull;
+		Oid				   *parts;
+		int					nparts = 0,
+							worker_idx = 0;
+		shm_mq_result		res;
+
+		CHECK_FOR_INTERRUPTS();
+
+		ResetPerTupleExprContext(estate);
+		old_mcxt = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+
+		if (!NextCopyFromCompat(cstate, econtext, values, nulls, &tuple_oid))
+		{
+			MemoryContextSwitchTo(old_mcxt);
+			break;
 		}
 
-		/* Failed this time, wait */
-		else if (failed)
+		tuple = heap_form_tuple(tupdesc, values, nulls);
+#if PG_VERSION_NUM >= 120000
+		ExecStoreHeapTuple(tuple, slot, false);
+#else
+		ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+#endif
+
+		econtext->ecxt_scantuple = slot;
+		value = ExecEvalExprCompat(expr_state, econtext, &isnull);
+
+		/*
+		 * Missing partitions (and NULLs) are handled by the first
+		 * worker, so that only one of them creates new partitions.
+		 */
+		if (!isnull)
 		{
-			/* Abort transaction */
-			AbortCurrentTransaction();
+			parts = find_partitions_for_value(value, prel->ev_type, prel, &nparts);
 
-			/* Sleep for a specified amount of time (default 1s) */
-			DirectFunctionCall1(pg_sleep, Float8GetDatum(part_slot->sleep_time));
+			if (nparts == 1)
+			{
+				ParallelCopyRoute  *route;
+				bool				found;
+
+				route = (ParallelCopyRoute *) hash_search(routes,
+														  (const void *) &parts[0],
+														  HASH_ENTER, &found);
+				if (!found)
+					route->worker_idx = next_worker++ % nworkers;
+
+				worker_idx = route->worker_idx;
+			}
 		}
 
-		/* Everything is fine */
-		else
+		res = shm_mq_send_compat(mqhs[worker_idx], tuple->t_len, tuple->t_data, false);
+		if (res != SHM_MQ_SUCCESS)
+			ereport(ERROR,
+					(errmsg("%s has exited unexpectedly", parallel_copy_bgw),
+					 errhint("See server log for more details.")));
+
+		MemoryContextSwitchTo(old_mcxt);
+	}
+
+	EndCopyFrom(cstate);
+
+	/* Let workers know there's nothing left */
+	SpinLockAcquire(&shared->mutex);
+	shared->done = true;
+	SpinLockRelease(&shared->mutex);
+
+	for (i = 0; i < nworkers; i++)
+		shm_mq_detach_compat(mqhs[i]);
+
+	/* Wait till every worker is ready (or some of them fails) */
+	for (;;)
+	{
+		int nready = 0;
+
+		for (i = 0; i < nworkers; i++)
 		{
-			/* Commit transaction and reset 'failures_count' */
-			CommitTransactionCommand();
-			failures_count = 0;
+			ParallelCopyWorkerStatus	status = pcw_check_status(&shared->workers[i]);
+			BgwHandleStatus				bgw_status;
+			pid_t						pid;
 
-			/* Add rows to total_rows */
-			SpinLockAcquire(&part_slot->mutex);
-			part_slot->total_rows += rows;
-			SpinLockRelease(&part_slot->mutex);
+			if (status == PCW_READY)
+			{
+				nready++;
+				continue;
+			}
 
-#ifdef USE_ASSERT_CHECKING
-			/* Report debug message */
-			elog(DEBUG1, "%s: "
-						 "relocated" INT64_FORMAT "rows, "
-						 "total: " INT64_FORMAT,
-				 concurrent_part_bgw, rows, part_slot->total_rows);
-#endif
+			if (status == PCW_FAILED)
+			{
+				failed = true;
+				continue;
+			}
+
+			/* Worker has exited before attaching to segment */
+			bgw_status = GetBackgroundWorkerPid(handles[i], &pid);
+			if (bgw_status == BGWH_STOPPED ||
+				bgw_status == BGWH_POSTMASTER_DIED)
+				failed = true;
+
+			/* BGWH_NOT_YET_STARTED: postmaster hasn't forked it yet */
 		}
 
-		/* If other backend requested to stop us, quit */
-		if (cps_check_status(part_slot) == CPS_STOPPING)
+		if (failed || nready == nworkers)
 			break;
+
+		DirectFunctionCall1(pg_sleep, Float8GetDatum(PARALLEL_COPY_POLL_INTERVAL));
 	}
-	while(rows > 0 || failed); /* do while there's still rows to be relocated */
+
+	SpinLockAcquire(&shared->mutex);
+	shared->decision = (failed ? PCD_ABORT : PCD_COMMIT);
+	SpinLockRelease(&shared->mutex);
+
+	for (i = 0; i < nworkers; i++)
+	{
+		if (WaitForBackgroundWorkerShutdown(handles[i]) == BGWH_POSTMASTER_DIED)
+			ereport(ERROR,
+					(errmsg("Postmaster died during the pg_pathman background worker process"),
+					 errhint("More details may be available in the server log.")));
+
+		if (pcw_check_status(&shared->workers[i]) == PCW_COMMITTED)
+		{
+			processed += shared->workers[i].processed;
+			ncommitted++;
+		}
+	}
+
+	close_pathman_relation_info(prel);
+	FreeExecutorState(estate);
+	heap_close_compat(rel, AccessShareLock);
+
+	dsm_detach(segment);
+
+	if (failed)
+		ereport(ERROR,
+				(errmsg("parallel COPY into \"%s\" has failed",
+						get_rel_name(relid)),
+				 errhint("See server log for more details.")));
+
+	/* Some rows have been loaded anyway */
+	if (ncommitted < nworkers)
+		ereport(ERROR,
+				(errmsg("parallel COPY into \"%s\" has failed",
+						get_rel_name(relid)),
+				 errdetail("%d of %d workers have committed their rows.",
+						   ncommitted, nworkers),
+				 errhint("See server log for more details.")));
+
+	PG_RETURN_INT64((int64) processed);
+}
+
+
+/*
+ * -----------------------------------
+ *  ProvisioningWorker implementation
+ * -----------------------------------
+ */
+
+static inline ConcurrentPartSlotStatus
+ps_check_status(ProvisioningSlot *slot)
+{
+	ConcurrentPartSlotStatus status;
+
+	SpinLockAcquire(&slot->mutex);
+	status = slot->worker_status;
+	SpinLockRelease(&slot->mutex);
+
+	return status;
+}
+
+static inline void
+ps_set_status(ProvisioningSlot *slot, ConcurrentPartSlotStatus status)
+{
+	SpinLockAcquire(&slot->mutex);
+	slot->worker_status = status;
+	SpinLockRelease(&slot->mutex);
+}
+
+/* Free bgworker's provisioning slot */
+static void
+free_provisioning_slot(int code, Datum arg)
+{
+	ProvisioningSlot *slot = (ProvisioningSlot *) DatumGetPointer(arg);
+
+	ps_set_status(slot, CPS_FREE);
+}
+
+/*
+ * Count partitions created by INSERT (see create_partitions_for_value()).
+ */
+void
+count_partition_spawn(bool using_bgw)
+{
+	SpinLockAcquire(&spawn_stats->mutex);
+
+	if (using_bgw)
+		spawn_stats->bgw_spawns++;
+	else
+		spawn_stats->backend_spawns++;
+
+	SpinLockRelease(&spawn_stats->mutex);
+}
+
+/*
+ * Count partitions created ahead of time.
+ */
+void
+count_premade_partitions(int64 count)
+{
+	SpinLockAcquire(&spawn_stats->mutex);
+	spawn_stats->premade += count;
+	SpinLockRelease(&spawn_stats->mutex);
 }
 
+/*
+ * Entry point for ProvisioningWorker's process.
+ * Every 'naptime' seconds it calls premake_range_partitions()
+ * for each table which has 'premake' > 0, one table per transaction.
+ */
+void
+bgw_main_provisioning(Datum main_arg)
+{
+	ProvisioningSlot   *slot;
+	MemoryContext		old_mcxt,
+						round_mcxt;
+	char			   *list_sql,
+					   *premake_sql;
+
+	/* Update provisioning slot */
+	slot = &provisioning_slots[DatumGetInt32(main_arg)];
+	slot->pid = MyProcPid;
+
+	/* Establish atexit callback that will free the slot */
+	on_proc_exit(free_provisioning_slot, PointerGetDatum(slot));
+
+	/* Establish signal handlers before unblocking signals */
+	pqsignal(SIGTERM, handle_sigterm);
+
+	/* We're now ready to receive signals */
+	BackgroundWorkerUnblockSignals();
+
+	/* Create resource owner */
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, provisioning_bgw);
+
+	/* Establish connection and start transaction */
+	BackgroundWorkerInitializeConnectionByOidCompat(slot->dbid, slot->userid);
+
+	StartTransactionCommand();
+
+	/* ProvisioningLauncher doesn't know if pg_pathman is installed here */
+	if (slot->auto_started && !OidIsValid(get_pathman_schema()))
+	{
+		CommitTransactionCommand();
+		return;
+	}
+
+	/* Initialize pg_pathman's local config */
+	bg_worker_load_config(provisioning_bgw);
+
+	/* Queries will be used after this transaction finishes */
+	old_mcxt = MemoryContextSwitchTo(TopPathmanContext);
+
+	list_sql = psprintf("SELECT partrel FROM %s.%s WHERE premake > 0",
+						quote_identifier(get_namespace_name(get_pathman_schema())),
+						quote_identifier(PATHMAN_CONFIG_PARAMS));
+	premake_sql = psprintf("SELECT %s.premake_range_partitions($1)",
+						   quote_identifier(get_namespace_name(get_pathman_schema())));
+
+	MemoryContextSwitchTo(old_mcxt);
+	CommitTransactionCommand();
+
+	round_mcxt = AllocSetContextCreate(TopMemoryContext,
+									   "ProvisioningWorker round",
+									   ALLOCSET_DEFAULT_SIZES);
+
+	while (ps_check_status(slot) == CPS_WORKING)
+	{
+		List	   *relids = NIL;
+		ListCell   *lc;
+		float8		slept;
+		uint64		i;
+
+		CHECK_FOR_INTERRUPTS();
+
+		MemoryContextReset(round_mcxt);
+
+		/* Fetch tables which need partitions ahead of time */
+		StartTransactionCommand();
+
+		if (SPI_connect() != SPI_OK_CONNECT)
+			elog(ERROR, "could not connect using SPI");
+
+		PushActiveSnapshot(GetTransactionSnapshot());
+
+		if (SPI_execute(list_sql, true, 0) != SPI_OK_SELECT)
+			elog(ERROR, "could not read %s", PATHMAN_CONFIG_PARAMS);
+
+		old_mcxt = MemoryContextSwitchTo(round_mcxt);
+		for (i = 0; i < SPI_processed; i++)
+		{
+			bool	isnull;
+			Datum	relid = SPI_getbinval(SPI_tuptable->vals[i],
+										  SPI_tuptable->tupdesc,
+										  1, &isnull);
+
+			relids = lappend_oid(relids, DatumGetObjectId(relid));
+		}
+		MemoryContextSwitchTo(old_mcxt);
+
+		SPI_finish();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+
+		/* ProvisioningLauncher will check this database again later */
+		if (relids == NIL && slot->auto_started)
+			break;
+
+		foreach (lc, relids)
+		{
+			Oid				relid		= lfirst_oid(lc);
+			Oid				types[1]	= { REGCLASSOID };
+			Datum			vals[1]		= { ObjectIdGetDatum(relid) };
+			volatile bool	failed = false;
+			volatile int32	created = 0;
+
+			CHECK_FOR_INTERRUPTS();
+
+			/* Start new transaction (syscache access etc.) */
+			StartTransactionCommand();
+
+			/* We'll need this to recover from errors */
+			old_mcxt = CurrentMemoryContext;
+
+			if (SPI_connect() != SPI_OK_CONNECT)
+				elog(ERROR, "could not connect using SPI");
 
-/*
- * -----------------------------------------------
- *  Public interface for the ConcurrentPartWorker
- * -----------------------------------------------
- */
+			PushActiveSnapshot(GetTransactionSnapshot());
 
-/*
- * Start concurrent partitioning worker to redistribute rows.
- * NOTE: this function returns immediately.
- */
-Datum
-partition_table_concurrently(PG_FUNCTION_ARGS)
-{
-	Oid				relid = PG_GETARG_OID(0);
-	int32			batch_size = PG_GETARG_INT32(1);
-	float8			sleep_time = PG_GETARG_FLOAT8(2);
-	int				empty_slot_idx = -1,		/* do we have a slot for BGWorker? */
-					i;
-	TransactionId	rel_xmin;
-	LOCKMODE		lockmode = ShareUpdateExclusiveLock;
+			PG_TRY();
+			{
+				bool isnull;
+
+				/* Table might have been dropped meanwhile */
+				if (SearchSysCacheExists1(RELOID, ObjectIdGetDatum(relid)))
+				{
+					if (SPI_execute_with_args(premake_sql, 1, types, vals,
+											  NULL, false, 0) != SPI_OK_SELECT)
+						elog(ERROR, "could not create partitions of relation %u",
+							 relid);
+
+					created = DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[0],
+														  SPI_tuptable->tupdesc,
+														  1, &isnull));
+				}
+			}
+			PG_CATCH();
+			{
+				ErrorData *error;
 
-	/* Check batch_size */
-	if (batch_size < 1 || batch_size > 10000)
-		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-						errmsg("'batch_size' should not be less than 1"
-							   " or greater than 10000")));
+				failed = true;
 
-	/* Check sleep_time */
-	if (sleep_time < 0.5)
-		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-						errmsg("'sleep_time' should not be less than 0.5")));
+				/* Switch to the original context & copy edata */
+				MemoryContextSwitchTo(old_mcxt);
+				error = CopyErrorData();
+				FlushErrorState();
 
-	check_relation_oid(relid);
+				/* Print message for this BGWorker to server log */
+				ereport(LOG,
+						(errmsg("%s: %s", provisioning_bgw, error->message),
+						 errdetail("relation: %u", relid)));
 
-	/* Prevent concurrent function calls */
-	LockRelationOid(relid, lockmode);
+				/* Finally, free error data */
+				FreeErrorData(error);
+			}
+			PG_END_TRY();
 
-	/* Check if relation is a partitioned table */
-	if (!has_pathman_relation_info(relid))
-		shout_if_prel_is_invalid(relid, NULL, PT_ANY);
+			SPI_finish();
+			PopActiveSnapshot();
 
-	/* Check that partitioning operation result is visible */
-	if (pathman_config_contains_relation(relid, NULL, NULL, &rel_xmin, NULL))
-	{
-		if (!xact_object_is_visible(rel_xmin))
-			ereport(ERROR, (errmsg("cannot start %s", concurrent_part_bgw),
-							errdetail("table is being partitioned now")));
+			/* Move on to the next table anyway */
+			if (failed)
+				AbortCurrentTransaction();
+			else
+			{
+				CommitTransactionCommand();
+
+				SpinLockAcquire(&slot->mutex);
+				slot->premade += created;
+				SpinLockRelease(&slot->mutex);
+
+				if (created > 0)
+					elog(LOG, "%s: created %d partitions of relation %u [%u]",
+						 provisioning_bgw, created, relid, MyProcPid);
+			}
+		}
+
+		/* Sleep for 'naptime', unless we're asked to stop */
+		for (slept = 0;
+			 slept < slot->naptime && ps_check_status(slot) == CPS_WORKING;
+			 slept += PROVISIONING_POLL_INTERVAL)
+		{
+			DirectFunctionCall1(pg_sleep, Float8GetDatum(PROVISIONING_POLL_INTERVAL));
+		}
 	}
-	else ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-						 errmsg("relation \"%s\" is not partitioned",
-								get_rel_name_or_relid(relid))));
+}
+
+/*
+ * Find an empty provisioning slot and prepare it for worker of 'dbid'.
+ * Returns -1 if there's no empty slot or if this database already
+ * has a worker (then 'exists' is set).
+ */
+static int
+acquire_provisioning_slot(Oid dbid, Oid userid, float8 naptime,
+						  bool auto_started, bool *exists)
+{
+	int		empty_slot_idx = -1,
+			i;
+
+	*exists = false;
 
 	/*
-	 * Look for an empty slot and also check that a concurrent
-	 * partitioning operation for this table hasn't started yet.
+	 * Look for an empty slot and also check that
+	 * this database doesn't have a worker yet.
 	 */
 	for (i = 0; i < PART_WORKER_SLOTS; i++)
 	{
-		ConcurrentPartSlot *cur_slot = &concurrent_part_slots[i];
+		ProvisioningSlot   *cur_slot = &provisioning_slots[i];
 		bool				keep_this_lock = false;
 
 		/* Lock current slot */
@@ -751,9 +2886,8 @@ partition_table_concurrently(PG_FUNCTION_ARGS)
 			keep_this_lock = true;	/* also don't unlock it */
 		}
 
-		/* Oops, looks like we already have BGWorker for this table */
-		if (cur_slot->relid == relid &&
-			cur_slot->dbid == MyDatabaseId &&
+		/* Oops, looks like we already have BGWorker for this database */
+		if (cur_slot->dbid == dbid &&
 			cur_slot->worker_status != CPS_FREE)
 		{
 			/* Unlock current slot */
@@ -761,10 +2895,10 @@ partition_table_concurrently(PG_FUNCTION_ARGS)
 
 			/* Release borrowed slot for new BGWorker too */
 			if (empty_slot_idx >= 0 && empty_slot_idx != i)
-				SpinLockRelease(&concurrent_part_slots[empty_slot_idx].mutex);
+				SpinLockRelease(&provisioning_slots[empty_slot_idx].mutex);
 
-			ereport(ERROR, (errmsg("table \"%s\" is already being partitioned",
-								   get_rel_name(relid))));
+			*exists = true;
+			return -1;
 		}
 
 		/* Normally we don't want to keep it */
@@ -772,163 +2906,286 @@ partition_table_concurrently(PG_FUNCTION_ARGS)
 			SpinLockRelease(&cur_slot->mutex);
 	}
 
-	/* Looks like we could not find an empty slot */
-	if (empty_slot_idx < 0)
-		ereport(ERROR, (errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
-						errmsg("no empty worker slots found"),
-						errhint("consider increasing max_worker_processes")));
-	else
+	if (empty_slot_idx >= 0)
 	{
-		/* Initialize concurrent part slot */
-		InitConcurrentPartSlot(&concurrent_part_slots[empty_slot_idx],
-							   GetUserId(), CPS_WORKING, MyDatabaseId,
-							   relid, batch_size, sleep_time);
+		ProvisioningSlot *slot = &provisioning_slots[empty_slot_idx];
+
+		/* Initialize provisioning slot */
+		slot->worker_status = CPS_WORKING;
+		slot->userid = userid;
+		slot->pid = 0;
+		slot->dbid = dbid;
+		slot->naptime = naptime;
+		slot->premade = 0;
+		slot->auto_started = auto_started;
 
 		/* Now we can safely unlock slot for new BGWorker */
-		SpinLockRelease(&concurrent_part_slots[empty_slot_idx].mutex);
+		SpinLockRelease(&slot->mutex);
 	}
 
-	/* Start worker (we should not wait) */
-	if (!start_bgworker(concurrent_part_bgw,
-						CppAsString(bgw_main_concurrent_part),
-						Int32GetDatum(empty_slot_idx),
-						false))
-	{
-		/* Couldn't start, free CPS slot */
-		cps_set_status(&concurrent_part_slots[empty_slot_idx], CPS_FREE);
+	return empty_slot_idx;
+}
 
-		start_bgworker_errmsg(concurrent_part_bgw);
-	}
+/*
+ * Register ProvisioningLauncher, which starts ProvisioningWorkers
+ * for databases having tables with 'premake' > 0. Unlike workers
+ * started by start_provisioning_worker(), it's restarted by postmaster
+ * after server restart or crash. NOTE: called by _PG_init().
+ */
+void
+register_provisioning_launcher(void)
+{
+	BackgroundWorker	worker;
 
-	/* Tell user everything's fine */
-	elog(NOTICE,
-		 "worker started, you can stop it "
-		 "with the following command: select %s.%s('%s');",
-		 get_namespace_name(get_pathman_schema()),
-		 CppAsString(stop_concurrent_part_task),
-		 get_rel_name(relid));
+	/* It's an opt-in feature */
+	if (pg_pathman_provisioning_naptime <= 0)
+		return;
 
-	/* We don't need this lock anymore */
-	UnlockRelationOid(relid, lockmode);
+	memset(&worker, 0, sizeof(worker));
 
-	PG_RETURN_VOID();
+	snprintf(worker.bgw_name, BGW_MAXLEN, "%s", provisioning_launcher_bgw);
+	snprintf(worker.bgw_function_name, BGW_MAXLEN, "%s",
+			 CppAsString(bgw_main_provisioning_launcher));
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "pg_pathman");
+
+	worker.bgw_flags			= BGWORKER_SHMEM_ACCESS |
+								  BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time		= BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time		= PROVISIONING_LAUNCHER_RESTART;
+	worker.bgw_main_arg			= (Datum) 0;
+	worker.bgw_notify_pid		= 0;
+
+	RegisterBackgroundWorker(&worker);
 }
 
-/*
- * Return list of active concurrent partitioning workers.
- * NOTE: this is a set-returning-function (SRF).
- */
-Datum
-show_concurrent_part_tasks_internal(PG_FUNCTION_ARGS)
+/* Return Oids of databases which accept connections */
+static List *
+list_connectable_databases(void)
 {
-	FuncCallContext		   *funcctx;
-	active_workers_cxt	   *userctx;
-	int						i;
+	List		   *result = NIL;
+	Relation		rel;
+	Snapshot		snapshot;
+#if PG_VERSION_NUM >= 120000
+	TableScanDesc	scan;
+#else
+	HeapScanDesc	scan;
+#endif
+	HeapTuple		htup;
+
+	rel = heap_open_compat(DatabaseRelationId, AccessShareLock);
+	snapshot = RegisterSnapshot(GetLatestSnapshot());
+#if PG_VERSION_NUM >= 120000
+	scan = table_beginscan(rel, snapshot, 0, NULL);
+#else
+	scan = heap_beginscan(rel, snapshot, 0, NULL);
+#endif
 
-	/*
-	 * Initialize tuple descriptor & function call context.
-	 */
-	if (SRF_IS_FIRSTCALL())
+	while ((htup = heap_getnext(scan, ForwardScanDirection)) != NULL)
 	{
-		TupleDesc			tupdesc;
-		MemoryContext		old_mcxt;
+		Form_pg_database db = (Form_pg_database) GETSTRUCT(htup);
 
-		funcctx = SRF_FIRSTCALL_INIT();
+		if (db->datistemplate || !db->datallowconn)
+			continue;
 
-		old_mcxt = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+#ifdef DATCONNLIMIT_INVALID_DB
+		/* Skip databases left by interrupted DROP DATABASE */
+		if (db->datconnlimit == DATCONNLIMIT_INVALID_DB)
+			continue;
+#endif
 
-		userctx = (active_workers_cxt *) palloc(sizeof(active_workers_cxt));
-		userctx->cur_idx = 0;
+#if PG_VERSION_NUM >= 120000
+		result = lappend_oid(result, db->oid);
+#else
+		result = lappend_oid(result, HeapTupleGetOid(htup));
+#endif
+	}
 
-		/* Create tuple descriptor */
-		tupdesc = CreateTemplateTupleDescCompat(Natts_pathman_cp_tasks, false);
+#if PG_VERSION_NUM >= 120000
+	table_endscan(scan);
+#else
+	heap_endscan(scan);
+#endif
+	UnregisterSnapshot(snapshot);
+	heap_close_compat(rel, AccessShareLock);
 
-		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_userid,
-						   "userid", REGROLEOID, -1, 0);
-		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_pid,
-						   "pid", INT4OID, -1, 0);
-		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_dbid,
-						   "dbid", OIDOID, -1, 0);
-		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_relid,
-						   "relid", REGCLASSOID, -1, 0);
-		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_processed,
-						   "processed", INT8OID, -1, 0);
-		TupleDescInitEntry(tupdesc, Anum_pathman_cp_tasks_status,
-						   "status", TEXTOID, -1, 0);
+	return result;
+}
 
-		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
-		funcctx->user_fctx = (void *) userctx;
+/*
+ * Entry point for ProvisioningLauncher's process.
+ * Every 'pg_pathman.provisioning_naptime' seconds it starts
+ * ProvisioningWorker for each database which doesn't have one.
+ * Workers exit if there are no tables with 'premake' > 0.
+ */
+void
+bgw_main_provisioning_launcher(Datum main_arg)
+{
+	MemoryContext	round_mcxt;
 
-		MemoryContextSwitchTo(old_mcxt);
-	}
+	/* Establish signal handlers before unblocking signals */
+	pqsignal(SIGTERM, handle_sigterm);
+	pqsignal(SIGHUP, handle_sighup);
 
-	funcctx = SRF_PERCALL_SETUP();
-	userctx = (active_workers_cxt *) funcctx->user_fctx;
+	/* We're now ready to receive signals */
+	BackgroundWorkerUnblockSignals();
 
-	/* Iterate through worker slots */
-	for (i = userctx->cur_idx; i < PART_WORKER_SLOTS; i++)
+	/* Connect to shared catalogs only */
+	BackgroundWorkerInitializeConnectionByOidCompat(InvalidOid, InvalidOid);
+
+	round_mcxt = AllocSetContextCreate(TopMemoryContext,
+									   "ProvisioningLauncher round",
+									   ALLOCSET_DEFAULT_SIZES);
+
+	for (;;)
 	{
-		ConcurrentPartSlot *cur_slot = &concurrent_part_slots[i],
-							slot_copy;
-		HeapTuple			htup = NULL;
+		int		rc;
 
-		/* Copy slot to process local memory */
-		SpinLockAcquire(&cur_slot->mutex);
-		memcpy(&slot_copy, cur_slot, sizeof(ConcurrentPartSlot));
-		SpinLockRelease(&cur_slot->mutex);
+		CHECK_FOR_INTERRUPTS();
 
-		if (slot_copy.worker_status != CPS_FREE)
+		if (got_sighup)
 		{
-			Datum		values[Natts_pathman_cp_tasks];
-			bool		isnull[Natts_pathman_cp_tasks] = { 0 };
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
 
-			values[Anum_pathman_cp_tasks_userid - 1]	= slot_copy.userid;
-			values[Anum_pathman_cp_tasks_pid - 1]		= slot_copy.pid;
-			values[Anum_pathman_cp_tasks_dbid - 1]		= slot_copy.dbid;
-			values[Anum_pathman_cp_tasks_relid - 1]		= slot_copy.relid;
+		if (pg_pathman_provisioning_naptime > 0)
+		{
+			MemoryContext	old_mcxt;
+			List		   *dbids;
+			ListCell	   *lc;
 
-			/* Record processed rows */
-			values[Anum_pathman_cp_tasks_processed - 1]	=
-					Int64GetDatum(slot_copy.total_rows);
+			MemoryContextReset(round_mcxt);
 
-			/* Now build a status string */
-			values[Anum_pathman_cp_tasks_status - 1] =
-					CStringGetTextDatum(cps_print_status(slot_copy.worker_status));
+			StartTransactionCommand();
+			old_mcxt = MemoryContextSwitchTo(round_mcxt);
+			dbids = list_connectable_databases();
+			MemoryContextSwitchTo(old_mcxt);
+			CommitTransactionCommand();
 
-			/* Form output tuple */
-			htup = heap_form_tuple(funcctx->tuple_desc, values, isnull);
+			foreach (lc, dbids)
+			{
+				int		slot_idx;
+				bool	worker_exists;
+
+				slot_idx = acquire_provisioning_slot(lfirst_oid(lc),
+													 BOOTSTRAP_SUPERUSERID,
+													 pg_pathman_provisioning_naptime,
+													 true, &worker_exists);
+
+				/* Database is already being served */
+				if (worker_exists)
+					continue;
+
+				if (slot_idx < 0)
+				{
+					elog(LOG, "%s: no empty worker slots found",
+						 provisioning_launcher_bgw);
+					break;
+				}
+
+				/* Start worker (we should not wait) */
+				if (!start_bgworker(provisioning_bgw,
+									CppAsString(bgw_main_provisioning),
+									Int32GetDatum(slot_idx),
+									NULL, 0,
+									false, NULL))
+				{
+					/* Couldn't start, free the slot and try again later */
+					ps_set_status(&provisioning_slots[slot_idx], CPS_FREE);
+
+					elog(LOG, "%s: could not start %s",
+						 provisioning_launcher_bgw, provisioning_bgw);
+					break;
+				}
+			}
 
-			/* Switch to next worker */
-			userctx->cur_idx = i + 1;
+			rc = WaitLatchCompat(MyLatch,
+								 WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+								 pg_pathman_provisioning_naptime * 1000L);
 		}
+		/* Wait for SIGHUP or SIGTERM */
+		else rc = WaitLatchCompat(MyLatch,
+								  WL_LATCH_SET | WL_POSTMASTER_DEATH,
+								  -1L);
 
-		/* Return tuple if needed */
-		if (htup)
-			SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(htup));
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		ResetLatch(MyLatch);
 	}
+}
 
-	SRF_RETURN_DONE(funcctx);
+/*
+ * Start provisioning worker for current database.
+ * NOTE: this function returns immediately.
+ */
+Datum
+start_provisioning_worker(PG_FUNCTION_ARGS)
+{
+	float8	naptime = PG_GETARG_FLOAT8(0);
+	int		empty_slot_idx;			/* do we have a slot for BGWorker? */
+	bool	worker_exists;
+
+	/* Check naptime */
+	if (naptime < PROVISIONING_POLL_INTERVAL)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("'naptime' should not be less than %.1f",
+							   PROVISIONING_POLL_INTERVAL)));
+
+	empty_slot_idx = acquire_provisioning_slot(MyDatabaseId, GetUserId(),
+											   naptime, false, &worker_exists);
+
+	/* Oops, looks like we already have BGWorker for this database */
+	if (worker_exists)
+		ereport(ERROR, (errmsg("%s is already running in this database",
+							   provisioning_bgw)));
+
+	/* Looks like we could not find an empty slot */
+	if (empty_slot_idx < 0)
+		ereport(ERROR, (errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+						errmsg("no empty worker slots found"),
+						errhint("consider increasing max_worker_processes")));
+
+	/* Start worker (we should not wait) */
+	if (!start_bgworker(provisioning_bgw,
+						CppAsString(bgw_main_provisioning),
+						Int32GetDatum(empty_slot_idx),
+						NULL, 0,
+						false, NULL))
+	{
+		/* Couldn't start, free the slot */
+		ps_set_status(&provisioning_slots[empty_slot_idx], CPS_FREE);
+
+		start_bgworker_errmsg(provisioning_bgw);
+	}
+
+	/* Tell user everything's fine */
+	elog(NOTICE,
+		 "worker started, you can stop it "
+		 "with the following command: select %s.%s();",
+		 get_namespace_name(get_pathman_schema()),
+		 CppAsString(stop_provisioning_worker));
+
+	PG_RETURN_VOID();
 }
 
 /*
- * Stop the specified concurrent partitioning worker.
- * NOTE: worker will stop after it finishes a batch.
+ * Stop provisioning worker of current database.
+ * NOTE: worker will stop after it finishes current round.
  */
 Datum
-stop_concurrent_part_task(PG_FUNCTION_ARGS)
+stop_provisioning_worker(PG_FUNCTION_ARGS)
 {
-	Oid		relid = PG_GETARG_OID(0);
 	bool	worker_found = false;
 	int		i;
 
 	for (i = 0; i < PART_WORKER_SLOTS && !worker_found; i++)
 	{
-		ConcurrentPartSlot *cur_slot = &concurrent_part_slots[i];
+		ProvisioningSlot *cur_slot = &provisioning_slots[i];
 
 		SpinLockAcquire(&cur_slot->mutex);
 
 		if (cur_slot->worker_status != CPS_FREE &&
-			cur_slot->relid == relid &&
 			cur_slot->dbid == MyDatabaseId)
 		{
 			/* Change worker's state & set 'worker_found' */
@@ -941,14 +3198,44 @@ stop_concurrent_part_task(PG_FUNCTION_ARGS)
 
 	if (worker_found)
 	{
-		elog(NOTICE, "worker will stop after it finishes current batch");
+		elog(NOTICE, "worker will stop after it finishes current round");
 		PG_RETURN_BOOL(true);
 	}
 	else
 	{
-		elog(ERROR, "cannot find worker for relation \"%s\"",
-			 get_rel_name_or_relid(relid));
+		elog(ERROR, "cannot find %s for current database", provisioning_bgw);
 
 		PG_RETURN_BOOL(false); /* keep compiler happy */
 	}
 }
+
+/*
+ * Return counters of partitions created on INSERT and ahead of time.
+ */
+Datum
+show_spawn_stats_internal(PG_FUNCTION_ARGS)
+{
+	TupleDesc			tupdesc;
+	PathmanSpawnStats	stats_copy;
+	Datum				values[Natts_pathman_spawn_stats];
+	bool				isnull[Natts_pathman_spawn_stats] = { 0 };
+
+	/* Copy stats to process local memory */
+	SpinLockAcquire(&spawn_stats->mutex);
+	memcpy(&stats_copy, spawn_stats, sizeof(PathmanSpawnStats));
+	SpinLockRelease(&spawn_stats->mutex);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	values[Anum_pathman_spawn_stats_backend_spawns - 1] =
+			Int64GetDatum(stats_copy.backend_spawns);
+	values[Anum_pathman_spawn_stats_bgw_spawns - 1] =
+			Int64GetDatum(stats_copy.bgw_spawns);
+	values[Anum_pathman_spawn_stats_premade - 1] =
+			Int64GetDatum(stats_copy.premade);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, isnull)));
+}
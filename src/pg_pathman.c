@@ -12,12 +12,15 @@
 #include "compat/pg_compat.h"
 #include "compat/rowmarks_fix.h"
 
+#include "dynamic_filter.h"
 #include "init.h"
 #include "hooks.h"
+#include "monotonic_transforms.h"
 #include "pathman.h"
 #include "partition_filter.h"
 #include "partition_router.h"
 #include "partition_overseer.h"
+#include "pathman_workers.h"
 #include "planner_tree_modification.h"
 #include "runtime_append.h"
 #include "runtime_merge_append.h"
@@ -31,6 +34,7 @@
 #endif
 #include "access/xact.h"
 #include "catalog/pg_collation.h"
+#include "catalog/pg_proc.h"
 #include "catalog/indexing.h"
 #include "catalog/pg_type.h"
 #include "catalog/pg_extension.h"
@@ -39,15 +43,20 @@
 #include "miscadmin.h"
 #if PG_VERSION_NUM >= 120000
 #include "optimizer/optimizer.h"
+#else
+#include "optimizer/var.h"
 #endif
 #include "optimizer/clauses.h"
 #include "optimizer/plancat.h"
 #include "optimizer/restrictinfo.h"
 #include "optimizer/cost.h"
+#include "rewrite/rewriteManip.h"
+#include "utils/builtins.h"
 #include "utils/datum.h"
 #include "utils/fmgroids.h"
 #include "utils/rel.h"
 #include "utils/lsyscache.h"
+#include "utils/pg_locale.h"
 #include "utils/syscache.h"
 #include "utils/selfuncs.h"
 #include "utils/typcache.h"
@@ -57,7 +66,11 @@ PG_MODULE_MAGIC;
 
 
 Oid		pathman_config_relid		= InvalidOid,
-		pathman_config_params_relid	= InvalidOid;
+		pathman_config_params_relid	= InvalidOid,
+		pathman_zone_maps_relid		= InvalidOid,
+		pathman_monotonic_transforms_relid = InvalidOid;
+
+int		pg_pathman_bulk_children_threshold = 1000;
 
 
 /* pg module functions */
@@ -92,6 +105,31 @@ static void handle_opexpr(const OpExpr *expr,
 						  const WalkerContext *context,
 						  WrapperNode *result);
 
+static void handle_funcexpr(const FuncExpr *expr,
+							const WalkerContext *context,
+							WrapperNode *result);
+
+static bool handle_prefix_match(Oid funcid,
+								Node *pattern,
+								const WalkerContext *context,
+								WrapperNode *result);
+
+static bool handle_transformed_opexpr(const OpExpr *expr,
+									  const WalkerContext *context,
+									  WrapperNode *result);
+
+static void handle_transform_of_key(const FuncExpr *func,
+									const MonotonicTransform *mt,
+									Oid opno, Node *value,
+									const WalkerContext *context,
+									WrapperNode *result);
+
+static void handle_key_of_transform(const FuncExpr *func,
+									const MonotonicTransform *mt,
+									Oid opno, Node *value,
+									const WalkerContext *context,
+									WrapperNode *result);
+
 static Datum array_find_min_max(Datum *values,
 								bool *isnull,
 								int length,
@@ -148,8 +186,9 @@ IsConstValue(Node *node, const WalkerContext *context)
 			}
 			return true;
 
+		/* Stable expressions (e.g. now()) are known at executor startup */
 		default:
-			return false;
+			return WcxtHasExprContext(context) && is_runtime_const_expr(node);
 	}
 }
 
@@ -206,7 +245,15 @@ ExtractConst(Node *node, const WalkerContext *context)
 			break;
 
 		default:
-			elog(ERROR, "error in function " CppAsString(ExtractConst));
+			{
+				typid	= exprType(node);
+				typmod	= exprTypmod(node);
+				collid	= exprCollation(node);
+
+				/* It must be provided */
+				Assert(WcxtHasExprContext(context));
+			}
+			break;
 	}
 
 	/* Evaluate expression */
@@ -365,10 +412,14 @@ _PG_init(void)
 	init_relation_info_static_data();
 	init_runtime_append_static_data();
 	init_runtime_merge_append_static_data();
+	init_dynamic_filter_static_data();
 	init_partition_filter_static_data();
 	init_partition_router_static_data();
 	init_partition_overseer_static_data();
 
+	/* Keep ProvisioningWorkers running across restarts */
+	register_provisioning_launcher();
+
 #ifdef PGPRO_EE
 	/* Callbacks for reload relcache for ATX transactions */
 	PgproRegisterXactCallback(pathman_xact_cb, NULL, XACT_EVENT_KIND_VANILLA | XACT_EVENT_KIND_ATX);
@@ -424,6 +475,44 @@ get_pathman_config_params_relid(bool invalid_is_ok)
 	return pathman_config_params_relid;
 }
 
+/* Get cached PATHMAN_ZONE_MAPS relation Oid */
+Oid
+get_pathman_zone_maps_relid(bool invalid_is_ok)
+{
+	if (!IsPathmanInitialized())
+	{
+		if (invalid_is_ok)
+			return InvalidOid;
+		elog(ERROR, "pg_pathman is not initialized yet");
+	}
+
+	/* Raise ERROR if Oid is invalid */
+	if (!OidIsValid(pathman_zone_maps_relid) && !invalid_is_ok)
+		elog(ERROR, "unexpected error in function "
+			 CppAsString(get_pathman_zone_maps_relid));
+
+	return pathman_zone_maps_relid;
+}
+
+/* Get cached PATHMAN_MONOTONIC_TRANSFORMS relation Oid */
+Oid
+get_pathman_monotonic_transforms_relid(bool invalid_is_ok)
+{
+	if (!IsPathmanInitialized())
+	{
+		if (invalid_is_ok)
+			return InvalidOid;
+		elog(ERROR, "pg_pathman is not initialized yet");
+	}
+
+	/* Raise ERROR if Oid is invalid */
+	if (!OidIsValid(pathman_monotonic_transforms_relid) && !invalid_is_ok)
+		elog(ERROR, "unexpected error in function "
+			 CppAsString(get_pathman_monotonic_transforms_relid));
+
+	return pathman_monotonic_transforms_relid;
+}
+
 /*
  * Return pg_pathman schema's Oid or InvalidOid if that's not possible.
  */
@@ -481,10 +570,200 @@ get_pathman_schema(void)
  * ----------------------------------------
  */
 
+/* Don't remember too many distinct sets of child restrictions */
+#define BULK_CHILD_MAX_ENTRIES		8
+
+/*
+ * Restrictions of a child expanded in bulk child mode.
+ * Children which keep the same clauses get a copy of them.
+ */
+typedef struct
+{
+	Bitmapset  *always_true;	/* wrappers which are always true */
+	Index		child_rti;		/* RT index of the child 'quals' belong to */
+	List	   *quals;			/* implicitly-ANDed restrictions */
+	bool		is_false;		/* restrictions reduce to FALSE or NULL */
+} BulkChildQuals;
+
+/*
+ * Prepare 'bulk' for expansion of the parent's children.
+ * Returns false if restrictions can't be shared between them.
+ */
+bool
+init_bulk_child_context(BulkChildContext *bulk,
+						List *restrictinfo,
+						Index parent_rti)
+{
+	Bitmapset *varattnos = NULL;
+
+	bulk->translated_vars = NIL;
+	bulk->entries = NIL;
+
+	/* Whole-row Vars are translated to a child's rowtype */
+	pull_varattnos((Node *) get_all_actual_clauses(restrictinfo),
+				   parent_rti, &varattnos);
+
+	return !bms_is_member(0 - FirstLowInvalidHeapAttributeNumber, varattnos);
+}
+
+/* Do both children have the same columns at the same positions? */
+static bool
+translations_match(List *translated_vars1, List *translated_vars2)
+{
+	ListCell *lc1,
+			 *lc2;
+
+	if (list_length(translated_vars1) != list_length(translated_vars2))
+		return false;
+
+	forboth (lc1, translated_vars1, lc2, translated_vars2)
+	{
+		Var *var1 = (Var *) lfirst(lc1),
+			*var2 = (Var *) lfirst(lc2);
+
+		/* Dropped columns are NULL */
+		if (!var1 || !var2)
+		{
+			if (var1 != var2)
+				return false;
+
+			continue;
+		}
+
+		if (var1->varattno != var2->varattno ||
+			var1->vartype != var2->vartype ||
+			var1->vartypmod != var2->vartypmod ||
+			var1->varcollid != var2->varcollid)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Find restrictions of a similar child in 'bulk'.
+ * Sets 'cacheable' if the ones of this child may be remembered.
+ */
+static BulkChildQuals *
+bulk_child_lookup(BulkChildContext *bulk,
+				  List *wrappers,
+				  int ir_index,
+				  List *translated_vars,
+				  Bitmapset **always_true,
+				  bool *cacheable)
+{
+	ListCell   *lc;
+	int			i = 0;
+
+	*always_true = NULL;
+	*cacheable = false;
+
+	/* Children must share the layout of the first cached one */
+	if (bulk->translated_vars &&
+		!translations_match(bulk->translated_vars, translated_vars))
+		return NULL;
+
+	/* Find out which clauses wrapper_make_expression() would keep */
+	foreach (lc, wrappers)
+	{
+		WrapperNode	   *wrap = (WrapperNode *) lfirst(lc);
+		bool			lossy;
+
+		if (!irange_list_find(wrap->rangeset, ir_index, &lossy))
+			return NULL;
+
+		if (!lossy)
+			*always_true = bms_add_member(*always_true, i);
+
+		/* Such clauses are rebuilt for each child */
+		else if (IsA(wrap->orig, BoolExpr) &&
+				 (((const BoolExpr *) wrap->orig)->boolop == OR_EXPR ||
+				  ((const BoolExpr *) wrap->orig)->boolop == AND_EXPR))
+			return NULL;
+
+		i++;
+	}
+
+	*cacheable = true;
+
+	foreach (lc, bulk->entries)
+	{
+		BulkChildQuals *entry = (BulkChildQuals *) lfirst(lc);
+
+		if (bms_equal(entry->always_true, *always_true))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* Remember restrictions of a child expanded in bulk child mode */
+static void
+bulk_child_remember(BulkChildContext *bulk,
+					Bitmapset *always_true,
+					Index child_rti,
+					List *translated_vars,
+					List *quals,
+					bool is_false)
+{
+	BulkChildQuals *entry;
+
+	if (list_length(bulk->entries) >= BULK_CHILD_MAX_ENTRIES)
+		return;
+
+	entry = palloc(sizeof(BulkChildQuals));
+	entry->always_true	= always_true;
+	entry->child_rti	= child_rti;
+	entry->quals		= copyObject(quals);
+	entry->is_false		= is_false;
+
+	if (!bulk->translated_vars)
+		bulk->translated_vars = copyObject(translated_vars);
+
+	bulk->entries = lappend(bulk->entries, entry);
+}
+
+/*
+ * Does partition have CHECK constraints besides the one of pg_pathman?
+ * Those might still exclude it in bulk child mode.
+ */
+static bool
+has_user_check_constraints(Relation rel)
+{
+	TupleConstr	   *constr = RelationGetDescr(rel)->constr;
+	char		   *pathman_check;
+	bool			result = false;
+	int				i;
+
+	if (!constr || constr->num_check == 0)
+		return false;
+
+	pathman_check = build_check_constraint_name_relname_internal(
+						RelationGetRelationName(rel));
+
+	for (i = 0; i < constr->num_check; i++)
+	{
+		if (strcmp(constr->check[i].ccname, pathman_check) != 0)
+		{
+			result = true;
+			break;
+		}
+	}
+
+	pfree(pathman_check);
+
+	return result;
+}
+
 /*
  * Creates child relation and adds it to root.
  * Returns child index in simple_rel_array.
  *
+ * In bulk child mode ('bulk' is not NULL) restrictions are shared
+ * between children of the same layout, and constraint exclusion is
+ * skipped for partitions which have no CHECK constraints but the one
+ * of pg_pathman, since they have already been selected by their bounds.
+ *
  * NOTE: partially based on the expand_inherited_rtentry() function.
  */
 Index
@@ -494,7 +773,8 @@ append_child_relation(PlannerInfo *root,
 					  Index parent_rti,
 					  int ir_index,
 					  Oid child_oid,
-					  List *wrappers)
+					  List *wrappers,
+					  BulkChildContext *bulk)
 {
 	RangeTblEntry  *parent_rte,
 				   *child_rte;
@@ -506,6 +786,10 @@ append_child_relation(PlannerInfo *root,
 	PlanRowMark	   *child_rowmark = NULL;
 	Node		   *childqual;
 	List		   *childquals;
+	bool			childqual_false;
+	BulkChildQuals *bulk_entry = NULL;
+	Bitmapset	   *always_true_set = NULL;
+	bool			cacheable = false;
 	ListCell	   *lc1,
 				   *lc2;
 	LOCKMODE		lockmode;
@@ -715,62 +999,96 @@ append_child_relation(PlannerInfo *root,
 	/* Adjust target list for this child */
 	adjust_rel_targetlist_compat(root, child_rel, parent_rel, appinfo);
 
-	/*
-	 * Copy restrictions. If it's not the parent table, copy only
-	 * those restrictions that are related to this partition.
-	 */
-	if (parent_rte->relid != child_oid)
-	{
-		childquals = NIL;
+	/* Bulk child mode is meant for partitions only */
+	if (parent_rte->relid == child_oid)
+		bulk = NULL;
 
-		forboth (lc1, wrappers, lc2, parent_rel->baserestrictinfo)
+	if (bulk)
+		bulk_entry = bulk_child_lookup(bulk, wrappers, ir_index,
+									   appinfo->translated_vars,
+									   &always_true_set, &cacheable);
+
+	/* Reuse restrictions of a similar child if possible */
+	if (bulk_entry)
+	{
+		childquals = copyObject(bulk_entry->quals);
+		ChangeVarNodes((Node *) childquals, bulk_entry->child_rti, child_rti, 0);
+		childqual_false = bulk_entry->is_false;
+	}
+	else
+	{
+		/*
+		 * Copy restrictions. If it's not the parent table, copy only
+		 * those restrictions that are related to this partition.
+		 */
+		if (parent_rte->relid != child_oid)
 		{
-			WrapperNode	   *wrap = (WrapperNode *) lfirst(lc1);
-			Node		   *new_clause;
-			bool			always_true;
+			childquals = NIL;
 
-			/* Generate a set of clauses for this child using WrapperNode */
-			new_clause = wrapper_make_expression(wrap, ir_index, &always_true);
+			forboth (lc1, wrappers, lc2, parent_rel->baserestrictinfo)
+			{
+				WrapperNode	   *wrap = (WrapperNode *) lfirst(lc1);
+				Node		   *new_clause;
+				bool			always_true;
 
-			/* Don't add this clause if it's always true */
-			if (always_true)
-				continue;
+				/* Generate a set of clauses for this child using WrapperNode */
+				new_clause = wrapper_make_expression(wrap, ir_index, &always_true);
 
-			/* Clause should not be NULL */
-			Assert(new_clause);
-			childquals = lappend(childquals, new_clause);
+				/* Don't add this clause if it's always true */
+				if (always_true)
+					continue;
+
+				/* Clause should not be NULL */
+				Assert(new_clause);
+				childquals = lappend(childquals, new_clause);
+			}
 		}
-	}
-	/* If it's the parent table, copy all restrictions */
-	else childquals = get_all_actual_clauses(parent_rel->baserestrictinfo);
+		/* If it's the parent table, copy all restrictions */
+		else childquals = get_all_actual_clauses(parent_rel->baserestrictinfo);
+
+		/* Now it's time to change varnos and rebuld quals */
+		childquals = (List *) adjust_appendrel_attrs_compat(root,
+													 (Node *) childquals,
+													 appinfo);
+		childqual = eval_const_expressions(root, (Node *)
+										   make_ands_explicit(childquals));
 
-	/* Now it's time to change varnos and rebuld quals */
-	childquals = (List *) adjust_appendrel_attrs_compat(root,
-												 (Node *) childquals,
-												 appinfo);
-	childqual = eval_const_expressions(root, (Node *)
-									   make_ands_explicit(childquals));
-	if (childqual && IsA(childqual, Const) &&
-		(((Const *) childqual)->constisnull ||
-		 !DatumGetBool(((Const *) childqual)->constvalue)))
-	{
 		/*
 		 * Restriction reduces to constant FALSE or constant NULL after
 		 * substitution, so this child need not be scanned.
 		 */
+		childqual_false = (childqual && IsA(childqual, Const) &&
+						   (((Const *) childqual)->constisnull ||
+							!DatumGetBool(((Const *) childqual)->constvalue)));
+
+		childquals = make_ands_implicit((Expr *) childqual);
+
+		/* Let similar children reuse these restrictions */
+		if (cacheable)
+			bulk_child_remember(bulk, always_true_set, child_rti,
+								appinfo->translated_vars,
+								childquals, childqual_false);
+	}
+
+	if (childqual_false)
+	{
 #if PG_VERSION_NUM >= 120000
 		mark_dummy_rel(child_rel);
 #else
 		set_dummy_rel_pathlist(child_rel);
 #endif
 	}
-	childquals = make_ands_implicit((Expr *) childqual);
 	childquals = make_restrictinfos_from_actual_clauses(root, childquals);
 
 	/* Set new shiny childquals */
 	child_rel->baserestrictinfo = childquals;
 
-	if (relation_excluded_by_constraints(root, child_rel, child_rte))
+	/*
+	 * Bounds have already been checked in bulk child mode,
+	 * but user CHECK constraints might still exclude this child.
+	 */
+	if ((!bulk || has_user_check_constraints(child_relation)) &&
+		relation_excluded_by_constraints(root, child_rel, child_rte))
 	{
 		/*
 		 * This child need not be scanned, so we can omit it from the
@@ -1052,6 +1370,11 @@ walk_expr_tree(Expr *expr, const WalkerContext *context)
 			handle_arrexpr((ScalarArrayOpExpr *) expr, context, result);
 			return result;
 
+		/* starts_with() etc */
+		case T_FuncExpr:
+			handle_funcexpr((FuncExpr *) expr, context, result);
+			return result;
+
 		default:
 			result->orig = (const Node *) expr;
 			result->args = NIL;
@@ -1515,6 +1838,11 @@ handle_arrexpr(const ScalarArrayOpExpr *expr,
 	if (strategy == 0)
 		goto handle_arrexpr_all;
 
+	/* Evaluate array PARAM or stable expression if it's possible */
+	if (!IsA(array, Const) && !IsA(array, ArrayExpr) &&
+		IsConstValue(array, context))
+		array = (Node *) ExtractConst(array, context);
+
 	/* Examine the array node */
 	switch (nodeTag(array))
 	{
@@ -1657,6 +1985,11 @@ handle_opexpr(const OpExpr *expr,
 		tce = lookup_type_cache(prel->ev_type, TYPECACHE_BTREE_OPFAMILY);
 		strategy = get_op_opfamily_strategy(opid, tce->btree_opf);
 
+		/* Maybe it's KEY LIKE 'abc%' or similar? */
+		if (strategy == 0 && opid == expr->opno &&
+			handle_prefix_match(get_opcode(opid), param, context, result))
+			return; /* done, exit */
+
 		if (IsConstValue(param, context))
 		{
 			handle_const(ExtractConst(param, context),
@@ -1666,15 +1999,630 @@ handle_opexpr(const OpExpr *expr,
 			return; /* done, exit */
 		}
 		/* TODO: estimate selectivity for param if it's Var */
-		else if (IsA(param, Param) || IsA(param, Var))
+		else if (IsA(param, Param) || IsA(param, Var) ||
+				 is_runtime_const_expr(param))
+		{
+			result->rangeset = list_make1_irange_full(prel, IR_LOSSY);
+			result->paramsel = estimate_paramsel_using_prel(prel, strategy);
+
+			return; /* done, exit */
+		}
+	}
+
+	/* Is it TRANSFORM(KEY) OP PARAM or ARG OP PARAM, KEY = TRANSFORM(ARG)? */
+	else if (handle_transformed_opexpr(expr, context, result))
+		return; /* done, exit */
+
+	result->rangeset = list_make1_irange_full(prel, IR_LOSSY);
+	result->paramsel = 1.0;
+}
+
+
+/* Function call handler */
+static void
+handle_funcexpr(const FuncExpr *expr,
+				const WalkerContext *context,
+				WrapperNode *result)	/* ret value #1 */
+{
+	/* Save expression */
+	result->orig = (const Node *) expr;
+
+	/* Is it starts_with(KEY, PARAM)? */
+	if (list_length(expr->args) == 2 &&
+		match_expr_to_operand(context->prel_expr, linitial(expr->args)) &&
+		handle_prefix_match(expr->funcid, lsecond(expr->args), context, result))
+		return; /* done, exit */
+
+	result->rangeset = list_make1_irange_full(context->prel, IR_LOSSY);
+	result->paramsel = 1.0;
+}
+
+/*
+ * Extract fixed prefix of a LIKE pattern.
+ * Set 'exact' if the pattern has no wildcards at all.
+ */
+static char *
+like_fixed_prefix(const char *patt, bool *exact) /* ret value #1 */
+{
+	StringInfoData	prefix;
+
+	initStringInfo(&prefix);
+	*exact = false;
+
+	for (; *patt; patt++)
+	{
+		if (*patt == '%' || *patt == '_')
+			return prefix.data;
+
+		/* Backslash escapes the next character */
+		if (*patt == '\\' && *(++patt) == '\0')
+			break;
+
+		appendStringInfoChar(&prefix, *patt);
+	}
+
+	*exact = true;
+	return prefix.data;
+}
+
+/*
+ * Extract fixed prefix of a regular expression anchored with '^'.
+ * We only care about plain ASCII characters, which is enough
+ * for patterns like '^abc' or '^ab.*'.
+ */
+static char *
+regex_fixed_prefix(const char *patt)
+{
+	StringInfoData	prefix;
+
+	initStringInfo(&prefix);
+
+	/* Alternatives might have different prefixes */
+	if (*patt++ != '^' || strchr(patt, '|'))
+		return prefix.data;
+
+	for (; *patt; patt++)
+	{
+		/* Quantifier applies to the last char, drop it */
+		if (strchr("*?+{", *patt))
+		{
+			if (prefix.len > 0)
+				prefix.data[--prefix.len] = '\0';
+			break;
+		}
+
+		/* Stop at special and non-ASCII characters */
+		if (IS_HIGHBIT_SET(*patt) || strchr("^$.[]()|\\", *patt))
+			break;
+
+		appendStringInfoChar(&prefix, *patt);
+	}
+
+	return prefix.data;
+}
+
+/*
+ * Handle prefix matches of partitioning expression:
+ *		KEY LIKE 'abc%', KEY ~ '^abc', KEY ^@ 'abc', starts_with(KEY, 'abc').
+ *
+ * All of them mean 'abc' <= KEY < 'abd' (lossy), but only if KEY is compared
+ * using "C" collation: other collations don't sort strings by bytes, so
+ * the prefix might be scattered across partitions. Patterns without
+ * wildcards turn into KEY = 'abc' for any (deterministic) collation.
+ *
+ * Returns false if 'funcid' is not one of the functions above.
+ */
+static bool
+handle_prefix_match(Oid funcid,
+					Node *pattern,
+					const WalkerContext *context,
+					WrapperNode *result) /* ret value #1 */
+{
+	const PartRelationInfo *prel = context->prel;
+	Const				   *c,
+						   *lower,
+						   *upper;
+	char				   *patt,
+						   *prefix;
+	bool					exact = false;
+	FmgrInfo				ltproc;
+	WrapperNode				upper_wrap = InvalidWrapperNode;
+
+	/* Only text keys are supported */
+	if (prel->ev_type != TEXTOID && prel->ev_type != VARCHAROID)
+		return false;
+
+	switch (funcid)
+	{
+		case F_TEXTLIKE:
+		case F_TEXTREGEXEQ:
+#ifdef F_TEXT_STARTS_WITH_COMPAT
+		case F_TEXT_STARTS_WITH_COMPAT:
+#endif
+			break;
+
+		default:
+			return false;
+	}
+
+	if (exprType(pattern) != TEXTOID || !IsConstValue(pattern, context))
+	{
+		/* We'll know more at runtime */
+		if (IsA(pattern, Param) || is_runtime_const_expr(pattern))
+		{
+			result->rangeset = list_make1_irange_full(prel, IR_LOSSY);
+			result->paramsel = estimate_paramsel_using_prel(prel, BTLessStrategyNumber);
+
+			return true; /* done, exit */
+		}
+
+		return false;
+	}
+
+	c = ExtractConst(pattern, context);
+
+	/* Comparison with NULL is never true */
+	if (c->constisnull)
+	{
+		result->rangeset = NIL;
+		result->paramsel = 0.0;
+
+		return true; /* done, exit */
+	}
+
+	patt = TextDatumGetCString(c->constvalue);
+
+	if (funcid == F_TEXTLIKE)
+		prefix = like_fixed_prefix(patt, &exact);
+	else if (funcid == F_TEXTREGEXEQ)
+		prefix = regex_fixed_prefix(patt);
+	else
+		prefix = patt;
+
+	lower = makeConst(prel->ev_type, -1, prel->ev_collid, -1,
+					  CStringGetTextDatum(prefix), false, false);
+
+	/* No wildcards, so it's just KEY = 'abc' */
+	if (exact)
+	{
+		handle_const(lower, prel->ev_collid,
+					 BTEqualStrategyNumber, context, result);
+
+		return true; /* done, exit */
+	}
+
+	/* Prefix ranges only make sense for byte-wise comparison */
+	if (prefix[0] == '\0' || prel->parttype != PT_RANGE ||
+		!lc_collate_is_c(prel->ev_collid))
+	{
+		result->rangeset = list_make1_irange_full(prel, IR_LOSSY);
+		result->paramsel = 1.0;
+
+		return true; /* done, exit */
+	}
+
+	/* 'abc' <= KEY */
+	handle_const(lower, prel->ev_collid,
+				 BTGreaterEqualStrategyNumber, context, result);
+
+	/* KEY < 'abd' (there might be no such string) */
+	fmgr_info(F_TEXT_LT, &ltproc);
+	upper = make_greater_string(lower, &ltproc, prel->ev_collid);
+	if (upper)
+	{
+		handle_const(upper, prel->ev_collid,
+					 BTLessStrategyNumber, context, &upper_wrap);
+
+		result->rangeset = irange_list_intersection(result->rangeset,
+													upper_wrap.rangeset);
+	}
+
+	/* Original condition still has to be checked */
+	result->rangeset = irange_list_set_lossiness(result->rangeset, IR_LOSSY);
+	result->paramsel = estimate_paramsel_using_prel(prel, BTLessStrategyNumber);
+
+	return true;
+}
+
+/* Skip binary-compatible casts */
+static Node *
+strip_relabel(Node *node)
+{
+	while (node && IsA(node, RelabelType))
+		node = (Node *) ((RelabelType *) node)->arg;
+
+	return node;
+}
+
+/*
+ * Check that all args of 'func' except for 'key_arg' are known at runtime.
+ * Set 'known_now' if they can be evaluated right now.
+ */
+static bool
+transform_args_are_const(const FuncExpr *func, int key_arg,
+						 const WalkerContext *context,
+						 bool *known_now) /* ret value #1 */
+{
+	ListCell   *lc;
+	int			i = 0;
+
+	*known_now = true;
+
+	foreach (lc, func->args)
+	{
+		Node *arg = (Node *) lfirst(lc);
+
+		if (i++ == key_arg)
+			continue;
+
+		if (!is_runtime_const_expr(arg))
+			return false;
+
+		if (!IsConstValue(arg, context))
+			*known_now = false;
+	}
+
+	return true;
+}
+
+/* Replace arg 'key_arg' of 'func' with 'value', evaluate the rest */
+static List *
+make_transform_args(const FuncExpr *func, int key_arg, Const *value,
+					const WalkerContext *context)
+{
+	List	   *result = NIL;
+	ListCell   *lc;
+	int			i = 0;
+
+	foreach (lc, func->args)
+	{
+		Node *arg = (Node *) lfirst(lc);
+
+		if (i++ == key_arg)
+			result = lappend(result, value);
+		else
+			result = lappend(result, ExtractConst(arg, context));
+	}
+
+	return result;
+}
+
+/* Evaluate function 'funcid' with constant 'args' */
+static Const *
+eval_transform_func(Oid funcid, List *args, Oid inputcollid,
+					const WalkerContext *context)
+{
+	ExprState	   *estate;
+	ExprContext	   *econtext = context->econtext;
+	FuncExpr	   *fexpr;
+	Oid				rettype = get_func_rettype(funcid);
+	Datum			value;
+	bool			isnull;
+
+	fexpr = makeFuncExpr(funcid, rettype, args,
+						 InvalidOid, inputcollid,
+						 COERCE_EXPLICIT_CALL);
+
+	/* If there's no context - create it! */
+	if (!WcxtHasExprContext(context))
+		econtext = CreateStandaloneExprContext();
+
+	/* Evaluate expression */
+	estate = ExecInitExpr((Expr *) fexpr, NULL);
+	value = ExecEvalExprCompat(estate, econtext, &isnull);
+
+	/* Free temp econtext if needed */
+	if (!WcxtHasExprContext(context))
+		FreeExprContext(econtext, true);
+
+	return makeConst(rettype, -1, InvalidOid, get_typlen(rettype),
+					 value, isnull, get_typbyval(rettype));
+}
+
+/*
+ * Handle conditions on monotonic functions (see pathman_monotonic_transforms):
+ *		TRANSFORM(KEY) OP PARAM, where KEY is partitioning expression;
+ *		ARG OP PARAM, where partitioning expression is TRANSFORM(ARG).
+ *
+ * Both are translated into lossy conditions on partitioning expression.
+ * Returns false if 'expr' is neither of them.
+ */
+static bool
+handle_transformed_opexpr(const OpExpr *expr,
+						  const WalkerContext *context,
+						  WrapperNode *result) /* ret value #1 */
+{
+	const MonotonicTransform   *mt;
+	Node					   *prel_expr;
+	int							i;
+
+	/* Check number of arguments */
+	if (list_length(expr->args) != 2)
+		return false;
+
+	/* TRANSFORM(KEY) OP PARAM or PARAM OP TRANSFORM(KEY) */
+	for (i = 0; i < 2; i++)
+	{
+		Node   *operand = strip_relabel((Node *) list_nth(expr->args, i)),
+			   *param = (Node *) list_nth(expr->args, 1 - i);
+		Oid		opno = (i == 0) ? expr->opno : get_commutator(expr->opno);
+
+		if (!OidIsValid(opno) || !IsA(operand, FuncExpr))
+			continue;
+
+		mt = get_monotonic_transform(((FuncExpr *) operand)->funcid);
+
+		if (mt && OidIsValid(mt->lower_bound) &&
+			match_expr_to_operand(context->prel_expr,
+								  list_nth(((FuncExpr *) operand)->args,
+										   mt->key_arg)))
+		{
+			handle_transform_of_key((const FuncExpr *) operand, mt,
+									opno, param, context, result);
+			return true;
+		}
+	}
+
+	/* Partitioning expression might be TRANSFORM(ARG) itself */
+	prel_expr = strip_relabel(context->prel_expr);
+	if (!IsA(prel_expr, FuncExpr) ||
+		!(mt = get_monotonic_transform(((FuncExpr *) prel_expr)->funcid)))
+		return false;
+
+	/* ARG OP PARAM or PARAM OP ARG */
+	for (i = 0; i < 2; i++)
+	{
+		Node   *operand = (Node *) list_nth(expr->args, i),
+			   *param = (Node *) list_nth(expr->args, 1 - i);
+		Oid		opno = (i == 0) ? expr->opno : get_commutator(expr->opno);
+
+		if (!OidIsValid(opno))
+			continue;
+
+		if (match_expr_to_operand(list_nth(((FuncExpr *) prel_expr)->args,
+										   mt->key_arg),
+								  operand))
+		{
+			handle_key_of_transform((const FuncExpr *) prel_expr, mt,
+									opno, param, context, result);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * TRANSFORM(KEY) OP PARAM. Bound functions of 'mt' give us the smallest
+ * KEY such that TRANSFORM(KEY) >= PARAM (lower) or TRANSFORM(KEY) > PARAM
+ * (upper), which is enough to build a range of KEY for every operator.
+ */
+static void
+handle_transform_of_key(const FuncExpr *func,
+						const MonotonicTransform *mt,
+						Oid opno, Node *param,
+						const WalkerContext *context,
+						WrapperNode *result) /* ret value #1 */
+{
+	const PartRelationInfo *prel = context->prel;
+	TypeCacheEntry		   *tce;
+	int						strategy;
+	bool					args_known_now;
+	Const				   *c,
+						   *lower,
+						   *upper = NULL;
+	List				   *args;
+
+	tce = lookup_type_cache(func->funcresulttype, TYPECACHE_BTREE_OPFAMILY);
+	strategy = get_op_opfamily_strategy(opno, tce->btree_opf);
+
+	/* Bound functions expect a value of transform's type */
+	if (strategy == 0 || exprType(param) != func->funcresulttype)
+		goto handle_transform_of_key_all;
+
+	if (!is_runtime_const_expr(param) ||
+		!transform_args_are_const(func, mt->key_arg, context, &args_known_now))
+		goto handle_transform_of_key_all;
+
+	/* We'll know more at runtime, stable bounds can't be used for planning */
+	if (!args_known_now || !IsConstValue(param, context) ||
+		(!WcxtHasExprContext(context) &&
+		 (func_volatile(mt->lower_bound) != PROVOLATILE_IMMUTABLE ||
+		  (OidIsValid(mt->upper_bound) &&
+		   func_volatile(mt->upper_bound) != PROVOLATILE_IMMUTABLE))))
+	{
+		result->rangeset = list_make1_irange_full(prel, IR_LOSSY);
+		result->paramsel = estimate_paramsel_using_prel(prel, strategy);
+
+		return; /* done, exit */
+	}
+
+	c = ExtractConst(param, context);
+
+	/* Comparison with NULL is never true */
+	if (c->constisnull)
+	{
+		result->rangeset = NIL;
+		result->paramsel = 0.0;
+
+		return; /* done, exit */
+	}
+
+	args = make_transform_args(func, mt->key_arg, c, context);
+
+	lower = eval_transform_func(mt->lower_bound, args,
+								func->inputcollid, context);
+	if (OidIsValid(mt->upper_bound))
+		upper = eval_transform_func(mt->upper_bound, args,
+									func->inputcollid, context);
+
+	/* Bound is out of KEY's domain */
+	if (lower->constisnull || (upper && upper->constisnull))
+		goto handle_transform_of_key_all;
+
+	/*
+	 * TRANSFORM is strictly increasing, 'lower' is its inverse. PARAM
+	 * might not be a value of TRANSFORM, so the range has to include
+	 * 'lower' (e.g. TRANSFORM(KEY) > PARAM means KEY >= lower).
+	 */
+	if (!upper) switch (strategy)
+	{
+		case BTLessStrategyNumber:
+		case BTLessEqualStrategyNumber:
+			handle_const(lower, prel->ev_collid,
+						 BTLessEqualStrategyNumber, context, result);
+			break;
+
+		case BTGreaterEqualStrategyNumber:
+		case BTGreaterStrategyNumber:
+		case BTEqualStrategyNumber:
+			handle_const(lower, prel->ev_collid,
+						 BTGreaterEqualStrategyNumber, context, result);
+			break;
+
+		default:
+			goto handle_transform_of_key_all;
+	}
+
+	else switch (strategy)
+	{
+		case BTLessStrategyNumber:
+			handle_const(lower, prel->ev_collid,
+						 BTLessStrategyNumber, context, result);
+			break;
+
+		case BTLessEqualStrategyNumber:
+			handle_const(upper, prel->ev_collid,
+						 BTLessStrategyNumber, context, result);
+			break;
+
+		case BTGreaterEqualStrategyNumber:
+			handle_const(lower, prel->ev_collid,
+						 BTGreaterEqualStrategyNumber, context, result);
+			break;
+
+		case BTGreaterStrategyNumber:
+			handle_const(upper, prel->ev_collid,
+						 BTGreaterEqualStrategyNumber, context, result);
+			break;
+
+		case BTEqualStrategyNumber:
+			{
+				WrapperNode upper_wrap = InvalidWrapperNode;
+
+				/* lower <= KEY < upper */
+				handle_const(lower, prel->ev_collid,
+							 BTGreaterEqualStrategyNumber, context, result);
+				handle_const(upper, prel->ev_collid,
+							 BTLessStrategyNumber, context, &upper_wrap);
+
+				result->rangeset = irange_list_intersection(result->rangeset,
+															upper_wrap.rangeset);
+				result->paramsel = estimate_paramsel_using_prel(prel, strategy);
+			}
+			break;
+
+		default:
+			goto handle_transform_of_key_all;
+	}
+
+	/* Original clause still has to be checked */
+	result->rangeset = irange_list_set_lossiness(result->rangeset, IR_LOSSY);
+
+	return; /* done, exit */
+
+handle_transform_of_key_all:
+	result->rangeset = list_make1_irange_full(prel, IR_LOSSY);
+	result->paramsel = 1.0;
+}
+
+/*
+ * ARG OP PARAM, where partitioning expression is TRANSFORM(ARG).
+ * Since TRANSFORM doesn't decrease, ARG < PARAM yields
+ * TRANSFORM(ARG) <= TRANSFORM(PARAM) and so on.
+ */
+static void
+handle_key_of_transform(const FuncExpr *func,
+						const MonotonicTransform *mt,
+						Oid opno, Node *param,
+						const WalkerContext *context,
+						WrapperNode *result) /* ret value #1 */
+{
+	const PartRelationInfo *prel = context->prel;
+	Oid						arg_type;
+	TypeCacheEntry		   *tce;
+	int						strategy;
+	bool					args_known_now;
+	Const				   *c;
+
+	arg_type = exprType((Node *) list_nth(func->args, mt->key_arg));
+	tce = lookup_type_cache(arg_type, TYPECACHE_BTREE_OPFAMILY);
+	strategy = get_op_opfamily_strategy(opno, tce->btree_opf);
+
+	/* TRANSFORM expects a value of ARG's type */
+	if (strategy == 0 || exprType(param) != arg_type)
+		goto handle_key_of_transform_all;
+
+	if (!transform_args_are_const(func, mt->key_arg, context, &args_known_now) ||
+		!args_known_now)
+		goto handle_key_of_transform_all;
+
+	if (!IsConstValue(param, context))
+	{
+		/* We'll know more at runtime */
+		if (IsA(param, Param) || is_runtime_const_expr(param))
 		{
 			result->rangeset = list_make1_irange_full(prel, IR_LOSSY);
 			result->paramsel = estimate_paramsel_using_prel(prel, strategy);
 
 			return; /* done, exit */
 		}
+
+		goto handle_key_of_transform_all;
+	}
+
+	c = ExtractConst(param, context);
+
+	/* Comparison with NULL is never true */
+	if (c->constisnull)
+	{
+		result->rangeset = NIL;
+		result->paramsel = 0.0;
+
+		return; /* done, exit */
+	}
+
+	c = eval_transform_func(func->funcid,
+							make_transform_args(func, mt->key_arg, c, context),
+							func->inputcollid, context);
+
+	if (c->constisnull)
+		goto handle_key_of_transform_all;
+
+	switch (strategy)
+	{
+		case BTLessStrategyNumber:
+		case BTLessEqualStrategyNumber:
+			strategy = BTLessEqualStrategyNumber;
+			break;
+
+		case BTGreaterStrategyNumber:
+		case BTGreaterEqualStrategyNumber:
+			strategy = BTGreaterEqualStrategyNumber;
+			break;
+
+		default:
+			break;
 	}
 
+	handle_const(c, prel->ev_collid, strategy, context, result);
+
+	/* Original clause still has to be checked */
+	result->rangeset = irange_list_set_lossiness(result->rangeset, IR_LOSSY);
+
+	return; /* done, exit */
+
+handle_key_of_transform_all:
 	result->rangeset = list_make1_irange_full(prel, IR_LOSSY);
 	result->paramsel = 1.0;
 }
@@ -1902,6 +2850,35 @@ generate_mergeappend_paths(PlannerInfo *root, RelOptInfo *rel,
 				accumulate_append_subpath(total_subpaths, cheapest_total);
 		}
 
+#if PG_VERSION_NUM >= 120000
+		/*
+		 * Bounded queries (e.g. min() & max() of partitioning expression,
+		 * which are turned into ORDER BY ... LIMIT 1 by planagg.c) are best
+		 * served by walking partitions in bound order: executor will stop as
+		 * soon as LIMIT is satisfied, so empty partitions at the edge are
+		 * skipped and the rest of them are never touched. Children which
+		 * can't produce the required ordering are going to be sorted
+		 * separately (see create_append_plan()), so we don't need all of
+		 * them to be presorted.
+		 */
+		if (!presorted && root->limit_tuples > 0 &&
+			((PathKey *) linitial(pathkeys) == pathkeyAsc ||
+			 (PathKey *) linitial(pathkeys) == pathkeyDesc))
+		{
+			bool reverse = ((PathKey *) linitial(pathkeys) == pathkeyDesc);
+
+			add_path(rel, (Path *) create_ordered_append_path_compat(
+							root, rel,
+							reverse ? list_reverse(startup_subpaths) : startup_subpaths,
+							pathkeys));
+			if (startup_neq_total)
+				add_path(rel, (Path *) create_ordered_append_path_compat(
+								root, rel,
+								reverse ? list_reverse(total_subpaths) : total_subpaths,
+								pathkeys));
+		}
+#endif
+
 		/*
 		 * When first pathkey matching ascending/descending sort by partition
 		 * column then build path with Append node, because MergeAppend is not
@@ -2018,6 +2995,8 @@ translate_col_privs(const Bitmapset *parent_privs,
  *	  an inheritance child.
  *
  * For paranoia's sake, we match type/collation as well as attribute name.
+ *
+ * NOTE: attribute numbers of partition are cached alongside its bounds.
  */
 void
 make_inh_translation_list(Relation oldrelation, Relation newrelation,
@@ -2030,6 +3009,8 @@ make_inh_translation_list(Relation oldrelation, Relation newrelation,
 	int			oldnatts = old_tupdesc->natts;
 	int			newnatts = new_tupdesc->natts;
 	int			old_attno;
+	const AttrNumber *cached_attnos = NULL;
+	AttrNumber *new_attnos = NULL;
 #if PG_VERSION_NUM >= 130000 /* see commit ce76c0ba */
 	AttrNumber *pcolnos = NULL;
 
@@ -2042,6 +3023,19 @@ make_inh_translation_list(Relation oldrelation, Relation newrelation,
 	}
 #endif
 
+	if (oldrelation != newrelation)
+	{
+		/* Maybe we've already matched these columns? */
+		cached_attnos = get_translation_of_partition(RelationGetRelid(newrelation),
+													 RelationGetRelid(oldrelation),
+													 oldnatts, newnatts);
+
+		/* If not, remember the result for subsequent calls */
+		if (!cached_attnos)
+			new_attnos = (AttrNumber *) palloc0(Max(oldnatts, 1) *
+												sizeof(AttrNumber));
+	}
+
 	for (old_attno = 0; old_attno < oldnatts; old_attno++)
 	{
 		Form_pg_attribute att;
@@ -2065,19 +3059,24 @@ make_inh_translation_list(Relation oldrelation, Relation newrelation,
 
 		/*
 		 * When we are generating the "translation list" for the parent table
-		 * of an inheritance set, no need to search for matches.
+		 * of an inheritance set (or columns have already been matched),
+		 * no need to search for matches.
 		 */
-		if (oldrelation == newrelation)
+		if (oldrelation == newrelation || cached_attnos)
 		{
+			AttrNumber attno = cached_attnos ?
+									cached_attnos[old_attno] :
+									(AttrNumber) (old_attno + 1);
+
 			vars = lappend(vars, makeVar(newvarno,
-										 (AttrNumber) (old_attno + 1),
+										 attno,
 										 atttypid,
 										 atttypmod,
 										 attcollation,
 										 0));
 #if PG_VERSION_NUM >= 130000
 			if (pcolnos)
-				pcolnos[old_attno] = old_attno + 1;
+				pcolnos[attno - 1] = old_attno + 1;
 #endif
 			continue;
 		}
@@ -2140,6 +3139,15 @@ make_inh_translation_list(Relation oldrelation, Relation newrelation,
 		if (pcolnos)
 			pcolnos[new_attno] = old_attno + 1;
 #endif
+		new_attnos[old_attno] = (AttrNumber) (new_attno + 1);
+	}
+
+	if (new_attnos)
+	{
+		cache_translation_of_partition(RelationGetRelid(newrelation),
+									   RelationGetRelid(oldrelation),
+									   new_attnos, oldnatts, newnatts);
+		pfree(new_attnos);
 	}
 
 	*translated_vars = vars;
@@ -15,6 +15,7 @@
 #include "partition_creation.h"
 #include "partition_filter.h"
 #include "relation_info.h"
+#include "utility_stmt_hooking.h"
 #include "xact_handling.h"
 #include "utils.h"
 
@@ -60,6 +61,7 @@ PG_FUNCTION_INFO_V1( get_base_type_pl );
 PG_FUNCTION_INFO_V1( get_tablespace_pl );
 
 PG_FUNCTION_INFO_V1( show_cache_stats_internal );
+PG_FUNCTION_INFO_V1( show_copy_stats_internal );
 PG_FUNCTION_INFO_V1( show_partition_list_internal );
 
 PG_FUNCTION_INFO_V1( build_check_constraint_name );
@@ -365,6 +367,35 @@ show_cache_stats_internal(PG_FUNCTION_ARGS)
 	SRF_RETURN_DONE(funccxt);
 }
 
+/*
+ * Return how many partitions the last COPY FROM has opened and evicted.
+ */
+Datum
+show_copy_stats_internal(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[Natts_pathman_copy_stats];
+	bool		isnull[Natts_pathman_copy_stats] = { 0 };
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	/* There was no COPY FROM in this session */
+	if (!OidIsValid(last_copy_stats.parent_relid))
+		PG_RETURN_NULL();
+
+	values[Anum_pathman_cps_parent - 1] =
+			ObjectIdGetDatum(last_copy_stats.parent_relid);
+	values[Anum_pathman_cps_opened - 1] =
+			Int64GetDatum((int64) last_copy_stats.partitions_opened);
+	values[Anum_pathman_cps_evicted - 1] =
+			Int64GetDatum((int64) last_copy_stats.partitions_evicted);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, isnull)));
+}
+
 /*
  * List all existing partitions and their parents.
  *
@@ -970,6 +1001,7 @@ pathman_config_params_trigger_func(PG_FUNCTION_ARGS)
 	TriggerData	   *trigdata = (TriggerData *) fcinfo->context;
 	Oid				pathman_config_params;
 	Oid				pathman_config;
+	Oid				pathman_zone_maps;
 	Oid				partrel;
 	Datum			partrel_datum;
 	bool			partrel_isnull;
@@ -977,6 +1009,7 @@ pathman_config_params_trigger_func(PG_FUNCTION_ARGS)
 	/* Fetch Oid of PATHMAN_CONFIG_PARAMS */
 	pathman_config_params = get_pathman_config_params_relid(true);
 	pathman_config = get_pathman_config_relid(true);
+	pathman_zone_maps = get_pathman_zone_maps_relid(true);
 
 	/* Handle "pg_pathman.enabled = f" case */
 	if (!OidIsValid(pathman_config_params))
@@ -993,15 +1026,18 @@ pathman_config_params_trigger_func(PG_FUNCTION_ARGS)
 
 	/* Handle wrong relation */
 	if (RelationGetRelid(trigdata->tg_relation) != pathman_config_params &&
-		RelationGetRelid(trigdata->tg_relation) != pathman_config)
-		elog(ERROR, "%s: must be fired for relation \"%s\" or \"%s\"",
+		RelationGetRelid(trigdata->tg_relation) != pathman_config &&
+		RelationGetRelid(trigdata->tg_relation) != pathman_zone_maps)
+		elog(ERROR, "%s: must be fired for relation \"%s\", \"%s\" or \"%s\"",
 			 trigdata->tg_trigger->tgname,
 			 get_rel_name(pathman_config_params),
-			 get_rel_name(pathman_config));
+			 get_rel_name(pathman_config),
+			 get_rel_name(pathman_zone_maps));
 
 	/*
 	 * Extract partitioned relation's Oid.
-	 * Hacky: 1 is attrnum of relid for both pathman_config and pathman_config_params
+	 * Hacky: 1 is attrnum of relid for all of pathman_config,
+	 * pathman_config_params and pathman_zone_maps
 	 */
 	partrel_datum = heap_getattr(trigdata->tg_trigtuple,
 								 Anum_pathman_config_params_partrel,
@@ -11,6 +11,7 @@
 #include "init.h"
 #include "pathman.h"
 #include "partition_creation.h"
+#include "pathman_workers.h"
 #include "relation_info.h"
 #include "utils.h"
 #include "xact_handling.h"
@@ -22,12 +23,14 @@
 #include "access/xact.h"
 #include "catalog/heap.h"
 #include "catalog/namespace.h"
+#include "catalog/pg_class.h"
 #include "catalog/pg_type.h"
 #include "commands/tablecmds.h"
 #include "executor/spi.h"
 #include "nodes/nodeFuncs.h"
 #include "parser/parse_relation.h"
 #include "parser/parse_expr.h"
+#include "storage/bufmgr.h"
 #include "utils/array.h"
 #if PG_VERSION_NUM >= 120000
 #include "utils/float.h"
@@ -60,6 +63,7 @@ PG_FUNCTION_INFO_V1( validate_interval_value );
 PG_FUNCTION_INFO_V1( split_range_partition );
 PG_FUNCTION_INFO_V1( merge_range_partitions );
 PG_FUNCTION_INFO_V1( drop_range_partition_expand_next );
+PG_FUNCTION_INFO_V1( premake_range_partitions );
 
 PG_FUNCTION_INFO_V1( get_part_range_by_oid );
 PG_FUNCTION_INFO_V1( get_part_range_by_idx );
@@ -87,6 +91,8 @@ static bool interval_is_trivial(Oid atttype,
 								Datum interval,
 								Oid interval_type);
 
+static bool partition_is_unused(Oid partition_relid);
+
 
 /*
  * -----------------------------
@@ -193,6 +199,7 @@ create_range_partitions_internal(PG_FUNCTION_ARGS)
 	Datum		   *datums;
 	bool		   *nulls;
 	int				ndatums;
+	Bound		   *range_bounds;
 	int				i;
 
 	/* Extract parent's Oid */
@@ -264,29 +271,24 @@ create_range_partitions_internal(PG_FUNCTION_ARGS)
 							errmsg("'bounds' array must be ascending")));
 	}
 
-	/* Create partitions using provided bounds */
-	for (i = 0; i < ndatums - 1; i++)
+	/* Convert datums to bounds (only the first one might be -inf) */
+	range_bounds = palloc(sizeof(Bound) * ndatums);
+	for (i = 0; i < ndatums; i++)
 	{
-		Bound		start	= nulls[i] ?
-								MakeBoundInf(MINUS_INFINITY) :
-								MakeBound(datums[i]),
-
-					end		= nulls[i + 1] ?
-								MakeBoundInf(PLUS_INFINITY) :
-								MakeBound(datums[i + 1]);
-
-		RangeVar   *name	= rangevars ? rangevars[i] : NULL;
-
-		char	   *tablespace = tablespaces ? tablespaces[i] : NULL;
-
-		(void) create_single_range_partition_internal(parent_relid,
-													  &start,
-													  &end,
-													  bounds_type,
-													  name,
-													  tablespace);
+		if (!nulls[i])
+			range_bounds[i] = MakeBound(datums[i]);
+		else
+			range_bounds[i] = MakeBoundInf(i == 0 ? MINUS_INFINITY : PLUS_INFINITY);
 	}
 
+	/* Create partitions using provided bounds */
+	create_range_partitions_bulk(parent_relid,
+								 range_bounds,
+								 ndatums,
+								 bounds_type,
+								 rangevars,
+								 tablespaces);
+
 	/* Return number of partitions */
 	PG_RETURN_INT32(ndatums - 1);
 }
@@ -897,6 +899,92 @@ drop_range_partition_expand_next(PG_FUNCTION_ARGS)
 	PG_RETURN_VOID();
 }
 
+/*
+ * Make sure that there are 'premake' unused partitions after the
+ * last used one, so that INSERTs of new values don't have to spawn
+ * partitions. Returns the number of created partitions.
+ */
+Datum
+premake_range_partitions(PG_FUNCTION_ARGS)
+{
+	Oid					parent_relid = PG_GETARG_OID(0);
+	PartRelationInfo   *prel;
+	RangeEntry		   *ranges;
+	int32				premake = DEFAULT_PATHMAN_PREMAKE,
+						unused = 0,
+						created = 0;
+	int					i;
+
+	Datum				values[Natts_pathman_config_params];
+	bool				isnull[Natts_pathman_config_params];
+
+	check_relation_oid(parent_relid);
+
+	if (read_pathman_params(parent_relid, values, isnull))
+		premake = DatumGetInt32(values[Anum_pathman_config_params_premake - 1]);
+
+	if (premake <= 0)
+		PG_RETURN_INT32(0);
+
+	/* Prevent changes in partitioning scheme (and concurrent calls) */
+	LockRelationOid(parent_relid, ShareUpdateExclusiveLock);
+
+	/* Emit an error if it is not partitioned by RANGE */
+	prel = get_pathman_relation_info(parent_relid);
+	shout_if_prel_is_invalid(parent_relid, prel, PT_RANGE);
+
+	ranges = PrelGetRangesArray(prel);
+
+	/* Nothing can be appended after an infinite bound */
+	if (PrelChildrenCount(prel) == 0 ||
+		IsInfinite(&ranges[PrelLastChild(prel)].max))
+	{
+		close_pathman_relation_info(prel);
+		PG_RETURN_INT32(0);
+	}
+
+	/* Count unused partitions at the end */
+	for (i = PrelLastChild(prel); i >= 0 && unused < premake; i--)
+	{
+		if (!partition_is_unused(ranges[i].child_oid))
+			break;
+
+		unused++;
+	}
+
+	/* Don't forget to close 'prel'! */
+	close_pathman_relation_info(prel);
+
+	if (unused < premake)
+	{
+		Oid		types[1]	= { REGCLASSOID };
+		Datum	vals[1]		= { ObjectIdGetDatum(parent_relid) };
+		char   *sql;
+
+		/* Go through SQL function, so that DDL could be replicated */
+		sql = psprintf("SELECT %s.append_range_partition($1)",
+					   quote_identifier(get_namespace_name(get_pathman_schema())));
+
+		if (SPI_connect() != SPI_OK_CONNECT)
+			elog(ERROR, "could not connect using SPI");
+
+		for (; unused < premake; unused++, created++)
+		{
+			if (SPI_execute_with_args(sql, 1, types, vals, NULL,
+									  false, 0) != SPI_OK_SELECT)
+				elog(ERROR, "could not append partition to \"%s\"",
+					 get_rel_name_or_relid(parent_relid));
+		}
+
+		SPI_finish();
+		pfree(sql);
+
+		count_premade_partitions(created);
+	}
+
+	PG_RETURN_INT32(created);
+}
+
 
 /*
  * ------------------------
@@ -1405,3 +1493,23 @@ construct_bounds_array(Bound *elems,
 
 	return arr;
 }
+
+/*
+ * Check that partition has never stored any rows. This doesn't
+ * require a scan: unused heap doesn't have any pages yet.
+ */
+static bool
+partition_is_unused(Oid partition_relid)
+{
+	Relation	partition_rel;
+	bool		result;
+
+	partition_rel = heap_open_compat(partition_relid, AccessShareLock);
+
+	result = partition_rel->rd_rel->relkind == RELKIND_RELATION &&
+			 RelationGetNumberOfBlocks(partition_rel) == 0;
+
+	heap_close_compat(partition_rel, AccessShareLock);
+
+	return result;
+}
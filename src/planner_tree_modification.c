@@ -115,6 +115,7 @@ typedef struct
 
 static bool pathman_transform_query_walker(Node *node, void *context);
 static bool pathman_post_analyze_query_walker(Node *node, void *context);
+static bool pathman_query_is_relevant_walker(Node *node, void *context);
 
 static void disable_standard_inheritance(Query *parse, transform_query_cxt *context);
 static void handle_modification_query(Query *parse, transform_query_cxt *context);
@@ -336,6 +337,16 @@ state_visit_members(PlanState **planstates, int nplans,
  * -------------------------------
  */
 
+/*
+ * Does Query tree reference any tables handled by pg_pathman?
+ * Cheap enough to let queries over plain tables bypass all walkers.
+ */
+bool
+pathman_query_is_relevant(Query *parse)
+{
+	return pathman_query_is_relevant_walker((Node *) parse, NULL);
+}
+
 /* Perform some transformations on Query tree */
 void
 pathman_transform_query(Query *parse, ParamListInfo params)
@@ -428,6 +439,53 @@ pathman_transform_query_walker(Node *node, void *context)
 								  context);
 }
 
+/* Walker for pathman_query_is_relevant() */
+static bool
+pathman_query_is_relevant_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+
+	else if (IsA(node, Query))
+	{
+		Query	   *query = (Query *) node;
+		ListCell   *lc;
+		Index		current_rti = 0;
+
+		foreach (lc, query->rtable)
+		{
+			RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc);
+
+			current_rti++; /* increment RTE index */
+
+			if (rte->rtekind != RTE_RELATION ||
+				rte->relkind != RELKIND_RELATION)
+				continue;
+
+			/* Negative answers are cached as well */
+			if (has_pathman_relation_info(rte->relid))
+				return true;
+
+			/* UPDATE of a partition might need PartitionRouter */
+			if (query->commandType == CMD_UPDATE &&
+				query->resultRelation == current_rti &&
+				pg_pathman_enable_partition_router &&
+				OidIsValid(get_parent_of_partition(rte->relid)))
+				return true;
+		}
+
+		/* Check subqueries, CTEs and SubLinks */
+		return query_tree_walker(query,
+								 pathman_query_is_relevant_walker,
+								 context,
+								 0);
+	}
+
+	return expression_tree_walker(node,
+								  pathman_query_is_relevant_walker,
+								  context);
+}
+
 static bool
 pathman_post_analyze_query_walker(Node *node, void *context)
 {
@@ -848,13 +906,15 @@ partition_filter_visitor(Plan *plan, void *context)
 															modify_table->nominalRelation,
 															modify_table->onConflictAction,
 															modify_table->operation,
-															returning_list);
+															returning_list,
+															modify_table->canSetTag);
 #else
 			lfirst(lc1) = make_partition_filter((Plan *) lfirst(lc1), relid,
 												modify_table->nominalRelation,
 												modify_table->onConflictAction,
 												modify_table->operation,
-												returning_list);
+												returning_list,
+												modify_table->canSetTag);
 #endif
 		}
 	}
@@ -947,7 +1007,8 @@ partition_router_visitor(Plan *plan, void *context)
 											modify_table->nominalRelation,
 											ONCONFLICT_NONE,
 											CMD_UPDATE,
-											returning_list);
+											returning_list,
+											modify_table->canSetTag);
 
 #if PG_VERSION_NUM >= 140000 /* for changes in 86dc90056dfd */
 			outerPlan(modify_table) = pfilter;
@@ -14,6 +14,7 @@
 #include "init.h"
 #include "utils.h"
 #include "xact_handling.h"
+#include "zone_maps.h"
 
 #include "access/htup_details.h"
 #if PG_VERSION_NUM >= 120000
@@ -346,6 +347,13 @@ get_pathman_relation_info(Oid relid)
 									  relid, HASH_FIND,
 									  NULL);
 
+	/* Zone maps might have been invalidated by a committed transaction */
+	if (psin && psin->prel && zone_maps_need_reload(psin->prel))
+	{
+		invalidate_psin_entry(psin);
+		psin = NULL;
+	}
+
 	if (!psin)
 	{
 		PartRelationInfo   *prel = NULL;
@@ -490,11 +498,16 @@ build_pathman_relation_info(Oid relid, Datum *values)
 		if (prel_children)
 			pfree(prel_children);
 
-		/* Read additional parameters ('enable_parent' at the moment) */
+		/* Read additional parameters ('enable_parent' and zone maps) */
 		if (read_pathman_params(relid, param_values, param_isnull))
 		{
 			prel->enable_parent =
 					param_values[Anum_pathman_config_params_enable_parent - 1];
+
+			/* Load summaries of non-key columns */
+			if (!param_isnull[Anum_pathman_config_params_zone_map_columns - 1])
+				fill_prel_with_zone_maps(prel,
+										 param_values[Anum_pathman_config_params_zone_map_columns - 1]);
 		}
 		/* Else set default values if they cannot be found */
 		else
@@ -1122,6 +1135,10 @@ get_bounds_of_partition(Oid partition, const PartRelationInfo *prel)
 		/* Initialize other fields */
 		pbin_local.child_relid = partition;
 		pbin_local.byval = prel->ev_byval;
+		pbin_local.trans_parent = InvalidOid;
+		pbin_local.trans_parent_natts = 0;
+		pbin_local.trans_child_natts = 0;
+		pbin_local.trans_attnos = NULL;
 
 		/* Try to build constraint's expression tree (may emit ERROR) */
 		con_expr = get_partition_constraint_expr(partition, true);
@@ -1144,6 +1161,152 @@ get_bounds_of_partition(Oid partition, const PartRelationInfo *prel)
 	return pbin;
 }
 
+/*
+ * Return index of partition in PrelGetChildrenArray() (or -1).
+ * Uses cached bounds, so it doesn't have to scan all children.
+ * Returns -1 for children which are not pg_pathman's partitions.
+ */
+int
+get_index_of_partition(Oid partition, const PartRelationInfo *prel)
+{
+	PartBoundInfo  *pbin;
+	Oid			   *children = PrelGetChildrenArray(prel);
+	int				idx = -1;
+
+	/* Don't let get_bounds_of_partition() emit ERROR for foreign children */
+	pbin = pg_pathman_enable_bounds_cache ?
+				pathman_cache_search_relid(bounds_cache,
+										   partition,
+										   HASH_FIND,
+										   NULL) :
+				NULL;
+
+	if (!pbin)
+	{
+		char   *conname = build_check_constraint_name_relid_internal(partition);
+		Oid		conid = get_relation_constraint_oid(partition, conname, true);
+
+		pfree(conname);
+
+		if (!OidIsValid(conid))
+			return -1;
+
+		pbin = get_bounds_of_partition(partition, prel);
+	}
+
+	if (pbin->parttype != prel->parttype)
+		return -1;
+
+	switch (prel->parttype)
+	{
+		case PT_HASH:
+			idx = (int) pbin->part_idx;
+			break;
+
+		case PT_RANGE:
+			{
+				RangeEntry *ranges = PrelGetRangesArray(prel);
+				FmgrInfo	cmp_func;
+				int			lower = 0,
+							upper = (int) PrelChildrenCount(prel) - 1;
+
+				fmgr_info(prel->cmp_proc, &cmp_func);
+
+				/* Ranges are sorted by lower bound and don't overlap */
+				while (lower <= upper)
+				{
+					int		mid = lower + (upper - lower) / 2,
+							cmp;
+
+					cmp = cmp_bounds(&cmp_func, prel->ev_collid,
+									 &ranges[mid].min, &pbin->range_min);
+
+					if (cmp == 0)
+					{
+						idx = mid;
+						break;
+					}
+					else if (cmp < 0)
+						lower = mid + 1;
+					else
+						upper = mid - 1;
+				}
+			}
+			break;
+
+		default:
+			WrongPartType(prel->parttype);
+	}
+
+	/* Cached bounds might be stale, double-check */
+	if (idx < 0 || idx >= (int) PrelChildrenCount(prel) ||
+		children[idx] != partition)
+		return -1;
+
+	return idx;
+}
+
+/*
+ * Return cached translation of parent's columns for partition (or NULL).
+ * It lives as long as partition's bounds, i.e. until relcache invalidation.
+ */
+const AttrNumber *
+get_translation_of_partition(Oid partition, Oid parent,
+							 int parent_natts, int child_natts)
+{
+	PartBoundInfo *pbin;
+
+	/* Translations are stored alongside bounds */
+	if (!pg_pathman_enable_bounds_cache || !bounds_cache)
+		return NULL;
+
+	pbin = pathman_cache_search_relid(bounds_cache,
+									  partition,
+									  HASH_FIND,
+									  NULL);
+
+	if (pbin && pbin->trans_attnos &&
+		pbin->trans_parent == parent &&
+		pbin->trans_parent_natts == parent_natts &&
+		pbin->trans_child_natts == child_natts)
+		return pbin->trans_attnos;
+
+	return NULL;
+}
+
+/* Remember translation of parent's columns for partition */
+void
+cache_translation_of_partition(Oid partition, Oid parent,
+							   const AttrNumber *attnos,
+							   int parent_natts, int child_natts)
+{
+	PartBoundInfo *pbin;
+
+	if (!pg_pathman_enable_bounds_cache || !bounds_cache)
+		return;
+
+	pbin = pathman_cache_search_relid(bounds_cache,
+									  partition,
+									  HASH_FIND,
+									  NULL);
+
+	/* Don't bother if bounds of this partition are not cached */
+	if (!pbin)
+		return;
+
+	if (pbin->trans_attnos)
+		pfree(pbin->trans_attnos);
+
+	pbin->trans_attnos = MemoryContextAlloc(PathmanBoundsCacheContext,
+											Max(parent_natts, 1) *
+												sizeof(AttrNumber));
+	memcpy(pbin->trans_attnos, attnos, parent_natts * sizeof(AttrNumber));
+
+	pbin->trans_parent = parent;
+	pbin->trans_parent_natts = parent_natts;
+	pbin->trans_child_natts = child_natts;
+}
+
 void
 invalidate_bounds_cache(void)
 {
@@ -14,8 +14,11 @@
 
 #include "utils/guc.h"
 
+#include <limits.h>
+
 
 bool				pg_pathman_enable_runtimeappend = true;
+int					pg_pathman_runtimeappend_max_children = 1024;
 
 CustomPathMethods	runtimeappend_path_methods;
 CustomScanMethods	runtimeappend_plan_methods;
@@ -51,6 +54,20 @@ init_runtime_append_static_data(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomIntVariable("pg_pathman.runtimeappend_max_children",
+							"Sets the maximum number of initialized children of "
+							RUNTIME_APPEND_NODE_NAME " and RuntimeMergeAppend nodes.",
+							"Least recently used children are shut down when "
+							"this limit is exceeded, 0 means no limit.",
+							&pg_pathman_runtimeappend_max_children,
+							1024,
+							0, INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	RegisterCustomScanMethods(&runtimeappend_plan_methods);
 }
 
@@ -14,6 +14,7 @@
 #include "compat/debug_compat_features.h"
 #include "compat/pg_compat.h"
 #include "init.h"
+#include "multi_insert.h"
 #include "utility_stmt_hooking.h"
 #include "partition_filter.h"
 
@@ -35,9 +36,15 @@
 #include "foreign/fdwapi.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
+#if PG_VERSION_NUM >= 120000
+#include "optimizer/optimizer.h"
+#else
+#include "optimizer/clauses.h"
+#endif
 #if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
 #include "parser/parse_relation.h"
 #endif
+#include "rewrite/rewriteHandler.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
@@ -73,22 +80,38 @@ ProtocolVersion		FrontendProtocol = (ProtocolVersion) 0;
 #define PATHMAN_COPY_WRITE_LOCK		RowExclusiveLock
 
 
+/* Statistics of the last COPY FROM */
+PathmanCopyStats	last_copy_stats = { InvalidOid, 0, 0 };
+
+
 static uint64 PathmanCopyFrom(
 #if PG_VERSION_NUM >= 140000 /* Structure changed in c532d15dddff */
 							  CopyFromState cstate,
 #else
 							  CopyState cstate,
 #endif
+							  CopyNextTupleFunc next_tuple,
+							  void *next_tuple_arg,
 							  Relation parent_rel,
 							  List *range_table,
+							  List *rteperminfos,
 							  bool old_protocol);
 
+static bool copy_next_tuple_from_cstate(void *arg, ExprContext *econtext,
+										Datum *values, bool *nulls,
+										Oid *tuple_oid);
+
 static void prepare_rri_for_copy(ResultRelInfoHolder *rri_holder,
 								 const ResultPartsStorage *rps_storage);
 
 static void finish_rri_for_copy(ResultRelInfoHolder *rri_holder,
 								const ResultPartsStorage *rps_storage);
 
+static void evict_rri_for_copy(ResultRelInfoHolder *rri_holder,
+							   const ResultPartsStorage *rps_storage);
+
+static bool has_volatile_defaults(Relation rel);
+
 
 /*
  * Is pg_pathman supposed to handle this COPY stmt?
@@ -512,7 +535,15 @@ PathmanDoCopy(const CopyStmt *stmt,
 		cstate = BeginCopyFromCompat(pstate, rel, stmt->filename,
 									 stmt->is_program, NULL, stmt->attlist,
 									 stmt->options);
-		*processed = PathmanCopyFrom(cstate, rel, range_table, is_old_protocol);
+		*processed = PathmanCopyFrom(cstate,
+									 copy_next_tuple_from_cstate, cstate,
+									 rel, range_table,
+#if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
+									 pstate->p_rteperminfos,
+#else
+									 NIL,
+#endif
+									 is_old_protocol);
 		EndCopyFrom(cstate);
 	}
 	else
@@ -533,8 +564,82 @@ PathmanDoCopy(const CopyStmt *stmt,
 	heap_close_compat(rel, (is_from ? NoLock : PATHMAN_COPY_READ_LOCK));
 }
 
+/*
+ * Insert tuples produced by 'next_tuple' into a partitioned table
+ * (e.g. by a ParallelCopyWorker). Returns number of inserted tuples.
+ */
+uint64
+PathmanCopyFromTuples(Relation parent_rel,
+					  CopyNextTupleFunc next_tuple,
+					  void *next_tuple_arg)
+{
+	RangeTblEntry	   *rte;
+	List			   *range_table;
+	List			   *rteperminfos = NIL;
+	List			   *attnums;
+	ListCell		   *cur;
+#if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
+	RTEPermissionInfo  *perminfo;
+#endif
+
+	rte = makeNode(RangeTblEntry);
+	rte->rtekind = RTE_RELATION;
+	rte->relid = RelationGetRelid(parent_rel);
+	rte->relkind = parent_rel->rd_rel->relkind;
+	range_table = list_make1(rte);
+
+	/* We're going to insert all columns */
+	attnums = PathmanCopyGetAttnums(RelationGetDescr(parent_rel), parent_rel, NIL);
+#if PG_VERSION_NUM >= 160000 /* for commit a61b1f74823c */
+	perminfo = addRTEPermissionInfo(&rteperminfos, rte);
+	perminfo->requiredPerms = ACL_INSERT;
+	foreach(cur, attnums)
+	{
+		int attnum = lfirst_int(cur) - FirstLowInvalidHeapAttributeNumber;
+
+		perminfo->insertedCols = bms_add_member(perminfo->insertedCols, attnum);
+	}
+	ExecCheckPermissions(range_table, rteperminfos, true);
+#else
+	rte->requiredPerms = ACL_INSERT;
+	foreach(cur, attnums)
+	{
+		int attnum = lfirst_int(cur) - FirstLowInvalidHeapAttributeNumber;
+
+		rte->insertedCols = bms_add_member(rte->insertedCols, attnum);
+	}
+	ExecCheckRTPerms(range_table, true);
+#endif
+
+	/* Disable COPY FROM if table has RLS */
+	if (check_enable_rls(rte->relid, InvalidOid, false) == RLS_ENABLED)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("COPY FROM not supported with row-level security"),
+				 errhint("Use INSERT statements instead.")));
+
+	return PathmanCopyFrom(NULL, next_tuple, next_tuple_arg,
+						   parent_rel, range_table, rteperminfos, false);
+}
+
+/* Fetch next tuple using NextCopyFrom() */
+static bool
+copy_next_tuple_from_cstate(void *arg, ExprContext *econtext,
+							Datum *values, bool *nulls,
+							Oid *tuple_oid)
+{
+#if PG_VERSION_NUM >= 140000 /* Structure changed in c532d15dddff */
+	CopyFromState	cstate = (CopyFromState) arg;
+#else
+	CopyState		cstate = (CopyState) arg;
+#endif
+
+	return NextCopyFromCompat(cstate, econtext, values, nulls, tuple_oid);
+}
+
 /*
  * Copy FROM file to relation.
+ * NOTE: 'cstate' is NULL if tuples don't come from COPY.
  */
 static uint64
 PathmanCopyFrom(
@@ -543,8 +648,12 @@ PathmanCopyFrom(
 #else
 				CopyState cstate,
 #endif
+				CopyNextTupleFunc next_tuple,
+				void *next_tuple_arg,
 				Relation parent_rel,
-				List *range_table, bool old_protocol)
+				List *range_table,
+				List *rteperminfos,
+				bool old_protocol)
 {
 	HeapTuple			tuple;
 	TupleDesc			tupDesc;
@@ -559,6 +668,9 @@ PathmanCopyFrom(
 	EState			   *estate = CreateExecutorState(); /* for ExecConstraints() */
 	TupleTableSlot	   *myslot;
 
+	MultiInsertState	mistate;
+	bool				use_multi_insert;
+
 	uint64				processed = 0;
 
 	tupDesc = RelationGetDescr(parent_rel);
@@ -576,7 +688,7 @@ PathmanCopyFrom(
 	 * field "estate->es_result_relations":
 	 */
 #if PG_VERSION_NUM >= 160000
-	ExecInitRangeTable(estate, range_table, cstate->rteperminfos);
+	ExecInitRangeTable(estate, range_table, rteperminfos);
 #else
 	ExecInitRangeTable(estate, range_table);
 #endif
@@ -616,7 +728,7 @@ PathmanCopyFrom(
 	 * Copy the RTEPermissionInfos into estate as well, so that
 	 * scan_result_parts_storage() et al will work correctly.
 	 */
-	estate->es_rteperminfos = cstate->rteperminfos;
+	estate->es_rteperminfos = rteperminfos;
 #endif
 
 	/* Set up a tuple slot too */
@@ -640,13 +752,25 @@ PathmanCopyFrom(
 	values = (Datum *) palloc(tupDesc->natts * sizeof(Datum));
 	nulls = (bool *) palloc(tupDesc->natts * sizeof(bool));
 
+	/*
+	 * Volatile defaults might look at the table being filled (see copy.c),
+	 * in which case every row should be inserted right away.
+	 */
+	use_multi_insert = !has_volatile_defaults(parent_rel);
+	if (use_multi_insert)
+	{
+		init_multi_insert_state(&mistate, estate, false);
+
+		/* Buffered tuples should be inserted before partition is closed */
+		parts_storage.evict_rri_holder_cb = evict_rri_for_copy;
+		parts_storage.evict_rri_holder_cb_arg = &mistate;
+	}
+
 	for (;;)
 	{
 		TupleTableSlot		   *slot;
 		bool					skip_tuple = false;
-#if PG_VERSION_NUM < 120000
-		Oid						tuple_oid = InvalidOid;
-#endif
+		Oid						tuple_oid = InvalidOid;		/* only < 12 */
 		ExprContext		 	   *econtext = GetPerTupleExprContext(estate);
 
 		ResultRelInfoHolder	   *rri_holder;
@@ -659,7 +783,7 @@ PathmanCopyFrom(
 		/* Switch into per tuple memory context */
 		MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
 
-		if (!NextCopyFromCompat(cstate, econtext, values, nulls, &tuple_oid))
+		if (!next_tuple(next_tuple_arg, econtext, values, nulls, &tuple_oid))
 			break;
 
 		/* We can form the input tuple */
@@ -717,6 +841,25 @@ PathmanCopyFrom(
 		/* Triggers and stuff need to be invoked in query context. */
 		MemoryContextSwitchTo(query_mcxt);
 
+		if (use_multi_insert)
+		{
+			/* Buffer this tuple if partition has no row triggers */
+			if (multi_insert_allowed(rri_holder))
+			{
+				/* Check the constraints of the tuple */
+				if (child_rri->ri_RelationDesc->rd_att->constr)
+					ExecConstraints(child_rri, slot, estate);
+
+				multi_insert_add_tuple(&mistate, rri_holder, slot);
+
+				processed++;
+				continue;
+			}
+
+			/* Triggers should see all rows inserted before this one */
+			multi_insert_flush(&mistate);
+		}
+
 		/* BEFORE ROW INSERT Triggers */
 		if (child_rri->ri_TrigDesc &&
 			child_rri->ri_TrigDesc->trig_insert_before_row)
@@ -796,6 +939,10 @@ PathmanCopyFrom(
 	/* Switch back to query context */
 	MemoryContextSwitchTo(query_mcxt);
 
+	/* Insert remaining buffered tuples */
+	if (use_multi_insert)
+		fini_multi_insert_state(&mistate);
+
 	/* Required for old protocol */
 	if (old_protocol)
 		pq_endmsgread();
@@ -812,6 +959,11 @@ PathmanCopyFrom(
 	/* Release resources for tuple table */
 	ExecResetTupleTable(estate->es_tupleTable, false);
 
+	/* Save statistics for show_copy_stats() */
+	last_copy_stats.parent_relid = parent_relid;
+	last_copy_stats.partitions_opened = parts_storage.partitions_opened;
+	last_copy_stats.partitions_evicted = parts_storage.partitions_evicted;
+
 	/* Close partitions and destroy hash table */
 	fini_result_parts_storage(&parts_storage);
 
@@ -824,6 +976,31 @@ PathmanCopyFrom(
 	return processed;
 }
 
+/*
+ * Does any column of 'rel' have a volatile default (except for nextval())?
+ */
+static bool
+has_volatile_defaults(Relation rel)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	int			i;
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute	attr = TupleDescAttr(tupdesc, i);
+		Node			   *defexpr;
+
+		if (attr->attisdropped || !attr->atthasdef)
+			continue;
+
+		defexpr = build_column_default(rel, i + 1);
+		if (defexpr && contain_volatile_functions_not_nextval(defexpr))
+			return true;
+	}
+
+	return false;
+}
+
 /*
  * Init COPY FROM, if supported.
  */
@@ -843,7 +1020,8 @@ prepare_rri_for_copy(ResultRelInfoHolder *rri_holder,
 		 */
 #ifdef PG_SHARDMAN
 		/* shardman COPY FROM requested? */
-		if (*find_rendezvous_variable(
+		if (rps_storage->init_rri_holder_cb_arg != NULL &&
+			*find_rendezvous_variable(
 				"shardman_pathman_copy_from_rendezvous") != NULL &&
 			FdwCopyFromIsSupported(fdw_routine))
 		{
@@ -877,6 +1055,18 @@ finish_rri_for_copy(ResultRelInfoHolder *rri_holder,
 #endif
 }
 
+/*
+ * Partition is about to be closed, insert its pending tuples.
+ */
+static void
+evict_rri_for_copy(ResultRelInfoHolder *rri_holder,
+				   const ResultPartsStorage *rps_storage)
+{
+	MultiInsertState *mistate = (MultiInsertState *) rps_storage->evict_rri_holder_cb_arg;
+
+	multi_insert_forget(mistate, rri_holder);
+}
+
 /*
  * Rename RANGE\HASH check constraint of a partition on table rename event.
  */
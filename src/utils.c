@@ -22,6 +22,12 @@
 #include "catalog/pg_type.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
+#if PG_VERSION_NUM >= 120000
+#include "optimizer/optimizer.h"
+#else
+#include "optimizer/clauses.h"
+#include "optimizer/var.h"
+#endif
 #include "parser/parse_coerce.h"
 #include "parser/parse_oper.h"
 #include "utils/array.h"
@@ -76,6 +82,31 @@ clause_contains_params(Node *clause)
 								  NULL);
 }
 
+/*
+ * Check whether clause contains something that is only known
+ * at executor startup, i.e. PARAMs or stable functions (now() etc).
+ * Volatile functions don't count, since they can't be used for pruning.
+ */
+bool
+clause_contains_runtime_values(Node *clause)
+{
+	return (clause_contains_params(clause) ||
+			contain_mutable_functions(clause)) &&
+		   !contain_volatile_functions(clause);
+}
+
+/*
+ * Check whether expression can be computed once per scan, i.e. it
+ * doesn't reference any columns and has no volatile functions or subplans.
+ */
+bool
+is_runtime_const_expr(Node *node)
+{
+	return !contain_var_clause(node) &&
+		   !contain_volatile_functions(node) &&
+		   !contain_subplans(node);
+}
+
 /*
  * Check if this is a "date"-related type.
  */
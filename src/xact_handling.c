@@ -56,6 +56,22 @@ xact_lock_rel(Oid relid, LOCKMODE lockmode, bool nowait)
 	return LockAcquireOid(relid, lockmode, false, nowait);
 }
 
+/*
+ * Lock RANGE partition to be spawned (identified by 'range_key').
+ * Lock is released at the end of transaction.
+ */
+void
+xact_lock_spawn_range(Oid relid, uint32 range_key)
+{
+	LOCKTAG		tag;
+
+	SET_LOCKTAG_ADVISORY(tag, MyDatabaseId, relid, range_key,
+						 SPAWN_RANGE_LOCKTAG_CLASS);
+
+	if (LockAcquire(&tag, ExclusiveLock, false, false) != LOCKACQUIRE_ALREADY_HELD)
+		AcceptInvalidationMessages();
+}
+
 /*
  * Check whether we already hold a lock that
  * might conflict with partition spawning BGW.
@@ -63,10 +79,20 @@ xact_lock_rel(Oid relid, LOCKMODE lockmode, bool nowait)
 bool
 xact_bgw_conflicting_lock_exists(Oid relid)
 {
-#if PG_VERSION_NUM >= 90600
-	/* We use locking groups for 9.6+ */
-	return false;
-#else
+	/*
+	 * Even though we use locking groups for 9.6+, BGW might have to wait
+	 * for locks on ranges held by backends waiting for our lock.
+	 */
+	return xact_spawn_lock_held(relid);
+}
+
+/*
+ * Check whether we hold a lock which prevents
+ * other backends from creating partitions.
+ */
+bool
+xact_spawn_lock_held(Oid relid)
+{
 	LOCKMODE	lockmode;
 
 	/* Try each lock >= ShareUpdateExclusiveLock */
@@ -79,7 +105,27 @@ xact_bgw_conflicting_lock_exists(Oid relid)
 	}
 
 	return false;
-#endif
+}
+
+/*
+ * Check whether we hold a lock which prevents
+ * other backends from inserting rows.
+ */
+bool
+xact_insert_conflicting_lock_held(Oid relid)
+{
+	LOCKMODE	lockmode;
+
+	/* Try each lock >= ShareLock */
+	for (lockmode = ShareLock;
+		 lockmode <= AccessExclusiveLock;
+		 lockmode++)
+	{
+		if (do_we_hold_the_lock(relid, lockmode))
+			return true;
+	}
+
+	return false;
 }
 
 
@@ -169,9 +215,6 @@ xact_object_is_visible(TransactionId obj_xmin)
 /*
  * Do we hold the specified lock?
  */
-#ifdef __GNUC__
-__attribute__((unused))
-#endif
 static inline bool
 do_we_hold_the_lock(Oid relid, LOCKMODE lockmode)
 {
@@ -0,0 +1,1218 @@
+/* ------------------------------------------------------------------------
+ *
+ * zone_maps.c
+ *		Partition pruning using min/max summaries of non-key columns
+ *
+ * Copyright (c) 2026, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "compat/pg_compat.h"
+
+#include "init.h"
+#include "pathman.h"
+#include "rangeset.h"
+#include "relation_info.h"
+#include "utils.h"
+#include "zone_maps.h"
+
+#include "access/htup_details.h"
+#include "access/heapam.h"
+#include "access/nbtree.h"
+#include "access/xact.h"
+#if PG_VERSION_NUM >= 120000
+#include "access/relscan.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#endif
+#include "catalog/pg_type.h"
+#include "commands/trigger.h"
+#include "executor/executor.h"
+#include "executor/spi.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "storage/lmgr.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+#include "utils/typcache.h"
+
+#if PG_VERSION_NUM >= 120000
+#include "optimizer/optimizer.h"
+#else
+#include "optimizer/var.h"
+#endif
+
+
+/* Kinds of conditions which can be checked against zone maps */
+typedef enum
+{
+	ZMC_AND = 0,
+	ZMC_OR,
+	ZMC_OP			/* COLUMN OP VALUE or COLUMN = ANY(VALUES) */
+} ZoneMapCondKind;
+
+/* Condition prepared for checks against zone maps */
+typedef struct ZoneMapCond
+{
+	ZoneMapCondKind		kind;
+	List			   *args;			/* ZMC_AND & ZMC_OR */
+
+	const PartZoneMap  *zm;				/* summarized column */
+	StrategyNumber		strategy;		/* btree strategy of COLUMN OP VALUE */
+	FmgrInfo			cmp_finfo;		/* compares COLUMN to VALUE */
+	Oid					collid;
+
+	Datum			   *values;			/* non-NULL values */
+	int					nvalues;
+} ZoneMapCond;
+
+
+PG_FUNCTION_INFO_V1( pathman_zone_map_trigger_func );
+
+
+/*
+ * Number of shared zone map versions. Each parent is
+ * assigned to one of them using its Oid as a hash key.
+ */
+#define ZONE_MAPS_BUCKETS			64
+
+#define ZoneMapsBucket(parent)		( (parent) % ZONE_MAPS_BUCKETS )
+
+/*
+ * Shared state of zone maps. Cached summaries are used only if
+ * nobody is going to invalidate them and nobody has invalidated
+ * them since they were loaded (we might not have received sinval yet).
+ */
+typedef struct
+{
+	slock_t		mutex;
+	uint64		versions[ZONE_MAPS_BUCKETS];	/* bumped after commit */
+	uint32		pending[ZONE_MAPS_BUCKETS];		/* invalidations before commit */
+} ZoneMapsShared;
+
+/* Partition whose zone map will be invalidated before commit */
+typedef struct
+{
+	Oid		zone_maps_relid;
+	Oid		partition;
+	Oid		parent;
+	Oid		userid;			/* role which has modified partition */
+	int		sec_context;
+} PendingZoneMapInvalidation;
+
+
+static ZoneMapsShared  *zone_maps_shared = NULL;
+
+/* Invalidations of current transaction (in TopMemoryContext) */
+static List			   *pending_invalidations = NIL;
+
+
+static const PartZoneMap *find_zone_map(Node *node,
+										const PartRelationInfo *prel,
+										Index varno);
+
+static ZoneMapCond *build_zone_map_cond(Node *clause,
+										const PartRelationInfo *prel,
+										Index varno,
+										ExprContext *econtext,
+										bool check_only);
+
+static bool zone_map_cond_holds(ZoneMapCond *cond, uint32 part_idx);
+
+static bool zone_map_is_usable(const PartZoneMap *zm, uint32 part_idx,
+							   Snapshot snapshot);
+
+static bool zone_maps_are_current(const PartRelationInfo *prel);
+
+static bool zone_map_invalidation_is_pending(Oid partition);
+
+static void add_pending_zone_map_invalidation(Oid zone_maps_relid,
+											  Oid partition,
+											  Oid parent);
+
+static void zone_maps_xact_callback(XactEvent event, void *arg);
+
+static void invalidate_zone_maps(PendingZoneMapInvalidation *pending);
+
+static int oid_cmp_idx(const void *a, const void *b);
+
+
+/* Oid of child partition & its index in PartRelationInfo */
+typedef struct
+{
+	Oid		relid;
+	uint32	idx;
+} ChildIdx;
+
+
+/*
+ * -------------------------
+ *  Zone maps construction
+ * -------------------------
+ */
+
+/*
+ * Estimate amount of shmem needed for zone maps.
+ */
+Size
+estimate_zone_maps_shmem_size(void)
+{
+	return sizeof(ZoneMapsShared);
+}
+
+/*
+ * Initialize shared state of zone maps.
+ */
+void
+init_zone_maps_shmem(void)
+{
+	bool	found;
+
+	zone_maps_shared = (ZoneMapsShared *)
+			ShmemInitStruct("pg_pathman's zone maps", sizeof(ZoneMapsShared), &found);
+
+	if (!found)
+	{
+		memset(zone_maps_shared, 0, sizeof(ZoneMapsShared));
+		SpinLockInit(&zone_maps_shared->mutex);
+	}
+}
+
+/* Has anybody invalidated zone maps of 'prel' since they were loaded? */
+bool
+zone_maps_need_reload(const PartRelationInfo *prel)
+{
+	uint64	version;
+
+	if (prel->nzone_maps == 0 || !zone_maps_shared)
+		return false;
+
+	SpinLockAcquire(&zone_maps_shared->mutex);
+	version = zone_maps_shared->versions[ZoneMapsBucket(prel->relid)];
+	SpinLockRelease(&zone_maps_shared->mutex);
+
+	return version != prel->zone_maps_version;
+}
+
+/* Can cached zone maps of 'prel' be trusted right now? */
+static bool
+zone_maps_are_current(const PartRelationInfo *prel)
+{
+	int		bucket = ZoneMapsBucket(prel->relid);
+	bool	result;
+
+	/* We can't tell if they're outdated */
+	if (!zone_maps_shared)
+		return false;
+
+	SpinLockAcquire(&zone_maps_shared->mutex);
+	result = zone_maps_shared->pending[bucket] == 0 &&
+			 zone_maps_shared->versions[bucket] == prel->zone_maps_version;
+	SpinLockRelease(&zone_maps_shared->mutex);
+
+	return result;
+}
+
+/* Load zone maps of 'columns' (TEXT[]) into 'prel' */
+void
+fill_prel_with_zone_maps(PartRelationInfo *prel, Datum columns)
+{
+	Oid				zone_maps_relid = get_pathman_zone_maps_relid(true);
+	char		  **attnames;
+	int				nattnames,
+					i;
+	uint32			nchildren = PrelChildrenCount(prel);
+	ChildIdx	   *children;
+	MemoryContext	old_mcxt;
+
+	Relation		rel;
+#if PG_VERSION_NUM >= 120000
+	TableScanDesc	scan;
+#else
+	HeapScanDesc	scan;
+#endif
+	ScanKeyData		key[1];
+	Snapshot		snapshot;
+	HeapTuple		htup;
+
+	/* Frontend might be outdated */
+	if (!OidIsValid(zone_maps_relid) || nchildren == 0)
+		return;
+
+	attnames = deconstruct_text_array(columns, &nattnames);
+	if (nattnames == 0)
+		return;
+
+	/* Must be read before snapshot is taken */
+	if (zone_maps_shared)
+	{
+		SpinLockAcquire(&zone_maps_shared->mutex);
+		prel->zone_maps_version = zone_maps_shared->versions[ZoneMapsBucket(prel->relid)];
+		SpinLockRelease(&zone_maps_shared->mutex);
+	}
+
+	old_mcxt = MemoryContextSwitchTo(prel->mcxt);
+
+	prel->zone_maps = palloc0(nattnames * sizeof(PartZoneMap));
+	prel->nzone_maps = 0;
+
+	for (i = 0; i < nattnames; i++)
+	{
+		PartZoneMap	   *zm;
+		AttrNumber		attnum;
+		Oid				typid,
+						collid;
+		int32			typmod;
+		TypeCacheEntry *tce;
+
+		/* Column might have been dropped */
+		attnum = get_attnum(prel->relid, attnames[i]);
+		if (attnum == InvalidAttrNumber)
+			continue;
+
+		get_atttypetypmodcoll(prel->relid, attnum, &typid, &typmod, &collid);
+
+		tce = lookup_type_cache(typid, TYPECACHE_BTREE_OPFAMILY |
+									   TYPECACHE_CMP_PROC);
+
+		/* Type might have changed as well */
+		if (!OidIsValid(tce->btree_opf) || !OidIsValid(tce->cmp_proc))
+			continue;
+
+		zm = &prel->zone_maps[prel->nzone_maps++];
+
+		zm->attname		= pstrdup(attnames[i]);
+		zm->attnum		= attnum;
+		zm->typid		= typid;
+		zm->collid		= collid;
+		zm->byval		= tce->typbyval;
+		zm->len			= tce->typlen;
+		zm->btree_opf	= tce->btree_opf;
+		fmgr_info_cxt(tce->cmp_proc, &zm->cmp_finfo, prel->mcxt);
+
+		/* Everything is unknown until we've read summaries */
+		zm->valid			= palloc0(nchildren * sizeof(bool));
+		zm->has_values		= palloc0(nchildren * sizeof(bool));
+		zm->refresh_xids	= palloc0(nchildren * sizeof(TransactionId));
+		zm->min_values		= palloc0(nchildren * sizeof(Datum));
+		zm->max_values		= palloc0(nchildren * sizeof(Datum));
+	}
+
+	MemoryContextSwitchTo(old_mcxt);
+
+	/* There's nothing to summarize */
+	if (prel->nzone_maps == 0)
+		return;
+
+	/* Sort children by Oid to find their indices quickly */
+	children = palloc(nchildren * sizeof(ChildIdx));
+	for (i = 0; i < nchildren; i++)
+	{
+		children[i].relid = prel->children[i];
+		children[i].idx = i;
+	}
+	qsort(children, nchildren, sizeof(ChildIdx), oid_cmp_idx);
+
+	ScanKeyInit(&key[0],
+				Anum_pathman_zone_maps_partrel,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(prel->relid));
+
+	rel = heap_open_compat(zone_maps_relid, AccessShareLock);
+	snapshot = RegisterSnapshot(GetLatestSnapshot());
+#if PG_VERSION_NUM >= 120000
+	scan = table_beginscan(rel, snapshot, 1, key);
+#else
+	scan = heap_beginscan(rel, snapshot, 1, key);
+#endif
+
+	while ((htup = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		Datum			values[Natts_pathman_zone_maps];
+		bool			isnull[Natts_pathman_zone_maps];
+		PartZoneMap	   *zm = NULL;
+		ChildIdx		search,
+					   *found;
+		char		   *attname;
+		Oid				typinput,
+						typioparam;
+		uint32			idx;
+
+		heap_deform_tuple(htup, RelationGetDescr(rel), values, isnull);
+
+		/* Skip outdated summaries */
+		if (!DatumGetBool(values[Anum_pathman_zone_maps_valid - 1]))
+			continue;
+
+		/* Find summarized column */
+		attname = TextDatumGetCString(values[Anum_pathman_zone_maps_attname - 1]);
+		for (i = 0; i < prel->nzone_maps; i++)
+			if (strcmp(prel->zone_maps[i].attname, attname) == 0)
+				zm = &prel->zone_maps[i];
+
+		/* Summary of another type is useless */
+		if (!zm || zm->typid != DatumGetObjectId(values[Anum_pathman_zone_maps_atttype - 1]))
+			continue;
+
+		/* Find summarized partition */
+		search.relid = DatumGetObjectId(values[Anum_pathman_zone_maps_partition - 1]);
+		found = bsearch(&search, children, nchildren, sizeof(ChildIdx), oid_cmp_idx);
+		if (!found)
+			continue;
+
+		idx = found->idx;
+
+		zm->valid[idx] = true;
+		zm->refresh_xids[idx] = HeapTupleGetXminCompat(htup);
+
+		/* Partition contains only NULLs */
+		if (isnull[Anum_pathman_zone_maps_min_value - 1] ||
+			isnull[Anum_pathman_zone_maps_max_value - 1])
+			continue;
+
+		getTypeInputInfo(zm->typid, &typinput, &typioparam);
+
+		old_mcxt = MemoryContextSwitchTo(prel->mcxt);
+		zm->min_values[idx] =
+				OidInputFunctionCall(typinput,
+									 TextDatumGetCString(values[Anum_pathman_zone_maps_min_value - 1]),
+									 typioparam, -1);
+		zm->max_values[idx] =
+				OidInputFunctionCall(typinput,
+									 TextDatumGetCString(values[Anum_pathman_zone_maps_max_value - 1]),
+									 typioparam, -1);
+		MemoryContextSwitchTo(old_mcxt);
+
+		zm->has_values[idx] = true;
+	}
+
+	/* Clean resources */
+#if PG_VERSION_NUM >= 120000
+	table_endscan(scan);
+#else
+	heap_endscan(scan);
+#endif
+	UnregisterSnapshot(snapshot);
+	heap_close_compat(rel, AccessShareLock);
+
+	pfree(children);
+}
+
+static int
+oid_cmp_idx(const void *a, const void *b)
+{
+	Oid		lhs = ((const ChildIdx *) a)->relid,
+			rhs = ((const ChildIdx *) b)->relid;
+
+	if (lhs < rhs)
+		return -1;
+	if (lhs > rhs)
+		return 1;
+	return 0;
+}
+
+
+/*
+ * ------------------------
+ *  Conditions & clauses
+ * ------------------------
+ */
+
+/* Return zone map if 'node' is a Var of a summarized column */
+static const PartZoneMap *
+find_zone_map(Node *node, const PartRelationInfo *prel, Index varno)
+{
+	Var	   *var;
+	int		i;
+
+	/* Strip binary-compatible casts (e.g. varchar -> text) */
+	while (node && IsA(node, RelabelType))
+		node = (Node *) ((RelabelType *) node)->arg;
+
+	if (!node || !IsA(node, Var))
+		return NULL;
+
+	var = (Var *) node;
+	if (var->varno != varno || var->varlevelsup != 0)
+		return NULL;
+
+	for (i = 0; i < prel->nzone_maps; i++)
+		if (prel->zone_maps[i].attnum == var->varattno)
+			return &prel->zone_maps[i];
+
+	return NULL;
+}
+
+/* Evaluate Const, Param or stable expr, returns false if it's something else */
+static bool
+zone_map_eval_value(Node *node, ExprContext *econtext,
+					bool check_only, Datum *value, bool *isnull)
+{
+	if (IsA(node, Const))
+	{
+		*value = ((Const *) node)->constvalue;
+		*isnull = ((Const *) node)->constisnull;
+		return true;
+	}
+
+	if (IsA(node, Param) || is_runtime_const_expr(node))
+	{
+		ExprState *estate;
+
+		/* Value will be known at runtime */
+		if (check_only)
+		{
+			*value = (Datum) 0;
+			*isnull = true;
+			return true;
+		}
+
+		if (!econtext)
+			return false;
+
+		estate = ExecInitExpr((Expr *) node, NULL);
+		*value = ExecEvalExprCompat(estate, econtext, isnull);
+		return true;
+	}
+
+	return false;
+}
+
+/* Prepare COLUMN OP VALUE or COLUMN OP ANY(VALUES), 'zm' describes COLUMN */
+static ZoneMapCond *
+build_zone_map_op_cond(Oid opno, Oid inputcollid, Node *value,
+					   bool commuted, bool is_array,
+					   const PartZoneMap *zm,
+					   ExprContext *econtext,
+					   bool check_only)
+{
+	ZoneMapCond	   *cond;
+	int				strategy;
+	Oid				lefttype,
+					righttype,
+					cmp_proc;
+	Datum			datum;
+	bool			isnull;
+
+	/* Summaries were built using column's collation */
+	if (OidIsValid(zm->collid) && inputcollid != zm->collid)
+		return NULL;
+
+	/* Operator must belong to column's btree family */
+	if (!op_in_opfamily(opno, zm->btree_opf))
+		return NULL;
+
+	get_op_opfamily_properties(opno, zm->btree_opf, false,
+							   &strategy, &lefttype, &righttype);
+
+	/* Make it look like COLUMN OP VALUE */
+	if (commuted)
+	{
+		Oid tmp = lefttype;
+
+		lefttype = righttype;
+		righttype = tmp;
+
+		/* Swap < and >, <= and >= */
+		strategy = BTMaxStrategyNumber + 1 - strategy;
+	}
+
+	cmp_proc = get_opfamily_proc(zm->btree_opf, lefttype, righttype, BTORDER_PROC);
+	if (!OidIsValid(cmp_proc))
+		return NULL;
+
+	if (!zone_map_eval_value(value, econtext, check_only, &datum, &isnull))
+		return NULL;
+
+	cond = palloc0(sizeof(ZoneMapCond));
+	cond->kind		= ZMC_OP;
+	cond->zm		= zm;
+	cond->strategy	= strategy;
+	cond->collid	= zm->collid;
+	fmgr_info(cmp_proc, &cond->cmp_finfo);
+
+	/* NULL never matches strict btree operators */
+	if (isnull)
+		return cond;
+
+	if (is_array)
+	{
+		ArrayType  *arr = DatumGetArrayTypeP(datum);
+		Datum	   *elems;
+		bool	   *elem_nulls;
+		int			nelems,
+					i;
+		int16		elmlen;
+		bool		elmbyval;
+		char		elmalign;
+
+		get_typlenbyvalalign(ARR_ELEMTYPE(arr), &elmlen, &elmbyval, &elmalign);
+		deconstruct_array(arr, ARR_ELEMTYPE(arr),
+						  elmlen, elmbyval, elmalign,
+						  &elems, &elem_nulls, &nelems);
+
+		cond->values = palloc(Max(nelems, 1) * sizeof(Datum));
+		for (i = 0; i < nelems; i++)
+			if (!elem_nulls[i])
+				cond->values[cond->nvalues++] = elems[i];
+	}
+	else
+	{
+		cond->values = palloc(sizeof(Datum));
+		cond->values[cond->nvalues++] = datum;
+	}
+
+	return cond;
+}
+
+/*
+ * Prepare 'clause' for checks against zone maps.
+ * Returns NULL if clause can't be used to exclude partitions.
+ */
+static ZoneMapCond *
+build_zone_map_cond(Node *clause,
+					const PartRelationInfo *prel,
+					Index varno,
+					ExprContext *econtext,
+					bool check_only)
+{
+	if (IsA(clause, RestrictInfo))
+		clause = (Node *) ((RestrictInfo *) clause)->clause;
+
+	if (is_andclause_compat(clause) || is_orclause_compat(clause))
+	{
+		bool			is_and = is_andclause_compat(clause);
+		ZoneMapCond	   *cond;
+		List		   *args = NIL;
+		ListCell	   *lc;
+
+		foreach (lc, ((BoolExpr *) clause)->args)
+		{
+			ZoneMapCond *arg = build_zone_map_cond(lfirst(lc), prel, varno,
+												   econtext, check_only);
+
+			/* Unknown arg of OR might hold for any partition */
+			if (!arg && !is_and)
+				return NULL;
+
+			if (arg)
+				args = lappend(args, arg);
+		}
+
+		if (args == NIL)
+			return NULL;
+
+		cond = palloc0(sizeof(ZoneMapCond));
+		cond->kind = is_and ? ZMC_AND : ZMC_OR;
+		cond->args = args;
+
+		return cond;
+	}
+
+	if (IsA(clause, OpExpr) && list_length(((OpExpr *) clause)->args) == 2)
+	{
+		OpExpr			   *expr = (OpExpr *) clause;
+		Node			   *left = linitial(expr->args),
+						   *right = lsecond(expr->args);
+		const PartZoneMap  *zm;
+
+		if ((zm = find_zone_map(left, prel, varno)) != NULL)
+			return build_zone_map_op_cond(expr->opno, expr->inputcollid,
+										  right, false, false,
+										  zm, econtext, check_only);
+
+		if ((zm = find_zone_map(right, prel, varno)) != NULL)
+			return build_zone_map_op_cond(expr->opno, expr->inputcollid,
+										  left, true, false,
+										  zm, econtext, check_only);
+
+		return NULL;
+	}
+
+	/* COLUMN = ANY(VALUES) */
+	if (IsA(clause, ScalarArrayOpExpr))
+	{
+		ScalarArrayOpExpr  *expr = (ScalarArrayOpExpr *) clause;
+		const PartZoneMap  *zm;
+
+		if (!expr->useOr)
+			return NULL;
+
+		if ((zm = find_zone_map(linitial(expr->args), prel, varno)) != NULL)
+			return build_zone_map_op_cond(expr->opno, expr->inputcollid,
+										  lsecond(expr->args),
+										  false, true,
+										  zm, econtext, check_only);
+	}
+
+	return NULL;
+}
+
+/* Can summary of partition be trusted by our snapshot? */
+static bool
+zone_map_is_usable(const PartZoneMap *zm, uint32 part_idx, Snapshot snapshot)
+{
+	if (!zm->valid[part_idx])
+		return false;
+
+	/*
+	 * Refresh must have finished before our snapshot was taken,
+	 * otherwise it might have missed rows that we still see.
+	 */
+	return snapshot &&
+		   TransactionIdPrecedes(zm->refresh_xids[part_idx], snapshot->xmin);
+}
+
+/* Does COLUMN OP VALUE hold for any value of [min, max]? */
+static bool
+zone_map_value_fits(ZoneMapCond *cond, Datum min, Datum max, Datum value)
+{
+#define cmp(a, b) \
+	DatumGetInt32(FunctionCall2Coll(&cond->cmp_finfo, cond->collid, (a), (b)))
+
+	switch (cond->strategy)
+	{
+		case BTLessStrategyNumber:
+			return cmp(min, value) < 0;
+
+		case BTLessEqualStrategyNumber:
+			return cmp(min, value) <= 0;
+
+		case BTEqualStrategyNumber:
+			return cmp(min, value) <= 0 && cmp(max, value) >= 0;
+
+		case BTGreaterEqualStrategyNumber:
+			return cmp(max, value) >= 0;
+
+		case BTGreaterStrategyNumber:
+			return cmp(max, value) > 0;
+
+		default:
+			return true;
+	}
+
+#undef cmp
+}
+
+/* Might partition contain rows satisfying 'cond'? */
+static bool
+zone_map_cond_holds(ZoneMapCond *cond, uint32 part_idx)
+{
+	ListCell   *lc;
+	int			i;
+
+	switch (cond->kind)
+	{
+		case ZMC_AND:
+			foreach (lc, cond->args)
+				if (!zone_map_cond_holds(lfirst(lc), part_idx))
+					return false;
+			return true;
+
+		case ZMC_OR:
+			foreach (lc, cond->args)
+				if (zone_map_cond_holds(lfirst(lc), part_idx))
+					return true;
+			return false;
+
+		case ZMC_OP:
+			{
+				const PartZoneMap *zm = cond->zm;
+
+				/* Partition contains only NULLs */
+				if (!zm->has_values[part_idx])
+					return false;
+
+				for (i = 0; i < cond->nvalues; i++)
+					if (zone_map_value_fits(cond,
+											zm->min_values[part_idx],
+											zm->max_values[part_idx],
+											cond->values[i]))
+						return true;
+			}
+			return false;
+
+		default:
+			elog(ERROR, "unknown zone map condition kind %d", (int) cond->kind);
+			return true; /* keep compiler happy */
+	}
+}
+
+/* Are all zone maps used by 'cond' usable for partition? */
+static bool
+zone_map_cond_usable(ZoneMapCond *cond, uint32 part_idx, Snapshot snapshot)
+{
+	ListCell *lc;
+
+	if (cond->kind == ZMC_OP)
+		return zone_map_is_usable(cond->zm, part_idx, snapshot);
+
+	foreach (lc, cond->args)
+		if (!zone_map_cond_usable(lfirst(lc), part_idx, snapshot))
+			return false;
+
+	return true;
+}
+
+/* Could 'clause' exclude partitions using zone maps? */
+bool
+clause_refers_to_zone_map(Node *clause,
+						  const PartRelationInfo *prel,
+						  Index varno)
+{
+	if (prel->nzone_maps == 0)
+		return false;
+
+	return build_zone_map_cond(clause, prel, varno, NULL, true) != NULL;
+}
+
+/* Extract Vars of summarized columns from 'clauses' */
+List *
+zone_map_vars(List *clauses,
+			  const PartRelationInfo *prel,
+			  Index varno)
+{
+	List	   *result = NIL,
+			   *vars;
+	ListCell   *lc;
+
+	if (prel->nzone_maps == 0)
+		return NIL;
+
+	vars = pull_var_clause_compat((Node *) clauses,
+								  PVC_RECURSE_AGGREGATES,
+								  PVC_RECURSE_PLACEHOLDERS);
+
+	foreach (lc, vars)
+	{
+		if (find_zone_map(lfirst(lc), prel, varno))
+			result = list_append_unique(result, lfirst(lc));
+	}
+
+	return result;
+}
+
+/*
+ * Estimate fraction of partitions selected by a parameterized clause.
+ * Summaries of clustered columns rarely overlap, thus COLUMN = PARAM
+ * should select about one partition (plus unsummarized ones).
+ */
+double
+zone_map_paramsel(Node *clause,
+				  const PartRelationInfo *prel,
+				  Index varno)
+{
+	ZoneMapCond	   *cond;
+	uint32			nchildren = PrelChildrenCount(prel),
+					unknown = 0,
+					i;
+
+	if (prel->nzone_maps == 0 || nchildren == 0 ||
+		!clause_contains_runtime_values(clause))
+		return 1.0;
+
+	cond = build_zone_map_cond(clause, prel, varno, NULL, true);
+	if (!cond || cond->kind != ZMC_OP || cond->strategy != BTEqualStrategyNumber)
+		return 1.0;
+
+	for (i = 0; i < nchildren; i++)
+		if (!cond->zm->valid[i])
+			unknown++;
+
+	return Min(1.0, (double) (unknown + 1) / nchildren);
+}
+
+/*
+ * Exclude partitions whose zone maps contradict 'clauses'.
+ * Pass 'econtext' to evaluate PARAMs, else they will be ignored.
+ */
+List *
+zone_map_prune_ranges(List *ranges,
+					  List *clauses,
+					  const PartRelationInfo *prel,
+					  Index varno,
+					  ExprContext *econtext)
+{
+	List	   *conds = NIL,
+			   *result = NIL;
+	Snapshot	snapshot;
+	ListCell   *lc;
+
+	/* Fast path: nothing to check */
+	if (prel->nzone_maps == 0 || ranges == NIL)
+		return ranges;
+
+	/* Summaries might be outdated, don't prune anything */
+	if (!zone_maps_are_current(prel))
+		return ranges;
+
+	foreach (lc, clauses)
+	{
+		ZoneMapCond *cond = build_zone_map_cond(lfirst(lc), prel, varno,
+												econtext, false);
+
+		if (cond)
+			conds = lappend(conds, cond);
+	}
+
+	if (conds == NIL)
+		return ranges;
+
+	snapshot = ActiveSnapshotSet() ? GetActiveSnapshot() : NULL;
+
+	foreach (lc, ranges)
+	{
+		IndexRange	irange = lfirst_irange(lc);
+		uint32		lower = irange_lower(irange),
+					upper = irange_upper(irange),
+					run_lower = 0,
+					i;
+		bool		lossy = is_irange_lossy(irange),
+					in_run = false;
+
+		for (i = lower; i <= upper; i++)
+		{
+			bool		keep = true;
+			ListCell   *cond_lc;
+
+			foreach (cond_lc, conds)
+			{
+				ZoneMapCond *cond = (ZoneMapCond *) lfirst(cond_lc);
+
+				if (zone_map_cond_usable(cond, i, snapshot) &&
+					!zone_map_cond_holds(cond, i))
+				{
+					keep = false;
+					break;
+				}
+			}
+
+			if (keep && !in_run)
+			{
+				run_lower = i;
+				in_run = true;
+			}
+			else if (!keep && in_run)
+			{
+				result = lappend_irange(result, make_irange(run_lower, i - 1, lossy));
+				in_run = false;
+			}
+		}
+
+		if (in_run)
+			result = lappend_irange(result, make_irange(run_lower, upper, lossy));
+	}
+
+	return result;
+}
+
+
+/*
+ * ------------------------
+ *  Zone maps invalidation
+ * ------------------------
+ */
+
+/*
+ * Invalidate zone map of a partition if new row doesn't fit it.
+ *
+ * NOTE: summaries are marked as invalid right before commit (see
+ * zone_maps_xact_callback()), meanwhile they're not used by anyone.
+ */
+Datum
+pathman_zone_map_trigger_func(PG_FUNCTION_ARGS)
+{
+	TriggerData		   *trigdata = (TriggerData *) fcinfo->context;
+	HeapTuple			new_tuple;
+
+	/* Handle user calls */
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "this function should not be called directly");
+
+	/* Handle wrong fire mode */
+	if (!TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
+		elog(ERROR, "%s: must be fired for row",
+			 trigdata->tg_trigger->tgname);
+
+	if (TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
+		new_tuple = trigdata->tg_newtuple;
+	else
+		new_tuple = trigdata->tg_trigtuple;
+
+	zone_maps_check_tuples(trigdata->tg_relation, &new_tuple, 1);
+
+	PG_RETURN_POINTER(new_tuple);
+}
+
+/*
+ * Invalidate zone map of a partition if any of new rows doesn't fit it.
+ * This is what pathman_zone_map_trigger does, but it's also called for
+ * batches of rows which don't fire AFTER ROW triggers (see multi_insert.c).
+ */
+void
+zone_maps_check_tuples(Relation rel, HeapTuple *tuples, int ntuples)
+{
+	Oid					partition,
+						parent,
+						zone_maps_relid;
+	bool				fits = false;
+
+	partition = RelationGetRelid(rel);
+
+	/* Zone map will be invalidated anyway */
+	if (zone_map_invalidation_is_pending(partition))
+		return;
+
+	/* Summaries must be invalidated even if pg_pathman is disabled */
+	zone_maps_relid = get_pathman_zone_maps_relid(true);
+	if (!OidIsValid(zone_maps_relid))
+	{
+		Oid pathman_schema = get_pathman_schema();
+
+		if (OidIsValid(pathman_schema))
+			zone_maps_relid = get_relname_relid(PATHMAN_ZONE_MAPS, pathman_schema);
+	}
+
+	/* pg_pathman is not installed or outdated */
+	if (!OidIsValid(zone_maps_relid))
+		return;
+
+	parent = get_parent_of_partition(partition);
+	if (!OidIsValid(parent))
+		return;
+
+	/* Check new rows against cached summaries */
+	if (IsPathmanReady())
+	{
+		PartRelationInfo   *prel = get_pathman_relation_info(parent);
+		uint32				part_idx;
+		int					i,
+							j;
+
+		/* Outdated summaries can't tell us anything */
+		if (prel && !zone_maps_need_reload(prel) &&
+			(part_idx = PrelHasPartition(prel, partition)) > 0)
+		{
+			AttrNumber *attnums = palloc(prel->nzone_maps * sizeof(AttrNumber));
+
+			part_idx--;
+			fits = true;
+
+			/* Columns of partition might be in a different order */
+			for (i = 0; i < prel->nzone_maps; i++)
+				attnums[i] = get_attnum(partition, prel->zone_maps[i].attname);
+
+			for (j = 0; j < ntuples && fits; j++)
+			{
+				for (i = 0; i < prel->nzone_maps && fits; i++)
+				{
+					PartZoneMap	   *zm = &prel->zone_maps[i];
+					Datum			value;
+					bool			isnull;
+
+					/* Nothing to invalidate */
+					if (!zm->valid[part_idx] || attnums[i] == InvalidAttrNumber)
+						continue;
+
+					value = heap_getattr(tuples[j], attnums[i],
+										 RelationGetDescr(rel),
+										 &isnull);
+
+					/* NULLs don't affect min & max */
+					if (isnull)
+						continue;
+
+					fits = zm->has_values[part_idx] &&
+						DatumGetInt32(FunctionCall2Coll(&zm->cmp_finfo, zm->collid,
+														zm->min_values[part_idx],
+														value)) <= 0 &&
+						DatumGetInt32(FunctionCall2Coll(&zm->cmp_finfo, zm->collid,
+														zm->max_values[part_idx],
+														value)) >= 0;
+				}
+			}
+
+			pfree(attnums);
+		}
+
+		if (prel)
+			close_pathman_relation_info(prel);
+	}
+
+	if (!fits)
+		add_pending_zone_map_invalidation(zone_maps_relid, partition, parent);
+}
+
+/* Will zone map of partition be invalidated by current transaction? */
+static bool
+zone_map_invalidation_is_pending(Oid partition)
+{
+	ListCell *lc;
+
+	foreach (lc, pending_invalidations)
+	{
+		PendingZoneMapInvalidation *pending = lfirst(lc);
+
+		if (pending->partition == partition)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Remember partition till commit. Parent's zone maps
+ * are not used by anyone until we're done with it.
+ */
+static void
+add_pending_zone_map_invalidation(Oid zone_maps_relid, Oid partition, Oid parent)
+{
+	static bool					callback_registered = false;
+	PendingZoneMapInvalidation *pending;
+	MemoryContext				old_mcxt;
+
+	if (!zone_maps_shared)
+		elog(ERROR, "pg_pathman's zone maps require shared_preload_libraries");
+
+	if (!callback_registered)
+	{
+		RegisterXactCallback(zone_maps_xact_callback, NULL);
+		callback_registered = true;
+	}
+
+	old_mcxt = MemoryContextSwitchTo(TopMemoryContext);
+
+	pending = palloc(sizeof(PendingZoneMapInvalidation));
+	pending->zone_maps_relid = zone_maps_relid;
+	pending->partition = partition;
+	pending->parent = parent;
+	GetUserIdAndSecContext(&pending->userid, &pending->sec_context);
+
+	pending_invalidations = lappend(pending_invalidations, pending);
+
+	MemoryContextSwitchTo(old_mcxt);
+
+	SpinLockAcquire(&zone_maps_shared->mutex);
+	zone_maps_shared->pending[ZoneMapsBucket(parent)]++;
+	SpinLockRelease(&zone_maps_shared->mutex);
+}
+
+/* Write pending invalidations before commit, publish them after it */
+static void
+zone_maps_xact_callback(XactEvent event, void *arg)
+{
+	ListCell   *lc;
+
+	if (pending_invalidations == NIL)
+		return;
+
+	switch (event)
+	{
+		case XACT_EVENT_PRE_COMMIT:
+			foreach (lc, pending_invalidations)
+			{
+				PendingZoneMapInvalidation *pending = lfirst(lc);
+
+				invalidate_zone_maps(pending);
+			}
+			break;
+
+		/* Summaries can't be trusted until COMMIT PREPARED */
+		case XACT_EVENT_PRE_PREPARE:
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("cannot PREPARE a transaction that has "
+							"invalidated zone maps")));
+			break;
+
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_ABORT:
+			SpinLockAcquire(&zone_maps_shared->mutex);
+			foreach (lc, pending_invalidations)
+			{
+				PendingZoneMapInvalidation *pending = lfirst(lc);
+				int							bucket = ZoneMapsBucket(pending->parent);
+
+				/* Cached summaries have become outdated */
+				if (event == XACT_EVENT_COMMIT)
+					zone_maps_shared->versions[bucket]++;
+
+				zone_maps_shared->pending[bucket]--;
+			}
+			SpinLockRelease(&zone_maps_shared->mutex);
+
+			list_free_deep(pending_invalidations);
+			pending_invalidations = NIL;
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * Mark summaries of partition as outdated. This is done by a plain UPDATE
+ * on behalf of the role which has modified partition, so that permissions,
+ * RLS policies and triggers of pathman_zone_maps are respected.
+ */
+static void
+invalidate_zone_maps(PendingZoneMapInvalidation *pending)
+{
+	Oid			save_userid;
+	int			save_sec_context;
+	Snapshot	snapshot;
+	SPIPlanPtr	plan;
+	Oid			types[1]	= { REGCLASSOID };
+	Datum		values[1]	= { ObjectIdGetDatum(pending->partition) };
+	char	   *sql;
+	int			ret;
+
+	/*
+	 * Serialize concurrent writers of the same partition, so that
+	 * the latest snapshot would contain their changes of summaries.
+	 * We're about to commit, so the lock won't be held for long.
+	 */
+	LockDatabaseObject(pending->zone_maps_relid, pending->partition,
+					   0, ExclusiveLock);
+
+	sql = psprintf("UPDATE %s SET valid = false "
+				   "WHERE partition = $1 AND valid",
+				   get_qualified_rel_name(pending->zone_maps_relid));
+
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(pending->userid, pending->sec_context);
+
+	SPI_connect();
+
+	/* Rows might have been updated by writers we've waited for */
+	snapshot = RegisterSnapshot(GetLatestSnapshot());
+
+	plan = SPI_prepare(sql, 1, types);
+	if (!plan)
+		elog(ERROR, "%s: SPI_prepare returned %d",
+			 __FUNCTION__, SPI_result);
+
+	ret = SPI_execute_snapshot(plan, values, NULL,
+							   snapshot, InvalidSnapshot,
+							   false, true, 0);
+	if (ret != SPI_OK_UPDATE)
+		elog(ERROR, "%s: SPI_execute_snapshot returned %d",
+			 __FUNCTION__, ret);
+
+	UnregisterSnapshot(snapshot);
+
+	SPI_finish();
+
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	pfree(sql);
+}
@@ -143,6 +143,225 @@ class Tests(unittest.TestCase):
             self.assertEqual(data[0][0], 300000)
             node.stop()
 
+    def test_parallel_copy(self):
+        """ Test copy_from_parallel() """
+
+        with self.start_new_pathman_cluster() as node:
+            node.safe_psql("""
+                create table abc(id int not null, t text);
+                select create_range_partitions('abc', 'id', 1, 10000, 5);
+                create table def(id int not null, t text);
+                select create_hash_partitions('def', 'id', 4);
+            """)
+
+            # rows 50001..60000 need a new partition
+            filename = os.path.join(node.base_dir, 'parallel_copy.txt')
+            with open(filename, 'w') as f:
+                for i in range(1, 60001):
+                    f.write('%d\trow %d\n' % (i, i))
+
+            for relname in ('abc', 'def'):
+                data = node.execute("select copy_from_parallel('%s', '%s', 3)"
+                                    % (relname, filename))
+                self.assertEqual(data[0][0], 60000)
+
+                data = node.execute('select count(*), count(distinct id) from %s'
+                                    % relname)
+                self.assertEqual(data[0], (60000, 60000))
+                data = node.execute('select count(*) from only %s' % relname)
+                self.assertEqual(data[0][0], 0)
+
+            data = node.execute("""
+                select count(*) from pathman_partition_list
+                where parent = 'abc'::regclass
+            """)
+            self.assertEqual(data[0][0], 6)
+
+            # workers don't commit anything if leader fails
+            with open(filename, 'a') as f:
+                f.write('not a number\tbroken row\n')
+
+            with self.assertRaises(Exception):
+                node.execute("select copy_from_parallel('def', '%s', 3)" % filename)
+
+            data = node.execute('select count(*) from def')
+            self.assertEqual(data[0][0], 60000)
+
+            # workers can't see our uncommitted DDL
+            with node.connect() as con:
+                con.begin()
+                con.execute('alter table def alter column t type varchar')
+                with self.assertRaises(Exception):
+                    con.execute("select copy_from_parallel('def', '%s', 3)"
+                                % filename)
+                con.rollback()
+
+            node.stop()
+
+    def test_provisioning_worker(self):
+        """ Test that ProvisioningWorker keeps partitions ahead of data """
+
+        with self.start_new_pathman_cluster() as node:
+            node.safe_psql("""
+                create table abc(id int not null);
+                select create_range_partitions('abc', 'id', 1, 10, 2);
+                select set_premake('abc', 3);
+                insert into abc values (1);
+            """)
+
+            node.safe_psql('select start_provisioning_worker(1.0)')
+
+            # a second worker for the same database is not allowed
+            with self.assertRaises(Exception):
+                node.safe_psql('select start_provisioning_worker(1.0)')
+
+            def wait_for_partitions(count):
+                for _ in range(100):
+                    data = node.execute("""
+                        select count(*) from pathman_partition_list
+                        where parent = 'abc'::regclass
+                    """)
+                    if data[0][0] == count:
+                        return
+                    time.sleep(0.1)
+                self.fail('worker has not created partitions')
+
+            # 1 used partition + 3 unused ones
+            wait_for_partitions(4)
+
+            # new values land in premade partitions, no spawns on INSERT
+            spawns = node.execute('select backend_spawns from pathman_spawn_stats')
+            node.safe_psql('insert into abc select generate_series(2, 40)')
+            data = node.execute('select backend_spawns from pathman_spawn_stats')
+            self.assertEqual(data, spawns)
+
+            # 4 used partitions + 3 unused ones
+            wait_for_partitions(7)
+
+            node.safe_psql('select stop_provisioning_worker()')
+            node.stop()
+
+    def test_provisioning_launcher(self):
+        """ Test that ProvisioningWorkers are started after restart """
+
+        with self.start_new_pathman_cluster() as node:
+            # ProvisioningLauncher is registered at server start
+            node.append_conf('pg_pathman.provisioning_naptime = 1\n')
+            node.restart()
+
+            node.safe_psql("""
+                create table abc(id int not null);
+                select create_range_partitions('abc', 'id', 1, 10, 2);
+                select set_premake('abc', 3);
+                insert into abc values (1);
+            """)
+
+            def wait_for_partitions(count):
+                for _ in range(100):
+                    data = node.execute("""
+                        select count(*) from pathman_partition_list
+                        where parent = 'abc'::regclass
+                    """)
+                    if data[0][0] == count:
+                        return
+                    time.sleep(0.1)
+                self.fail('worker has not created partitions')
+
+            # 1 used partition + 3 unused ones
+            wait_for_partitions(4)
+
+            # workers are started again after restart
+            node.restart()
+            node.safe_psql('insert into abc select generate_series(2, 40)')
+
+            # 4 used partitions + 3 unused ones
+            wait_for_partitions(7)
+
+            node.stop()
+
+    def test_spawn_worker_pool(self):
+        """ Test that long-lived SpawnPartitionsWorkers serve INSERTs """
+
+        with self.start_new_pathman_cluster() as node:
+            node.append_conf('postgresql.conf', 'pg_pathman.spawn_pool_size = 2\n')
+            node.reload()
+
+            node.safe_psql("""
+                create table abc(id int not null);
+                select create_range_partitions('abc', 'id', 1, 10, 2);
+                select set_spawn_using_bgw('abc', true);
+            """)
+
+            for i in range(3):
+                node.safe_psql('insert into abc values ({})'.format(25 + i * 10))
+
+            # each INSERT got its own partition
+            data = node.execute("""
+                select count(*) from pathman_partition_list
+                where parent = 'abc'::regclass
+            """)
+            self.assertEqual(data[0][0], 5)
+
+            # the same worker has created all of them
+            data = node.execute("""
+                select count(*), sum(processed), bool_and(status = 'idle')
+                from pathman_spawn_workers
+            """)
+            self.assertEqual(data[0], (1, 3, True))
+
+            data = node.execute('select bgw_spawns from pathman_spawn_stats')
+            self.assertEqual(data[0][0], 3)
+
+            # workers serve a single user and connect as that user
+            node.safe_psql('create role alice login superuser')
+            node.safe_psql('insert into abc values (55)', username='alice')
+            data = node.execute("""
+                select count(*), count(distinct userid),
+                       bool_or(userid = 'alice'::regrole)
+                from pathman_spawn_workers
+            """)
+            self.assertEqual(data[0], (2, 2, True))
+
+            # pooled worker waits for our lock, a dedicated one is used instead
+            node.safe_psql("""
+                create table log(id int);
+                create function log_init(args jsonb) returns void as $$
+                    insert into log values (1)
+                $$ language sql;
+                select set_init_callback('abc', 'log_init(jsonb)');
+            """)
+            with node.connect() as con:
+                con.begin()
+                con.execute('set local statement_timeout = 30000')
+                con.execute('lock table log in exclusive mode')
+                con.execute('insert into abc values (65)')
+                con.commit()
+
+            data = node.execute('select count(*) from abc where id = 65')
+            self.assertEqual(data[0][0], 1)
+
+            # settings changed by callbacks don't leak into next requests
+            node.safe_psql("""
+                create table settings_log(work_mem text);
+                create function set_init(args jsonb) returns void as $$
+                begin
+                    insert into settings_log values (current_setting('work_mem'));
+                    set work_mem = '77MB';
+                end
+                $$ language plpgsql;
+                select set_init_callback('abc', 'set_init(jsonb)');
+            """)
+            node.safe_psql('insert into abc values (75)')
+            node.safe_psql('insert into abc values (85)')
+
+            data = node.execute("""
+                select count(*), bool_or(work_mem = '77MB')
+                from settings_log
+            """)
+            self.assertEqual(data[0], (2, False))
+
+            node.stop()
+
     def test_replication(self):
         """ Test how pg_pathman works with replication """
 
@@ -806,6 +1025,69 @@ class Tests(unittest.TestCase):
                 self.assertEqual(int(rows[4][5]), 51)
                 self.assertEqual(int(rows[5][5]), 61)
 
+    def test_conc_part_creation_same_range(self):
+        """ Test concurrent creation of the same partition on INSERT """
+
+        # Create and start new instance
+        with self.start_new_pathman_cluster(allow_streaming=False) as node:
+            # Create table 'ins_test' and partition it
+            with node.connect() as con0:
+                # yapf: disable
+                con0.begin()
+                con0.execute("create table ins_test(val int not null)")
+                con0.execute("select create_range_partitions('ins_test', 'val', 1, 10, 5)")
+                con0.commit()
+
+            # Create two separate connections for this test
+            with node.connect() as con1, node.connect() as con2:
+
+                # Thread for connection #2 (it has to wait)
+                def con2_thread():
+                    con2.execute('insert into ins_test values(55)')
+                    con2.commit()
+
+                # Step 1: create partition [51, 61) in con1
+                con1.begin()
+                con1.execute('insert into ins_test values(52)')
+
+                # Step 2: try inserting a value of the same range in con2 (waiting)
+                con2.begin()
+                con2.execute('select count(*) from ins_test')  # load pathman's cache
+                t = threading.Thread(target=con2_thread)
+                t.start()
+
+                # Step 3: wait until 't' locks the range (not the parent)
+                while True:
+                    with node.connect() as con0:
+                        locks = con0.execute("""
+                            select count(*) from pg_locks
+                            where granted = 'f' and locktype = 'advisory'
+                        """)
+
+                        if int(locks[0][0]) > 0:
+                            break
+
+                # Step 4: commit partition (unlock)
+                con1.commit()
+
+                # Step 5: wait for con2
+                t.join()
+
+                rows = con1.execute("""
+                    select val, tableoid::regclass::text from ins_test
+                    where val > 50 order by val
+                """)
+
+                # both rows should be in the partition created by con1
+                self.assertEqual(rows, [(52, 'ins_test_6'), (55, 'ins_test_6')])
+
+                # check number of partitions
+                rows = con1.execute("""
+                    select count(*) from pathman_partition_list
+                    where parent = 'ins_test'::regclass
+                """)
+                self.assertEqual(int(rows[0][0]), 6)
+
     def test_conc_part_merge_insert(self):
         """ Test concurrent merge_range_partitions() + INSERT """
 
@@ -1078,6 +1360,54 @@ class Tests(unittest.TestCase):
             node.psql('postgres', 'DROP SCHEMA test_update_node CASCADE;')
             node.psql('postgres', 'DROP EXTENSION pg_pathman CASCADE;')
 
+    def test_update_delete_pruning(self):
+        '''
+        UPDATE and DELETE touching several HASH partitions should keep
+        only the matching ones as result relations (CHECK constraints of
+        HASH partitions are useless for constraint exclusion).
+        '''
+
+        if version < LooseVersion('14'):
+            self.skipTest('requires UPDATE/DELETE planned as appendrel')
+
+        def target_tables(con, query):
+            plan = con.execute('EXPLAIN (COSTS OFF, FORMAT JSON) ' + query)[0][0]
+            nodes = [plan[0]["Plan"]]
+            while nodes:
+                node = nodes.pop()
+                if node["Node Type"] == "ModifyTable":
+                    return len(node.get("Target Tables", [node]))
+                nodes.extend(node.get("Plans", []))
+            return 0
+
+        with self.start_new_pathman_cluster() as node:
+            node.safe_psql("""
+                CREATE TABLE hash_dml(id INT4 NOT NULL, val INT4);
+                INSERT INTO hash_dml SELECT i, i FROM generate_series(1, 1000) i;
+                SELECT create_hash_partitions('hash_dml', 'id', 10);
+
+                /* Plain inheritance child, not a partition of pg_pathman */
+                CREATE TABLE hash_dml_extra() INHERITS (hash_dml);
+            """)
+
+            with node.connect() as con:
+                self.assertLessEqual(
+                    target_tables(con, 'UPDATE hash_dml SET val = 0 WHERE id IN (1, 2)'), 3)
+                self.assertLessEqual(
+                    target_tables(con, 'DELETE FROM hash_dml WHERE id = 3 OR id = 4'), 3)
+                self.assertEqual(
+                    target_tables(con, 'DELETE FROM hash_dml WHERE val = 5'), 11)
+
+                # Make sure that matching rows are still processed
+                con.execute('UPDATE hash_dml SET val = 0 WHERE id IN (1, 2)')
+                con.execute('DELETE FROM hash_dml WHERE id = 3 OR id = 4')
+                con.commit()
+
+                self.assertEqual(
+                    con.execute('SELECT count(*) FROM hash_dml WHERE val = 0')[0][0], 2)
+                self.assertEqual(
+                    con.execute('SELECT count(*) FROM hash_dml')[0][0], 998)
+
     def test_concurrent_updates(self):
         '''
         Test whether conncurrent updates work correctly between
@@ -1110,6 +1440,117 @@ class Tests(unittest.TestCase):
                 self.assertEqual(node.execute("select count(*) from test1")[0][0], 100)
 
 
+    def test_bulk_children_planning(self):
+        '''
+        Compare planning time of a query which keeps almost all partitions
+        with and without bulk child mode. Numbers of partitions are taken
+        from PLANNING_BENCH_PARTITIONS (e.g. "1000,10000,50000").
+        '''
+
+        counts = os.environ.get('PLANNING_BENCH_PARTITIONS', '1000')
+        counts = [int(c) for c in counts.split(',') if c.strip()]
+
+        def planning_time(con, query):
+            plan = con.execute('EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF) ' + query)
+            for row in plan:
+                m = re.match(r'Planning time: ([0-9.]+) ms', row[0], re.IGNORECASE)
+                if m:
+                    return float(m.group(1))
+            self.fail('planning time not found')
+
+        def plan_text(con, query):
+            plan = con.execute('EXPLAIN (COSTS OFF) ' + query)
+            return [row[0] for row in plan]
+
+        with get_new_node('test_bulk_children') as node:
+            node.init()
+            node.append_conf('postgresql.conf', """
+                shared_preload_libraries=\'pg_pathman\'
+                max_locks_per_transaction=%d
+            """ % (max(counts) // 50 + 64))
+            node.start()
+            node.psql('postgres', 'CREATE EXTENSION pg_pathman;')
+
+            for count in counts:
+                node.safe_psql('postgres', """
+                    CREATE TABLE bench_%d(id INT4 NOT NULL, val INT4);
+                    SELECT create_range_partitions('bench_%d', 'id', 1, 10, %d);
+                    ALTER TABLE bench_%d_2 ADD CHECK (val <> 1);
+                """ % (count, count, count, count))
+
+                # Keep all partitions except the first one (and the
+                # second one, which is excluded by its own CHECK)
+                query = 'SELECT * FROM bench_%d WHERE id > 5 AND val = 1' % count
+
+                with node.connect() as con:
+                    con.execute('SET pg_pathman.bulk_children_threshold = 0')
+                    regular_plan = plan_text(con, query)
+                    planning_time(con, query)  # warm up caches
+                    regular = min(planning_time(con, query) for i in range(3))
+
+                    con.execute('SET pg_pathman.bulk_children_threshold = 1')
+                    bulk_plan = plan_text(con, query)
+                    bulk = min(planning_time(con, query) for i in range(3))
+
+                # Both modes must produce the same plan
+                self.assertEqual(regular_plan, bulk_plan)
+
+                logging.info('bulk children planning (%d partitions): '
+                             'regular %.3f ms, bulk %.3f ms',
+                             count, regular, bulk)
+                print('%d partitions: regular %.3f ms, bulk %.3f ms'
+                      % (count, regular, bulk))
+
+                node.safe_psql('postgres', 'DROP TABLE bench_%d CASCADE' % count)
+
+    def test_hooks_overhead(self):
+        '''
+        Measure per-statement overhead of pg_pathman's hooks for queries
+        over non-partitioned tables (pgbench -S with and without the
+        extension loaded). Duration is taken from OVERHEAD_BENCH_SECONDS.
+        '''
+
+        duration = int(os.environ.get('OVERHEAD_BENCH_SECONDS', '5'))
+
+        def run_pgbench(node):
+            bench = node.pgbench(stdout=subprocess.PIPE,
+                                 stderr=subprocess.STDOUT,
+                                 options=["-S", "-M", "simple",
+                                          "-c", "4", "-j", "4",
+                                          "-T", "%d" % duration])
+            out, _ = bench.communicate()
+            m = re.search(r'tps = ([0-9.]+)', out.decode())
+            self.assertIsNotNone(m, msg=out.decode())
+            return float(m.group(1))
+
+        with get_new_node('test_hooks_overhead') as node:
+            node.init()
+            node.start()
+
+            with open(os.devnull, 'w') as fnull:
+                node.pgbench(stdout=fnull, stderr=fnull, options=["-i"]).wait()
+
+            # Vanilla server
+            tps_vanilla = run_pgbench(node)
+
+            # pg_pathman is loaded and there's one partitioned table
+            node.append_conf("shared_preload_libraries='pg_pathman'\n")
+            node.restart()
+            node.safe_psql('postgres', """
+                CREATE EXTENSION pg_pathman;
+                CREATE TABLE part_test(id INT4 NOT NULL);
+                SELECT create_range_partitions('part_test', 'id', 1, 10, 10);
+            """)
+            tps_pathman = run_pgbench(node)
+
+            overhead = (1.0 / tps_pathman - 1.0 / tps_vanilla) * 1e6 * 4
+            logging.info('pgbench -S: vanilla %.1f tps, pg_pathman %.1f tps '
+                         '(%.2f us per statement)',
+                         tps_vanilla, tps_pathman, overhead)
+            print('pgbench -S: vanilla %.1f tps, pg_pathman %.1f tps '
+                  '(%.2f us per statement)'
+                  % (tps_vanilla, tps_pathman, overhead))
+
 def make_updates(node, count):
     update_sql = '''
     BEGIN;